@@ -0,0 +1,658 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file compile_bench.cpp
+ *
+ * Compiles and links every program of a shader-db style corpus of
+ * .shader_test files on several threads, and reports the time and the number
+ * of allocations spent in each phase of the compiler.
+ *
+ * The totals can be saved, and a later run compared against them fails if
+ * any of them grew by more than a threshold.  Times are summed over the
+ * threads, so runs to be compared should use the same number of threads.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "c11/threads.h"
+#include "main/mtypes.h"
+#include "main/shaderobj.h"
+#include "compiler/nir/nir.h"
+#include "util/ralloc.h"
+#include "util/string_to_uint_map.h"
+#include "util/u_atomic.h"
+#include "glsl_parser_extras.h"
+#include "glsl_to_nir.h"
+#include "program.h"
+#include "standalone.h"
+
+enum bench_phase {
+   PHASE_PREPROCESS,
+   PHASE_PARSE,
+   PHASE_AST_TO_HIR,
+   PHASE_OPTIMIZE,
+   PHASE_LINK,
+   PHASE_GLSL_TO_NIR,
+   PHASE_COUNT,
+   PHASE_NONE = PHASE_COUNT
+};
+
+/* The compile phases match the names _mesa_glsl_compile_shader() reports. */
+static const char *const phase_names[PHASE_COUNT] = {
+   "preprocess",
+   "parse",
+   "ast_to_hir",
+   "optimize",
+   "link",
+   "glsl_to_nir",
+};
+
+#ifdef __GLIBC__
+/* Count the allocations made by each thread by wrapping the allocator. */
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t nmemb, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static __thread uint64_t thread_allocations;
+
+extern "C" void *
+malloc(size_t size) __THROW
+{
+   thread_allocations++;
+   return __libc_malloc(size);
+}
+
+extern "C" void *
+calloc(size_t nmemb, size_t size) __THROW
+{
+   thread_allocations++;
+   return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *
+realloc(void *ptr, size_t size) __THROW
+{
+   thread_allocations++;
+   return __libc_realloc(ptr, size);
+}
+
+static const bool count_allocations = true;
+#else
+static const uint64_t thread_allocations = 0;
+static const bool count_allocations = false;
+#endif
+
+struct bench_shader {
+   GLenum type;
+   const char *source;
+};
+
+struct bench_program {
+   const char *name;
+   int glsl_version;
+   unsigned num_shaders;
+   struct bench_shader *shaders;
+};
+
+enum program_status {
+   PROGRAM_LINKED,
+   PROGRAM_FAILED,
+   PROGRAM_SKIPPED,
+};
+
+struct bench_thread {
+   /* First, so that the compile phase hook can find the thread. */
+   struct gl_context ctx;
+
+   thrd_t thread;
+
+   enum bench_phase phase;
+   uint64_t phase_start_ns;
+   uint64_t phase_start_allocations;
+
+   uint64_t ns[PHASE_COUNT];
+   uint64_t allocations[PHASE_COUNT];
+   unsigned num_status[PROGRAM_SKIPPED + 1];
+};
+
+static int num_threads = 1;
+static int do_glsl_to_nir;
+static const char *save_file;
+static const char *baseline_file;
+static double threshold = 10.0;
+
+static struct bench_program *programs;
+static unsigned num_programs;
+static unsigned next_program;
+
+static const nir_shader_compiler_options nir_options = {};
+
+const struct option bench_opts[] = {
+   { "threads",   required_argument, NULL, 'j' },
+   { "nir",       no_argument,       &do_glsl_to_nir, 1 },
+   { "save",      required_argument, NULL, 's' },
+   { "baseline",  required_argument, NULL, 'b' },
+   { "threshold", required_argument, NULL, 't' },
+   { NULL, 0, NULL, 0 }
+};
+
+static void
+usage_fail(const char *name)
+{
+   printf("usage: %s [options] <directory | file.shader_test>...\n"
+          "\n"
+          "Possible options are:\n"
+          "    --threads=N       compile on N threads (default 1)\n"
+          "    --nir             also translate the linked shaders to NIR\n"
+          "    --save=FILE       save the totals to FILE\n"
+          "    --baseline=FILE   fail if a total grew past the threshold\n"
+          "                      compared to the ones saved in FILE\n"
+          "    --threshold=PCT   regression threshold in percent (default 10)\n",
+          name);
+   exit(EXIT_FAILURE);
+}
+
+static uint64_t
+get_time_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+end_phase(struct bench_thread *t)
+{
+   if (t->phase == PHASE_NONE)
+      return;
+
+   t->ns[t->phase] += get_time_ns() - t->phase_start_ns;
+   t->allocations[t->phase] += thread_allocations - t->phase_start_allocations;
+   t->phase = PHASE_NONE;
+}
+
+static void
+begin_phase(struct bench_thread *t, enum bench_phase phase)
+{
+   end_phase(t);
+
+   t->phase = phase;
+   t->phase_start_ns = get_time_ns();
+   t->phase_start_allocations = thread_allocations;
+}
+
+static void
+compile_phase_hook(struct gl_context *ctx, const char *name)
+{
+   struct bench_thread *t = (struct bench_thread *) ctx;
+
+   if (name) {
+      for (unsigned i = 0; i < PHASE_COUNT; i++) {
+         if (strcmp(name, phase_names[i]) == 0) {
+            begin_phase(t, (enum bench_phase) i);
+            return;
+         }
+      }
+   }
+
+   end_phase(t);
+}
+
+static char *
+load_text_file(void *mem_ctx, const char *file_name)
+{
+   FILE *fp = fopen(file_name, "rb");
+   char *text;
+   long size;
+
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0L, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0L, SEEK_SET);
+
+   text = (char *) ralloc_size(mem_ctx, size + 1);
+   if (size < 0 || fread(text, 1, size, fp) != (size_t) size) {
+      ralloc_free(text);
+      text = NULL;
+   } else {
+      text[size] = '\0';
+   }
+
+   fclose(fp);
+   return text;
+}
+
+static const struct {
+   const char *section;
+   GLenum type;
+} shader_sections[] = {
+   { "[vertex shader]",                  GL_VERTEX_SHADER },
+   { "[tessellation control shader]",    GL_TESS_CONTROL_SHADER },
+   { "[tessellation evaluation shader]", GL_TESS_EVALUATION_SHADER },
+   { "[geometry shader]",                GL_GEOMETRY_SHADER },
+   { "[fragment shader]",                GL_FRAGMENT_SHADER },
+   { "[compute shader]",                 GL_COMPUTE_SHADER },
+};
+
+static void
+add_shader(void *mem_ctx, struct bench_program *prog, GLenum type,
+           const char *source)
+{
+   prog->shaders = reralloc(mem_ctx, prog->shaders, struct bench_shader,
+                            prog->num_shaders + 1);
+   prog->shaders[prog->num_shaders].type = type;
+   prog->shaders[prog->num_shaders].source = source;
+   prog->num_shaders++;
+}
+
+/**
+ * Splits a .shader_test file into its shaders, in place.  Only the GLSL
+ * requirement and the shader sections are looked at.
+ */
+static void
+parse_shader_test(void *mem_ctx, struct bench_program *prog, char *text)
+{
+   const char *source = NULL;
+   GLenum type = GL_NONE;
+   bool in_require = false;
+   char *line = text;
+
+   prog->glsl_version = 110;
+
+   while (*line) {
+      char *next = strchr(line, '\n');
+      next = next ? next + 1 : line + strlen(line);
+
+      if (line[0] == '[') {
+         GLenum new_type = GL_NONE;
+
+         for (unsigned i = 0; i < ARRAY_SIZE(shader_sections); i++) {
+            const char *section = shader_sections[i].section;
+
+            if (strncmp(line, section, strlen(section)) == 0)
+               new_type = shader_sections[i].type;
+         }
+         in_require = strncmp(line, "[require]", 9) == 0;
+
+         /* Terminate the previous shader's source. */
+         if (source) {
+            *line = '\0';
+            add_shader(mem_ctx, prog, type, source);
+         }
+
+         type = new_type;
+         source = type != GL_NONE ? next : NULL;
+      } else if (in_require) {
+         unsigned major, minor;
+
+         if (sscanf(line, "GLSL >= %u.%u", &major, &minor) == 2 ||
+             sscanf(line, "GLSL ES >= %u.%u", &major, &minor) == 2)
+            prog->glsl_version = major * 100 + minor;
+      }
+
+      line = next;
+   }
+
+   if (source)
+      add_shader(mem_ctx, prog, type, source);
+}
+
+static bool
+has_suffix(const char *str, const char *suffix)
+{
+   const size_t len = strlen(str);
+   const size_t suffix_len = strlen(suffix);
+
+   return len >= suffix_len && strcmp(str + len - suffix_len, suffix) == 0;
+}
+
+/**
+ * Adds the programs of a .shader_test file, or of the ones found anywhere
+ * under a directory.
+ */
+static bool
+add_programs(void *mem_ctx, const char *path)
+{
+   struct stat st;
+
+   if (stat(path, &st) != 0) {
+      fprintf(stderr, "Cannot open %s\n", path);
+      return false;
+   }
+
+   if (S_ISDIR(st.st_mode)) {
+      DIR *dir = opendir(path);
+      struct dirent *entry;
+      bool ok = true;
+
+      if (!dir) {
+         fprintf(stderr, "Cannot open %s\n", path);
+         return false;
+      }
+
+      while ((entry = readdir(dir)) != NULL) {
+         if (entry->d_name[0] == '.')
+            continue;
+
+         char *child = ralloc_asprintf(mem_ctx, "%s/%s", path, entry->d_name);
+         if (stat(child, &st) == 0 &&
+             (S_ISDIR(st.st_mode) || has_suffix(child, ".shader_test")))
+            ok = add_programs(mem_ctx, child) && ok;
+      }
+
+      closedir(dir);
+      return ok;
+   }
+
+   char *text = load_text_file(mem_ctx, path);
+   if (!text) {
+      fprintf(stderr, "Cannot read %s\n", path);
+      return false;
+   }
+
+   programs = reralloc(mem_ctx, programs, struct bench_program,
+                       num_programs + 1);
+
+   struct bench_program *prog = &programs[num_programs++];
+   memset(prog, 0, sizeof(*prog));
+   prog->name = path;
+   parse_shader_test(mem_ctx, prog, text);
+
+   return true;
+}
+
+static enum program_status
+compile_program(struct bench_thread *t, const struct bench_program *prog)
+{
+   struct gl_context *ctx = &t->ctx;
+   bool ok = true;
+
+   if (prog->num_shaders == 0 ||
+       !standalone_initialize_context(ctx, prog->glsl_version))
+      return PROGRAM_SKIPPED;
+
+   ctx->Driver.GLSLCompilePhase = compile_phase_hook;
+
+   struct gl_shader_program *whole_program =
+      rzalloc(NULL, struct gl_shader_program);
+   whole_program->data = rzalloc(whole_program, struct gl_shader_program_data);
+   whole_program->data->InfoLog = ralloc_strdup(whole_program->data, "");
+
+   whole_program->AttributeBindings = new string_to_uint_map;
+   whole_program->FragDataBindings = new string_to_uint_map;
+   whole_program->FragDataIndexBindings = new string_to_uint_map;
+
+   whole_program->Shaders = ralloc_array(whole_program, struct gl_shader *,
+                                         prog->num_shaders);
+
+   for (unsigned i = 0; i < prog->num_shaders; i++) {
+      struct gl_shader *shader = rzalloc(whole_program, gl_shader);
+
+      shader->Type = prog->shaders[i].type;
+      shader->Stage = _mesa_shader_enum_to_shader_stage(shader->Type);
+      shader->Source = prog->shaders[i].source;
+
+      whole_program->Shaders[whole_program->NumShaders++] = shader;
+
+      _mesa_glsl_compile_shader(ctx, shader, false, false, true);
+      if (!shader->CompileStatus) {
+         fprintf(stderr, "%s: compile failed\n%s", prog->name,
+                 shader->InfoLog);
+         ok = false;
+         break;
+      }
+   }
+
+   if (ok) {
+      _mesa_clear_shader_program_data(ctx, whole_program);
+
+      begin_phase(t, PHASE_LINK);
+      link_shaders(ctx, whole_program);
+      end_phase(t);
+
+      if (!whole_program->data->LinkStatus) {
+         fprintf(stderr, "%s: link failed\n%s", prog->name,
+                 whole_program->data->InfoLog);
+         ok = false;
+      }
+   }
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (!whole_program->_LinkedShaders[i])
+         continue;
+
+      if (ok && do_glsl_to_nir) {
+         begin_phase(t, PHASE_GLSL_TO_NIR);
+         nir_shader *nir = glsl_to_nir(whole_program, (gl_shader_stage) i,
+                                       &nir_options);
+         end_phase(t);
+         ralloc_free(nir);
+      }
+
+      ralloc_free(whole_program->_LinkedShaders[i]->Program);
+   }
+
+   _mesa_clear_shader_program_data(ctx, whole_program);
+
+   delete whole_program->AttributeBindings;
+   delete whole_program->FragDataBindings;
+   delete whole_program->FragDataIndexBindings;
+
+   ralloc_free(whole_program);
+
+   return ok ? PROGRAM_LINKED : PROGRAM_FAILED;
+}
+
+static int
+bench_thread_func(void *data)
+{
+   struct bench_thread *t = (struct bench_thread *) data;
+   unsigned i;
+
+   t->phase = PHASE_NONE;
+
+   while ((i = p_atomic_inc_return(&next_program) - 1) < num_programs)
+      t->num_status[compile_program(t, &programs[i])]++;
+
+   return 0;
+}
+
+static bool
+save_totals(const char *file_name, const uint64_t *ns,
+            const uint64_t *allocations)
+{
+   FILE *fp = fopen(file_name, "w");
+
+   if (!fp) {
+      fprintf(stderr, "Cannot write %s\n", file_name);
+      return false;
+   }
+
+   for (unsigned i = 0; i < PHASE_COUNT; i++) {
+      fprintf(fp, "%s %" PRIu64 " %" PRIu64 "\n",
+              phase_names[i], ns[i], allocations[i]);
+   }
+
+   fclose(fp);
+   return true;
+}
+
+static bool
+regressed(const char *phase, const char *what, uint64_t value, uint64_t base)
+{
+   if (base == 0 || value <= base * (1.0 + threshold / 100.0))
+      return false;
+
+   fprintf(stderr, "%s: %s regressed by %.1f%%\n", phase, what,
+           (value - base) * 100.0 / base);
+   return true;
+}
+
+/**
+ * Returns true if no total grew past the threshold, compared to the ones
+ * saved by an earlier run.
+ */
+static bool
+compare_totals(const char *file_name, const uint64_t *ns,
+               const uint64_t *allocations)
+{
+   FILE *fp = fopen(file_name, "r");
+   char phase[64];
+   uint64_t base_ns, base_allocations;
+   bool ok = true;
+
+   if (!fp) {
+      fprintf(stderr, "Cannot read %s\n", file_name);
+      return false;
+   }
+
+   while (fscanf(fp, "%63s %" SCNu64 " %" SCNu64,
+                 phase, &base_ns, &base_allocations) == 3) {
+      for (unsigned i = 0; i < PHASE_COUNT; i++) {
+         if (strcmp(phase, phase_names[i]) != 0)
+            continue;
+
+         ok = !regressed(phase, "time", ns[i], base_ns) && ok;
+         if (count_allocations) {
+            ok = !regressed(phase, "allocations", allocations[i],
+                            base_allocations) && ok;
+         }
+      }
+   }
+
+   fclose(fp);
+   return ok;
+}
+
+int
+main(int argc, char * const* argv)
+{
+   int c;
+   int idx = 0;
+
+   while ((c = getopt_long(argc, argv, "j:", bench_opts, &idx)) != -1) {
+      switch (c) {
+      case 'j':
+         num_threads = strtol(optarg, NULL, 10);
+         break;
+      case 's':
+         save_file = optarg;
+         break;
+      case 'b':
+         baseline_file = optarg;
+         break;
+      case 't':
+         threshold = strtod(optarg, NULL);
+         break;
+      case 0:
+         break;
+      default:
+         usage_fail(argv[0]);
+      }
+   }
+
+   if (argc <= optind || num_threads < 1)
+      usage_fail(argv[0]);
+
+   void *mem_ctx = ralloc_context(NULL);
+   bool ok = true;
+
+   for (int i = optind; i < argc; i++)
+      ok = add_programs(mem_ctx, argv[i]) && ok;
+
+   if (!ok)
+      return EXIT_FAILURE;
+
+   struct bench_thread **threads = (struct bench_thread **)
+      calloc(num_threads, sizeof(*threads));
+   const uint64_t start = get_time_ns();
+
+   for (int i = 0; i < num_threads; i++) {
+      threads[i] = (struct bench_thread *) calloc(1, sizeof(*threads[i]));
+      if (thrd_create(&threads[i]->thread, bench_thread_func,
+                      threads[i]) != thrd_success) {
+         fprintf(stderr, "Cannot create thread\n");
+         return EXIT_FAILURE;
+      }
+   }
+
+   uint64_t ns[PHASE_COUNT] = { 0 };
+   uint64_t allocations[PHASE_COUNT] = { 0 };
+   unsigned num_status[PROGRAM_SKIPPED + 1] = { 0 };
+
+   for (int i = 0; i < num_threads; i++) {
+      thrd_join(threads[i]->thread, NULL);
+
+      for (unsigned j = 0; j < PHASE_COUNT; j++) {
+         ns[j] += threads[i]->ns[j];
+         allocations[j] += threads[i]->allocations[j];
+      }
+      for (unsigned j = 0; j <= PROGRAM_SKIPPED; j++)
+         num_status[j] += threads[i]->num_status[j];
+
+      free(threads[i]);
+   }
+
+   const uint64_t wall_ns = get_time_ns() - start;
+   free(threads);
+
+   printf("%-12s %12s %14s\n", "phase", "time (ms)", "allocations");
+   for (unsigned i = 0; i < PHASE_COUNT; i++) {
+      if (i == PHASE_GLSL_TO_NIR && !do_glsl_to_nir)
+         continue;
+
+      if (count_allocations) {
+         printf("%-12s %12.3f %14" PRIu64 "\n",
+                phase_names[i], ns[i] / 1e6, allocations[i]);
+      } else {
+         printf("%-12s %12.3f %14s\n", phase_names[i], ns[i] / 1e6, "-");
+      }
+   }
+   printf("\n%u programs linked, %u failed, %u skipped in %.3f ms "
+          "on %d threads\n",
+          num_status[PROGRAM_LINKED], num_status[PROGRAM_FAILED],
+          num_status[PROGRAM_SKIPPED], wall_ns / 1e6, num_threads);
+
+   if (save_file)
+      ok = save_totals(save_file, ns, allocations) && ok;
+
+   if (baseline_file)
+      ok = compare_totals(baseline_file, ns, allocations) && ok;
+
+   ralloc_free(mem_ctx);
+   _mesa_glsl_release_types();
+   _mesa_glsl_release_builtin_functions();
+
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
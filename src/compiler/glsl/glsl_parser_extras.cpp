@@ -31,12 +31,14 @@
 #include "main/formats.h"
 #include "main/shaderobj.h"
 #include "util/u_atomic.h" /* for p_atomic_cmpxchg */
+#include "util/hash_table.h"
 #include "util/ralloc.h"
 #include "ast.h"
 #include "glsl_parser_extras.h"
 #include "glsl_parser.h"
 #include "ir_optimization.h"
 #include "loop_analysis.h"
+#include "shader_cache.h"
 
 /**
  * Format a short human-readable description of the given GLSL version.
@@ -1899,22 +1901,54 @@ do_late_parsing_checks(struct _mesa_glsl_parse_state *state)
    }
 }
 
+static inline void
+begin_compile_phase(struct gl_context *ctx, const char *phase)
+{
+   if (ctx->Driver.GLSLCompilePhase)
+      ctx->Driver.GLSLCompilePhase(ctx, phase);
+}
+
 void
 _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
-                          bool dump_ast, bool dump_hir)
+                          bool dump_ast, bool dump_hir, bool force_recompile)
 {
+   const char *source = force_recompile && shader->FallbackSource ?
+      shader->FallbackSource : shader->Source;
+
+   if (!force_recompile && ctx->Cache) {
+      shader_cache_compute_shader_sha1(ctx, shader, source);
+
+      if (shader_cache_has_shader(ctx, shader)) {
+         /* The shader compiled before and a program linked from it is in
+          * the cache, so defer compiling it until a link misses the cache.
+          */
+         ralloc_free(shader->ir);
+         shader->ir = NULL;
+         shader->symbols = NULL;
+
+         ralloc_free(shader->InfoLog);
+         shader->InfoLog = ralloc_strdup(shader, "");
+         shader->CompileStatus = true;
+
+         free((void *) shader->FallbackSource);
+         shader->FallbackSource = strdup(source);
+         return;
+      }
+   }
+
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
-   const char *source = shader->Source;
 
    if (ctx->Const.GenerateTemporaryNames)
       (void) p_atomic_cmpxchg(&ir_variable::temporaries_allocate_names,
                               false, true);
 
+   begin_compile_phase(ctx, "preprocess");
    state->error = glcpp_preprocess(state, &source, &state->info_log,
                              add_builtin_defines, state, ctx);
 
    if (!state->error) {
+     begin_compile_phase(ctx, "parse");
      _mesa_glsl_lexer_ctor(state, source);
      _mesa_glsl_parse(state);
      _mesa_glsl_lexer_dtor(state);
@@ -1930,8 +1964,10 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 
    ralloc_free(shader->ir);
    shader->ir = new(shader) exec_list;
-   if (!state->error && !state->translation_unit.is_empty())
+   if (!state->error && !state->translation_unit.is_empty()) {
+      begin_compile_phase(ctx, "ast_to_hir");
       _mesa_ast_to_hir(shader->ir, state);
+   }
 
    if (!state->error) {
       validate_ir_tree(shader->ir);
@@ -1947,14 +1983,14 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
       struct gl_shader_compiler_options *options =
          &ctx->Const.ShaderCompilerOptions[shader->Stage];
 
+      begin_compile_phase(ctx, "optimize");
       assign_subroutine_indexes(shader, state);
       lower_subroutine(shader->ir, state);
       /* Do some optimization at compile time to reduce shader IR size
        * and reduce later work if the same shader is linked multiple times
        */
-      while (do_common_optimization(shader->ir, false, false, options,
-                                    ctx->Const.NativeIntegers))
-         ;
+      do_common_optimization_loop(shader->ir, false, false, options,
+                                  ctx->Const.NativeIntegers);
 
       validate_ir_tree(shader->ir);
 
@@ -2025,110 +2061,465 @@ _mesa_glsl_compile_shader(struct gl_context *ctx, struct gl_shader *shader,
 
    delete state->symbols;
    ralloc_free(state);
+
+   free((void *) shader->FallbackSource);
+   shader->FallbackSource = NULL;
+
+   begin_compile_phase(ctx, NULL);
 }
 
 } /* extern "C" */
+namespace {
+
 /**
- * Do the set of common optimizations passes
+ * Bookkeeping for do_common_optimization_loop().
  *
- * \param ir                          List of instructions to be optimized
- * \param linked                      Is the shader linked?  This enables
- *                                    optimizations passes that remove code at
- *                                    global scope and could cause linking to
- *                                    fail.
- * \param uniform_locations_assigned  Have locations already been assigned for
- *                                    uniforms?  This prevents the declarations
- *                                    of unused uniforms from being removed.
- *                                    The setting of this flag only matters if
- *                                    \c linked is \c true.
- * \param options                     The driver's preferred shader options.
- * \param native_integers             Selects optimizations that depend on the
- *                                    implementations supporting integers
- *                                    natively (as opposed to supporting
- *                                    integers in floating point registers).
+ * Most of the passes run by do_common_optimization() look at one function at
+ * a time.  Once a whole round of them leaves a function unchanged, the next
+ * round won't change it either, unless a pass looking at the whole program
+ * changes something it depends on.  This keeps track of the functions that
+ * may still change, so that the per-function passes only revisit those.
+ */
+class function_tracker {
+public:
+   function_tracker(exec_list *ir);
+   ~function_tracker();
+
+   bool begin_round();
+   void end_round();
+
+   void collect_dirty();
+   unsigned num_dirty() const
+   {
+      return this->dirty_count;
+   }
+
+   exec_list *checkout(unsigned i);
+   void checkin(unsigned i, bool progress);
+
+   void mark_all_changed();
+   void measure();
+   void find_shrunk();
+
+private:
+   struct function_state {
+      /** Left unchanged by the last round */
+      bool clean;
+      /** Changed during the current round */
+      bool changed;
+      /** Number of IR nodes, valid while the function is unchanged */
+      unsigned size;
+      unsigned round;
+   };
+
+   function_state *get_state(ir_function *f);
+
+   exec_list *ir;
+   void *mem_ctx;
+   struct hash_table *states;
+   unsigned round;
+
+   /** Functions to run the per-function passes on in this round */
+   ir_function **dirty;
+   unsigned dirty_count;
+   unsigned dirty_size;
+
+   /** List holding the checked out function, and where it goes back to */
+   exec_list region;
+   exec_node *anchor;
+};
+
+} /* anonymous namespace */
+
+static void
+count_instruction(ir_instruction *, void *data)
+{
+   (*(unsigned *) data)++;
+}
+
+static unsigned
+function_size(ir_function *f)
+{
+   unsigned size = 0;
+
+   visit_tree(f, count_instruction, &size);
+   return size;
+}
+
+function_tracker::function_tracker(exec_list *ir)
+   : ir(ir), round(0), dirty(NULL), dirty_count(0), dirty_size(0),
+     anchor(NULL)
+{
+   this->mem_ctx = ralloc_context(NULL);
+   this->states = _mesa_hash_table_create(this->mem_ctx, _mesa_hash_pointer,
+                                          _mesa_key_pointer_equal);
+}
+
+function_tracker::~function_tracker()
+{
+   ralloc_free(this->mem_ctx);
+}
+
+function_tracker::function_state *
+function_tracker::get_state(ir_function *f)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(this->states, f);
+   if (entry)
+      return (function_state *) entry->data;
+
+   function_state *state = rzalloc(this->mem_ctx, function_state);
+   _mesa_hash_table_insert(this->states, f, state);
+   return state;
+}
+
+/**
+ * Starts a new round.  Returns false if the per-function passes have to see
+ * the whole program, which is the case when there is code at global scope.
  */
 bool
-do_common_optimization(exec_list *ir, bool linked,
-		       bool uniform_locations_assigned,
-                       const struct gl_shader_compiler_options *options,
-                       bool native_integers)
+function_tracker::begin_round()
+{
+   unsigned num_functions = 0;
+
+   this->round++;
+
+   foreach_in_list(ir_instruction, node, this->ir) {
+      if (node->ir_type == ir_type_function) {
+         num_functions++;
+      } else if (node->ir_type != ir_type_variable) {
+         _mesa_hash_table_clear(this->states, NULL);
+         return false;
+      }
+   }
+
+   if (num_functions > this->dirty_size) {
+      this->dirty = reralloc(this->mem_ctx, this->dirty, ir_function *,
+                             num_functions);
+      this->dirty_size = num_functions;
+   }
+
+   foreach_in_list(ir_instruction, node, this->ir) {
+      ir_function *f = node->as_function();
+      if (!f)
+         continue;
+
+      function_state *state = get_state(f);
+      state->round = this->round;
+      state->changed = false;
+   }
+
+   /* Forget about the functions removed by the last round. */
+   struct hash_entry *entry;
+   hash_table_foreach(this->states, entry) {
+      if (((function_state *) entry->data)->round != this->round)
+         _mesa_hash_table_remove(this->states, entry);
+   }
+
+   return true;
+}
+
+void
+function_tracker::end_round()
+{
+   struct hash_entry *entry;
+   hash_table_foreach(this->states, entry) {
+      function_state *state = (function_state *) entry->data;
+      state->clean = !state->changed;
+   }
+}
+
+/**
+ * Collects the functions that were changed by the last round or so far in
+ * this one.  The whole program passes may have removed functions since the
+ * last time, so this is redone before each per-function pass.
+ */
+void
+function_tracker::collect_dirty()
+{
+   this->dirty_count = 0;
+
+   foreach_in_list(ir_instruction, node, this->ir) {
+      ir_function *f = node->as_function();
+      if (!f)
+         continue;
+
+      function_state *state = get_state(f);
+      if (!state->clean || state->changed)
+         this->dirty[this->dirty_count++] = f;
+   }
+}
+
+/**
+ * Takes the i-th dirty function out of the program and returns a list that
+ * only holds it, for the per-function passes to run on.
+ */
+exec_list *
+function_tracker::checkout(unsigned i)
+{
+   ir_function *f = this->dirty[i];
+
+   this->anchor = f->prev;
+   f->remove();
+   this->region.make_empty();
+   this->region.push_tail(f);
+   return &this->region;
+}
+
+/**
+ * Puts the function taken out by checkout() back where it was.
+ */
+void
+function_tracker::checkin(unsigned i, bool progress)
+{
+   exec_node *pos = this->anchor;
+
+   foreach_in_list_safe(exec_node, node, &this->region) {
+      node->remove();
+      pos->insert_after(node);
+      pos = node;
+   }
+
+   if (progress)
+      get_state(this->dirty[i])->changed = true;
+}
+
+/**
+ * For passes that may have changed any function.
+ */
+void
+function_tracker::mark_all_changed()
+{
+   struct hash_entry *entry;
+   hash_table_foreach(this->states, entry)
+      ((function_state *) entry->data)->changed = true;
+}
+
+/**
+ * Records the size of the functions that don't have an up to date one,
+ * before running a pass that can only remove code.
+ */
+void
+function_tracker::measure()
+{
+   foreach_in_list(ir_instruction, node, this->ir) {
+      ir_function *f = node->as_function();
+      if (!f)
+         continue;
+
+      function_state *state = get_state(f);
+      if (!state->clean || state->changed)
+         state->size = function_size(f);
+   }
+}
+
+/**
+ * Marks the functions that shrank since measure() as changed.
+ */
+void
+function_tracker::find_shrunk()
+{
+   foreach_in_list(ir_instruction, node, this->ir) {
+      ir_function *f = node->as_function();
+      if (!f)
+         continue;
+
+      function_state *state = get_state(f);
+      if (!state->changed && function_size(f) != state->size)
+         state->changed = true;
+   }
+}
+
+static bool
+do_loop_unrolling(exec_list *ir,
+                  const struct gl_shader_compiler_options *options)
+{
+   bool progress = false;
+   loop_state *ls = analyze_loop_variables(ir);
+
+   if (ls->loop_found) {
+      progress = set_loop_controls(ir, ls) || progress;
+      progress = unroll_loops(ir, ls, options) || progress;
+   }
+   delete ls;
+
+   return progress;
+}
+
+static bool
+do_common_optimization_round(exec_list *ir, bool linked,
+                             bool uniform_locations_assigned,
+                             const struct gl_shader_compiler_options *options,
+                             bool native_integers,
+                             function_tracker *tracker)
 {
    const bool debug = false;
    GLboolean progress = GL_FALSE;
+   bool pass_progress;
 
 #define OPT(PASS, ...) do {                                             \
       if (debug) {                                                      \
          fprintf(stderr, "START GLSL optimization %s\n", #PASS);        \
-         const bool opt_progress = PASS(__VA_ARGS__);                   \
-         progress = opt_progress || progress;                           \
-         if (opt_progress)                                              \
+         pass_progress = PASS(__VA_ARGS__);                             \
+         if (pass_progress)                                             \
             _mesa_print_ir(stderr, ir, NULL);                           \
          fprintf(stderr, "GLSL optimization %s: %s progress\n",         \
-                 #PASS, opt_progress ? "made" : "no");                  \
+                 #PASS, pass_progress ? "made" : "no");                 \
+      } else {                                                          \
+         pass_progress = PASS(__VA_ARGS__);                             \
+      }                                                                 \
+      progress = pass_progress || progress;                             \
+   } while (false)
+
+   /* Runs a pass that only looks at one function at a time on each of the
+    * functions that may still change, with ir standing for a list holding
+    * just that function.
+    */
+#define OPT_LOCAL(PASS, ...) do {                                       \
+      if (tracker) {                                                    \
+         tracker->collect_dirty();                                      \
+         for (unsigned i = 0; i < tracker->num_dirty(); i++) {          \
+            exec_list *ir = tracker->checkout(i);                       \
+            OPT(PASS, __VA_ARGS__);                                     \
+            tracker->checkin(i, pass_progress);                         \
+         }                                                              \
       } else {                                                          \
-         progress = PASS(__VA_ARGS__) || progress;                      \
+         OPT(PASS, __VA_ARGS__);                                        \
       }                                                                 \
    } while (false)
 
-   OPT(lower_instructions, ir, SUB_TO_ADD_NEG);
+   /* Runs a pass on the whole program. */
+#define OPT_GLOBAL(PASS, ...) do {                                      \
+      OPT(PASS, __VA_ARGS__);                                           \
+      if (pass_progress && tracker)                                     \
+         tracker->mark_all_changed();                                   \
+   } while (false)
+
+   /* Runs a pass that needs the whole program but only ever removes code
+    * from functions, so the functions it changed are the ones that shrank.
+    */
+#define OPT_GLOBAL_REMOVAL(PASS, ...) do {                              \
+      if (tracker)                                                      \
+         tracker->measure();                                            \
+      OPT(PASS, __VA_ARGS__);                                           \
+      if (pass_progress && tracker)                                     \
+         tracker->find_shrunk();                                        \
+   } while (false)
+
+   OPT_LOCAL(lower_instructions, ir, SUB_TO_ADD_NEG);
 
    if (linked) {
-      OPT(do_function_inlining, ir);
-      OPT(do_dead_functions, ir);
-      OPT(do_structure_splitting, ir);
+      OPT_GLOBAL(do_function_inlining, ir);
+      OPT_GLOBAL(do_dead_functions, ir);
+      OPT_GLOBAL(do_structure_splitting, ir);
    }
-   propagate_invariance(ir);
-   OPT(do_if_simplification, ir);
-   OPT(opt_flatten_nested_if_blocks, ir);
-   OPT(opt_conditional_discard, ir);
-   OPT(do_copy_propagation, ir);
-   OPT(do_copy_propagation_elements, ir);
+   if (propagate_invariance(ir) && tracker)
+      tracker->mark_all_changed();
+   OPT_LOCAL(do_if_simplification, ir);
+   OPT_LOCAL(opt_flatten_nested_if_blocks, ir);
+   OPT_LOCAL(opt_conditional_discard, ir);
+   OPT_LOCAL(do_copy_propagation, ir);
+   OPT_LOCAL(do_copy_propagation_elements, ir);
 
    if (options->OptimizeForAOS && !linked)
-      OPT(opt_flip_matrices, ir);
+      OPT_GLOBAL(opt_flip_matrices, ir);
 
    if (linked && options->OptimizeForAOS) {
-      OPT(do_vectorize, ir);
+      OPT_LOCAL(do_vectorize, ir);
    }
 
    if (linked)
-      OPT(do_dead_code, ir, uniform_locations_assigned);
+      OPT_GLOBAL_REMOVAL(do_dead_code, ir, uniform_locations_assigned);
    else
-      OPT(do_dead_code_unlinked, ir);
-   OPT(do_dead_code_local, ir);
-   OPT(do_tree_grafting, ir);
-   OPT(do_constant_propagation, ir);
+      OPT_GLOBAL_REMOVAL(do_dead_code_unlinked, ir);
+   OPT_LOCAL(do_dead_code_local, ir);
+   /* Tree grafting counts the references to global variables too. */
+   OPT_GLOBAL_REMOVAL(do_tree_grafting, ir);
+   OPT_LOCAL(do_constant_propagation, ir);
    if (linked)
-      OPT(do_constant_variable, ir);
+      OPT_GLOBAL(do_constant_variable, ir);
    else
-      OPT(do_constant_variable_unlinked, ir);
-   OPT(do_constant_folding, ir);
-   OPT(do_minmax_prune, ir);
-   OPT(do_rebalance_tree, ir);
-   OPT(do_algebraic, ir, native_integers, options);
-   OPT(do_lower_jumps, ir);
-   OPT(do_vec_index_to_swizzle, ir);
-   OPT(lower_vector_insert, ir, false);
-   OPT(do_swizzle_swizzle, ir);
-   OPT(do_noop_swizzle, ir);
-
-   OPT(optimize_split_arrays, ir, linked);
-   OPT(optimize_redundant_jumps, ir);
-
-   if (options->MaxUnrollIterations) {
-      loop_state *ls = analyze_loop_variables(ir);
-      if (ls->loop_found) {
-         OPT(set_loop_controls, ir, ls);
-         OPT(unroll_loops, ir, ls, options);
-      }
-      delete ls;
-   }
-
+      OPT_GLOBAL(do_constant_variable_unlinked, ir);
+   OPT_LOCAL(do_constant_folding, ir);
+   OPT_LOCAL(do_minmax_prune, ir);
+   OPT_LOCAL(do_rebalance_tree, ir);
+   OPT_LOCAL(do_algebraic, ir, native_integers, options);
+   OPT_LOCAL(do_lower_jumps, ir);
+   OPT_LOCAL(do_vec_index_to_swizzle, ir);
+   OPT_LOCAL(lower_vector_insert, ir, false);
+   OPT_LOCAL(do_swizzle_swizzle, ir);
+   OPT_LOCAL(do_noop_swizzle, ir);
+
+   OPT_GLOBAL(optimize_split_arrays, ir, linked);
+   OPT_LOCAL(optimize_redundant_jumps, ir);
+
+   if (options->MaxUnrollIterations)
+      OPT_LOCAL(do_loop_unrolling, ir, options);
+
+#undef OPT_GLOBAL_REMOVAL
+#undef OPT_GLOBAL
+#undef OPT_LOCAL
 #undef OPT
 
    return progress;
 }
 
+/**
+ * Do the set of common optimizations passes
+ *
+ * \param ir                          List of instructions to be optimized
+ * \param linked                      Is the shader linked?  This enables
+ *                                    optimizations passes that remove code at
+ *                                    global scope and could cause linking to
+ *                                    fail.
+ * \param uniform_locations_assigned  Have locations already been assigned for
+ *                                    uniforms?  This prevents the declarations
+ *                                    of unused uniforms from being removed.
+ *                                    The setting of this flag only matters if
+ *                                    \c linked is \c true.
+ * \param options                     The driver's preferred shader options.
+ * \param native_integers             Selects optimizations that depend on the
+ *                                    implementations supporting integers
+ *                                    natively (as opposed to supporting
+ *                                    integers in floating point registers).
+ */
+bool
+do_common_optimization(exec_list *ir, bool linked,
+		       bool uniform_locations_assigned,
+                       const struct gl_shader_compiler_options *options,
+                       bool native_integers)
+{
+   return do_common_optimization_round(ir, linked, uniform_locations_assigned,
+                                       options, native_integers, NULL);
+}
+
+/**
+ * Runs do_common_optimization() until it stops making progress.
+ *
+ * This gives the same result as calling it in a loop, but after the first
+ * round the passes that work on one function at a time skip the functions
+ * that already reached a fixed point.
+ */
+void
+do_common_optimization_loop(exec_list *ir, bool linked,
+                            bool uniform_locations_assigned,
+                            const struct gl_shader_compiler_options *options,
+                            bool native_integers)
+{
+   function_tracker tracker(ir);
+   bool progress;
+
+   do {
+      const bool incremental = tracker.begin_round();
+
+      progress = do_common_optimization_round(ir, linked,
+                                              uniform_locations_assigned,
+                                              options, native_integers,
+                                              incremental ? &tracker : NULL);
+      if (incremental)
+         tracker.end_round();
+   } while (progress);
+}
+
 extern "C" {
 
 /**
@@ -0,0 +1,1319 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.cpp
+ *
+ * Binary serialization of GLSL IR.
+ *
+ * The stream starts with a table of every variable declared in the
+ * instruction list (including function parameters and locals) and a table of
+ * every function signature, so that dereferences and calls can refer to them
+ * by index regardless of the order in which the declarations appear.  The
+ * instructions follow; a variable declaration in the stream is only a
+ * reference to the table.
+ */
+
+#include <string.h>
+#include "ir.h"
+#include "ir_hierarchical_visitor.h"
+#include "ir_serialize.h"
+#include "compiler/glsl_types.h"
+#include "util/hash_table.h"
+
+/* Type tag used for NULL types; one past the last glsl_base_type. */
+#define SERIALIZED_TYPE_NULL (GLSL_TYPE_ERROR + 1)
+
+/* Node tag used for NULL rvalues and for the end of an instruction list. */
+#define SERIALIZED_NODE_NULL ir_type_unset
+
+/* Index used for NULL variables. */
+#define SERIALIZED_NO_VARIABLE ~0u
+
+void
+encode_type_to_blob(struct blob *blob, const glsl_type *type)
+{
+   if (type == NULL) {
+      blob_write_uint32(blob, SERIALIZED_TYPE_NULL);
+      return;
+   }
+
+   blob_write_uint32(blob, type->base_type);
+
+   switch (type->base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL:
+      blob_write_uint32(blob, type->vector_elements);
+      blob_write_uint32(blob, type->matrix_columns);
+      return;
+   case GLSL_TYPE_SAMPLER:
+      blob_write_uint32(blob, type->sampler_dimensionality);
+      blob_write_uint32(blob, type->sampler_shadow);
+      blob_write_uint32(blob, type->sampler_array);
+      blob_write_uint32(blob, type->sampled_type);
+      return;
+   case GLSL_TYPE_IMAGE:
+      blob_write_uint32(blob, type->sampler_dimensionality);
+      blob_write_uint32(blob, type->sampler_array);
+      blob_write_uint32(blob, type->sampled_type);
+      return;
+   case GLSL_TYPE_ATOMIC_UINT:
+   case GLSL_TYPE_VOID:
+   case GLSL_TYPE_ERROR:
+      return;
+   case GLSL_TYPE_ARRAY:
+      blob_write_uint32(blob, type->length);
+      encode_type_to_blob(blob, type->fields.array);
+      return;
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE:
+      blob_write_string(blob, type->name);
+      blob_write_uint32(blob, type->length);
+      blob_write_uint32(blob, type->interface_packing);
+      blob_write_uint32(blob, type->interface_row_major);
+      for (unsigned i = 0; i < type->length; i++) {
+         glsl_struct_field field = type->fields.structure[i];
+
+         encode_type_to_blob(blob, field.type);
+         blob_write_string(blob, field.name);
+
+         /* Everything else in the field is plain data. */
+         field.type = NULL;
+         field.name = NULL;
+         blob_write_bytes(blob, &field, sizeof(field));
+      }
+      return;
+   case GLSL_TYPE_SUBROUTINE:
+      blob_write_string(blob, type->name);
+      return;
+   case GLSL_TYPE_FUNCTION:
+      blob_write_uint32(blob, type->length);
+      /* The return type is stored as parameter 0. */
+      for (unsigned i = 0; i <= type->length; i++) {
+         encode_type_to_blob(blob, type->fields.parameters[i].type);
+         blob_write_uint32(blob, type->fields.parameters[i].in);
+         blob_write_uint32(blob, type->fields.parameters[i].out);
+      }
+      return;
+   }
+
+   assert(!"Unknown type");
+}
+
+const glsl_type *
+decode_type_from_blob(struct blob_reader *blob)
+{
+   uint32_t base_type = blob_read_uint32(blob);
+
+   if (blob->overrun || base_type == SERIALIZED_TYPE_NULL)
+      return NULL;
+
+   switch (base_type) {
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL: {
+      unsigned rows = blob_read_uint32(blob);
+      unsigned columns = blob_read_uint32(blob);
+      const glsl_type *type = glsl_type::get_instance(base_type, rows, columns);
+      return type == glsl_type::error_type ? NULL : type;
+   }
+   case GLSL_TYPE_SAMPLER: {
+      unsigned dim = blob_read_uint32(blob);
+      bool shadow = blob_read_uint32(blob);
+      bool array = blob_read_uint32(blob);
+      unsigned sampled_type = blob_read_uint32(blob);
+      return glsl_type::get_sampler_instance((enum glsl_sampler_dim) dim,
+                                             shadow, array,
+                                             (glsl_base_type) sampled_type);
+   }
+   case GLSL_TYPE_IMAGE: {
+      unsigned dim = blob_read_uint32(blob);
+      bool array = blob_read_uint32(blob);
+      unsigned sampled_type = blob_read_uint32(blob);
+      return glsl_type::get_image_instance((enum glsl_sampler_dim) dim,
+                                           array,
+                                           (glsl_base_type) sampled_type);
+   }
+   case GLSL_TYPE_ATOMIC_UINT:
+      return glsl_type::atomic_uint_type;
+   case GLSL_TYPE_VOID:
+      return glsl_type::void_type;
+   case GLSL_TYPE_ERROR:
+      return glsl_type::error_type;
+   case GLSL_TYPE_ARRAY: {
+      unsigned length = blob_read_uint32(blob);
+      const glsl_type *element = decode_type_from_blob(blob);
+      if (element == NULL)
+         return NULL;
+      return glsl_type::get_array_instance(element, length);
+   }
+   case GLSL_TYPE_STRUCT:
+   case GLSL_TYPE_INTERFACE: {
+      const char *name = blob_read_string(blob);
+      unsigned length = blob_read_uint32(blob);
+      unsigned packing = blob_read_uint32(blob);
+      bool row_major = blob_read_uint32(blob);
+
+      if (name == NULL || blob->overrun ||
+          length > (size_t) (blob->end - blob->current))
+         return NULL;
+
+      glsl_struct_field *fields = new glsl_struct_field[length];
+      for (unsigned i = 0; i < length; i++) {
+         const glsl_type *field_type = decode_type_from_blob(blob);
+         const char *field_name = blob_read_string(blob);
+
+         blob_copy_bytes(blob, (uint8_t *) &fields[i], sizeof(fields[i]));
+         fields[i].type = field_type;
+         fields[i].name = field_name;
+
+         if (field_type == NULL || field_name == NULL || blob->overrun) {
+            delete [] fields;
+            blob->overrun = true;
+            return NULL;
+         }
+      }
+
+      const glsl_type *type;
+      if (base_type == GLSL_TYPE_STRUCT) {
+         type = glsl_type::get_record_instance(fields, length, name);
+      } else {
+         type = glsl_type::get_interface_instance(fields, length,
+                                                  (enum glsl_interface_packing) packing,
+                                                  row_major, name);
+      }
+
+      delete [] fields;
+      return type;
+   }
+   case GLSL_TYPE_SUBROUTINE: {
+      const char *name = blob_read_string(blob);
+      return name ? glsl_type::get_subroutine_instance(name) : NULL;
+   }
+   case GLSL_TYPE_FUNCTION: {
+      unsigned num_params = blob_read_uint32(blob);
+
+      if (blob->overrun ||
+          num_params >= (size_t) (blob->end - blob->current))
+         return NULL;
+
+      glsl_function_param *params = new glsl_function_param[num_params + 1];
+      for (unsigned i = 0; i <= num_params; i++) {
+         params[i].type = decode_type_from_blob(blob);
+         params[i].in = blob_read_uint32(blob);
+         params[i].out = blob_read_uint32(blob);
+
+         if (params[i].type == NULL) {
+            delete [] params;
+            blob->overrun = true;
+            return NULL;
+         }
+      }
+
+      const glsl_type *type =
+         glsl_type::get_function_instance(params[0].type, &params[1],
+                                          num_params);
+      delete [] params;
+      return type;
+   }
+   }
+
+   blob->overrun = true;
+   return NULL;
+}
+
+
+namespace {
+
+/**
+ * Gathers the variables and function signatures declared in an instruction
+ * list, numbering them in declaration order.
+ */
+class declaration_collector : public ir_hierarchical_visitor {
+public:
+   declaration_collector()
+   {
+      variables = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                          _mesa_key_pointer_equal);
+      signatures = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                           _mesa_key_pointer_equal);
+   }
+
+   ~declaration_collector()
+   {
+      _mesa_hash_table_destroy(variables, NULL);
+      _mesa_hash_table_destroy(signatures, NULL);
+   }
+
+   virtual ir_visitor_status visit(ir_variable *var)
+   {
+      _mesa_hash_table_insert(variables, var,
+                              (void *) (uintptr_t) variable_list.length());
+      variable_list.push_tail(new(mem_ctx) pointer_node(var));
+      return visit_continue;
+   }
+
+   virtual ir_visitor_status visit_enter(ir_function_signature *sig)
+   {
+      _mesa_hash_table_insert(signatures, sig,
+                              (void *) (uintptr_t) signature_list.length());
+      signature_list.push_tail(new(mem_ctx) pointer_node(sig));
+      return visit_continue;
+   }
+
+   struct pointer_node : public exec_node {
+      pointer_node(void *ptr) : ptr(ptr) { }
+      void *ptr;
+   };
+
+   void *mem_ctx;
+
+   struct hash_table *variables;
+   struct hash_table *signatures;
+
+   exec_list variable_list;
+   exec_list signature_list;
+};
+
+
+class ir_serializer {
+public:
+   ir_serializer(struct blob *blob)
+      : blob(blob), failed(false)
+   {
+      decls.mem_ctx = ralloc_context(NULL);
+   }
+
+   ~ir_serializer()
+   {
+      ralloc_free(decls.mem_ctx);
+   }
+
+   bool run(exec_list *instructions);
+
+private:
+   void write_variable_ref(const ir_variable *var);
+   void write_signature_ref(const ir_function_signature *sig);
+   void write_variable(ir_variable *var);
+   void write_signature(ir_function_signature *sig);
+   void write_constant(const ir_constant *c);
+   void write_rvalue(const ir_rvalue *rvalue);
+   void write_instruction(const ir_instruction *ir);
+   void write_list(const exec_list *list);
+
+   struct blob *blob;
+   declaration_collector decls;
+   bool failed;
+};
+
+
+void
+ir_serializer::write_variable_ref(const ir_variable *var)
+{
+   if (var == NULL) {
+      blob_write_uint32(blob, SERIALIZED_NO_VARIABLE);
+      return;
+   }
+
+   hash_entry *entry = _mesa_hash_table_search(decls.variables, var);
+   if (entry == NULL) {
+      failed = true;
+      return;
+   }
+
+   blob_write_uint32(blob, (uintptr_t) entry->data);
+}
+
+
+void
+ir_serializer::write_signature_ref(const ir_function_signature *sig)
+{
+   hash_entry *entry = _mesa_hash_table_search(decls.signatures, sig);
+   if (entry == NULL) {
+      failed = true;
+      return;
+   }
+
+   blob_write_uint32(blob, (uintptr_t) entry->data);
+}
+
+
+void
+ir_serializer::write_variable(ir_variable *var)
+{
+   encode_type_to_blob(blob, var->type);
+
+   blob_write_string(blob, var->name);
+
+   blob_write_bytes(blob, &var->data, sizeof(var->data));
+
+   encode_type_to_blob(blob, var->get_interface_type());
+   if (var->get_interface_type() != NULL && var->is_interface_instance()) {
+      blob_write_bytes(blob, var->get_max_ifc_array_access(),
+                       var->get_interface_type()->length * sizeof(int));
+   }
+
+   const unsigned num_state_slots =
+      var->get_state_slots() ? var->get_num_state_slots() : 0;
+   blob_write_uint32(blob, num_state_slots);
+   if (num_state_slots) {
+      blob_write_bytes(blob, var->get_state_slots(),
+                       num_state_slots * sizeof(ir_state_slot));
+   }
+
+   write_rvalue(var->constant_value);
+   write_rvalue(var->constant_initializer);
+}
+
+
+void
+ir_serializer::write_signature(ir_function_signature *sig)
+{
+   encode_type_to_blob(blob, sig->return_type);
+   blob_write_uint32(blob, sig->is_defined);
+   blob_write_uint32(blob, sig->intrinsic_id);
+
+   /* Built-in signatures are recorded by their position in the built-in
+    * function, so that the availability predicate can be restored.
+    */
+   int builtin_index = -1;
+   if (sig->is_builtin()) {
+      ir_function *f =
+         _mesa_glsl_find_builtin_function_by_name(sig->function_name());
+      int i = 0;
+
+      if (f) {
+         foreach_in_list(ir_function_signature, builtin, &f->signatures) {
+            if (builtin->return_type == sig->return_type &&
+                builtin->parameters.length() == sig->parameters.length()) {
+               const exec_node *a = builtin->parameters.get_head_raw();
+               const exec_node *b = sig->parameters.get_head_raw();
+
+               while (!a->is_tail_sentinel() &&
+                      ((const ir_variable *) a)->type ==
+                      ((const ir_variable *) b)->type) {
+                  a = a->next;
+                  b = b->next;
+               }
+
+               if (a->is_tail_sentinel()) {
+                  builtin_index = i;
+                  break;
+               }
+            }
+            i++;
+         }
+      }
+
+      if (builtin_index < 0)
+         failed = true;
+   }
+
+   blob_write_uint32(blob, builtin_index);
+   if (builtin_index >= 0)
+      blob_write_string(blob, sig->function_name());
+}
+
+
+void
+ir_serializer::write_constant(const ir_constant *c)
+{
+   encode_type_to_blob(blob, c->type);
+
+   switch (c->type->base_type) {
+   case GLSL_TYPE_ARRAY:
+      for (unsigned i = 0; i < c->type->length; i++)
+         write_constant(c->array_elements[i]);
+      break;
+   case GLSL_TYPE_STRUCT:
+      foreach_in_list(const ir_constant, field, &c->components)
+         write_constant(field);
+      break;
+   default: {
+      const unsigned size = c->type->components() *
+         (c->type->is_double() ? sizeof(double) : sizeof(unsigned));
+      blob_write_bytes(blob, &c->value, MIN2(size, sizeof(c->value)));
+      break;
+   }
+   }
+}
+
+
+void
+ir_serializer::write_rvalue(const ir_rvalue *rvalue)
+{
+   if (rvalue == NULL) {
+      blob_write_uint32(blob, SERIALIZED_NODE_NULL);
+      return;
+   }
+
+   blob_write_uint32(blob, rvalue->ir_type);
+
+   switch (rvalue->ir_type) {
+   case ir_type_dereference_variable:
+      write_variable_ref(((const ir_dereference_variable *) rvalue)->var);
+      break;
+
+   case ir_type_dereference_array: {
+      const ir_dereference_array *deref =
+         (const ir_dereference_array *) rvalue;
+      write_rvalue(deref->array);
+      write_rvalue(deref->array_index);
+      break;
+   }
+
+   case ir_type_dereference_record: {
+      const ir_dereference_record *deref =
+         (const ir_dereference_record *) rvalue;
+      write_rvalue(deref->record);
+      blob_write_string(blob, deref->field);
+      break;
+   }
+
+   case ir_type_constant:
+      write_constant((const ir_constant *) rvalue);
+      break;
+
+   case ir_type_expression: {
+      const ir_expression *expr = (const ir_expression *) rvalue;
+      blob_write_uint32(blob, expr->operation);
+      encode_type_to_blob(blob, expr->type);
+      for (unsigned i = 0; i < ARRAY_SIZE(expr->operands); i++)
+         write_rvalue(expr->operands[i]);
+      break;
+   }
+
+   case ir_type_swizzle: {
+      const ir_swizzle *swiz = (const ir_swizzle *) rvalue;
+      write_rvalue(swiz->val);
+      blob_write_bytes(blob, &swiz->mask, sizeof(swiz->mask));
+      break;
+   }
+
+   case ir_type_texture: {
+      const ir_texture *tex = (const ir_texture *) rvalue;
+      blob_write_uint32(blob, tex->op);
+      encode_type_to_blob(blob, tex->type);
+      write_rvalue(tex->sampler);
+      write_rvalue(tex->coordinate);
+      write_rvalue(tex->projector);
+      write_rvalue(tex->shadow_comparator);
+      write_rvalue(tex->offset);
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+      case ir_texture_samples:
+      case ir_samples_identical:
+         break;
+      case ir_txb:
+         write_rvalue(tex->lod_info.bias);
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         write_rvalue(tex->lod_info.lod);
+         break;
+      case ir_txf_ms:
+         write_rvalue(tex->lod_info.sample_index);
+         break;
+      case ir_txd:
+         write_rvalue(tex->lod_info.grad.dPdx);
+         write_rvalue(tex->lod_info.grad.dPdy);
+         break;
+      case ir_tg4:
+         write_rvalue(tex->lod_info.component);
+         break;
+      }
+      break;
+   }
+
+   default:
+      failed = true;
+      break;
+   }
+}
+
+
+void
+ir_serializer::write_instruction(const ir_instruction *ir)
+{
+   switch (ir->ir_type) {
+   case ir_type_variable:
+      blob_write_uint32(blob, ir->ir_type);
+      write_variable_ref((const ir_variable *) ir);
+      break;
+
+   case ir_type_assignment: {
+      const ir_assignment *assign = (const ir_assignment *) ir;
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(assign->lhs);
+      write_rvalue(assign->rhs);
+      write_rvalue(assign->condition);
+      blob_write_uint32(blob, assign->write_mask);
+      break;
+   }
+
+   case ir_type_call: {
+      const ir_call *call = (const ir_call *) ir;
+      blob_write_uint32(blob, ir->ir_type);
+      write_signature_ref(call->callee);
+      write_rvalue(call->return_deref);
+      blob_write_uint32(blob, call->actual_parameters.length());
+      foreach_in_list(const ir_rvalue, param, &call->actual_parameters)
+         write_rvalue(param);
+      write_variable_ref(call->sub_var);
+      write_rvalue(call->array_idx);
+      break;
+   }
+
+   case ir_type_function: {
+      const ir_function *f = (const ir_function *) ir;
+      blob_write_uint32(blob, ir->ir_type);
+      blob_write_string(blob, f->name);
+      blob_write_uint32(blob, f->is_subroutine);
+      blob_write_uint32(blob, f->subroutine_index);
+      blob_write_uint32(blob, f->num_subroutine_types);
+      for (int i = 0; i < f->num_subroutine_types; i++)
+         encode_type_to_blob(blob, f->subroutine_types[i]);
+
+      blob_write_uint32(blob, f->signatures.length());
+      foreach_in_list(const ir_function_signature, sig, &f->signatures) {
+         write_signature_ref(sig);
+         blob_write_uint32(blob, sig->parameters.length());
+         foreach_in_list(const ir_variable, param, &sig->parameters)
+            write_variable_ref(param);
+         write_list(&sig->body);
+      }
+      break;
+   }
+
+   case ir_type_if: {
+      const ir_if *iff = (const ir_if *) ir;
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(iff->condition);
+      write_list(&iff->then_instructions);
+      write_list(&iff->else_instructions);
+      break;
+   }
+
+   case ir_type_loop:
+      blob_write_uint32(blob, ir->ir_type);
+      write_list(&((const ir_loop *) ir)->body_instructions);
+      break;
+
+   case ir_type_loop_jump:
+      blob_write_uint32(blob, ir->ir_type);
+      blob_write_uint32(blob, ((const ir_loop_jump *) ir)->mode);
+      break;
+
+   case ir_type_return:
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(((const ir_return *) ir)->value);
+      break;
+
+   case ir_type_discard:
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(((const ir_discard *) ir)->condition);
+      break;
+
+   case ir_type_emit_vertex:
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(((const ir_emit_vertex *) ir)->stream);
+      break;
+
+   case ir_type_end_primitive:
+      blob_write_uint32(blob, ir->ir_type);
+      write_rvalue(((const ir_end_primitive *) ir)->stream);
+      break;
+
+   case ir_type_barrier:
+      blob_write_uint32(blob, ir->ir_type);
+      break;
+
+   default:
+      /* Bare rvalues are not expected at instruction level. */
+      failed = true;
+      break;
+   }
+}
+
+
+void
+ir_serializer::write_list(const exec_list *list)
+{
+   foreach_in_list(const ir_instruction, ir, list)
+      write_instruction(ir);
+   blob_write_uint32(blob, SERIALIZED_NODE_NULL);
+}
+
+
+bool
+ir_serializer::run(exec_list *instructions)
+{
+   decls.run(instructions);
+
+   blob_write_uint32(blob, decls.variable_list.length());
+   foreach_in_list(declaration_collector::pointer_node, node,
+                   &decls.variable_list) {
+      write_variable((ir_variable *) node->ptr);
+   }
+
+   blob_write_uint32(blob, decls.signature_list.length());
+   foreach_in_list(declaration_collector::pointer_node, node,
+                   &decls.signature_list) {
+      write_signature((ir_function_signature *) node->ptr);
+   }
+
+   write_list(instructions);
+
+   return !failed;
+}
+
+
+class ir_deserializer {
+public:
+   ir_deserializer(struct blob_reader *blob, void *mem_ctx)
+      : blob(blob), mem_ctx(mem_ctx), variables(NULL), num_variables(0),
+        signatures(NULL), signature_used(NULL), num_signatures(0)
+   {
+   }
+
+   ~ir_deserializer()
+   {
+      free(variables);
+      free(signatures);
+      free(signature_used);
+   }
+
+   bool run(exec_list *instructions);
+
+private:
+   void fail()
+   {
+      blob->overrun = true;
+   }
+
+   bool has_bytes(size_t count) const
+   {
+      return count <= (size_t) (blob->end - blob->current);
+   }
+
+   ir_variable *read_variable_ref();
+   ir_function_signature *read_signature_ref();
+   ir_variable *read_variable();
+   ir_function_signature *read_signature();
+   ir_constant *read_constant();
+   ir_rvalue *read_rvalue();
+   ir_instruction *read_instruction(uint32_t ir_type);
+   bool read_list(exec_list *list);
+
+   struct blob_reader *blob;
+   void *mem_ctx;
+
+   ir_variable **variables;
+   unsigned num_variables;
+
+   ir_function_signature **signatures;
+   bool *signature_used;
+   unsigned num_signatures;
+};
+
+
+ir_variable *
+ir_deserializer::read_variable_ref()
+{
+   uint32_t index = blob_read_uint32(blob);
+
+   if (index >= num_variables) {
+      if (index != SERIALIZED_NO_VARIABLE)
+         fail();
+      return NULL;
+   }
+
+   return variables[index];
+}
+
+
+ir_function_signature *
+ir_deserializer::read_signature_ref()
+{
+   uint32_t index = blob_read_uint32(blob);
+
+   if (index >= num_signatures) {
+      fail();
+      return NULL;
+   }
+
+   return signatures[index];
+}
+
+
+ir_variable *
+ir_deserializer::read_variable()
+{
+   const glsl_type *type = decode_type_from_blob(blob);
+   const char *name = blob_read_string(blob);
+   ir_variable::ir_variable_data data;
+
+   blob_copy_bytes(blob, (uint8_t *) &data, sizeof(data));
+
+   if (type == NULL || name == NULL || blob->overrun ||
+       data.mode >= ir_var_mode_count) {
+      fail();
+      return NULL;
+   }
+
+   ir_variable *var =
+      new(mem_ctx) ir_variable(type, name, (ir_variable_mode) data.mode);
+   memcpy(&var->data, &data, sizeof(data));
+   var->set_num_state_slots(0);
+
+   const glsl_type *interface_type = decode_type_from_blob(blob);
+   if (interface_type != NULL) {
+      var->init_interface_type(interface_type);
+      if (var->is_interface_instance()) {
+         blob_copy_bytes(blob, (uint8_t *) var->get_max_ifc_array_access(),
+                         interface_type->length * sizeof(int));
+      }
+   }
+
+   const unsigned num_state_slots = blob_read_uint32(blob);
+   if (num_state_slots) {
+      if (var->is_interface_instance() ||
+          !has_bytes(num_state_slots * sizeof(ir_state_slot))) {
+         fail();
+         return NULL;
+      }
+
+      ir_state_slot *slots = var->allocate_state_slots(num_state_slots);
+      blob_copy_bytes(blob, (uint8_t *) slots,
+                      num_state_slots * sizeof(ir_state_slot));
+   }
+
+   ir_rvalue *constant_value = read_rvalue();
+   ir_rvalue *constant_initializer = read_rvalue();
+
+   if ((constant_value && !constant_value->as_constant()) ||
+       (constant_initializer && !constant_initializer->as_constant())) {
+      fail();
+      return NULL;
+   }
+
+   var->constant_value = (ir_constant *) constant_value;
+   var->constant_initializer = (ir_constant *) constant_initializer;
+
+   return blob->overrun ? NULL : var;
+}
+
+
+ir_function_signature *
+ir_deserializer::read_signature()
+{
+   const glsl_type *return_type = decode_type_from_blob(blob);
+   bool is_defined = blob_read_uint32(blob);
+   unsigned intrinsic_id = blob_read_uint32(blob);
+   int builtin_index = blob_read_uint32(blob);
+
+   if (return_type == NULL || blob->overrun) {
+      fail();
+      return NULL;
+   }
+
+   ir_function_signature *sig;
+
+   if (builtin_index >= 0) {
+      const char *name = blob_read_string(blob);
+      ir_function *f =
+         name ? _mesa_glsl_find_builtin_function_by_name(name) : NULL;
+      ir_function_signature *builtin = NULL;
+
+      if (f) {
+         int i = 0;
+         foreach_in_list(ir_function_signature, s, &f->signatures) {
+            if (i++ == builtin_index) {
+               builtin = s;
+               break;
+            }
+         }
+      }
+
+      if (builtin == NULL || builtin->return_type != return_type) {
+         fail();
+         return NULL;
+      }
+
+      /* Only the availability predicate is wanted; the parameters are
+       * restored from the variable table like any other signature's.
+       */
+      sig = builtin->clone_prototype(mem_ctx, NULL);
+      sig->parameters.make_empty();
+   } else {
+      sig = new(mem_ctx) ir_function_signature(return_type);
+   }
+
+   sig->is_defined = is_defined;
+   sig->intrinsic_id = (enum ir_intrinsic_id) intrinsic_id;
+
+   return sig;
+}
+
+
+ir_constant *
+ir_deserializer::read_constant()
+{
+   const glsl_type *type = decode_type_from_blob(blob);
+
+   if (type == NULL)
+      return NULL;
+
+   switch (type->base_type) {
+   case GLSL_TYPE_ARRAY:
+   case GLSL_TYPE_STRUCT: {
+      exec_list values;
+      for (unsigned i = 0; i < type->length; i++) {
+         ir_constant *c = read_constant();
+         if (c == NULL)
+            return NULL;
+         values.push_tail(c);
+      }
+      return new(mem_ctx) ir_constant(type, &values);
+   }
+   case GLSL_TYPE_UINT:
+   case GLSL_TYPE_INT:
+   case GLSL_TYPE_FLOAT:
+   case GLSL_TYPE_DOUBLE:
+   case GLSL_TYPE_BOOL: {
+      ir_constant_data data;
+      const unsigned size = type->components() *
+         (type->is_double() ? sizeof(double) : sizeof(unsigned));
+
+      memset(&data, 0, sizeof(data));
+      blob_copy_bytes(blob, (uint8_t *) &data, MIN2(size, sizeof(data)));
+      if (blob->overrun)
+         return NULL;
+      return new(mem_ctx) ir_constant(type, &data);
+   }
+   default:
+      fail();
+      return NULL;
+   }
+}
+
+
+ir_rvalue *
+ir_deserializer::read_rvalue()
+{
+   uint32_t ir_type = blob_read_uint32(blob);
+
+   if (blob->overrun || ir_type == SERIALIZED_NODE_NULL)
+      return NULL;
+
+   switch (ir_type) {
+   case ir_type_dereference_variable: {
+      ir_variable *var = read_variable_ref();
+      if (var == NULL) {
+         fail();
+         return NULL;
+      }
+      return new(mem_ctx) ir_dereference_variable(var);
+   }
+
+   case ir_type_dereference_array: {
+      ir_rvalue *array = read_rvalue();
+      ir_rvalue *index = read_rvalue();
+      if (array == NULL || index == NULL) {
+         fail();
+         return NULL;
+      }
+      return new(mem_ctx) ir_dereference_array(array, index);
+   }
+
+   case ir_type_dereference_record: {
+      ir_rvalue *record = read_rvalue();
+      const char *field = blob_read_string(blob);
+      if (record == NULL || field == NULL) {
+         fail();
+         return NULL;
+      }
+      return new(mem_ctx) ir_dereference_record(record, field);
+   }
+
+   case ir_type_constant: {
+      ir_constant *c = read_constant();
+      if (c == NULL)
+         fail();
+      return c;
+   }
+
+   case ir_type_expression: {
+      unsigned operation = blob_read_uint32(blob);
+      const glsl_type *type = decode_type_from_blob(blob);
+      ir_rvalue *operands[4];
+
+      for (unsigned i = 0; i < ARRAY_SIZE(operands); i++)
+         operands[i] = read_rvalue();
+
+      if (type == NULL || operands[0] == NULL ||
+          operation > ir_last_opcode || blob->overrun) {
+         fail();
+         return NULL;
+      }
+
+      return new(mem_ctx) ir_expression(operation, type,
+                                        operands[0], operands[1],
+                                        operands[2], operands[3]);
+   }
+
+   case ir_type_swizzle: {
+      ir_rvalue *val = read_rvalue();
+      ir_swizzle_mask mask;
+
+      blob_copy_bytes(blob, (uint8_t *) &mask, sizeof(mask));
+      if (val == NULL || blob->overrun) {
+         fail();
+         return NULL;
+      }
+
+      return new(mem_ctx) ir_swizzle(val, mask);
+   }
+
+   case ir_type_texture: {
+      unsigned op = blob_read_uint32(blob);
+      const glsl_type *type = decode_type_from_blob(blob);
+
+      if (op > ir_samples_identical || type == NULL) {
+         fail();
+         return NULL;
+      }
+
+      ir_texture *tex = new(mem_ctx) ir_texture((enum ir_texture_opcode) op);
+      ir_rvalue *sampler = read_rvalue();
+      tex->coordinate = read_rvalue();
+      tex->projector = read_rvalue();
+      tex->shadow_comparator = read_rvalue();
+      tex->offset = read_rvalue();
+
+      if (sampler == NULL || !sampler->as_dereference()) {
+         fail();
+         return NULL;
+      }
+      tex->set_sampler(sampler->as_dereference(), type);
+
+      switch (tex->op) {
+      case ir_tex:
+      case ir_lod:
+      case ir_query_levels:
+      case ir_texture_samples:
+      case ir_samples_identical:
+         break;
+      case ir_txb:
+         tex->lod_info.bias = read_rvalue();
+         break;
+      case ir_txl:
+      case ir_txf:
+      case ir_txs:
+         tex->lod_info.lod = read_rvalue();
+         break;
+      case ir_txf_ms:
+         tex->lod_info.sample_index = read_rvalue();
+         break;
+      case ir_txd:
+         tex->lod_info.grad.dPdx = read_rvalue();
+         tex->lod_info.grad.dPdy = read_rvalue();
+         break;
+      case ir_tg4:
+         tex->lod_info.component = read_rvalue();
+         break;
+      }
+
+      return blob->overrun ? NULL : tex;
+   }
+
+   default:
+      fail();
+      return NULL;
+   }
+}
+
+
+ir_instruction *
+ir_deserializer::read_instruction(uint32_t ir_type)
+{
+   switch (ir_type) {
+   case ir_type_variable: {
+      ir_variable *var = read_variable_ref();
+      /* Each declaration must appear exactly once. */
+      if (var == NULL || var->next != NULL) {
+         fail();
+         return NULL;
+      }
+      return var;
+   }
+
+   case ir_type_assignment: {
+      ir_rvalue *lhs = read_rvalue();
+      ir_rvalue *rhs = read_rvalue();
+      ir_rvalue *condition = read_rvalue();
+      unsigned write_mask = blob_read_uint32(blob);
+
+      if (lhs == NULL || rhs == NULL || !lhs->as_dereference() ||
+          blob->overrun) {
+         fail();
+         return NULL;
+      }
+
+      return new(mem_ctx) ir_assignment(lhs->as_dereference(), rhs,
+                                        condition, write_mask);
+   }
+
+   case ir_type_call: {
+      ir_function_signature *callee = read_signature_ref();
+      ir_rvalue *return_deref = read_rvalue();
+      unsigned num_params = blob_read_uint32(blob);
+      exec_list params;
+
+      if (callee == NULL || blob->overrun || !has_bytes(num_params) ||
+          (return_deref && !return_deref->as_dereference_variable())) {
+         fail();
+         return NULL;
+      }
+
+      for (unsigned i = 0; i < num_params; i++) {
+         ir_rvalue *param = read_rvalue();
+         if (param == NULL) {
+            fail();
+            return NULL;
+         }
+         params.push_tail(param);
+      }
+
+      ir_variable *sub_var = read_variable_ref();
+      ir_rvalue *array_idx = read_rvalue();
+
+      if (blob->overrun)
+         return NULL;
+
+      return new(mem_ctx) ir_call(callee,
+                                  return_deref ?
+                                  return_deref->as_dereference_variable() :
+                                  NULL,
+                                  &params, sub_var, array_idx);
+   }
+
+   case ir_type_function: {
+      const char *name = blob_read_string(blob);
+      if (name == NULL) {
+         fail();
+         return NULL;
+      }
+
+      ir_function *f = new(mem_ctx) ir_function(name);
+      f->is_subroutine = blob_read_uint32(blob);
+      f->subroutine_index = blob_read_uint32(blob);
+      f->num_subroutine_types = blob_read_uint32(blob);
+
+      if (f->num_subroutine_types < 0 ||
+          !has_bytes(f->num_subroutine_types)) {
+         fail();
+         return NULL;
+      }
+
+      f->subroutine_types = ralloc_array(mem_ctx, const struct glsl_type *,
+                                         f->num_subroutine_types);
+      for (int i = 0; i < f->num_subroutine_types; i++)
+         f->subroutine_types[i] = decode_type_from_blob(blob);
+
+      unsigned num_sigs = blob_read_uint32(blob);
+      for (unsigned i = 0; i < num_sigs && !blob->overrun; i++) {
+         uint32_t index = blob_read_uint32(blob);
+
+         if (index >= num_signatures || signature_used[index]) {
+            fail();
+            return NULL;
+         }
+
+         ir_function_signature *sig = signatures[index];
+         signature_used[index] = true;
+         f->add_signature(sig);
+
+         unsigned num_params = blob_read_uint32(blob);
+         for (unsigned j = 0; j < num_params && !blob->overrun; j++) {
+            ir_variable *param = read_variable_ref();
+            if (param == NULL || param->next != NULL) {
+               fail();
+               return NULL;
+            }
+            sig->parameters.push_tail(param);
+         }
+
+         if (!read_list(&sig->body))
+            return NULL;
+      }
+
+      return blob->overrun ? NULL : f;
+   }
+
+   case ir_type_if: {
+      ir_rvalue *condition = read_rvalue();
+      if (condition == NULL) {
+         fail();
+         return NULL;
+      }
+
+      ir_if *iff = new(mem_ctx) ir_if(condition);
+      if (!read_list(&iff->then_instructions) ||
+          !read_list(&iff->else_instructions))
+         return NULL;
+      return iff;
+   }
+
+   case ir_type_loop: {
+      ir_loop *loop = new(mem_ctx) ir_loop();
+      if (!read_list(&loop->body_instructions))
+         return NULL;
+      return loop;
+   }
+
+   case ir_type_loop_jump: {
+      unsigned mode = blob_read_uint32(blob);
+      if (mode > ir_loop_jump::jump_continue) {
+         fail();
+         return NULL;
+      }
+      return new(mem_ctx) ir_loop_jump((ir_loop_jump::jump_mode) mode);
+   }
+
+   case ir_type_return:
+      return new(mem_ctx) ir_return(read_rvalue());
+
+   case ir_type_discard:
+      return new(mem_ctx) ir_discard(read_rvalue());
+
+   case ir_type_emit_vertex:
+   case ir_type_end_primitive: {
+      ir_rvalue *stream = read_rvalue();
+      if (stream == NULL) {
+         fail();
+         return NULL;
+      }
+      if (ir_type == ir_type_emit_vertex)
+         return new(mem_ctx) ir_emit_vertex(stream);
+      else
+         return new(mem_ctx) ir_end_primitive(stream);
+   }
+
+   case ir_type_barrier:
+      return new(mem_ctx) ir_barrier();
+
+   default:
+      fail();
+      return NULL;
+   }
+}
+
+
+bool
+ir_deserializer::read_list(exec_list *list)
+{
+   for (;;) {
+      uint32_t ir_type = blob_read_uint32(blob);
+
+      if (blob->overrun)
+         return false;
+
+      if (ir_type == SERIALIZED_NODE_NULL)
+         return true;
+
+      ir_instruction *ir = read_instruction(ir_type);
+      if (ir == NULL) {
+         fail();
+         return false;
+      }
+
+      list->push_tail(ir);
+   }
+}
+
+
+bool
+ir_deserializer::run(exec_list *instructions)
+{
+   num_variables = blob_read_uint32(blob);
+   if (blob->overrun || !has_bytes(num_variables))
+      return false;
+
+   variables = (ir_variable **) calloc(num_variables, sizeof(*variables));
+   if (num_variables && variables == NULL)
+      return false;
+
+   for (unsigned i = 0; i < num_variables; i++) {
+      /* A variable's constant value may only refer to earlier entries. */
+      variables[i] = read_variable();
+      if (variables[i] == NULL)
+         return false;
+   }
+
+   num_signatures = blob_read_uint32(blob);
+   if (blob->overrun || !has_bytes(num_signatures))
+      return false;
+
+   signatures = (ir_function_signature **)
+      calloc(num_signatures, sizeof(*signatures));
+   signature_used = (bool *) calloc(num_signatures, sizeof(*signature_used));
+   if (num_signatures && (signatures == NULL || signature_used == NULL))
+      return false;
+
+   for (unsigned i = 0; i < num_signatures; i++) {
+      signatures[i] = read_signature();
+      if (signatures[i] == NULL)
+         return false;
+   }
+
+   return read_list(instructions) && !blob->overrun;
+}
+
+} /* anonymous namespace */
+
+
+bool
+serialize_ir(struct blob *blob, exec_list *instructions)
+{
+   ir_serializer s(blob);
+   return s.run(instructions);
+}
+
+
+bool
+deserialize_ir(struct blob_reader *blob, void *mem_ctx,
+               exec_list *instructions)
+{
+   ir_deserializer d(blob, mem_ctx);
+   return d.run(instructions);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file ir_serialize.h
+ *
+ * Binary serialization of GLSL IR instruction streams and types.
+ *
+ * The encoding is not portable: it depends on the layout of the IR
+ * structures, so it must only be read back by the same build of Mesa.
+ */
+
+#pragma once
+#ifndef IR_SERIALIZE_H
+#define IR_SERIALIZE_H
+
+#include "ir.h"
+#include "blob.h"
+
+/**
+ * Write a type (which may be \c NULL) to \c blob.
+ */
+void
+encode_type_to_blob(struct blob *blob, const glsl_type *type);
+
+/**
+ * Read a type written by encode_type_to_blob().
+ *
+ * Returns \c NULL for a \c NULL type, or if the data is malformed, in which
+ * case \c blob->overrun is set.
+ */
+const glsl_type *
+decode_type_from_blob(struct blob_reader *blob);
+
+/**
+ * Write the instruction list \c instructions to \c blob.
+ *
+ * Returns false if the list references variables or functions that are not
+ * declared in it, in which case the contents of \c blob are unusable.
+ */
+bool
+serialize_ir(struct blob *blob, exec_list *instructions);
+
+/**
+ * Read an instruction list written by serialize_ir(), allocating the nodes
+ * out of \c mem_ctx and appending them to \c instructions.
+ *
+ * Returns false if the data is malformed.
+ */
+bool
+deserialize_ir(struct blob_reader *blob, void *mem_ctx,
+               exec_list *instructions);
+
+#endif /* IR_SERIALIZE_H */
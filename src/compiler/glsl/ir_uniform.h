@@ -67,6 +67,12 @@ struct gl_uniform_driver_storage {
     * Pointer to the base of the data.
     */
    void *data;
+
+   /**
+    * Parameter list that data points into, if any, to record which of its
+    * values change.
+    */
+   struct gl_program_parameter_list *params;
 };
 
 struct gl_opaque_uniform_index {
@@ -38,30 +38,15 @@
 ir_variable_refcount_visitor::ir_variable_refcount_visitor()
 {
    this->mem_ctx = ralloc_context(NULL);
-   this->ht = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+   this->lin_ctx = linear_alloc_parent(this->mem_ctx, 0);
+   this->ht = _mesa_hash_table_create(this->mem_ctx, _mesa_hash_pointer,
                                       _mesa_key_pointer_equal);
 }
 
-static void
-free_entry(struct hash_entry *entry)
-{
-   ir_variable_refcount_entry *ivre = (ir_variable_refcount_entry *) entry->data;
-
-   /* Free assignment list */
-   exec_node *n;
-   while ((n = ivre->assign_list.pop_head()) != NULL) {
-      struct assignment_entry *assignment_entry =
-         exec_node_data(struct assignment_entry, n, link);
-      free(assignment_entry);
-   }
-
-   delete ivre;
-}
-
 ir_variable_refcount_visitor::~ir_variable_refcount_visitor()
 {
+   /* This frees the hash table and all the entries. */
    ralloc_free(this->mem_ctx);
-   _mesa_hash_table_destroy(this->ht, free_entry);
 }
 
 // constructor
@@ -83,7 +68,8 @@ ir_variable_refcount_visitor::get_variable_entry(ir_variable *var)
    if (e)
       return (ir_variable_refcount_entry *)e->data;
 
-   ir_variable_refcount_entry *entry = new ir_variable_refcount_entry(var);
+   ir_variable_refcount_entry *entry =
+      new(this->lin_ctx) ir_variable_refcount_entry(var);
    assert(entry->referenced_count == 0);
    _mesa_hash_table_insert(this->ht, var, entry);
 
@@ -143,7 +129,8 @@ ir_variable_refcount_visitor::visit_leave(ir_assignment *ir)
       assert(entry->referenced_count >= entry->assigned_count);
       if (entry->referenced_count == entry->assigned_count) {
          struct assignment_entry *assignment_entry =
-            (struct assignment_entry *)calloc(1, sizeof(*assignment_entry));
+            (struct assignment_entry *)
+            linear_alloc_child(this->lin_ctx, sizeof(*assignment_entry));
          assignment_entry->assign = ir;
          entry->assign_list.push_head(&assignment_entry->link);
       }
@@ -41,6 +41,8 @@ struct assignment_entry {
 class ir_variable_refcount_entry
 {
 public:
+   DECLARE_LINEAR_ALLOC_CXX_OPERATORS(ir_variable_refcount_entry)
+
    ir_variable_refcount_entry(ir_variable *var);
 
    ir_variable *var; /* The key: the variable's pointer. */
@@ -83,4 +85,10 @@ public:
    struct hash_table *ht;
 
    void *mem_ctx;
+
+   /**
+    * Linear allocator for the entries and their assignment lists, which
+    * are all freed together with the visitor.
+    */
+   void *lin_ctx;
 };
@@ -1220,6 +1220,8 @@ link_assign_uniform_storage(struct gl_context *ctx,
    union gl_constant_value *data = rzalloc_array(prog->data->UniformStorage,
                                                  union gl_constant_value,
                                                  num_data_slots);
+   prog->data->UniformDataSlots = data;
+   prog->data->NumUniformDataSlots = num_data_slots;
 #ifndef NDEBUG
    union gl_constant_value *data_end = &data[num_data_slots];
 #endif
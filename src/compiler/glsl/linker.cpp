@@ -81,6 +81,7 @@
 #include "ir_rvalue_visitor.h"
 #include "ir_uniform.h"
 
+#include "main/shaderapi.h"
 #include "main/shaderobj.h"
 #include "main/enums.h"
 
@@ -4194,6 +4195,7 @@ build_program_resource_list(struct gl_context *ctx,
       ralloc_free(shProg->ProgramResourceList);
       shProg->ProgramResourceList = NULL;
       shProg->NumProgramResourceList = 0;
+      shProg->ProgramResourceHash = NULL;
    }
 
    int input_stage = MESA_SHADER_STAGES, output_stage = 0;
@@ -4352,6 +4354,8 @@ build_program_resource_list(struct gl_context *ctx,
    }
 
    _mesa_set_destroy(resource_set, NULL);
+
+   _mesa_create_program_resource_hash(shProg);
 }
 
 /**
@@ -5033,10 +5037,9 @@ link_shaders(struct gl_context *ctx, struct gl_shader_program *prog)
          lower_tess_level(prog->_LinkedShaders[i]);
       }
 
-      while (do_common_optimization(prog->_LinkedShaders[i]->ir, true, false,
-                                    &ctx->Const.ShaderCompilerOptions[i],
-                                    ctx->Const.NativeIntegers))
-         ;
+      do_common_optimization_loop(prog->_LinkedShaders[i]->ir, true, false,
+                                  &ctx->Const.ShaderCompilerOptions[i],
+                                  ctx->Const.NativeIntegers);
 
       lower_const_arrays_to_uniforms(prog->_LinkedShaders[i]->ir, i);
       propagate_invariance(prog->_LinkedShaders[i]->ir);
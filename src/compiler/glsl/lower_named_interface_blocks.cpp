@@ -105,10 +105,12 @@ class flatten_named_interface_blocks_declarations : public ir_rvalue_visitor
 public:
    void * const mem_ctx;
    hash_table *interface_namespace;
+   void *lin_ctx; /**< lookup keys, freed with interface_namespace */
 
    flatten_named_interface_blocks_declarations(void *mem_ctx)
       : mem_ctx(mem_ctx),
-        interface_namespace(NULL)
+        interface_namespace(NULL),
+        lin_ctx(NULL)
    {
    }
 
@@ -125,6 +127,7 @@ flatten_named_interface_blocks_declarations::run(exec_list *instructions)
 {
    interface_namespace = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
                                                  _mesa_key_string_equal);
+   lin_ctx = linear_alloc_parent(interface_namespace, 0);
 
    /* First pass: adjust instance block variables with an instance name
     * to not have an instance name.
@@ -153,7 +156,7 @@ flatten_named_interface_blocks_declarations::run(exec_list *instructions)
       for (unsigned i = 0; i < iface_t->length; i++) {
          const char * field_name = iface_t->fields.structure[i].name;
          char *iface_field_name =
-            ralloc_asprintf(mem_ctx, "%s %s.%s.%s",
+            linear_asprintf(lin_ctx, "%s %s.%s.%s",
                             var->data.mode == ir_var_shader_in ? "in" : "out",
                             iface_t->name, var->name, field_name);
 
@@ -162,19 +165,17 @@ flatten_named_interface_blocks_declarations::run(exec_list *instructions)
          ir_variable *found_var = entry ? (ir_variable *) entry->data : NULL;
          if (!found_var) {
             ir_variable *new_var;
-            char *var_name =
-               ralloc_strdup(mem_ctx, iface_t->fields.structure[i].name);
             if (!var->type->is_array()) {
                new_var =
                   new(mem_ctx) ir_variable(iface_t->fields.structure[i].type,
-                                           var_name,
+                                           field_name,
                                            (ir_variable_mode) var->data.mode);
             } else {
                const glsl_type *new_array_type =
                   process_array_type(var->type, i);
                new_var =
                   new(mem_ctx) ir_variable(new_array_type,
-                                           var_name,
+                                           field_name,
                                            (ir_variable_mode) var->data.mode);
             }
             new_var->data.location = iface_t->fields.structure[i].location;
@@ -213,6 +214,7 @@ flatten_named_interface_blocks_declarations::run(exec_list *instructions)
    visit_list_elements(this, instructions);
    _mesa_hash_table_destroy(interface_namespace, NULL);
    interface_namespace = NULL;
+   lin_ctx = NULL;
 }
 
 ir_visitor_status
@@ -266,7 +268,7 @@ flatten_named_interface_blocks_declarations::handle_rvalue(ir_rvalue **rvalue)
 
    if (var->get_interface_type() != NULL) {
       char *iface_field_name =
-         ralloc_asprintf(mem_ctx, "%s %s.%s.%s",
+         linear_asprintf(lin_ctx, "%s %s.%s.%s",
                          var->data.mode == ir_var_shader_in ? "in" : "out",
                          var->get_interface_type()->name,
                          var->name, ir->field);
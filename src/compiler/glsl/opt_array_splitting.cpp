@@ -429,6 +429,7 @@ optimize_split_arrays(exec_list *instructions, bool linked)
       return false;
 
    void *mem_ctx = ralloc_context(NULL);
+   void *lin_ctx = linear_alloc_parent(mem_ctx, 0);
 
    /* Replace the decls of the arrays to be split with their split
     * components.
@@ -447,8 +448,9 @@ optimize_split_arrays(exec_list *instructions, bool linked)
       entry->components = ralloc_array(mem_ctx, ir_variable *, entry->size);
 
       for (unsigned int i = 0; i < entry->size; i++) {
-         const char *name = ralloc_asprintf(mem_ctx, "%s_%d",
-                                            entry->var->name, i);
+         const char *name = ir_variable::temporaries_allocate_names
+            ? linear_asprintf(lin_ctx, "%s_%d", entry->var->name, i)
+            : NULL;
 
          entry->components[i] =
             new(entry->mem_ctx) ir_variable(subtype, name, ir_var_temporary);
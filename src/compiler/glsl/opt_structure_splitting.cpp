@@ -330,6 +330,7 @@ do_structure_splitting(exec_list *instructions)
       return false;
 
    void *mem_ctx = ralloc_context(NULL);
+   void *lin_ctx = linear_alloc_parent(mem_ctx, 0);
 
    /* Replace the decls of the structures to be split with their split
     * components.
@@ -344,7 +345,7 @@ do_structure_splitting(exec_list *instructions)
 				       type->length);
 
       for (unsigned int i = 0; i < entry->var->type->length; i++) {
-	 const char *name = ralloc_asprintf(mem_ctx, "%s_%s",
+	 const char *name = linear_asprintf(lin_ctx, "%s_%s",
 					    entry->var->name,
 					    type->fields.structure[i].name);
 
@@ -0,0 +1,1063 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.cpp
+ *
+ * Storage of linked GLSL programs in the on-disk shader cache.
+ *
+ * An entry holds everything link_shaders() produces: the linked IR of each
+ * stage, the uniform storage and remap tables, the uniform and shader
+ * storage blocks, the atomic counter buffers and the transform feedback
+ * layout.  The program resource list is not stored; the driver's LinkShader
+ * hook rebuilds it from the restored state, as it does after a real link.
+ *
+ * Entries start with a CRC32 of the rest of the data, so a truncated or
+ * corrupted file is treated as a cache miss.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_DLOPEN
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
+#include "main/core.h"
+#include "main/shaderobj.h"
+#include "program/program.h"
+#include "blob.h"
+#include "ir.h"
+#include "ir_serialize.h"
+#include "ir_uniform.h"
+#include "shader_cache.h"
+#include "util/crc32.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
+#include "util/string_to_uint_map.h"
+
+/* Encodings of the special values of uniform remap table entries. */
+#define REMAP_ENTRY_NULL     0xffffffffu
+#define REMAP_ENTRY_INACTIVE 0xfffffffeu
+
+/**
+ * Hash everything about the context that affects compiling and linking.
+ */
+static void
+context_sha1_update(struct gl_context *ctx, struct mesa_sha1 *sha1)
+{
+   static const char tag[] = "glsl program";
+   struct gl_constants consts;
+
+   _mesa_sha1_update(sha1, tag, sizeof(tag));
+#ifdef PACKAGE_VERSION
+   _mesa_sha1_update(sha1, PACKAGE_VERSION, strlen(PACKAGE_VERSION));
+#endif
+#ifdef HAVE_DLOPEN
+   {
+      /* Tell development builds of the same version apart */
+      Dl_info info;
+      struct stat st;
+
+      if (dladdr((void *) context_sha1_update, &info) &&
+          info.dli_fname && stat(info.dli_fname, &st) == 0) {
+         _mesa_sha1_update(sha1, &st.st_mtime, sizeof(st.st_mtime));
+      }
+   }
+#endif
+
+   _mesa_sha1_update(sha1, &ctx->API, sizeof(ctx->API));
+   _mesa_sha1_update(sha1, &ctx->Version, sizeof(ctx->Version));
+   _mesa_sha1_update(sha1, &ctx->_Shader->Flags,
+                     sizeof(ctx->_Shader->Flags));
+
+   /* The extension enables, but not the string or anything after it. */
+   _mesa_sha1_update(sha1, &ctx->Extensions,
+                     offsetof(struct gl_extensions, String));
+   _mesa_sha1_update(sha1, &ctx->Extensions.Version,
+                     sizeof(ctx->Extensions.Version));
+
+   /* The NIR options are a pointer; the driver that installs them is
+    * already identified by the build.
+    */
+   memcpy(&consts, &ctx->Const, sizeof(consts));
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++)
+      consts.ShaderCompilerOptions[i].NirOptions = NULL;
+   _mesa_sha1_update(sha1, &consts, sizeof(consts));
+}
+
+void
+shader_cache_compute_shader_sha1(struct gl_context *ctx,
+                                 struct gl_shader *shader,
+                                 const char *source)
+{
+   struct mesa_sha1 *sha1 = _mesa_sha1_init();
+
+   if (!sha1) {
+      memset(shader->sha1, 0, sizeof(shader->sha1));
+      return;
+   }
+
+   context_sha1_update(ctx, sha1);
+   _mesa_sha1_update(sha1, &shader->Stage, sizeof(shader->Stage));
+   _mesa_sha1_update(sha1, source, strlen(source));
+   _mesa_sha1_final(sha1, shader->sha1);
+}
+
+bool
+shader_cache_has_shader(struct gl_context *ctx, struct gl_shader *shader)
+{
+   return ctx->Cache && disk_cache_has_key(ctx->Cache, shader->sha1);
+}
+
+
+struct binding {
+   const char *name;
+   unsigned value;
+};
+
+struct binding_list {
+   struct binding *bindings;
+   unsigned count;
+};
+
+static void
+add_binding(const char *name, unsigned value, void *closure)
+{
+   struct binding_list *list = (struct binding_list *) closure;
+
+   list->bindings = (struct binding *)
+      realloc(list->bindings, (list->count + 1) * sizeof(struct binding));
+   if (list->bindings == NULL) {
+      list->count = 0;
+      return;
+   }
+
+   list->bindings[list->count].name = name;
+   list->bindings[list->count].value = value;
+   list->count++;
+}
+
+static int
+compare_bindings(const void *a, const void *b)
+{
+   return strcmp(((const struct binding *) a)->name,
+                 ((const struct binding *) b)->name);
+}
+
+/**
+ * Hash the contents of a binding map in a stable order.
+ */
+static void
+bindings_sha1_update(struct string_to_uint_map *map, struct mesa_sha1 *sha1)
+{
+   struct binding_list list = { NULL, 0 };
+
+   if (map)
+      map->iterate(add_binding, &list);
+
+   qsort(list.bindings, list.count, sizeof(struct binding), compare_bindings);
+
+   _mesa_sha1_update(sha1, &list.count, sizeof(list.count));
+   for (unsigned i = 0; i < list.count; i++) {
+      _mesa_sha1_update(sha1, list.bindings[i].name,
+                        strlen(list.bindings[i].name) + 1);
+      _mesa_sha1_update(sha1, &list.bindings[i].value,
+                        sizeof(list.bindings[i].value));
+   }
+
+   free(list.bindings);
+}
+
+/**
+ * Compute the cache key of \c prog.
+ *
+ * \return false if the program cannot be cached.
+ */
+static bool
+compute_program_sha1(struct gl_context *ctx, struct gl_shader_program *prog,
+                     cache_key key)
+{
+   if (!ctx->Cache || prog->NumShaders == 0)
+      return false;
+
+   /* Programs built internally, like the fixed-function fragment shader,
+    * have no source and no key.
+    */
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      if (prog->Shaders[i]->Source == NULL)
+         return false;
+   }
+
+   struct mesa_sha1 *sha1 = _mesa_sha1_init();
+   if (!sha1)
+      return false;
+
+   context_sha1_update(ctx, sha1);
+
+   _mesa_sha1_update(sha1, &prog->NumShaders, sizeof(prog->NumShaders));
+   for (unsigned i = 0; i < prog->NumShaders; i++) {
+      _mesa_sha1_update(sha1, prog->Shaders[i]->sha1,
+                        sizeof(prog->Shaders[i]->sha1));
+   }
+
+   _mesa_sha1_update(sha1, &prog->SeparateShader,
+                     sizeof(prog->SeparateShader));
+
+   bindings_sha1_update(prog->AttributeBindings, sha1);
+   bindings_sha1_update(prog->FragDataBindings, sha1);
+   bindings_sha1_update(prog->FragDataIndexBindings, sha1);
+
+   _mesa_sha1_update(sha1, &prog->TransformFeedback.BufferMode,
+                     sizeof(prog->TransformFeedback.BufferMode));
+   _mesa_sha1_update(sha1, &prog->TransformFeedback.NumVarying,
+                     sizeof(prog->TransformFeedback.NumVarying));
+   for (unsigned i = 0; i < prog->TransformFeedback.NumVarying; i++) {
+      const char *name = prog->TransformFeedback.VaryingNames[i];
+      _mesa_sha1_update(sha1, name, strlen(name) + 1);
+   }
+
+   _mesa_sha1_final(sha1, key);
+   return true;
+}
+
+
+static void
+write_remap_table(struct blob *metadata, struct gl_shader_program *prog,
+                  unsigned num_entries, struct gl_uniform_storage **table)
+{
+   blob_write_uint32(metadata, num_entries);
+
+   for (unsigned i = 0; i < num_entries; i++) {
+      if (table[i] == NULL) {
+         blob_write_uint32(metadata, REMAP_ENTRY_NULL);
+      } else if (table[i] == INACTIVE_UNIFORM_EXPLICIT_LOCATION) {
+         blob_write_uint32(metadata, REMAP_ENTRY_INACTIVE);
+      } else {
+         blob_write_uint32(metadata, table[i] - prog->data->UniformStorage);
+      }
+   }
+}
+
+static bool
+read_remap_table(struct blob_reader *metadata, struct gl_shader_program *prog,
+                 void *mem_ctx, unsigned *num_entries,
+                 struct gl_uniform_storage ***table)
+{
+   const unsigned count = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       count > (size_t) (metadata->end - metadata->current) / 4)
+      return false;
+
+   *num_entries = count;
+   if (count == 0)
+      return true;
+
+   *table = rzalloc_array(mem_ctx, struct gl_uniform_storage *, count);
+
+   for (unsigned i = 0; i < count; i++) {
+      const uint32_t entry = blob_read_uint32(metadata);
+
+      if (entry == REMAP_ENTRY_NULL) {
+         (*table)[i] = NULL;
+      } else if (entry == REMAP_ENTRY_INACTIVE) {
+         (*table)[i] = INACTIVE_UNIFORM_EXPLICIT_LOCATION;
+      } else if (entry < prog->data->NumUniformStorage) {
+         (*table)[i] = &prog->data->UniformStorage[entry];
+      } else {
+         return false;
+      }
+   }
+
+   return !metadata->overrun;
+}
+
+
+static void
+write_uniforms(struct blob *metadata, struct gl_shader_program *prog)
+{
+   struct gl_shader_program_data *data = prog->data;
+
+   blob_write_uint32(metadata, data->NumUniformStorage);
+   blob_write_uint32(metadata, data->NumHiddenUniforms);
+   blob_write_uint32(metadata, data->NumUniformDataSlots);
+   blob_write_bytes(metadata, data->UniformDataSlots,
+                    data->NumUniformDataSlots *
+                    sizeof(union gl_constant_value));
+
+   for (unsigned i = 0; i < data->NumUniformStorage; i++) {
+      struct gl_uniform_storage uni = data->UniformStorage[i];
+
+      blob_write_string(metadata, uni.name);
+      encode_type_to_blob(metadata, uni.type);
+      blob_write_uint32(metadata, uni.storage ?
+                        uni.storage - data->UniformDataSlots : ~0u);
+
+      /* The rest is plain data.  Driver storage is attached by the driver's
+       * LinkShader hook.
+       */
+      uni.name = NULL;
+      uni.type = NULL;
+      uni.storage = NULL;
+      uni.num_driver_storage = 0;
+      uni.driver_storage = NULL;
+      blob_write_bytes(metadata, &uni, sizeof(uni));
+   }
+
+   write_remap_table(metadata, prog, prog->NumUniformRemapTable,
+                     prog->UniformRemapTable);
+}
+
+static bool
+read_uniforms(struct blob_reader *metadata, struct gl_shader_program *prog)
+{
+   struct gl_shader_program_data *data = prog->data;
+
+   data->NumUniformStorage = blob_read_uint32(metadata);
+   data->NumHiddenUniforms = blob_read_uint32(metadata);
+   const unsigned num_slots = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       data->NumUniformStorage > (size_t) (metadata->end - metadata->current) ||
+       num_slots > (size_t) (metadata->end - metadata->current) ||
+       (num_slots && !data->NumUniformStorage)) {
+      data->NumUniformStorage = 0;
+      return false;
+   }
+
+   if (data->NumUniformStorage) {
+      data->UniformStorage = rzalloc_array(prog, struct gl_uniform_storage,
+                                           data->NumUniformStorage);
+      data->UniformDataSlots = rzalloc_array(data->UniformStorage,
+                                             union gl_constant_value,
+                                             num_slots);
+      data->NumUniformDataSlots = num_slots;
+      blob_copy_bytes(metadata, (uint8_t *) data->UniformDataSlots,
+                      num_slots * sizeof(union gl_constant_value));
+   }
+
+   for (unsigned i = 0; i < data->NumUniformStorage; i++) {
+      struct gl_uniform_storage *uni = &data->UniformStorage[i];
+      const char *name = blob_read_string(metadata);
+      const glsl_type *type = decode_type_from_blob(metadata);
+      const uint32_t slot = blob_read_uint32(metadata);
+
+      blob_copy_bytes(metadata, (uint8_t *) uni, sizeof(*uni));
+
+      if (name == NULL || type == NULL || metadata->overrun ||
+          (slot != ~0u && slot >= num_slots))
+         return false;
+
+      uni->name = ralloc_strdup(data->UniformStorage, name);
+      uni->type = type;
+      uni->storage = slot != ~0u ? &data->UniformDataSlots[slot] : NULL;
+   }
+
+   return read_remap_table(metadata, prog, prog, &prog->NumUniformRemapTable,
+                           &prog->UniformRemapTable);
+}
+
+
+static void
+write_hash_entry(const char *key, unsigned value, void *closure)
+{
+   struct blob *metadata = (struct blob *) closure;
+
+   blob_write_string(metadata, key);
+   blob_write_uint32(metadata, value);
+}
+
+static void
+count_hash_entry(const char *key, unsigned value, void *closure)
+{
+   (*(unsigned *) closure)++;
+}
+
+static void
+write_uniform_hash(struct blob *metadata, struct gl_shader_program *prog)
+{
+   unsigned count = 0;
+
+   if (prog->UniformHash)
+      prog->UniformHash->iterate(count_hash_entry, &count);
+
+   blob_write_uint32(metadata, count);
+   if (count)
+      prog->UniformHash->iterate(write_hash_entry, metadata);
+}
+
+static bool
+read_uniform_hash(struct blob_reader *metadata,
+                  struct gl_shader_program *prog)
+{
+   const unsigned count = blob_read_uint32(metadata);
+
+   prog->UniformHash = new string_to_uint_map;
+
+   for (unsigned i = 0; i < count && !metadata->overrun; i++) {
+      const char *name = blob_read_string(metadata);
+      const unsigned value = blob_read_uint32(metadata);
+
+      if (name == NULL || value == UINT_MAX)
+         return false;
+
+      prog->UniformHash->put(value, name);
+   }
+
+   return !metadata->overrun;
+}
+
+
+static void
+write_blocks(struct blob *metadata, unsigned num_blocks,
+             const struct gl_uniform_block *blocks)
+{
+   blob_write_uint32(metadata, num_blocks);
+
+   for (unsigned i = 0; i < num_blocks; i++) {
+      const struct gl_uniform_block *b = &blocks[i];
+
+      blob_write_string(metadata, b->Name);
+      blob_write_uint32(metadata, b->NumUniforms);
+      blob_write_uint32(metadata, b->Binding);
+      blob_write_uint32(metadata, b->UniformBufferSize);
+      blob_write_uint32(metadata, b->stageref);
+      blob_write_uint32(metadata, b->linearized_array_index);
+      blob_write_uint32(metadata, b->_Packing);
+      blob_write_uint32(metadata, b->_RowMajor);
+
+      for (unsigned j = 0; j < b->NumUniforms; j++) {
+         const struct gl_uniform_buffer_variable *var = &b->Uniforms[j];
+         const bool same_name = var->IndexName == var->Name;
+
+         blob_write_string(metadata, var->Name);
+         blob_write_uint32(metadata, same_name);
+         if (!same_name)
+            blob_write_string(metadata, var->IndexName);
+         encode_type_to_blob(metadata, var->Type);
+         blob_write_uint32(metadata, var->Offset);
+         blob_write_uint32(metadata, var->RowMajor);
+      }
+   }
+}
+
+static bool
+read_blocks(struct blob_reader *metadata, void *mem_ctx,
+            unsigned *num_blocks, struct gl_uniform_block **blocks)
+{
+   const unsigned count = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       count > (size_t) (metadata->end - metadata->current))
+      return false;
+
+   *num_blocks = count;
+   if (count == 0)
+      return true;
+
+   *blocks = rzalloc_array(mem_ctx, struct gl_uniform_block, count);
+
+   for (unsigned i = 0; i < count; i++) {
+      struct gl_uniform_block *b = &(*blocks)[i];
+      const char *name = blob_read_string(metadata);
+
+      b->NumUniforms = blob_read_uint32(metadata);
+      b->Binding = blob_read_uint32(metadata);
+      b->UniformBufferSize = blob_read_uint32(metadata);
+      b->stageref = blob_read_uint32(metadata);
+      b->linearized_array_index = blob_read_uint32(metadata);
+      b->_Packing = (enum gl_uniform_block_packing) blob_read_uint32(metadata);
+      b->_RowMajor = blob_read_uint32(metadata);
+
+      if (name == NULL || metadata->overrun ||
+          b->NumUniforms > (size_t) (metadata->end - metadata->current)) {
+         b->NumUniforms = 0;
+         return false;
+      }
+
+      b->Name = ralloc_strdup(*blocks, name);
+      b->Uniforms = rzalloc_array(*blocks, struct gl_uniform_buffer_variable,
+                                  b->NumUniforms);
+
+      for (unsigned j = 0; j < b->NumUniforms; j++) {
+         struct gl_uniform_buffer_variable *var = &b->Uniforms[j];
+         const char *var_name = blob_read_string(metadata);
+
+         if (var_name == NULL)
+            return false;
+
+         var->Name = ralloc_strdup(*blocks, var_name);
+         if (blob_read_uint32(metadata)) {
+            var->IndexName = var->Name;
+         } else {
+            const char *index_name = blob_read_string(metadata);
+            if (index_name == NULL)
+               return false;
+            var->IndexName = ralloc_strdup(*blocks, index_name);
+         }
+         var->Type = decode_type_from_blob(metadata);
+         var->Offset = blob_read_uint32(metadata);
+         var->RowMajor = blob_read_uint32(metadata);
+
+         if (var->Type == NULL || metadata->overrun)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+static void
+write_block_indices(struct blob *metadata, unsigned num_blocks,
+                    struct gl_uniform_block **blocks,
+                    const struct gl_uniform_block *prog_blocks)
+{
+   blob_write_uint32(metadata, num_blocks);
+   for (unsigned i = 0; i < num_blocks; i++)
+      blob_write_uint32(metadata, blocks[i] - prog_blocks);
+}
+
+static bool
+read_block_indices(struct blob_reader *metadata, void *mem_ctx,
+                   unsigned *num_blocks, struct gl_uniform_block ***blocks,
+                   unsigned num_prog_blocks,
+                   struct gl_uniform_block *prog_blocks)
+{
+   const unsigned count = blob_read_uint32(metadata);
+
+   if (metadata->overrun || count > num_prog_blocks)
+      return false;
+
+   *num_blocks = count;
+   *blocks = ralloc_array(mem_ctx, struct gl_uniform_block *, count);
+
+   for (unsigned i = 0; i < count; i++) {
+      const unsigned index = blob_read_uint32(metadata);
+      if (index >= num_prog_blocks)
+         return false;
+      (*blocks)[i] = &prog_blocks[index];
+   }
+
+   return !metadata->overrun;
+}
+
+
+static void
+write_atomic_buffers(struct blob *metadata, struct gl_shader_program *prog)
+{
+   blob_write_uint32(metadata, prog->data->NumAtomicBuffers);
+
+   for (unsigned i = 0; i < prog->data->NumAtomicBuffers; i++) {
+      const struct gl_active_atomic_buffer *ab = &prog->data->AtomicBuffers[i];
+
+      blob_write_uint32(metadata, ab->NumUniforms);
+      blob_write_bytes(metadata, ab->Uniforms,
+                       ab->NumUniforms * sizeof(ab->Uniforms[0]));
+      blob_write_uint32(metadata, ab->Binding);
+      blob_write_uint32(metadata, ab->MinimumSize);
+      blob_write_bytes(metadata, ab->StageReferences,
+                       sizeof(ab->StageReferences));
+   }
+}
+
+static bool
+read_atomic_buffers(struct blob_reader *metadata,
+                    struct gl_shader_program *prog)
+{
+   const unsigned count = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       count > (size_t) (metadata->end - metadata->current))
+      return false;
+
+   if (count == 0)
+      return true;
+
+   prog->data->AtomicBuffers =
+      rzalloc_array(prog, struct gl_active_atomic_buffer, count);
+   prog->data->NumAtomicBuffers = count;
+
+   for (unsigned i = 0; i < count; i++) {
+      struct gl_active_atomic_buffer *ab = &prog->data->AtomicBuffers[i];
+      const unsigned num_uniforms = blob_read_uint32(metadata);
+
+      if (metadata->overrun ||
+          num_uniforms > (size_t) (metadata->end - metadata->current) / 4)
+         return false;
+
+      ab->NumUniforms = num_uniforms;
+      ab->Uniforms = rzalloc_array(prog->data->AtomicBuffers, GLuint,
+                                   num_uniforms);
+      blob_copy_bytes(metadata, (uint8_t *) ab->Uniforms,
+                      num_uniforms * sizeof(ab->Uniforms[0]));
+      ab->Binding = blob_read_uint32(metadata);
+      ab->MinimumSize = blob_read_uint32(metadata);
+      blob_copy_bytes(metadata, (uint8_t *) ab->StageReferences,
+                      sizeof(ab->StageReferences));
+
+      for (unsigned j = 0; j < num_uniforms; j++) {
+         if (ab->Uniforms[j] >= prog->data->NumUniformStorage)
+            return false;
+      }
+   }
+
+   return !metadata->overrun;
+}
+
+/**
+ * Set up the per-stage lists of atomic buffers, as
+ * link_assign_atomic_counter_resources() does.
+ */
+static void
+setup_stage_atomic_buffers(struct gl_shader_program *prog)
+{
+   for (unsigned j = 0; j < MESA_SHADER_STAGES; ++j) {
+      struct gl_linked_shader *sh = prog->_LinkedShaders[j];
+      unsigned num_buffers = 0;
+
+      if (sh == NULL)
+         continue;
+
+      for (unsigned i = 0; i < prog->data->NumAtomicBuffers; i++) {
+         if (prog->data->AtomicBuffers[i].StageReferences[j])
+            num_buffers++;
+      }
+
+      if (num_buffers == 0)
+         continue;
+
+      struct gl_program *gl_prog = sh->Program;
+      gl_prog->info.num_abos = num_buffers;
+      gl_prog->sh.AtomicBuffers =
+         rzalloc_array(prog, gl_active_atomic_buffer *, num_buffers);
+
+      unsigned intra_stage_idx = 0;
+      for (unsigned i = 0; i < prog->data->NumAtomicBuffers; i++) {
+         if (prog->data->AtomicBuffers[i].StageReferences[j]) {
+            gl_prog->sh.AtomicBuffers[intra_stage_idx++] =
+               &prog->data->AtomicBuffers[i];
+         }
+      }
+   }
+}
+
+
+static void
+write_xfb(struct blob *metadata, struct gl_shader_program *prog)
+{
+   const struct gl_transform_feedback_info *ltf =
+      &prog->LinkedTransformFeedback;
+
+   blob_write_uint32(metadata, ltf->NumOutputs);
+   blob_write_uint32(metadata, ltf->ActiveBuffers);
+   blob_write_bytes(metadata, ltf->Outputs,
+                    ltf->NumOutputs * sizeof(ltf->Outputs[0]));
+
+   blob_write_uint32(metadata, ltf->NumVarying);
+   for (int i = 0; i < ltf->NumVarying; i++) {
+      blob_write_string(metadata, ltf->Varyings[i].Name);
+      blob_write_uint32(metadata, ltf->Varyings[i].Type);
+      blob_write_uint32(metadata, ltf->Varyings[i].BufferIndex);
+      blob_write_uint32(metadata, ltf->Varyings[i].Size);
+      blob_write_uint32(metadata, ltf->Varyings[i].Offset);
+   }
+
+   blob_write_bytes(metadata, ltf->Buffers, sizeof(ltf->Buffers));
+}
+
+static bool
+read_xfb(struct blob_reader *metadata, struct gl_shader_program *prog)
+{
+   struct gl_transform_feedback_info *ltf = &prog->LinkedTransformFeedback;
+   const unsigned num_outputs = blob_read_uint32(metadata);
+   const unsigned active_buffers = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       num_outputs > (size_t) (metadata->end - metadata->current))
+      return false;
+
+   /* Replace the data of a previous link, like store_tfeedback_info(). */
+   ralloc_free(ltf->Varyings);
+   ralloc_free(ltf->Outputs);
+   memset(ltf, 0, sizeof(*ltf));
+
+   ltf->ActiveBuffers = active_buffers;
+   ltf->NumOutputs = num_outputs;
+   ltf->Outputs = rzalloc_array(prog, struct gl_transform_feedback_output,
+                                num_outputs);
+   blob_copy_bytes(metadata, (uint8_t *) ltf->Outputs,
+                   num_outputs * sizeof(ltf->Outputs[0]));
+
+   const unsigned num_varyings = blob_read_uint32(metadata);
+   if (metadata->overrun ||
+       num_varyings > (size_t) (metadata->end - metadata->current))
+      return false;
+
+   ltf->NumVarying = num_varyings;
+   ltf->Varyings = rzalloc_array(prog,
+                                 struct gl_transform_feedback_varying_info,
+                                 num_varyings);
+   for (unsigned i = 0; i < num_varyings; i++) {
+      const char *name = blob_read_string(metadata);
+      if (name == NULL)
+         return false;
+
+      ltf->Varyings[i].Name = ralloc_strdup(prog, name);
+      ltf->Varyings[i].Type = blob_read_uint32(metadata);
+      ltf->Varyings[i].BufferIndex = blob_read_uint32(metadata);
+      ltf->Varyings[i].Size = blob_read_uint32(metadata);
+      ltf->Varyings[i].Offset = blob_read_uint32(metadata);
+   }
+
+   blob_copy_bytes(metadata, (uint8_t *) ltf->Buffers, sizeof(ltf->Buffers));
+
+   return !metadata->overrun;
+}
+
+
+/**
+ * Write an optional list of IR, like gl_linked_shader::packed_varyings.
+ */
+static bool
+write_optional_ir(struct blob *metadata, exec_list *list)
+{
+   blob_write_uint32(metadata, list != NULL);
+   return list == NULL || serialize_ir(metadata, list);
+}
+
+static bool
+read_optional_ir(struct blob_reader *metadata, struct gl_linked_shader *sh,
+                 exec_list **list)
+{
+   if (!blob_read_uint32(metadata))
+      return !metadata->overrun;
+
+   *list = new(sh) exec_list;
+   return deserialize_ir(metadata, sh, *list);
+}
+
+static bool
+write_linked_shader(struct blob *metadata, struct gl_shader_program *prog,
+                    struct gl_linked_shader *sh)
+{
+   blob_write_uint32(metadata, sh->num_samplers);
+   blob_write_uint32(metadata, sh->active_samplers);
+   blob_write_uint32(metadata, sh->shadow_samplers);
+   blob_write_bytes(metadata, sh->SamplerUnits, sizeof(sh->SamplerUnits));
+   blob_write_bytes(metadata, sh->SamplerTargets, sizeof(sh->SamplerTargets));
+   blob_write_uint32(metadata, sh->num_uniform_components);
+   blob_write_uint32(metadata, sh->num_combined_uniform_components);
+
+   write_block_indices(metadata, sh->NumUniformBlocks, sh->UniformBlocks,
+                       prog->data->UniformBlocks);
+   write_block_indices(metadata, sh->NumShaderStorageBlocks,
+                       sh->ShaderStorageBlocks,
+                       prog->data->ShaderStorageBlocks);
+
+   blob_write_bytes(metadata, sh->ImageUnits, sizeof(sh->ImageUnits));
+   blob_write_bytes(metadata, sh->ImageAccess, sizeof(sh->ImageAccess));
+   blob_write_uint32(metadata, sh->NumImages);
+
+   blob_write_uint32(metadata, sh->NumSubroutineUniformTypes);
+   blob_write_uint32(metadata, sh->NumSubroutineUniforms);
+   write_remap_table(metadata, prog, sh->NumSubroutineUniformRemapTable,
+                     sh->SubroutineUniformRemapTable);
+
+   blob_write_uint32(metadata, sh->NumSubroutineFunctions);
+   blob_write_uint32(metadata, sh->MaxSubroutineFunctionIndex);
+   for (unsigned i = 0; i < sh->NumSubroutineFunctions; i++) {
+      const struct gl_subroutine_function *f = &sh->SubroutineFunctions[i];
+
+      blob_write_string(metadata, f->name);
+      blob_write_uint32(metadata, f->index);
+      blob_write_uint32(metadata, f->num_compat_types);
+      for (int j = 0; j < f->num_compat_types; j++)
+         encode_type_to_blob(metadata, f->types[j]);
+   }
+
+   blob_write_bytes(metadata, &sh->info, sizeof(sh->info));
+   blob_write_uint32(metadata, sh->Program->info.fs.post_depth_coverage);
+
+   return serialize_ir(metadata, sh->ir) &&
+          write_optional_ir(metadata, sh->packed_varyings) &&
+          write_optional_ir(metadata, sh->fragdata_arrays);
+}
+
+static bool
+read_linked_shader(struct blob_reader *metadata,
+                   struct gl_shader_program *prog,
+                   struct gl_linked_shader *sh)
+{
+   sh->num_samplers = blob_read_uint32(metadata);
+   sh->active_samplers = blob_read_uint32(metadata);
+   sh->shadow_samplers = blob_read_uint32(metadata);
+   blob_copy_bytes(metadata, (uint8_t *) sh->SamplerUnits,
+                   sizeof(sh->SamplerUnits));
+   blob_copy_bytes(metadata, (uint8_t *) sh->SamplerTargets,
+                   sizeof(sh->SamplerTargets));
+   sh->num_uniform_components = blob_read_uint32(metadata);
+   sh->num_combined_uniform_components = blob_read_uint32(metadata);
+
+   if (!read_block_indices(metadata, sh, &sh->NumUniformBlocks,
+                           &sh->UniformBlocks,
+                           prog->data->NumUniformBlocks,
+                           prog->data->UniformBlocks) ||
+       !read_block_indices(metadata, sh, &sh->NumShaderStorageBlocks,
+                           &sh->ShaderStorageBlocks,
+                           prog->data->NumShaderStorageBlocks,
+                           prog->data->ShaderStorageBlocks))
+      return false;
+
+   blob_copy_bytes(metadata, (uint8_t *) sh->ImageUnits,
+                   sizeof(sh->ImageUnits));
+   blob_copy_bytes(metadata, (uint8_t *) sh->ImageAccess,
+                   sizeof(sh->ImageAccess));
+   sh->NumImages = blob_read_uint32(metadata);
+
+   sh->NumSubroutineUniformTypes = blob_read_uint32(metadata);
+   sh->NumSubroutineUniforms = blob_read_uint32(metadata);
+   if (!read_remap_table(metadata, prog, sh,
+                         &sh->NumSubroutineUniformRemapTable,
+                         &sh->SubroutineUniformRemapTable))
+      return false;
+
+   const unsigned num_functions = blob_read_uint32(metadata);
+   sh->MaxSubroutineFunctionIndex = blob_read_uint32(metadata);
+
+   if (metadata->overrun ||
+       num_functions > (size_t) (metadata->end - metadata->current))
+      return false;
+
+   sh->NumSubroutineFunctions = num_functions;
+   sh->SubroutineFunctions =
+      rzalloc_array(sh, struct gl_subroutine_function, num_functions);
+
+   for (unsigned i = 0; i < num_functions; i++) {
+      struct gl_subroutine_function *f = &sh->SubroutineFunctions[i];
+      const char *name = blob_read_string(metadata);
+
+      if (name == NULL)
+         return false;
+
+      f->name = ralloc_strdup(sh, name);
+      f->index = blob_read_uint32(metadata);
+      f->num_compat_types = blob_read_uint32(metadata);
+
+      if (metadata->overrun || f->num_compat_types < 0 ||
+          f->num_compat_types > metadata->end - metadata->current)
+         return false;
+
+      f->types = ralloc_array(sh, const struct glsl_type *,
+                              f->num_compat_types);
+      for (int j = 0; j < f->num_compat_types; j++) {
+         f->types[j] = decode_type_from_blob(metadata);
+         if (f->types[j] == NULL)
+            return false;
+      }
+   }
+
+   blob_copy_bytes(metadata, (uint8_t *) &sh->info, sizeof(sh->info));
+   sh->Program->info.fs.post_depth_coverage = blob_read_uint32(metadata);
+
+   sh->ir = new(sh) exec_list;
+   return deserialize_ir(metadata, sh, sh->ir) &&
+          read_optional_ir(metadata, sh, &sh->packed_varyings) &&
+          read_optional_ir(metadata, sh, &sh->fragdata_arrays);
+}
+
+
+static bool
+write_program(struct blob *metadata, struct gl_shader_program *prog)
+{
+   blob_write_string(metadata, prog->data->InfoLog);
+   blob_write_uint32(metadata, prog->data->Version);
+   blob_write_uint32(metadata, prog->data->linked_stages);
+
+   blob_write_uint32(metadata, prog->FragDepthLayout);
+   blob_write_bytes(metadata, &prog->TessEval, sizeof(prog->TessEval));
+   blob_write_bytes(metadata, &prog->Geom, sizeof(prog->Geom));
+   blob_write_bytes(metadata, &prog->Vert, sizeof(prog->Vert));
+   blob_write_bytes(metadata, &prog->Comp, sizeof(prog->Comp));
+   blob_write_uint32(metadata, prog->LastClipDistanceArraySize);
+   blob_write_uint32(metadata, prog->LastCullDistanceArraySize);
+   blob_write_uint32(metadata, prog->IsES);
+   blob_write_uint32(metadata, prog->ARB_fragment_coord_conventions_enable);
+
+   write_uniforms(metadata, prog);
+   write_uniform_hash(metadata, prog);
+   write_blocks(metadata, prog->data->NumUniformBlocks,
+                prog->data->UniformBlocks);
+   write_blocks(metadata, prog->data->NumShaderStorageBlocks,
+                prog->data->ShaderStorageBlocks);
+   write_atomic_buffers(metadata, prog);
+   write_xfb(metadata, prog);
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      struct gl_linked_shader *sh = prog->_LinkedShaders[i];
+
+      blob_write_uint32(metadata, sh != NULL);
+      if (sh && !write_linked_shader(metadata, prog, sh))
+         return false;
+   }
+
+   return true;
+}
+
+static bool
+read_program(struct gl_context *ctx, struct blob_reader *metadata,
+             struct gl_shader_program *prog)
+{
+   const char *info_log = blob_read_string(metadata);
+   if (info_log == NULL)
+      return false;
+
+   ralloc_free(prog->data->InfoLog);
+   prog->data->InfoLog = ralloc_strdup(prog->data, info_log);
+   prog->data->Version = blob_read_uint32(metadata);
+   prog->data->linked_stages = blob_read_uint32(metadata);
+
+   prog->FragDepthLayout = (enum gl_frag_depth_layout)
+      blob_read_uint32(metadata);
+   blob_copy_bytes(metadata, (uint8_t *) &prog->TessEval,
+                   sizeof(prog->TessEval));
+   blob_copy_bytes(metadata, (uint8_t *) &prog->Geom, sizeof(prog->Geom));
+   blob_copy_bytes(metadata, (uint8_t *) &prog->Vert, sizeof(prog->Vert));
+   blob_copy_bytes(metadata, (uint8_t *) &prog->Comp, sizeof(prog->Comp));
+   prog->LastClipDistanceArraySize = blob_read_uint32(metadata);
+   prog->LastCullDistanceArraySize = blob_read_uint32(metadata);
+   prog->IsES = blob_read_uint32(metadata);
+   prog->ARB_fragment_coord_conventions_enable = blob_read_uint32(metadata);
+
+   if (!read_uniforms(metadata, prog) ||
+       !read_uniform_hash(metadata, prog) ||
+       !read_blocks(metadata, prog, &prog->data->NumUniformBlocks,
+                    &prog->data->UniformBlocks) ||
+       !read_blocks(metadata, prog, &prog->data->NumShaderStorageBlocks,
+                    &prog->data->ShaderStorageBlocks) ||
+       !read_atomic_buffers(metadata, prog) ||
+       !read_xfb(metadata, prog))
+      return false;
+
+   for (unsigned i = 0; i < MESA_SHADER_STAGES; i++) {
+      if (!blob_read_uint32(metadata))
+         continue;
+
+      if (metadata->overrun)
+         return false;
+
+      struct gl_linked_shader *sh =
+         ctx->Driver.NewShader((gl_shader_stage) i);
+      struct gl_program *gl_prog =
+         ctx->Driver.NewProgram(ctx, _mesa_shader_stage_to_program(i),
+                                prog->Name);
+      if (!gl_prog) {
+         _mesa_delete_linked_shader(ctx, sh);
+         return false;
+      }
+
+      /* Don't use _mesa_reference_program() just take ownership */
+      sh->Program = gl_prog;
+      prog->_LinkedShaders[i] = sh;
+
+      if (!read_linked_shader(metadata, prog, sh))
+         return false;
+   }
+
+   setup_stage_atomic_buffers(prog);
+
+   return metadata->current == metadata->end && !metadata->overrun;
+}
+
+
+void
+shader_cache_write_program_metadata(struct gl_context *ctx,
+                                    struct gl_shader_program *prog)
+{
+   cache_key key;
+
+   if (!compute_program_sha1(ctx, prog, key))
+      return;
+
+   struct blob *metadata = blob_create(NULL);
+   if (metadata == NULL)
+      return;
+
+   /* Checksum of the rest of the entry, filled in below. */
+   blob_write_uint32(metadata, 0);
+
+   if (write_program(metadata, prog)) {
+      blob_overwrite_uint32(metadata, 0,
+                            util_hash_crc32(metadata->data + 4,
+                                            metadata->size - 4));
+      disk_cache_put(ctx->Cache, key, metadata->data, metadata->size);
+
+      /* Let later compiles of these shaders be skipped. */
+      for (unsigned i = 0; i < prog->NumShaders; i++)
+         disk_cache_put_key(ctx->Cache, prog->Shaders[i]->sha1);
+   }
+
+   ralloc_free(metadata);
+}
+
+bool
+shader_cache_read_program_metadata(struct gl_context *ctx,
+                                   struct gl_shader_program *prog)
+{
+   cache_key key;
+   size_t size;
+
+   if (!compute_program_sha1(ctx, prog, key))
+      return false;
+
+   uint8_t *buffer = (uint8_t *) disk_cache_get(ctx->Cache, key, &size);
+   if (buffer == NULL)
+      return false;
+
+   struct blob_reader metadata;
+   blob_reader_init(&metadata, buffer, size);
+
+   const uint32_t crc = blob_read_uint32(&metadata);
+   bool hit = !metadata.overrun &&
+              crc == util_hash_crc32(buffer + 4, size - 4);
+
+   if (hit) {
+      hit = read_program(ctx, &metadata, prog);
+
+      if (!hit) {
+         /* Throw away whatever was restored and link for real. */
+         _mesa_clear_shader_program_data(ctx, prog);
+      }
+   }
+
+   free(buffer);
+
+   if (hit) {
+      prog->data->LinkStatus = true;
+      prog->data->Validated = false;
+      prog->_Used = false;
+   }
+
+   return hit;
+}
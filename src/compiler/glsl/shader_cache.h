@@ -0,0 +1,82 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \file shader_cache.h
+ *
+ * Persistent cache of linked GLSL programs.
+ *
+ * The result of link_shaders() is stored in the on-disk cache (see
+ * util/disk_cache.h) under a key derived from the source of the attached
+ * shaders, the state the application set up for linking and the driver's
+ * compiler options.  When the same program is linked again, possibly by a
+ * later run of the application, the linked shaders are restored from the
+ * cache and handed straight to the driver's LinkShader hook.
+ *
+ * Shaders whose program is expected to be in the cache are not compiled at
+ * all; if the program turns out not to be there, they are compiled during
+ * the link.
+ */
+
+#pragma once
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+struct gl_context;
+struct gl_shader;
+struct gl_shader_program;
+
+/**
+ * Compute the cache key of \c source compiled as \c shader into
+ * \c shader->sha1.
+ */
+void
+shader_cache_compute_shader_sha1(struct gl_context *ctx,
+                                 struct gl_shader *shader,
+                                 const char *source);
+
+/**
+ * Whether compiling \c shader can be deferred because a program linked from
+ * it is in the cache.  \c shader->sha1 must be up to date.
+ */
+bool
+shader_cache_has_shader(struct gl_context *ctx, struct gl_shader *shader);
+
+/**
+ * Restore the result of link_shaders() for \c prog from the cache.
+ *
+ * \return true on a cache hit.  On a miss \c prog is left untouched.
+ */
+bool
+shader_cache_read_program_metadata(struct gl_context *ctx,
+                                   struct gl_shader_program *prog);
+
+/**
+ * Store the result of a successful link_shaders() for \c prog in the cache.
+ * Must be called before the driver's LinkShader hook lowers the IR.
+ */
+void
+shader_cache_write_program_metadata(struct gl_context *ctx,
+                                    struct gl_shader_program *prog);
+
+#endif /* SHADER_CACHE_H */
@@ -135,14 +135,14 @@ new_program(struct gl_context *ctx, GLenum target, GLuint id)
 static const struct standalone_options *options;
 
 static void
-initialize_context(struct gl_context *ctx, gl_api api)
+initialize_context(struct gl_context *ctx, gl_api api, int glsl_version)
 {
    initialize_context_to_defaults(ctx, api);
 
    /* The standalone compiler needs to claim support for almost
     * everything in order to compile the built-in functions.
     */
-   ctx->Const.GLSLVersion = options->glsl_version;
+   ctx->Const.GLSLVersion = glsl_version;
    ctx->Extensions.ARB_ES3_compatibility = true;
    ctx->Const.MaxComputeWorkGroupCount[0] = 65535;
    ctx->Const.MaxComputeWorkGroupCount[1] = 65535;
@@ -384,7 +384,8 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    struct _mesa_glsl_parse_state *state =
       new(shader) _mesa_glsl_parse_state(ctx, shader->Stage, shader);
 
-   _mesa_glsl_compile_shader(ctx, shader, options->dump_ast, options->dump_hir);
+   _mesa_glsl_compile_shader(ctx, shader, options->dump_ast,
+                             options->dump_hir, true);
 
    /* Print out the resulting IR */
    if (!state->error && options->dump_lir) {
@@ -394,18 +395,16 @@ compile_shader(struct gl_context *ctx, struct gl_shader *shader)
    return;
 }
 
-extern "C" struct gl_shader_program *
-standalone_compile_shader(const struct standalone_options *_options,
-      unsigned num_files, char* const* files)
+/**
+ * Sets up a context supporting GLSL version glsl_version.  Returns false if
+ * the version isn't known.
+ */
+extern "C" bool
+standalone_initialize_context(struct gl_context *ctx, int glsl_version)
 {
-   int status = EXIT_SUCCESS;
-   static struct gl_context local_ctx;
-   struct gl_context *ctx = &local_ctx;
    bool glsl_es = false;
 
-   options = _options;
-
-   switch (options->glsl_version) {
+   switch (glsl_version) {
    case 100:
    case 300:
       glsl_es = true;
@@ -425,14 +424,32 @@ standalone_compile_shader(const struct standalone_options *_options,
       glsl_es = false;
       break;
    default:
-      fprintf(stderr, "Unrecognized GLSL version `%d'\n", options->glsl_version);
-      return NULL;
+      return false;
    }
 
    if (glsl_es) {
-      initialize_context(ctx, API_OPENGLES2);
+      initialize_context(ctx, API_OPENGLES2, glsl_version);
    } else {
-      initialize_context(ctx, options->glsl_version > 130 ? API_OPENGL_CORE : API_OPENGL_COMPAT);
+      initialize_context(ctx, glsl_version > 130 ? API_OPENGL_CORE : API_OPENGL_COMPAT,
+                         glsl_version);
+   }
+
+   return true;
+}
+
+extern "C" struct gl_shader_program *
+standalone_compile_shader(const struct standalone_options *_options,
+      unsigned num_files, char* const* files)
+{
+   int status = EXIT_SUCCESS;
+   static struct gl_context local_ctx;
+   struct gl_context *ctx = &local_ctx;
+
+   options = _options;
+
+   if (!standalone_initialize_context(ctx, options->glsl_version)) {
+      fprintf(stderr, "Unrecognized GLSL version `%d'\n", options->glsl_version);
+      return NULL;
    }
 
    struct gl_shader_program *whole_program;
@@ -24,6 +24,8 @@
 #ifndef GLSL_STANDALONE_H
 #define GLSL_STANDALONE_H
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -38,8 +40,11 @@ struct standalone_options {
    int just_log;
 };
 
+struct gl_context;
 struct gl_shader_program;
 
+bool standalone_initialize_context(struct gl_context *ctx, int glsl_version);
+
 struct gl_shader_program * standalone_compile_shader(
       const struct standalone_options *options,
       unsigned num_files, char* const* files);
@@ -95,7 +95,6 @@ _mesa_new_linked_shader(gl_shader_stage stage)
 {
    struct gl_linked_shader *shader;
 
-   assert(stage == MESA_SHADER_FRAGMENT || stage == MESA_SHADER_VERTEX);
    shader = rzalloc(NULL, struct gl_linked_shader);
    if (shader) {
       shader->Stage = stage;
@@ -119,6 +118,7 @@ void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
    free((void *)sh->Source);
+   free((void *)sh->FallbackSource);
    free(sh->Label);
    ralloc_free(sh);
 }
@@ -143,6 +143,8 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
 
    shProg->data->NumUniformStorage = 0;
    shProg->data->UniformStorage = NULL;
+   shProg->data->NumUniformDataSlots = 0;
+   shProg->data->UniformDataSlots = NULL;
    shProg->NumUniformRemapTable = 0;
    shProg->UniformRemapTable = NULL;
    shProg->UniformHash = NULL;
@@ -163,6 +165,11 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
    shProg->data->NumAtomicBuffers = 0;
 }
 
+void
+_mesa_create_program_resource_hash(struct gl_shader_program *shProg)
+{
+}
+
 void initialize_context_to_defaults(struct gl_context *ctx, gl_api api)
 {
    memset(ctx, 0, sizeof(*ctx));
@@ -63,6 +63,9 @@ extern "C" void
 _mesa_clear_shader_program_data(struct gl_context *ctx,
                                 struct gl_shader_program *);
 
+extern "C" void
+_mesa_create_program_resource_hash(struct gl_shader_program *shProg);
+
 extern "C" void
 _mesa_shader_debug(struct gl_context *ctx, GLenum type, GLuint *id,
                    const char *msg);
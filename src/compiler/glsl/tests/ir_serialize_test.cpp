@@ -0,0 +1,188 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ir.h"
+#include "ir_builder.h"
+#include "ir_serialize.h"
+#include "program.h"
+
+using namespace ir_builder;
+
+class ir_serialize_test : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   char *print(exec_list *list);
+   bool round_trip(exec_list *out, size_t truncate = 0);
+
+   void *mem_ctx;
+   exec_list instructions;
+};
+
+void
+ir_serialize_test::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+   instructions.make_empty();
+}
+
+void
+ir_serialize_test::TearDown()
+{
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+}
+
+char *
+ir_serialize_test::print(exec_list *list)
+{
+   char *buf = NULL;
+   size_t size = 0;
+   FILE *f = open_memstream(&buf, &size);
+
+   _mesa_print_ir(f, list, NULL);
+   fclose(f);
+
+   return buf;
+}
+
+/**
+ * Serialize \c instructions and read the result back into \c out, dropping
+ * the last \c truncate bytes of the data.
+ */
+bool
+ir_serialize_test::round_trip(exec_list *out, size_t truncate)
+{
+   struct blob *blob = blob_create(mem_ctx);
+   struct blob_reader reader;
+
+   EXPECT_TRUE(serialize_ir(blob, &instructions));
+
+   blob_reader_init(&reader, blob->data, blob->size - truncate);
+   return deserialize_ir(&reader, mem_ctx, out);
+}
+
+TEST_F(ir_serialize_test, types)
+{
+   const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_type::vec4_type, "a"),
+      glsl_struct_field(glsl_type::get_array_instance(glsl_type::mat3_type,
+                                                      2), "b"),
+   };
+   const glsl_type *types[] = {
+      glsl_type::dvec3_type,
+      glsl_type::get_array_instance(glsl_type::ivec2_type, 7),
+      glsl_type::get_sampler_instance(GLSL_SAMPLER_DIM_CUBE, true, true,
+                                      GLSL_TYPE_FLOAT),
+      glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), "S"),
+      glsl_type::get_interface_instance(fields, ARRAY_SIZE(fields),
+                                        GLSL_INTERFACE_PACKING_STD140,
+                                        false, "Block"),
+      glsl_type::atomic_uint_type,
+      NULL,
+   };
+
+   struct blob *blob = blob_create(mem_ctx);
+   for (unsigned i = 0; i < ARRAY_SIZE(types); i++)
+      encode_type_to_blob(blob, types[i]);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob->data, blob->size);
+   for (unsigned i = 0; i < ARRAY_SIZE(types); i++)
+      EXPECT_EQ(types[i], decode_type_from_blob(&reader));
+
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.end, reader.current);
+}
+
+TEST_F(ir_serialize_test, functions_and_control_flow)
+{
+   ir_variable *u = new(mem_ctx) ir_variable(glsl_type::vec4_type, "u",
+                                             ir_var_uniform);
+   ir_variable *out = new(mem_ctx) ir_variable(glsl_type::float_type, "out",
+                                               ir_var_shader_out);
+   instructions.push_tail(u);
+   instructions.push_tail(out);
+
+   /* float helper(float p) { return p * 2.0; } */
+   ir_function *helper_func = new(mem_ctx) ir_function("helper");
+   ir_function_signature *helper =
+      new(mem_ctx) ir_function_signature(glsl_type::float_type);
+   ir_variable *p = new(mem_ctx) ir_variable(glsl_type::float_type, "p",
+                                             ir_var_function_in);
+   helper->parameters.push_tail(p);
+   helper->body.push_tail(new(mem_ctx) ir_return(mul(p, new(mem_ctx) ir_constant(2.0f))));
+   helper->is_defined = true;
+   helper_func->add_signature(helper);
+   instructions.push_tail(helper_func);
+
+   /* void main() { ... } */
+   ir_function *main_func = new(mem_ctx) ir_function("main");
+   ir_function_signature *main_sig =
+      new(mem_ctx) ir_function_signature(glsl_type::void_type);
+   main_sig->is_defined = true;
+   main_func->add_signature(main_sig);
+   instructions.push_tail(main_func);
+
+   ir_factory body(&main_sig->body, mem_ctx);
+   ir_variable *t = body.make_temp(glsl_type::float_type, "t");
+
+   exec_list params;
+   params.push_tail(swizzle_y(u));
+   body.emit(new(mem_ctx) ir_call(helper,
+                                  new(mem_ctx) ir_dereference_variable(t),
+                                  &params));
+
+   ir_loop *loop = new(mem_ctx) ir_loop();
+   loop->body_instructions.push_tail(
+      new(mem_ctx) ir_loop_jump(ir_loop_jump::jump_break));
+
+   ir_if *branch = new(mem_ctx) ir_if(greater(t, new(mem_ctx) ir_constant(0.0f)));
+   branch->then_instructions.push_tail(loop);
+   branch->else_instructions.push_tail(new(mem_ctx) ir_discard());
+   body.emit(branch);
+   body.emit(assign(out, t));
+
+   exec_list copy;
+   ASSERT_TRUE(round_trip(&copy));
+
+   char *expected = print(&instructions);
+   char *actual = print(&copy);
+   EXPECT_STREQ(expected, actual);
+   free(expected);
+   free(actual);
+}
+
+TEST_F(ir_serialize_test, truncated_data_is_rejected)
+{
+   ir_variable *v = new(mem_ctx) ir_variable(glsl_type::vec2_type, "v",
+                                             ir_var_auto);
+   instructions.push_tail(v);
+   instructions.push_tail(assign(v, new(mem_ctx) ir_constant(1.0f, 2), 0x3));
+
+   exec_list copy;
+   EXPECT_FALSE(round_trip(&copy, 4));
+}
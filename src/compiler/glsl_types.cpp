@@ -26,14 +26,15 @@
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 
 mtx_t glsl_type::mutex = _MTX_INITIALIZER_NP;
-hash_table *glsl_type::array_types = NULL;
-hash_table *glsl_type::record_types = NULL;
-hash_table *glsl_type::interface_types = NULL;
-hash_table *glsl_type::function_types = NULL;
-hash_table *glsl_type::subroutine_types = NULL;
+glsl_type_table *glsl_type::array_types = NULL;
+glsl_type_table *glsl_type::record_types = NULL;
+glsl_type_table *glsl_type::interface_types = NULL;
+glsl_type_table *glsl_type::function_types = NULL;
+glsl_type_table *glsl_type::subroutine_types = NULL;
 void *glsl_type::mem_ctx = NULL;
 
 void
@@ -62,13 +63,9 @@ glsl_type::glsl_type(GLenum gl_type,
    STATIC_ASSERT((unsigned(GLSL_TYPE_INT)   & 3) == unsigned(GLSL_TYPE_INT));
    STATIC_ASSERT((unsigned(GLSL_TYPE_FLOAT) & 3) == unsigned(GLSL_TYPE_FLOAT));
 
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-
-   mtx_unlock(&glsl_type::mutex);
+   this->name = ralloc_strdup(this->ralloc_ctx, name);
 
    /* Neither dimension is zero or both dimensions are zero.
     */
@@ -85,13 +82,9 @@ glsl_type::glsl_type(GLenum gl_type, glsl_base_type base_type,
    sampler_array(array), sampled_type(type), interface_packing(0),
    interface_row_major(0), length(0)
 {
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-
-   mtx_unlock(&glsl_type::mutex);
+   this->name = ralloc_strdup(this->ralloc_ctx, name);
 
    memset(& fields, 0, sizeof(fields));
 
@@ -114,12 +107,10 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-   this->fields.structure = ralloc_array(this->mem_ctx,
+   this->name = ralloc_strdup(this->ralloc_ctx, name);
+   this->fields.structure = ralloc_array(this->ralloc_ctx,
                                          glsl_struct_field, length);
 
    for (i = 0; i < length; i++) {
@@ -127,8 +118,6 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
       this->fields.structure[i].name = ralloc_strdup(this->fields.structure,
                                                      fields[i].name);
    }
-
-   mtx_unlock(&glsl_type::mutex);
 }
 
 glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
@@ -144,20 +133,16 @@ glsl_type::glsl_type(const glsl_struct_field *fields, unsigned num_fields,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
    assert(name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, name);
-   this->fields.structure = rzalloc_array(this->mem_ctx,
+   this->name = ralloc_strdup(this->ralloc_ctx, name);
+   this->fields.structure = rzalloc_array(this->ralloc_ctx,
                                           glsl_struct_field, length);
    for (i = 0; i < length; i++) {
       this->fields.structure[i] = fields[i];
       this->fields.structure[i].name = ralloc_strdup(this->fields.structure,
                                                      fields[i].name);
    }
-
-   mtx_unlock(&glsl_type::mutex);
 }
 
 glsl_type::glsl_type(const glsl_type *return_type,
@@ -171,11 +156,9 @@ glsl_type::glsl_type(const glsl_type *return_type,
 {
    unsigned int i;
 
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
 
-   this->fields.parameters = rzalloc_array(this->mem_ctx,
+   this->fields.parameters = rzalloc_array(this->ralloc_ctx,
                                            glsl_function_param, num_params + 1);
 
    /* We store the return type as the first parameter */
@@ -189,8 +172,6 @@ glsl_type::glsl_type(const glsl_type *return_type,
       this->fields.parameters[i + 1].in = params[i].in;
       this->fields.parameters[i + 1].out = params[i].out;
    }
-
-   mtx_unlock(&glsl_type::mutex);
 }
 
 glsl_type::glsl_type(const char *subroutine_name) :
@@ -201,12 +182,14 @@ glsl_type::glsl_type(const char *subroutine_name) :
    vector_elements(1), matrix_columns(1),
    length(0)
 {
-   mtx_lock(&glsl_type::mutex);
-
-   init_ralloc_type_ctx();
+   this->ralloc_ctx = ralloc_context(NULL);
    assert(subroutine_name != NULL);
-   this->name = ralloc_strdup(this->mem_ctx, subroutine_name);
-   mtx_unlock(&glsl_type::mutex);
+   this->name = ralloc_strdup(this->ralloc_ctx, subroutine_name);
+}
+
+glsl_type::~glsl_type()
+{
+   ralloc_free(this->ralloc_ctx);
 }
 
 bool
@@ -387,6 +370,129 @@ const glsl_type *glsl_type::get_scalar_type() const
 }
 
 
+struct glsl_type_table_slot {
+   uint32_t hash;
+   const glsl_type *type;
+};
+
+/**
+ * Table of the interned types of one kind.
+ *
+ * Types are only ever added, so lookups can probe the table without
+ * locking, see glsl_type::lookup.  A slot is filled by storing its hash and
+ * then, with release semantics, the type.  Insertions take glsl_type::mutex.
+ * When the table grows, the old one is kept around as a child of the new
+ * one, since lookups may still be probing it.
+ */
+struct glsl_type_table {
+   unsigned mask;
+   unsigned entries;
+   glsl_type_table_slot *slots;
+};
+
+static const glsl_type *
+find_type(const glsl_type_table *table, uint32_t hash,
+          bool (*equal)(const void *, const void *), const void *key)
+{
+   if (table == NULL)
+      return NULL;
+
+   for (unsigned i = hash & table->mask; ; i = (i + 1) & table->mask) {
+      const glsl_type *t = p_atomic_read(&table->slots[i].type);
+
+      if (t == NULL)
+         return NULL;
+
+      if (table->slots[i].hash == hash && equal(t, key))
+         return t;
+   }
+}
+
+static void
+insert_type(glsl_type_table *table, uint32_t hash, const glsl_type *t)
+{
+   unsigned i = hash & table->mask;
+
+   while (table->slots[i].type != NULL)
+      i = (i + 1) & table->mask;
+
+   table->slots[i].hash = hash;
+   p_atomic_set(&table->slots[i].type, t);
+   table->entries++;
+}
+
+/**
+ * Find the type matching key in the table.
+ *
+ * The table is only probed without glsl_type::mutex when p_atomic_read()
+ * and p_atomic_set() are acquire loads and release stores.  The other
+ * u_atomic.h implementations make them plain accesses, which don't order
+ * the lookup with the stores filling in a new type or table.
+ */
+const glsl_type *
+glsl_type::lookup(glsl_type_table *const *table_ptr, uint32_t hash,
+                  bool (*equal)(const void *, const void *), const void *key)
+{
+#ifdef USE_GCC_ATOMIC_BUILTINS
+   return find_type(p_atomic_read(table_ptr), hash, equal, key);
+#else
+   mtx_lock(&glsl_type::mutex);
+   const glsl_type *t = find_type(*table_ptr, hash, equal, key);
+   mtx_unlock(&glsl_type::mutex);
+   return t;
+#endif
+}
+
+/**
+ * Add t to the table, unless another thread added a type matching key in
+ * the meantime, in which case t is deleted and that type is returned.
+ */
+const glsl_type *
+glsl_type::intern(glsl_type_table **table_ptr, uint32_t hash, glsl_type *t,
+                  bool (*equal)(const void *, const void *), const void *key)
+{
+   mtx_lock(&glsl_type::mutex);
+
+   const glsl_type *found = find_type(*table_ptr, hash, equal, key);
+   if (found != NULL) {
+      mtx_unlock(&glsl_type::mutex);
+      delete t;
+      return found;
+   }
+
+   glsl_type_table *table = *table_ptr;
+   if (table == NULL || (table->entries + 1) * 2 > table->mask + 1) {
+      const unsigned size = table != NULL ? 2 * (table->mask + 1) : 64;
+      glsl_type_table *grown = ralloc(mem_ctx, glsl_type_table);
+
+      grown->mask = size - 1;
+      grown->entries = 0;
+      grown->slots = rzalloc_array(grown, glsl_type_table_slot, size);
+
+      if (table != NULL) {
+         for (unsigned i = 0; i <= table->mask; i++) {
+            if (table->slots[i].type != NULL)
+               insert_type(grown, table->slots[i].hash, table->slots[i].type);
+         }
+         ralloc_steal(grown, table);
+      }
+
+      p_atomic_set(table_ptr, grown);
+      table = grown;
+   }
+
+   /* Interned types are never deleted, tie their storage to them so that
+    * it goes away with mem_ctx.
+    */
+   ralloc_steal(t, t->ralloc_ctx);
+   insert_type(table, hash, t);
+
+   mtx_unlock(&glsl_type::mutex);
+
+   return t;
+}
+
+
 void
 _mesa_glsl_release_types(void)
 {
@@ -394,20 +500,14 @@ _mesa_glsl_release_types(void)
     * object, or if process terminates), so no mutex-locking should be
     * necessary.
     */
-   if (glsl_type::array_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::array_types, NULL);
-      glsl_type::array_types = NULL;
-   }
+   ralloc_free(glsl_type::array_types);
+   glsl_type::array_types = NULL;
 
-   if (glsl_type::record_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::record_types, NULL);
-      glsl_type::record_types = NULL;
-   }
+   ralloc_free(glsl_type::record_types);
+   glsl_type::record_types = NULL;
 
-   if (glsl_type::interface_types != NULL) {
-      _mesa_hash_table_destroy(glsl_type::interface_types, NULL);
-      glsl_type::interface_types = NULL;
-   }
+   ralloc_free(glsl_type::interface_types);
+   glsl_type::interface_types = NULL;
 }
 
 
@@ -431,9 +531,8 @@ glsl_type::glsl_type(const glsl_type *array, unsigned length) :
     */
    const unsigned name_length = strlen(array->name) + 10 + 3;
 
-   mtx_lock(&glsl_type::mutex);
-   char *const n = (char *) ralloc_size(this->mem_ctx, name_length);
-   mtx_unlock(&glsl_type::mutex);
+   this->ralloc_ctx = ralloc_context(NULL);
+   char *const n = (char *) ralloc_size(this->ralloc_ctx, name_length);
 
    if (length == 0)
       snprintf(n, name_length, "%s[]", array->name);
@@ -813,42 +912,42 @@ glsl_type::get_image_instance(enum glsl_sampler_dim dim,
    unreachable("switch statement above should be complete");
 }
 
+struct array_key {
+   const glsl_type *base;
+   unsigned length;
+};
+
+static bool
+array_key_compare(const void *a, const void *b)
+{
+   const glsl_type *const t = (const glsl_type *) a;
+   const array_key *const key = (const array_key *) b;
+
+   return t->fields.array == key->base && t->length == key->length;
+}
+
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
-   /* Generate a name using the base type pointer in the key.  This is
+   /* The key uses the base type pointer rather than its name.  This is
     * done because the name of the base type may not be unique across
     * shaders.  For example, two shaders may have different record types
     * named 'foo'.
     */
-   char key[128];
-   snprintf(key, sizeof(key), "%p[%u]", (void *) base, array_size);
-
-   mtx_lock(&glsl_type::mutex);
-
-   if (array_types == NULL) {
-      array_types = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
-                                            _mesa_key_string_equal);
-   }
-
-   const struct hash_entry *entry = _mesa_hash_table_search(array_types, key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(base, array_size);
-      mtx_lock(&glsl_type::mutex);
+   const array_key key = { base, array_size };
+   const uint32_t hash = _mesa_hash_pointer(base) * 31 + array_size;
 
-      entry = _mesa_hash_table_insert(array_types,
-                                      ralloc_strdup(mem_ctx, key),
-                                      (void *) t);
+   const glsl_type *t = lookup(&array_types, hash, array_key_compare, &key);
+   if (t == NULL) {
+      t = intern(&array_types, hash, new glsl_type(base, array_size),
+                 array_key_compare, &key);
    }
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_ARRAY);
-   assert(((glsl_type *) entry->data)->length == array_size);
-   assert(((glsl_type *) entry->data)->fields.array == base);
+   assert(t->base_type == GLSL_TYPE_ARRAY);
+   assert(t->length == array_size);
+   assert(t->fields.array == base);
 
-   mtx_unlock(&glsl_type::mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -978,31 +1077,20 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
                                const char *name)
 {
    const glsl_type key(fields, num_fields, name);
+   const uint32_t hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::mutex);
-
-   if (record_types == NULL) {
-      record_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                             record_key_compare);
+   const glsl_type *t = lookup(&record_types, hash, record_key_compare, &key);
+   if (t == NULL) {
+      t = intern(&record_types, hash,
+                 new glsl_type(fields, num_fields, name),
+                 record_key_compare, &key);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(record_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(fields, num_fields, name);
-      mtx_lock(&glsl_type::mutex);
-
-      entry = _mesa_hash_table_insert(record_types, t, (void *) t);
-   }
+   assert(t->base_type == GLSL_TYPE_STRUCT);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, name) == 0);
 
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_STRUCT);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
-
-   mtx_unlock(&glsl_type::mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1014,62 +1102,41 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
                                   const char *block_name)
 {
    const glsl_type key(fields, num_fields, packing, row_major, block_name);
-
-   mtx_lock(&glsl_type::mutex);
-
-   if (interface_types == NULL) {
-      interface_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                record_key_compare);
+   const uint32_t hash = record_key_hash(&key);
+
+   const glsl_type *t = lookup(&interface_types, hash,
+                               record_key_compare, &key);
+   if (t == NULL) {
+      t = intern(&interface_types, hash,
+                 new glsl_type(fields, num_fields,
+                               packing, row_major, block_name),
+                 record_key_compare, &key);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(fields, num_fields,
-                                         packing, row_major, block_name);
-      mtx_lock(&glsl_type::mutex);
+   assert(t->base_type == GLSL_TYPE_INTERFACE);
+   assert(t->length == num_fields);
+   assert(strcmp(t->name, block_name) == 0);
 
-      entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
-   }
-
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_INTERFACE);
-   assert(((glsl_type *) entry->data)->length == num_fields);
-   assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
-
-   mtx_unlock(&glsl_type::mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 const glsl_type *
 glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
    const glsl_type key(subroutine_name);
+   const uint32_t hash = record_key_hash(&key);
 
-   mtx_lock(&glsl_type::mutex);
-
-   if (subroutine_types == NULL) {
-      subroutine_types = _mesa_hash_table_create(NULL, record_key_hash,
-                                                 record_key_compare);
+   const glsl_type *t = lookup(&subroutine_types, hash,
+                               record_key_compare, &key);
+   if (t == NULL) {
+      t = intern(&subroutine_types, hash, new glsl_type(subroutine_name),
+                 record_key_compare, &key);
    }
 
-   const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
-                                                            &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(subroutine_name);
-      mtx_lock(&glsl_type::mutex);
+   assert(t->base_type == GLSL_TYPE_SUBROUTINE);
+   assert(strcmp(t->name, subroutine_name) == 0);
 
-      entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
-   }
-
-   assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
-   assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
-
-   mtx_unlock(&glsl_type::mutex);
-
-   return (glsl_type *) entry->data;
+   return t;
 }
 
 
@@ -1101,30 +1168,19 @@ glsl_type::get_function_instance(const glsl_type *return_type,
                                  unsigned num_params)
 {
    const glsl_type key(return_type, params, num_params);
-
-   mtx_lock(&glsl_type::mutex);
-
-   if (function_types == NULL) {
-      function_types = _mesa_hash_table_create(NULL, function_key_hash,
-                                               function_key_compare);
-   }
-
-   struct hash_entry *entry = _mesa_hash_table_search(function_types, &key);
-   if (entry == NULL) {
-      mtx_unlock(&glsl_type::mutex);
-      const glsl_type *t = new glsl_type(return_type, params, num_params);
-      mtx_lock(&glsl_type::mutex);
-
-      entry = _mesa_hash_table_insert(function_types, t, (void *) t);
+   const uint32_t hash = function_key_hash(&key);
+
+   const glsl_type *t = lookup(&function_types, hash,
+                               function_key_compare, &key);
+   if (t == NULL) {
+      t = intern(&function_types, hash,
+                 new glsl_type(return_type, params, num_params),
+                 function_key_compare, &key);
    }
 
-   const glsl_type *t = (const glsl_type *)entry->data;
-
    assert(t->base_type == GLSL_TYPE_FUNCTION);
    assert(t->length == num_params);
 
-   mtx_unlock(&glsl_type::mutex);
-
    return t;
 }
 
@@ -125,6 +125,8 @@ enum {
 #include "util/ralloc.h"
 #include "main/mtypes.h" /* for gl_texture_index, C++'s enum rules are broken */
 
+struct glsl_type_table;
+
 struct glsl_type {
    GLenum gl_type;
    glsl_base_type base_type;
@@ -146,8 +148,7 @@ struct glsl_type {
    {
       mtx_lock(&glsl_type::mutex);
 
-      /* mem_ctx should have been created by the static members */
-      assert(glsl_type::mem_ctx != NULL);
+      init_ralloc_type_ctx();
 
       void *type;
 
@@ -168,6 +169,8 @@ struct glsl_type {
       mtx_unlock(&glsl_type::mutex);
    }
 
+   ~glsl_type();
+
    /**
     * \name Vector and matrix element counts
     *
@@ -792,7 +795,18 @@ private:
     */
    static void *mem_ctx;
 
-   void init_ralloc_type_ctx(void);
+   static void init_ralloc_type_ctx(void);
+
+   /**
+    * ralloc context holding the name and fields of this type
+    *
+    * Each type has its own, so that constructing a type doesn't touch
+    * shared state.  Interned types hand it over to the type's allocation.
+    */
+   void *ralloc_ctx;
+
+   /* Not defined, the storage in ralloc_ctx can't be shared. */
+   glsl_type(const glsl_type &);
 
    /** Constructor for vector and matrix types */
    glsl_type(GLenum gl_type,
@@ -824,23 +838,35 @@ private:
    glsl_type(const char *name);
 
    /** Hash table containing the known array types. */
-   static struct hash_table *array_types;
+   static struct glsl_type_table *array_types;
 
    /** Hash table containing the known record types. */
-   static struct hash_table *record_types;
+   static struct glsl_type_table *record_types;
 
    /** Hash table containing the known interface types. */
-   static struct hash_table *interface_types;
+   static struct glsl_type_table *interface_types;
 
    /** Hash table containing the known subroutine types. */
-   static struct hash_table *subroutine_types;
+   static struct glsl_type_table *subroutine_types;
 
    /** Hash table containing the known function types. */
-   static struct hash_table *function_types;
+   static struct glsl_type_table *function_types;
 
    static bool record_key_compare(const void *a, const void *b);
    static unsigned record_key_hash(const void *key);
 
+   static const glsl_type *lookup(struct glsl_type_table *const *table,
+                                  uint32_t hash,
+                                  bool (*equal)(const void *,
+                                                const void *),
+                                  const void *key);
+
+   static const glsl_type *intern(struct glsl_type_table **table,
+                                  uint32_t hash, glsl_type *t,
+                                  bool (*equal)(const void *,
+                                                const void *),
+                                  const void *key);
+
    /**
     * \name Built-in type flyweights
     */
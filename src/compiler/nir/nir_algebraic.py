@@ -494,6 +494,169 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """This class calculates a bottom-up tree automaton to quickly search for
+   the left-hand sides of transforms.
+
+   Instead of trying every transform for an opcode one after another, each of
+   them walking the expression tree again, the generated pass first assigns
+   a state to every SSA value in a single walk over the shader.  The state of
+   an ALU instruction only depends on its opcode and on the states of its
+   sources, so it is computed with a table lookup.  Each state stands for the
+   set of search (sub)expressions that the value may match, and only the
+   transforms whose search expression is in that set need to be tried.
+
+   The automaton only looks at the tree structure: variables and constants
+   match any source, and bit sizes, exactness, swizzles and variable
+   conditions are left to nir_search.  It may thus let transforms through
+   that nir_replace_instr() then rejects, but it never filters out one that
+   would match, so the pass does exactly what it did before.
+
+   A search expression is represented by a pattern (opcode, sources), where
+   each source is either the index of another pattern or -1 for anything.
+   In order to keep the transition tables small, the states of the sources
+   of an opcode are first reduced by a filter to the patterns that actually
+   appear as a source of that opcode.
+   """
+
+   def __init__(self, transforms):
+      self.patterns = []
+      self._pattern_ids = {}
+      self.opcodes = {}
+
+      self.xform_patterns = [self._add_pattern(xform.search)
+                             for xform in transforms]
+
+      # States are sets of patterns, state 0 is the empty set that non-ALU
+      # values are in.
+      self.states = []
+      self._state_ids = {}
+      self._get_state(frozenset())
+
+      # For each distinct filter, the list of filtered sets of patterns and
+      # the filtered set index for each state.
+      self._filter_sets = {}
+      self._filter_ids = {}
+      self.filter_maps = {}
+      for opcode in self.opcodes:
+         relevant = self._relevant(opcode)
+         if relevant not in self._filter_sets:
+            self._filter_sets[relevant] = []
+            self._filter_ids[relevant] = {}
+            self.filter_maps[relevant] = []
+
+      self._transitions = dict((opcode, {}) for opcode in self.opcodes)
+      self._build()
+
+   @staticmethod
+   def _is_commutative(opcode):
+      return "commutative" in opcodes[opcode].algebraic_properties
+
+   def _add_pattern(self, val):
+      if not isinstance(val, Expression):
+         return -1
+
+      srcs = tuple(self._add_pattern(src) for src in val.sources)
+      if self._is_commutative(val.opcode):
+         srcs = tuple(sorted(srcs))
+
+      pattern = (val.opcode, srcs)
+      if pattern not in self._pattern_ids:
+         self._pattern_ids[pattern] = len(self.patterns)
+         self.patterns.append(pattern)
+         self.opcodes.setdefault(val.opcode, []).append(len(self.patterns) - 1)
+
+      return self._pattern_ids[pattern]
+
+   def _relevant(self, opcode):
+      return frozenset(src for p in self.opcodes[opcode]
+                       for src in self.patterns[p][1] if src != -1)
+
+   def _get_state(self, patterns):
+      if patterns not in self._state_ids:
+         self._state_ids[patterns] = len(self.states)
+         self.states.append(patterns)
+         assert len(self.states) <= 0x10000
+      return self._state_ids[patterns]
+
+   def _filter_state(self, relevant, state):
+      filtered = state & relevant
+      ids = self._filter_ids[relevant]
+      if filtered not in ids:
+         ids[filtered] = len(self._filter_sets[relevant])
+         self._filter_sets[relevant].append(filtered)
+      return ids[filtered]
+
+   def _match(self, opcode, srcs):
+      def match_srcs(pattern_srcs, srcs):
+         return all(p == -1 or p in s for (p, s) in zip(pattern_srcs, srcs))
+
+      result = set()
+      for p in self.opcodes[opcode]:
+         pattern_srcs = self.patterns[p][1]
+         if match_srcs(pattern_srcs, srcs) or \
+            (self._is_commutative(opcode) and
+             match_srcs(pattern_srcs, srcs[::-1])):
+            result.add(p)
+      return frozenset(result)
+
+   def _build(self):
+      while True:
+         # Run the new states through the filters.
+         for (relevant, filter_map) in self.filter_maps.items():
+            while len(filter_map) < len(self.states):
+               filter_map.append(
+                  self._filter_state(relevant, self.states[len(filter_map)]))
+
+         num_states = len(self.states)
+         for (opcode, transitions) in self._transitions.items():
+            filter_sets = self._filter_sets[self._relevant(opcode)]
+            num_inputs = opcodes[opcode].num_inputs
+            for srcs in itertools.product(range(len(filter_sets)),
+                                          repeat=num_inputs):
+               if srcs not in transitions:
+                  state = self._match(opcode,
+                                      [filter_sets[i] for i in srcs])
+                  transitions[srcs] = self._get_state(state)
+
+         if len(self.states) == num_states:
+            break
+
+      # Give every distinct filter an index and flatten the tables.  Opcodes
+      # with a single filtered set don't look at their sources' states, so
+      # they don't need a filter.
+      self.filters = []
+      self.opcode_filter = {}
+      self.transition_tables = {}
+      filter_index = {}
+      for opcode in sorted(self.opcodes):
+         relevant = self._relevant(opcode)
+         num_inputs = opcodes[opcode].num_inputs
+         num_filtered = len(self._filter_sets[relevant])
+
+         if num_filtered > 1:
+            key = tuple(self.filter_maps[relevant])
+            if key not in filter_index:
+               filter_index[key] = len(self.filters)
+               self.filters.append(key)
+            self.opcode_filter[opcode] = filter_index[key]
+         self.transition_tables[opcode] = \
+            (num_filtered,
+             [self._transitions[opcode][srcs] for srcs in
+              itertools.product(range(num_filtered), repeat=num_inputs)])
+
+   def state_transforms(self):
+      """Returns, for each state, the indices of the transforms that may
+      match a value in that state, in the order they were passed in.
+      """
+      return [[i for (i, p) in enumerate(self.xform_patterns) if p in state]
+              for state in self.states]
+
+def _c_array_rows(values, per_row=16):
+   values = [str(v) for v in values]
+   return [', '.join(values[i:i + per_row]) + ','
+           for i in range(0, len(values), per_row)]
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -509,22 +672,91 @@ struct transform {
 
 #endif
 
-% for (opcode, xform_list) in xform_dict.iteritems():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
+static const struct transform ${pass_name}_xforms[] = {
+% for xform in xforms:
    { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
 % endfor
 };
+
+/* Transforms to try for each automaton state, the ones of state i are
+ * ${pass_name}_state_xforms[${pass_name}_state_xform_start[i]] up to
+ * ${pass_name}_state_xforms[${pass_name}_state_xform_start[i + 1]].
+ */
+static const uint16_t ${pass_name}_state_xforms[] = {
+% for row in rows([i for l in state_xforms for i in l] or [0]):
+   ${row}
+% endfor
+};
+
+static const uint16_t ${pass_name}_state_xform_start[] = {
+% for row in rows(state_xform_start):
+   ${row}
+% endfor
+};
+
+% for (i, f) in enumerate(automaton.filters):
+static const uint16_t ${pass_name}_filter${i}[] = {
+% for row in rows(f):
+   ${row}
+% endfor
+};
+
+% endfor
+% for opcode in sorted(automaton.opcodes):
+static const uint16_t ${pass_name}_${opcode}_transitions[] = {
+% for row in rows(automaton.transition_tables[opcode][1]):
+   ${row}
+% endfor
+};
+
 % endfor
+static inline uint16_t
+${pass_name}_src_state(const nir_alu_instr *alu, unsigned src,
+${" " * len(pass_name)}            const uint16_t *states)
+{
+   return alu->src[src].src.is_ssa ? states[alu->src[src].src.ssa->index] : 0;
+}
+
+/**
+ * Computes the automaton state of an ALU instruction from the states of its
+ * sources.  Values that aren't ALU instructions are in state 0.
+ */
+static void
+${pass_name}_compute_state(nir_alu_instr *alu, uint16_t *states)
+{
+   uint16_t state = 0;
+
+   switch (alu->op) {
+% for opcode in sorted(automaton.opcodes):
+   case nir_op_${opcode}: {
+   % if automaton.transition_tables[opcode][0] == 1:
+      state = ${pass_name}_${opcode}_transitions[0];
+   % else:
+      unsigned index = 0;
+      % for i in range(opcodes[opcode].num_inputs):
+      index = index * ${automaton.transition_tables[opcode][0]} +
+              ${pass_name}_filter${automaton.opcode_filter[opcode]}[${pass_name}_src_state(alu, ${i}, states)];
+      % endfor
+      state = ${pass_name}_${opcode}_transitions[index];
+   % endif
+      break;
+   }
+% endfor
+   default:
+      break;
+   }
+
+   states[alu->dest.dest.ssa.index] = state;
+}
 
 static bool
 ${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+                   const uint16_t *states, void *mem_ctx)
 {
    bool progress = false;
 
@@ -536,22 +768,17 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
+      uint16_t state = states[alu->dest.dest.ssa.index];
+      for (unsigned i = ${pass_name}_state_xform_start[state];
+           i < ${pass_name}_state_xform_start[state + 1]; i++) {
+         const struct transform *xform =
+            &${pass_name}_xforms[${pass_name}_state_xforms[i]];
+         if (condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               mem_ctx)) {
+            progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
@@ -564,10 +791,33 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   /* Instructions added by the replacements are inserted before the one
+    * being replaced, so the reverse walk below never visits them and the
+    * states only need to cover the SSA values that exist now.  The sources
+    * of an instruction are never changed before the walk reaches it either,
+    * so its state stays valid.
+    */
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(uint16_t));
+   if (!states)
+      return false;
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type != nir_instr_type_alu)
+            continue;
+
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         if (alu->dest.dest.is_ssa)
+            ${pass_name}_compute_state(alu, states);
+      }
+   }
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, condition_flags, states, mem_ctx);
    }
 
+   free(states);
+
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
                                   nir_metadata_dominance);
@@ -625,6 +875,22 @@ class AlgebraicPass(object):
          sys.exit(1)
 
    def render(self):
+      # Keep the transforms of an opcode together and in order, the ones of
+      # a given automaton state are tried in that order.
+      xforms = [xform for opcode in sorted(self.xform_dict)
+                for xform in self.xform_dict[opcode]]
+
+      automaton = TreeAutomaton(xforms)
+      state_xforms = automaton.state_transforms()
+      state_xform_start = [0]
+      for l in state_xforms:
+         state_xform_start.append(state_xform_start[-1] + len(l))
+
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
-                                             condition_list=condition_list)
+                                             xforms=xforms,
+                                             automaton=automaton,
+                                             state_xforms=state_xforms,
+                                             state_xform_start=state_xform_start,
+                                             condition_list=condition_list,
+                                             opcodes=opcodes,
+                                             rows=_c_array_rows)
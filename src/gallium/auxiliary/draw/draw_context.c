@@ -1089,6 +1089,17 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns the running totals of the post-transform vertex cache, which
+ * is only used by the LLVM path (see draw_pt_vcache.c).
+ */
+void
+draw_get_vcache_statistics(const struct draw_context *draw,
+                           struct draw_vcache_statistics *stats)
+{
+   *stats = draw->vcache_stats;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
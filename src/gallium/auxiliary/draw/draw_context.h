@@ -291,6 +291,15 @@ void draw_set_force_passthrough( struct draw_context *draw,
 void draw_collect_pipeline_statistics(struct draw_context *draw,
                                       boolean enable);
 
+/** Post-transform vertex cache counters, for indexed draws */
+struct draw_vcache_statistics {
+   uint64_t hits;    /**< vertices copied from an earlier segment */
+   uint64_t misses;  /**< vertices run through the vertex shader */
+};
+
+void draw_get_vcache_statistics(const struct draw_context *draw,
+                                struct draw_vcache_statistics *stats);
+
 /*******************************************************************************
  * Draw pipeline 
  */
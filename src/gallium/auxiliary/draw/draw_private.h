@@ -46,6 +46,8 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "draw/draw_context.h"
+
 #ifdef HAVE_LLVM
 struct gallivm_state;
 #endif
@@ -160,6 +162,9 @@ struct draw_context
 
       boolean rebind_parameters;
 
+      /** Current draw may be processed asynchronously by the middle end */
+      boolean async;
+
       struct {
          struct draw_pt_middle_end *fetch_emit;
          struct draw_pt_middle_end *fetch_shade_emit;
@@ -339,6 +344,8 @@ struct draw_context
    struct pipe_query_data_pipeline_statistics statistics;
    boolean collect_statistics;
 
+   struct draw_vcache_statistics vcache_stats;
+
    struct draw_assembler *ia;
 
    void *driver_private;
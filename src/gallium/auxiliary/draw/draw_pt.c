@@ -46,6 +46,11 @@
 DEBUG_GET_ONCE_BOOL_OPTION(draw_fse, "DRAW_FSE", FALSE)
 DEBUG_GET_ONCE_BOOL_OPTION(draw_no_fse, "DRAW_NO_FSE", FALSE)
 
+/* Draws with fewer vertices than this don't span enough segments to be
+ * worth handing to the middle end's worker threads.
+ */
+#define DRAW_PT_ASYNC_MIN_VERTICES 4096
+
 /* Overall we split things into:
  *     - frontend -- prepare fetch_elts, draw_elts - eg vsplit
  *     - middle   -- fetch, shade, cliptest, viewport
@@ -146,8 +151,14 @@ draw_pt_arrays(struct draw_context *draw,
       draw->pt.rebind_parameters = FALSE;
    }
 
+   draw->pt.async = count >= DRAW_PT_ASYNC_MIN_VERTICES;
+
    frontend->run( frontend, start, count );
 
+   if (middle->sync)
+      middle->sync(middle);
+   draw->pt.async = FALSE;
+
    return TRUE;
 }
 
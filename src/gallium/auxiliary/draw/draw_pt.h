@@ -124,6 +124,13 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)( struct draw_pt_middle_end * );
 
+   /* Optional.  Called at the end of each draw.  While draw->pt.async is
+    * set the run functions may return before the segment has been
+    * emitted; sync() retires all outstanding segments, in submission
+    * order.
+    */
+   void (*sync)( struct draw_pt_middle_end * );
+
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
 };
@@ -242,6 +249,31 @@ struct pt_post_vs *draw_pt_post_vs_create( struct draw_context *draw );
 void draw_pt_post_vs_destroy( struct pt_post_vs *pvs );
 
 
+/*******************************************************************************
+ * Post-transform vertex cache, spanning the segments of a draw
+ */
+struct pt_vcache;
+
+int draw_pt_vcache_lookup( struct pt_vcache *vcache,
+                           unsigned elt,
+                           unsigned seq,
+                           unsigned oldest_seq,
+                           boolean *hit,
+                           unsigned *producer );
+
+struct vertex_header *draw_pt_vcache_vertex( struct pt_vcache *vcache,
+                                             int entry );
+
+void draw_pt_vcache_invalidate( struct pt_vcache *vcache );
+
+boolean draw_pt_vcache_prepare( struct pt_vcache *vcache,
+                                unsigned vertex_size );
+
+struct pt_vcache *draw_pt_vcache_create( struct draw_context *draw );
+
+void draw_pt_vcache_destroy( struct pt_vcache *vcache );
+
+
 /*******************************************************************************
  * Utils: 
  */
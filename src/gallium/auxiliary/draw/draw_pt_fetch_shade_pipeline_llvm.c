@@ -37,6 +37,66 @@
 #include "draw/draw_vs.h"
 #include "draw/draw_llvm.h"
 #include "gallivm/lp_bld_init.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
+
+
+/** Max number of segments in flight for asynchronous draws */
+#define LLVM_MAX_SEGMENTS 16
+
+/** Max number of vertex shading worker threads */
+#define LLVM_MAX_THREADS 8
+
+
+struct llvm_middle_end;
+
+/**
+ * Where a vertex of a segment comes from when the vertex cache is used:
+ * either shaded by the segment itself, or copied from a cache entry
+ * produced by an earlier segment.
+ */
+struct llvm_vcache_op {
+   unsigned slot;        /**< index of the vertex in the segment */
+   int entry;            /**< vcache entry, or -1 if not cached */
+   unsigned producer;    /**< segment storing the entry */
+};
+
+/**
+ * A segment on its way through the middle end.  For asynchronous draws
+ * the vertices are shaded by a worker thread, and the segment owns copies
+ * of the frontend's element lists.
+ */
+struct llvm_segment {
+   struct llvm_middle_end *fpme;
+   struct util_queue_fence fence;
+
+   unsigned seq;
+   boolean produced;     /**< cache entries written, see produced_mutex */
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info vert_info;
+   unsigned primitive_length;
+   boolean clipped;
+
+   unsigned *fetch_elts;
+   unsigned fetch_elts_size;
+   ushort *draw_elts;
+   unsigned draw_elts_size;
+
+   /* Vertex cache plan: ops[0..num_shade) are shaded, in the order of
+    * shade_elts, the last num_copy ops are copied from the cache.
+    */
+   boolean use_vcache;
+   unsigned num_shade;
+   unsigned num_copy;
+   unsigned *shade_elts;
+   unsigned shade_elts_size;
+   struct llvm_vcache_op *ops;
+   unsigned ops_size;
+   struct vertex_header *shaded;
+   unsigned shaded_size;
+};
 
 
 struct llvm_middle_end {
@@ -47,6 +107,7 @@ struct llvm_middle_end {
    struct pt_so_emit *so_emit;
    struct pt_fetch *fetch;
    struct pt_post_vs *post_vs;
+   struct pt_vcache *vcache;
 
 
    unsigned vertex_data_offset;
@@ -56,6 +117,18 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Worker threads for asynchronous draws, see llvm_pipeline_generic().
+    * Segment seq lives in segments[seq % LLVM_MAX_SEGMENTS].
+    */
+   struct util_queue queue;
+   struct llvm_segment segments[LLVM_MAX_SEGMENTS];
+   unsigned next_seq;    /**< sequence number of the next segment */
+   unsigned retire_seq;  /**< oldest segment not retired yet */
+
+   /* Signals segments having stored their vertices in the vcache */
+   pipe_mutex produced_mutex;
+   pipe_condvar produced_cond;
 };
 
 
@@ -191,6 +264,12 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
     */
    fpme->vertex_size = sizeof(struct vertex_header) + nr * 4 * sizeof(float);
 
+   if (fpme->vcache &&
+       !draw_pt_vcache_prepare(fpme->vcache, fpme->vertex_size)) {
+      draw_pt_vcache_destroy(fpme->vcache);
+      fpme->vcache = NULL;
+   }
+
    /* return even number */
    *max_vertices = *max_vertices & ~1;
 
@@ -336,45 +415,20 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Fetch, shade and cliptest the vertices of a segment.  Runs either on
+ * the application thread or on one of the middle end's worker threads;
+ * everything it reads stays constant for the duration of draw_pt_arrays().
+ */
+static boolean
+llvm_pipeline_shade(struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    struct vertex_header *verts)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
    unsigned start_or_maxelt, vid_base;
    const unsigned *elts;
 
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
    if (fetch_info->linear) {
       start_or_maxelt = fetch_info->start;
       vid_base = draw->start_index;
@@ -385,22 +439,41 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
-
-   /* Finished with fetch and vs:
-    */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+   return fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                          verts,
+                                          draw->pt.user.vbuffer,
+                                          fetch_info->count,
+                                          start_or_maxelt,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id,
+                                          vid_base,
+                                          draw->start_instance,
+                                          elts);
+}
+
+
+/**
+ * Everything after the vertex shader: GS, stream output, clipping and
+ * emit.  Always runs on the application thread, in primitive order.
+ * Takes ownership of llvm_vert_info->verts.
+ */
+static void
+llvm_pipeline_finish(struct llvm_middle_end *fpme,
+                     struct draw_vertex_info *llvm_vert_info,
+                     const struct draw_prim_info *in_prim_info,
+                     boolean clipped)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_prim_info gs_prim_info;
+   struct draw_vertex_info gs_vert_info;
+   struct draw_vertex_info *vert_info = llvm_vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   const struct draw_prim_info *prim_info = in_prim_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -474,6 +547,366 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Make sure *ptr can hold size bytes, preserving nothing.
+ */
+static boolean
+llvm_segment_reserve(void **ptr, unsigned *capacity, unsigned size)
+{
+   if (size > *capacity) {
+      FREE(*ptr);
+      *ptr = MALLOC(size);
+      if (!*ptr) {
+         *capacity = 0;
+         return FALSE;
+      }
+      *capacity = size;
+   }
+   return TRUE;
+}
+
+
+static inline struct vertex_header *
+llvm_segment_vertex(const struct llvm_segment *seg,
+                    struct vertex_header *verts,
+                    unsigned i)
+{
+   return (struct vertex_header *)
+      ((char *) verts + i * seg->vert_info.stride);
+}
+
+
+static void
+llvm_segment_set_produced(struct llvm_middle_end *fpme,
+                          struct llvm_segment *seg)
+{
+   pipe_mutex_lock(fpme->produced_mutex);
+   seg->produced = TRUE;
+   pipe_condvar_broadcast(fpme->produced_cond);
+   pipe_mutex_unlock(fpme->produced_mutex);
+}
+
+
+/**
+ * Wait until segment seq has stored its vertices in the vcache.  If its
+ * slot was reused, it has been retired long ago.
+ */
+static void
+llvm_segment_wait_produced(struct llvm_middle_end *fpme, unsigned seq)
+{
+   struct llvm_segment *seg = &fpme->segments[seq % LLVM_MAX_SEGMENTS];
+
+   pipe_mutex_lock(fpme->produced_mutex);
+   while (seg->seq == seq && !seg->produced)
+      pipe_condvar_wait(fpme->produced_cond, fpme->produced_mutex);
+   pipe_mutex_unlock(fpme->produced_mutex);
+}
+
+
+/**
+ * Decide which vertices of an indexed segment can be copied from the
+ * vcache and which need shading.  Runs on the application thread, which
+ * owns the cache tags.
+ */
+static boolean
+llvm_segment_plan(struct llvm_middle_end *fpme,
+                  struct llvm_segment *seg)
+{
+   const unsigned count = seg->fetch_info.count;
+   unsigned i;
+
+   seg->use_vcache = FALSE;
+
+   if (!fpme->vcache || seg->fetch_info.linear)
+      return TRUE;
+
+   /* Lookups claim cache entries, so nothing may fail after them. */
+   if (!llvm_segment_reserve((void **) &seg->shade_elts,
+                             &seg->shade_elts_size,
+                             count * sizeof(unsigned)) ||
+       !llvm_segment_reserve((void **) &seg->ops, &seg->ops_size,
+                             count * sizeof(struct llvm_vcache_op)) ||
+       !llvm_segment_reserve((void **) &seg->shaded, &seg->shaded_size,
+                             seg->vert_info.stride *
+                             align(count, lp_native_vector_width / 32)))
+      return FALSE;
+
+   seg->num_shade = 0;
+   seg->num_copy = 0;
+
+   for (i = 0; i < count; i++) {
+      const unsigned elt = seg->fetch_info.elts[i];
+      struct llvm_vcache_op *op;
+      boolean hit;
+      unsigned producer;
+      int entry;
+
+      entry = draw_pt_vcache_lookup(fpme->vcache, elt, seg->seq,
+                                    fpme->retire_seq, &hit, &producer);
+      if (hit) {
+         op = &seg->ops[count - 1 - seg->num_copy++];
+      }
+      else {
+         seg->shade_elts[seg->num_shade] = elt;
+         op = &seg->ops[seg->num_shade++];
+      }
+      op->slot = i;
+      op->entry = entry;
+      op->producer = producer;
+   }
+
+   seg->use_vcache = TRUE;
+   return TRUE;
+}
+
+
+/**
+ * Produce the vertices of a segment, by shading them or copying them from
+ * the vcache.  Runs on a worker thread for asynchronous draws.
+ */
+static boolean
+llvm_segment_shade(struct llvm_middle_end *fpme,
+                   struct llvm_segment *seg)
+{
+   struct vertex_header *verts = seg->vert_info.verts;
+   struct vertex_header *shaded;
+   struct draw_fetch_info shade_info;
+   unsigned last_waited = ~0u;
+   boolean clipped = FALSE;
+   unsigned i;
+
+   if (!seg->use_vcache) {
+      clipped = llvm_pipeline_shade(fpme, &seg->fetch_info, verts);
+      llvm_segment_set_produced(fpme, seg);
+      return clipped;
+   }
+
+   /* Shade the misses, in place if there is nothing else. */
+   shaded = seg->num_copy ? seg->shaded : verts;
+   if (seg->num_shade) {
+      shade_info = seg->fetch_info;
+      shade_info.elts = seg->shade_elts;
+      shade_info.count = seg->num_shade;
+      clipped = llvm_pipeline_shade(fpme, &shade_info, shaded);
+   }
+
+   for (i = 0; i < seg->num_shade; i++) {
+      const struct llvm_vcache_op *op = &seg->ops[i];
+      const struct vertex_header *src =
+         llvm_segment_vertex(seg, shaded, i);
+
+      if (shaded != verts)
+         memcpy(llvm_segment_vertex(seg, verts, op->slot), src,
+                seg->vert_info.vertex_size);
+      if (op->entry >= 0)
+         memcpy(draw_pt_vcache_vertex(fpme->vcache, op->entry), src,
+                seg->vert_info.vertex_size);
+   }
+
+   llvm_segment_set_produced(fpme, seg);
+
+   for (i = seg->fetch_info.count - seg->num_copy;
+        i < seg->fetch_info.count; i++) {
+      const struct llvm_vcache_op *op = &seg->ops[i];
+      const struct vertex_header *src;
+
+      if (op->producer != last_waited) {
+         llvm_segment_wait_produced(fpme, op->producer);
+         last_waited = op->producer;
+      }
+
+      src = draw_pt_vcache_vertex(fpme->vcache, op->entry);
+      memcpy(llvm_segment_vertex(seg, verts, op->slot), src,
+             seg->vert_info.vertex_size);
+
+      /* conservative: may run the pipeline for nothing, see
+       * clipmask_booli8()
+       */
+      clipped |= src->clipmask != 0 || !src->edgeflag;
+   }
+
+   return clipped;
+}
+
+
+static void
+llvm_segment_execute(void *data, int thread_index)
+{
+   struct llvm_segment *seg = (struct llvm_segment *) data;
+
+   seg->clipped = llvm_segment_shade(seg->fpme, seg);
+}
+
+
+/**
+ * Wait for the oldest outstanding segment and push it down the rest of
+ * the pipeline.
+ */
+static void
+llvm_middle_end_retire(struct llvm_middle_end *fpme)
+{
+   struct llvm_segment *seg =
+      &fpme->segments[fpme->retire_seq % LLVM_MAX_SEGMENTS];
+
+   assert(fpme->retire_seq != fpme->next_seq);
+
+   util_queue_job_wait(&seg->fence);
+   llvm_pipeline_finish(fpme, &seg->vert_info, &seg->prim_info,
+                        seg->clipped);
+
+   fpme->retire_seq++;
+}
+
+
+/**
+ * Retires all outstanding segments.  Called at the end of every draw,
+ * which is also when the vcache contents become stale.
+ */
+static void
+llvm_middle_end_sync(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   while (fpme->retire_seq != fpme->next_seq)
+      llvm_middle_end_retire(fpme);
+
+   if (fpme->vcache) {
+      draw_pt_vcache_invalidate(fpme->vcache);
+
+      /* Sequence numbers only need to be ordered within a draw. */
+      if (fpme->next_seq > (1u << 31))
+         fpme->next_seq = fpme->retire_seq = 0;
+   }
+}
+
+
+/**
+ * Get the next segment slot, retiring old segments as needed.
+ */
+static struct llvm_segment *
+llvm_middle_end_next_segment(struct llvm_middle_end *fpme)
+{
+   struct llvm_segment *seg;
+
+   /* Retire whatever already finished so that emit overlaps with the
+    * shading of the following segments, and make room for this one.
+    */
+   while (fpme->retire_seq != fpme->next_seq &&
+          util_queue_fence_is_signalled(
+             &fpme->segments[fpme->retire_seq % LLVM_MAX_SEGMENTS].fence))
+      llvm_middle_end_retire(fpme);
+
+   if (fpme->next_seq - fpme->retire_seq == LLVM_MAX_SEGMENTS)
+      llvm_middle_end_retire(fpme);
+
+   seg = &fpme->segments[fpme->next_seq % LLVM_MAX_SEGMENTS];
+
+   pipe_mutex_lock(fpme->produced_mutex);
+   seg->seq = fpme->next_seq++;
+   seg->produced = FALSE;
+   pipe_mutex_unlock(fpme->produced_mutex);
+
+   return seg;
+}
+
+
+/**
+ * Copy the element lists of a segment which is going to be shaded
+ * asynchronously, since the frontend reuses its arrays.
+ */
+static boolean
+llvm_segment_copy_elts(struct llvm_segment *seg,
+                       const struct draw_fetch_info *fetch_info,
+                       const struct draw_prim_info *prim_info)
+{
+   assert(prim_info->primitive_count == 1);
+
+   if (!fetch_info->linear) {
+      if (!llvm_segment_reserve((void **) &seg->fetch_elts,
+                                &seg->fetch_elts_size,
+                                fetch_info->count * sizeof(unsigned)))
+         return FALSE;
+      memcpy(seg->fetch_elts, fetch_info->elts,
+             fetch_info->count * sizeof(unsigned));
+      seg->fetch_info.elts = seg->fetch_elts;
+   }
+
+   if (!prim_info->linear) {
+      if (!llvm_segment_reserve((void **) &seg->draw_elts,
+                                &seg->draw_elts_size,
+                                prim_info->count * sizeof(ushort)))
+         return FALSE;
+      memcpy(seg->draw_elts, prim_info->elts,
+             prim_info->count * sizeof(ushort));
+      seg->prim_info.elts = seg->draw_elts;
+   }
+   seg->primitive_length = prim_info->primitive_lengths[0];
+   seg->prim_info.primitive_lengths = &seg->primitive_length;
+
+   return TRUE;
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_info llvm_vert_info;
+   struct llvm_segment *seg;
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+   llvm_vert_info.verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(fetch_info->count, lp_native_vector_width / 32));
+   if (!llvm_vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   seg = llvm_middle_end_next_segment(fpme);
+   seg->fetch_info = *fetch_info;
+   seg->prim_info = *prim_info;
+   seg->vert_info = llvm_vert_info;
+   seg->clipped = FALSE;
+
+   /* Hand the segment to the worker threads, or fall back to processing
+    * it right away.
+    */
+   if (draw->pt.async && util_queue_is_initialized(&fpme->queue) &&
+       llvm_segment_copy_elts(seg, fetch_info, prim_info) &&
+       llvm_segment_plan(fpme, seg)) {
+      util_queue_add_job(&fpme->queue, seg, &seg->fence,
+                         llvm_segment_execute, NULL);
+      return;
+   }
+
+   /* Synchronous path, the segment points at the caller's arrays. */
+   seg->fetch_info = *fetch_info;
+   seg->prim_info = *prim_info;
+   /* on failure the segment just bypasses the vcache */
+   llvm_segment_plan(fpme, seg);
+
+   seg->clipped = llvm_segment_shade(fpme, seg);
+
+   /* Finished with fetch and vs, retire in order:
+    */
+   while (fpme->retire_seq != fpme->next_seq)
+      llvm_middle_end_retire(fpme);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -577,7 +1010,9 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   /* nothing to do, draw_pt_arrays() already synced */
+   assert(llvm_middle_end(middle)->retire_seq ==
+          llvm_middle_end(middle)->next_seq);
 }
 
 
@@ -585,6 +1020,27 @@ static void
 llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   unsigned i;
+
+   if (util_queue_is_initialized(&fpme->queue)) {
+      llvm_middle_end_sync(middle);
+      util_queue_destroy(&fpme->queue);
+   }
+
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++) {
+      util_queue_fence_destroy(&fpme->segments[i].fence);
+      FREE(fpme->segments[i].fetch_elts);
+      FREE(fpme->segments[i].draw_elts);
+      FREE(fpme->segments[i].shade_elts);
+      FREE(fpme->segments[i].ops);
+      FREE(fpme->segments[i].shaded);
+   }
+
+   pipe_condvar_destroy(fpme->produced_cond);
+   pipe_mutex_destroy(fpme->produced_mutex);
+
+   if (fpme->vcache)
+      draw_pt_vcache_destroy( fpme->vcache );
 
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
@@ -606,6 +1062,8 @@ struct draw_pt_middle_end *
 draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 {
    struct llvm_middle_end *fpme = 0;
+   unsigned num_threads;
+   unsigned i;
 
    if (!draw->llvm)
       return NULL;
@@ -619,11 +1077,19 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.sync            = llvm_middle_end_sync;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
    fpme->draw = draw;
 
+   for (i = 0; i < LLVM_MAX_SEGMENTS; i++) {
+      fpme->segments[i].fpme = fpme;
+      util_queue_fence_init(&fpme->segments[i].fence);
+   }
+   pipe_mutex_init(fpme->produced_mutex);
+   pipe_condvar_init(fpme->produced_cond);
+
    fpme->fetch = draw_pt_fetch_create( draw );
    if (!fpme->fetch)
       goto fail;
@@ -646,6 +1112,18 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   /* optional */
+   fpme->vcache = draw_pt_vcache_create( draw );
+
+   /* The application thread keeps doing the clipping and emit, so by
+    * default leave one core to it.
+    */
+   num_threads = debug_get_num_option("DRAW_NUM_THREADS",
+                                      util_cpu_caps.nr_cpus - 1);
+   num_threads = MIN2(num_threads, LLVM_MAX_THREADS);
+   if (num_threads)
+      util_queue_init(&fpme->queue, "draw", LLVM_MAX_SEGMENTS, num_threads);
+
    return &fpme->base;
 
  fail:
@@ -0,0 +1,235 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL VMWARE AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Post-transform vertex cache.
+ *
+ * The vsplit frontend only removes duplicate elements within a segment.
+ * This cache keeps copies of shaded vertices across the segments of a
+ * draw so that indexed meshes don't re-run the vertex shader for
+ * vertices shared by neighbouring segments.
+ *
+ * The cache is set-associative with FIFO replacement.  Entries are
+ * tagged with the element index and the sequence number of the segment
+ * that produced them; the middle end uses the latter to order accesses
+ * when segments are shaded by several threads.  Entries still used by
+ * segments in flight are never replaced.
+ */
+
+#include "draw/draw_context.h"
+#include "draw/draw_private.h"
+#include "draw/draw_pt.h"
+#include "util/u_debug.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+
+#define PT_VCACHE_WAYS 4
+
+DEBUG_GET_ONCE_NUM_OPTION(draw_vcache_size, "DRAW_VCACHE_SIZE", 1024)
+
+
+struct pt_vcache_tag {
+   unsigned elt;
+   unsigned generation;
+   unsigned producer;   /**< sequence number of the segment shading it */
+   unsigned last_use;   /**< sequence number of the last segment using it */
+};
+
+
+struct pt_vcache {
+   struct draw_context *draw;
+
+   unsigned num_sets;
+   unsigned set_shift;
+   unsigned generation;
+
+   struct pt_vcache_tag *tags;
+   ubyte *victim;         /**< next way to replace, per set */
+
+   ubyte *vertices;
+   unsigned vertex_size;
+};
+
+
+static inline unsigned
+pt_vcache_set(const struct pt_vcache *vcache, unsigned elt)
+{
+   /* Fibonacci hashing, so that meshes laid out in power of two rows
+    * don't all land in the same sets.
+    */
+   return (elt * 2654435761u) >> vcache->set_shift;
+}
+
+
+/**
+ * Look up a vertex.
+ *
+ * On a hit, returns the entry holding elt with *hit set.  On a miss,
+ * claims an entry for elt on behalf of segment seq, which must then store
+ * the vertex there.  Entries last used by segments older than oldest_seq
+ * may be replaced.  Returns -1 if no entry of the set can be replaced.
+ */
+int
+draw_pt_vcache_lookup(struct pt_vcache *vcache,
+                      unsigned elt,
+                      unsigned seq,
+                      unsigned oldest_seq,
+                      boolean *hit,
+                      unsigned *producer)
+{
+   const unsigned set = pt_vcache_set(vcache, elt);
+   struct pt_vcache_tag *tags = &vcache->tags[set * PT_VCACHE_WAYS];
+   unsigned way, i;
+
+   for (way = 0; way < PT_VCACHE_WAYS; way++) {
+      if (tags[way].elt == elt &&
+          tags[way].generation == vcache->generation) {
+         tags[way].last_use = seq;
+         *producer = tags[way].producer;
+         *hit = TRUE;
+         vcache->draw->vcache_stats.hits++;
+         return set * PT_VCACHE_WAYS + way;
+      }
+   }
+
+   *hit = FALSE;
+   vcache->draw->vcache_stats.misses++;
+
+   way = vcache->victim[set];
+   for (i = 0; i < PT_VCACHE_WAYS; i++) {
+      struct pt_vcache_tag *tag = &tags[way];
+
+      if (tag->generation != vcache->generation ||
+          tag->last_use < oldest_seq) {
+         tag->elt = elt;
+         tag->generation = vcache->generation;
+         tag->producer = seq;
+         tag->last_use = seq;
+         vcache->victim[set] = (way + 1) % PT_VCACHE_WAYS;
+         *producer = seq;
+         return set * PT_VCACHE_WAYS + way;
+      }
+
+      way = (way + 1) % PT_VCACHE_WAYS;
+   }
+
+   return -1;
+}
+
+
+struct vertex_header *
+draw_pt_vcache_vertex(struct pt_vcache *vcache, int entry)
+{
+   assert(entry >= 0 && entry < vcache->num_sets * PT_VCACHE_WAYS);
+   return (struct vertex_header *)
+      (vcache->vertices + entry * vcache->vertex_size);
+}
+
+
+/**
+ * Forget all cached vertices.  Must be called whenever anything the vertex
+ * shader outputs depend on may have changed, i.e. before each draw, and
+ * only once no segment is in flight anymore.
+ */
+void
+draw_pt_vcache_invalidate(struct pt_vcache *vcache)
+{
+   if (++vcache->generation == 0) {
+      /* wrapped around, make sure no stale tag matches */
+      memset(vcache->tags, 0,
+             vcache->num_sets * PT_VCACHE_WAYS * sizeof vcache->tags[0]);
+      vcache->generation = 1;
+   }
+}
+
+
+/**
+ * Size the vertex storage for the current vertex layout.
+ */
+boolean
+draw_pt_vcache_prepare(struct pt_vcache *vcache, unsigned vertex_size)
+{
+   if (vertex_size != vcache->vertex_size) {
+      FREE(vcache->vertices);
+      vcache->vertices = MALLOC(vcache->num_sets * PT_VCACHE_WAYS *
+                                vertex_size);
+      if (!vcache->vertices) {
+         vcache->vertex_size = 0;
+         return FALSE;
+      }
+      vcache->vertex_size = vertex_size;
+   }
+
+   draw_pt_vcache_invalidate(vcache);
+   return TRUE;
+}
+
+
+/**
+ * Returns NULL if the cache is disabled (DRAW_VCACHE_SIZE=0).
+ */
+struct pt_vcache *
+draw_pt_vcache_create(struct draw_context *draw)
+{
+   unsigned size = debug_get_option_draw_vcache_size();
+   struct pt_vcache *vcache;
+   unsigned num_sets;
+
+   if (size < PT_VCACHE_WAYS)
+      return NULL;
+
+   num_sets = MAX2(2, util_next_power_of_two(size / PT_VCACHE_WAYS));
+
+   vcache = CALLOC_STRUCT(pt_vcache);
+   if (!vcache)
+      return NULL;
+
+   vcache->draw = draw;
+   vcache->num_sets = num_sets;
+   vcache->set_shift = 32 - util_logbase2(num_sets);
+   vcache->generation = 1;
+
+   vcache->tags = CALLOC(num_sets * PT_VCACHE_WAYS, sizeof vcache->tags[0]);
+   vcache->victim = CALLOC(num_sets, sizeof vcache->victim[0]);
+   if (!vcache->tags || !vcache->victim) {
+      draw_pt_vcache_destroy(vcache);
+      return NULL;
+   }
+
+   return vcache;
+}
+
+
+void
+draw_pt_vcache_destroy(struct pt_vcache *vcache)
+{
+   FREE(vcache->tags);
+   FREE(vcache->victim);
+   FREE(vcache->vertices);
+   FREE(vcache);
+}
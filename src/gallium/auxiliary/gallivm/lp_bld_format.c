@@ -26,31 +26,94 @@
  **************************************************************************/
 
 
+#include "util/u_format.h"
+#include "util/u_memory.h"
+
 #include "lp_bld_format.h"
 
 
 
+unsigned lp_build_format_cache_size = 0;
+unsigned lp_build_format_cache_ways = 1;
+
+
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm)
 {
    LLVMTypeRef elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_COUNT];
-   LLVMTypeRef s;
-
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_DATA] =
-         LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
-                       LP_BUILD_FORMAT_CACHE_SIZE * 16);
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_TAGS] =
-         LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
-                       LP_BUILD_FORMAT_CACHE_SIZE);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
-         LLVMInt64TypeInContext(gallivm->context);
-   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
-         LLVMInt64TypeInContext(gallivm->context);
-#endif
-
-   s = LLVMStructTypeInContext(gallivm->context, elem_types,
-                               LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
-
-   return s;
+   unsigned i;
+
+   for (i = 0; i < LP_BUILD_FORMAT_CACHE_MEMBER_COUNT; i++)
+      elem_types[i] = LLVMInt64TypeInContext(gallivm->context);
+
+   return LLVMStructTypeInContext(gallivm->context, elem_types,
+                                  LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
+}
+
+
+/**
+ * Allocate a block cache with all blocks invalid.  Only the header is
+ * allocated when the cache is disabled.
+ */
+struct lp_build_format_cache *
+lp_build_format_cache_create(void)
+{
+   unsigned num_sets = lp_build_format_cache_size / lp_build_format_cache_ways;
+   unsigned size = sizeof(struct lp_build_format_cache);
+   struct lp_build_format_cache *cache;
+
+   if (lp_build_format_cache_size)
+      size = lp_build_format_cache_victim_offset() + num_sets;
+
+   cache = align_malloc(size, 64);
+   if (!cache)
+      return NULL;
+
+   /* tag_key 0 never matches the zeroed tags */
+   memset(cache, 0, size);
+   lp_build_format_cache_invalidate(cache);
+
+   return cache;
+}
+
+
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache)
+{
+   align_free(cache);
+}
+
+
+/**
+ * Invalidate all blocks, e.g. whenever the texture data may have changed.
+ * Only the tags need clearing when the generation wraps around.
+ */
+void
+lp_build_format_cache_invalidate(struct lp_build_format_cache *cache)
+{
+   const uint64_t one = (uint64_t)1 << 48;
+
+   cache->tag_key += one;
+   if (cache->tag_key == 0) {
+      if (lp_build_format_cache_size) {
+         memset((uint8_t *)cache + lp_build_format_cache_tags_offset(), 0,
+                lp_build_format_cache_size * sizeof(uint64_t));
+      }
+      cache->tag_key = one;
+   }
+}
+
+
+/**
+ * Whether fetches of the format can go through the block cache.
+ */
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   return lp_build_format_cache_size &&
+          format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN &&
+          format_desc->block.width == 4 &&
+          format_desc->block.height == 4 &&
+          util_format_fits_8unorm(format_desc) &&
+          format_desc->fetch_rgba_8unorm != NULL;
 }
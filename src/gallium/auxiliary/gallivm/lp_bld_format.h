@@ -38,50 +38,89 @@
 #include "gallivm/lp_bld_init.h"
 
 #include "pipe/p_format.h"
+#include "util/u_math.h"
 
 struct util_format_description;
 struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * Optional cache of decoded 4x4 blocks, used when unpacking compressed
+ * formats.  It is set associative, with round-robin replacement in each
+ * set.  The number of blocks and ways are read once at lp_build_init()
+ * time from LP_TEX_CACHE_SIZE and LP_TEX_CACHE_WAYS, and are powers of
+ * two.  A size of 0 disables the cache.
  */
-
-#define LP_BUILD_FORMAT_CACHE_SIZE 128
+extern unsigned lp_build_format_cache_size;
+extern unsigned lp_build_format_cache_ways;
 
 /*
- * Note: cache_data needs 16 byte alignment.
+ * Cache header.  The tags, the decoded blocks and the next way to replace
+ * in each set follow it in the same allocation, at the offsets returned by
+ * lp_build_format_cache_*_offset().
+ *
+ * Tags are block addresses xor'ed with tag_key.  Bumping the generation
+ * in the top 16 bits of tag_key invalidates all blocks at once.
  */
 struct lp_build_format_cache
 {
-   PIPE_ALIGN_VAR(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
-   uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   uint64_t cache_access_total;
-   uint64_t cache_access_miss;
-#endif
+   uint64_t tag_key;
+   uint64_t access_total;
+   uint64_t access_miss;
+   uint64_t pad;
 };
 
 
 enum {
-   LP_BUILD_FORMAT_CACHE_MEMBER_DATA = 0,
-   LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_BUILD_FORMAT_CACHE_MEMBER_TAG_KEY = 0,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS,
-#endif
+   LP_BUILD_FORMAT_CACHE_MEMBER_PAD,
    LP_BUILD_FORMAT_CACHE_MEMBER_COUNT
 };
 
 
+static inline unsigned
+lp_build_format_cache_tags_offset(void)
+{
+   return sizeof(struct lp_build_format_cache);
+}
+
+/** Decoded blocks, 16 rgba8 texels each, 64 byte aligned */
+static inline unsigned
+lp_build_format_cache_data_offset(void)
+{
+   return align(lp_build_format_cache_tags_offset() +
+                lp_build_format_cache_size * sizeof(uint64_t), 64);
+}
+
+/** One byte per set */
+static inline unsigned
+lp_build_format_cache_victim_offset(void)
+{
+   return lp_build_format_cache_data_offset() +
+          lp_build_format_cache_size * 16 * sizeof(uint32_t);
+}
+
+
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
+struct lp_build_format_cache *
+lp_build_format_cache_create(void);
+
+void
+lp_build_format_cache_destroy(struct lp_build_format_cache *cache);
+
+void
+lp_build_format_cache_invalidate(struct lp_build_format_cache *cache);
+
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
+
 
 /*
  * AoS
@@ -151,6 +190,15 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
                         LLVMValueRef cache,
                         LLVMValueRef rgba_out[4]);
 
+void
+lp_build_store_rgba_soa(struct gallivm_state *gallivm,
+                        const struct util_format_description *format_desc,
+                        struct lp_type type,
+                        LLVMValueRef exec_mask,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        const LLVMValueRef rgba_in[4]);
+
 /*
  * YUV
  */
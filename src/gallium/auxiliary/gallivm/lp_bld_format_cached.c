@@ -31,6 +31,7 @@
 #include "lp_bld_const.h"
 #include "lp_bld_flow.h"
 #include "lp_bld_swizzle.h"
+#include "lp_bld_intr.h"
 
 #include "util/u_math.h"
 
@@ -44,14 +45,13 @@
  * The elements in the cache are the decoded blocks - currently things
  * are restricted to formats which are 4x4 block based, and the decoded
  * texels must fit into 4x8 bits.
- * The cache is direct mapped so hitrates aren't all that great and cache
- * thrashing could happen.
+ * The cache is set associative, each decoded block can live in any of the
+ * ways of the set its address hashes to.
  *
  * @author Roland Scheidegger <sroland@vmware.com>
  */
 
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
 static void
 update_cache_access(struct gallivm_state *gallivm,
                     LLVMValueRef ptr,
@@ -71,38 +71,57 @@ update_cache_access(struct gallivm_state *gallivm,
                                                                    count, 0), "");
    LLVMBuildStore(builder, cache_access, member_ptr);
 }
-#endif
+
+
+/**
+ * Return a pointer of the given type to the cache data at byte offset.
+ */
+static LLVMValueRef
+cache_member_ptr(struct gallivm_state *gallivm,
+                 LLVMValueRef cache,
+                 unsigned offset,
+                 LLVMTypeRef type)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMValueRef ptr, index;
+
+   ptr = LLVMBuildBitCast(builder, cache, LLVMPointerType(i8t, 0), "");
+   index = lp_build_const_int32(gallivm, offset);
+   ptr = LLVMBuildGEP(builder, ptr, &index, 1, "");
+   return LLVMBuildBitCast(builder, ptr, LLVMPointerType(type, 0), "");
+}
 
 
 static void
 store_cached_block(struct gallivm_state *gallivm,
                    LLVMValueRef *col,
                    LLVMValueRef tag_value,
-                   LLVMValueRef hash_index,
+                   LLVMValueRef entry,
                    LLVMValueRef cache)
 {
    LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef ptr, indices[3];
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   LLVMValueRef ptr, data_ptr, index;
    LLVMTypeRef type_ptr4x32;
    unsigned count;
 
-   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = hash_index;
-   ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
+   type_ptr4x32 = LLVMPointerType(LLVMVectorType(i32t, 4), 0);
+
+   ptr = cache_member_ptr(gallivm, cache,
+                          lp_build_format_cache_tags_offset(), i64t);
+   ptr = LLVMBuildGEP(builder, ptr, &entry, 1, "");
    LLVMBuildStore(builder, tag_value, ptr);
 
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   hash_index = LLVMBuildMul(builder, hash_index,
-                             lp_build_const_int32(gallivm, 16), "");
+   data_ptr = cache_member_ptr(gallivm, cache,
+                               lp_build_format_cache_data_offset(), i32t);
+   index = LLVMBuildMul(builder, entry, lp_build_const_int32(gallivm, 16), "");
    for (count = 0; count < 4; count++) {
-      indices[2] = hash_index;
-      ptr = LLVMBuildGEP(builder, cache, indices, ARRAY_SIZE(indices), "");
+      ptr = LLVMBuildGEP(builder, data_ptr, &index, 1, "");
       ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
       LLVMBuildStore(builder, col[count], ptr);
-      hash_index = LLVMBuildAdd(builder, hash_index,
-                                lp_build_const_int32(gallivm, 4), "");
+      index = LLVMBuildAdd(builder, index, lp_build_const_int32(gallivm, 4), "");
    }
 }
 
@@ -113,37 +132,22 @@ lookup_cached_pixel(struct gallivm_state *gallivm,
                     LLVMValueRef index)
 {
    LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
+   LLVMValueRef member_ptr;
 
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_DATA);
-   indices[2] = index;
-   member_ptr = LLVMBuildGEP(builder, ptr, indices, ARRAY_SIZE(indices), "");
+   member_ptr = cache_member_ptr(gallivm, ptr,
+                                 lp_build_format_cache_data_offset(),
+                                 LLVMInt32TypeInContext(gallivm->context));
+   member_ptr = LLVMBuildGEP(builder, member_ptr, &index, 1, "");
    return LLVMBuildLoad(builder, member_ptr, "cache_data");
 }
 
 
-static LLVMValueRef
-lookup_tag_data(struct gallivm_state *gallivm,
-                LLVMValueRef ptr,
-                LLVMValueRef index)
-{
-   LLVMBuilderRef builder = gallivm->builder;
-   LLVMValueRef member_ptr, indices[3];
-
-   indices[0] = lp_build_const_int32(gallivm, 0);
-   indices[1] = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_MEMBER_TAGS);
-   indices[2] = index;
-   member_ptr = LLVMBuildGEP(builder, ptr, indices, ARRAY_SIZE(indices), "");
-   return LLVMBuildLoad(builder, member_ptr, "tag_data");
-}
-
-
 static void
 update_cached_block(struct gallivm_state *gallivm,
                     const struct util_format_description *format_desc,
                     LLVMValueRef ptr_addr,
-                    LLVMValueRef hash_index,
+                    LLVMValueRef tag_value,
+                    LLVMValueRef entry,
                     LLVMValueRef cache)
 
 {
@@ -153,7 +157,7 @@ update_cached_block(struct gallivm_state *gallivm,
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef i32x4 = LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4);
    LLVMValueRef function;
-   LLVMValueRef tag_value, tmp_ptr;
+   LLVMValueRef tmp_ptr;
    LLVMValueRef col[4];
    unsigned i, j;
 
@@ -229,9 +233,85 @@ update_cached_block(struct gallivm_state *gallivm,
       col[i] = LLVMBuildLoad(builder, ptr, "");
    }
 
-   tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
-                                 LLVMInt64TypeInContext(gallivm->context), "");
-   store_cached_block(gallivm, col, tag_value, hash_index, cache);
+   store_cached_block(gallivm, col, tag_value, entry, cache);
+}
+
+
+/**
+ * Find the block at addr in its set, decoding it into the next way to
+ * replace on a miss.
+ *
+ * Returns the index of the cache entry holding the block.
+ */
+static LLVMValueRef
+lookup_cached_block(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
+                    LLVMValueRef cache,
+                    LLVMValueRef tag_key,
+                    LLVMValueRef addr,
+                    LLVMValueRef set)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned ways = lp_build_format_cache_ways;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   LLVMTypeRef tags_type = LLVMVectorType(i64t, ways);
+   LLVMValueRef tag_value, tags_ptr, tags, hits, miss, way, way_var, entry;
+   LLVMValueRef first_entry;
+   struct lp_build_if_state if_ctx;
+
+   tag_value = LLVMBuildXor(builder, addr, tag_key, "");
+
+   /* compare the tags of all ways at once */
+   first_entry = LLVMBuildMul(builder, set,
+                              lp_build_const_int32(gallivm, ways), "");
+   tags_ptr = cache_member_ptr(gallivm, cache,
+                               lp_build_format_cache_tags_offset(), i64t);
+   tags_ptr = LLVMBuildGEP(builder, tags_ptr, &first_entry, 1, "");
+   tags_ptr = LLVMBuildBitCast(builder, tags_ptr,
+                               LLVMPointerType(tags_type, 0), "");
+   tags = LLVMBuildLoad(builder, tags_ptr, "tags");
+   LLVMSetAlignment(tags, 8);
+   hits = LLVMBuildICmp(builder, LLVMIntEQ, tags,
+                        lp_build_broadcast(gallivm, tags_type, tag_value), "");
+   hits = LLVMBuildBitCast(builder, hits,
+                           LLVMIntTypeInContext(gallivm->context, ways), "");
+   hits = LLVMBuildZExt(builder, hits, i32t, "");
+   miss = LLVMBuildICmp(builder, LLVMIntEQ, hits,
+                        lp_build_const_int32(gallivm, 0), "");
+
+   way_var = lp_build_alloca(gallivm, i32t, "way");
+   way = lp_build_intrinsic_binary(builder, "llvm.cttz.i32", i32t, hits,
+                                   LLVMConstInt(LLVMInt1TypeInContext(gallivm->context),
+                                                0, 0));
+   LLVMBuildStore(builder, way, way_var);
+
+   lp_build_if(&if_ctx, gallivm, miss);
+   {
+      LLVMValueRef victim_ptr, next, ptr_addr;
+
+      victim_ptr = cache_member_ptr(gallivm, cache,
+                                    lp_build_format_cache_victim_offset(), i8t);
+      victim_ptr = LLVMBuildGEP(builder, victim_ptr, &set, 1, "");
+      way = LLVMBuildLoad(builder, victim_ptr, "");
+      next = LLVMBuildAdd(builder, way, LLVMConstInt(i8t, 1, 0), "");
+      next = LLVMBuildAnd(builder, next, LLVMConstInt(i8t, ways - 1, 0), "");
+      LLVMBuildStore(builder, next, victim_ptr);
+      way = LLVMBuildZExt(builder, way, i32t, "");
+      LLVMBuildStore(builder, way, way_var);
+
+      entry = LLVMBuildAdd(builder, first_entry, way, "");
+      ptr_addr = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
+      update_cached_block(gallivm, format_desc, ptr_addr, tag_value, entry,
+                          cache);
+      update_cache_access(gallivm, cache, 1,
+                          LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+   }
+   lp_build_endif(&if_ctx);
+
+   way = LLVMBuildLoad(builder, way_var, "");
+   return LLVMBuildAdd(builder, first_entry, way, "");
 }
 
 
@@ -253,8 +333,8 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
 {
    LLVMBuilderRef builder = gallivm->builder;
    unsigned count, low_bit, log2size;
-   LLVMValueRef color, offset_stored, addr, ptr_addrtrunc, tmp;
-   LLVMValueRef ij_index, hash_index, hash_mask, block_index;
+   LLVMValueRef color, addr, ptr_addrtrunc, tmp, tag_key;
+   LLVMValueRef ij_index, hash_index, hash_mask;
    LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
    LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
@@ -266,15 +346,16 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
 
    assert(format_desc->block.width == 4);
    assert(format_desc->block.height == 4);
+   assert(lp_build_format_cache_size);
 
    lp_build_context_init(&bld32, gallivm, type);
 
    /*
-    * compute hash - we use direct mapped cache, the hash function could
-    *                be better but it needs to be simple
+    * compute hash - the hash function could be better but it needs to be
+    *                simple
     * per-element:
-    *    compare offset with offset stored at tag (hash)
-    *    if not equal decode/store block, update tag
+    *    compare the block address with the tags of the set (hash)
+    *    if none is equal decode/store block, update tag
     *    extract color from cache
     *    assemble result vector
     */
@@ -282,7 +363,8 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
    /* TODO: not ideal with 32bit pointers... */
 
    low_bit = util_logbase2(format_desc->block.bits / 8);
-   log2size = util_logbase2(LP_BUILD_FORMAT_CACHE_SIZE);
+   log2size = util_logbase2(lp_build_format_cache_size /
+                            lp_build_format_cache_ways);
    addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
    ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
    ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
@@ -300,75 +382,56 @@ lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
                        lp_build_const_int_vec(gallivm, type, log2size), "");
    hash_index = LLVMBuildXor(builder, hash_index, tmp, "");
 
-   hash_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SIZE - 1);
+   hash_mask = lp_build_const_int_vec(gallivm, type,
+                                      (1 << log2size) - 1);
    hash_index = LLVMBuildAnd(builder, hash_index, hash_mask, "");
    ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
    ij_index = LLVMBuildAdd(builder, ij_index, j, "");
-   block_index = LLVMBuildShl(builder, hash_index,
-                              lp_build_const_int_vec(gallivm, type, 4), "");
-   block_index = LLVMBuildAdd(builder, ij_index, block_index, "");
+
+   tag_key = LLVMBuildLoad(builder,
+                           lp_build_struct_get_ptr(gallivm, cache,
+                                                   LP_BUILD_FORMAT_CACHE_MEMBER_TAG_KEY,
+                                                   ""),
+                           "tag_key");
 
    if (n > 1) {
       color = LLVMGetUndef(LLVMVectorType(i32t, n));
       for (count = 0; count < n; count++) {
-         LLVMValueRef index, cond, colorx;
-         LLVMValueRef block_indexx, hash_indexx, addrx, offsetx, ptr_addrx;
-         struct lp_build_if_state if_ctx;
+         LLVMValueRef index, colorx, entry;
+         LLVMValueRef hash_indexx, ij_indexx, addrx, offsetx;
 
          index = lp_build_const_int32(gallivm, count);
          offsetx = LLVMBuildExtractElement(builder, offset, index, "");
          addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
          addrx = LLVMBuildAdd(builder, addrx, addr, "");
-         block_indexx = LLVMBuildExtractElement(builder, block_index, index, "");
-         hash_indexx = LLVMBuildLShr(builder, block_indexx,
-                                     lp_build_const_int32(gallivm, 4), "");
-         offset_stored = lookup_tag_data(gallivm, cache, hash_indexx);
-         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addrx, "");
-
-         lp_build_if(&if_ctx, gallivm, cond);
-         {
-            ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
-                                          LLVMPointerType(i8t, 0), "");
-            update_cached_block(gallivm, format_desc, ptr_addrx, hash_indexx, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-            update_cache_access(gallivm, cache, 1,
-                                LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-         }
-         lp_build_endif(&if_ctx);
-
-         colorx = lookup_cached_pixel(gallivm, cache, block_indexx);
+         hash_indexx = LLVMBuildExtractElement(builder, hash_index, index, "");
+         ij_indexx = LLVMBuildExtractElement(builder, ij_index, index, "");
+
+         entry = lookup_cached_block(gallivm, format_desc, cache, tag_key,
+                                     addrx, hash_indexx);
+         entry = LLVMBuildShl(builder, entry, lp_build_const_int32(gallivm, 4), "");
+         colorx = lookup_cached_pixel(gallivm, cache,
+                                      LLVMBuildAdd(builder, entry, ij_indexx, ""));
 
          color = LLVMBuildInsertElement(builder, color, colorx,
                                         lp_build_const_int32(gallivm, count), "");
       }
    }
    else {
-      LLVMValueRef cond;
-      struct lp_build_if_state if_ctx;
+      LLVMValueRef entry;
 
       tmp = LLVMBuildZExt(builder, offset, i64t, "");
       addr = LLVMBuildAdd(builder, tmp, addr, "");
-      offset_stored = lookup_tag_data(gallivm, cache, hash_index);
-      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addr, "");
-
-      lp_build_if(&if_ctx, gallivm, cond);
-      {
-         tmp = LLVMBuildIntToPtr(builder, addr, LLVMPointerType(i8t, 0), "");
-         update_cached_block(gallivm, format_desc, tmp, hash_index, cache);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-         update_cache_access(gallivm, cache, 1,
-                             LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
-#endif
-      }
-      lp_build_endif(&if_ctx);
 
-      color = lookup_cached_pixel(gallivm, cache, block_index);
+      entry = lookup_cached_block(gallivm, format_desc, cache, tag_key,
+                                  addr, hash_index);
+      entry = LLVMBuildShl(builder, entry, lp_build_const_int32(gallivm, 4), "");
+      color = lookup_cached_pixel(gallivm, cache,
+                                  LLVMBuildAdd(builder, entry, ij_index, ""));
    }
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+
    update_cache_access(gallivm, cache, n,
                        LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL);
-#endif
+
    return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
 }
-
@@ -41,6 +41,7 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_format.h"
 #include "lp_bld_arit.h"
+#include "lp_bld_bitarit.h"
 #include "lp_bld_pack.h"
 
 
@@ -853,3 +854,179 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
       convert_to_soa(gallivm, aos_fetch, rgba_out, type);
    }
 }
+
+
+/**
+ * Convert SoA texels to a format and store them into memory.
+ *
+ * Only plain formats whose channels don't straddle 32 bit words and
+ * R11G11B10_FLOAT are supported, which covers all the formats shader images
+ * can have.
+ *
+ * \param type  the type of rgba_in (32 bit float, or int/uint for pure
+ *              integer formats)
+ * \param exec_mask  integer mask of the texels to store, or NULL
+ * \param base_ptr  base pointer (i8 *)
+ * \param offsets  vector of byte offsets of the texels
+ * \param rgba_in  the SoA R,G,B,A vectors
+ */
+void
+lp_build_store_rgba_soa(struct gallivm_state *gallivm,
+                        const struct util_format_description *format_desc,
+                        struct lp_type type,
+                        LLVMValueRef exec_mask,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        const LLVMValueRef rgba_in[4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context float_bld, int_bld, uint_bld;
+   LLVMValueRef words[4];
+   unsigned num_words = (format_desc->block.bits + 31) / 32;
+   unsigned chan, i;
+
+   assert(type.width == 32);
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+   assert(num_words <= 4);
+
+   lp_build_context_init(&float_bld, gallivm,
+                         lp_type_float_vec(32, 32 * type.length));
+   lp_build_context_init(&int_bld, gallivm, lp_int_type(float_bld.type));
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(float_bld.type));
+
+   for (i = 0; i < num_words; i++) {
+      words[i] = int_bld.zero;
+   }
+
+   if (format_desc->format == PIPE_FORMAT_R11G11B10_FLOAT) {
+      LLVMValueRef rgb[3];
+      for (chan = 0; chan < 3; chan++) {
+         rgb[chan] = LLVMBuildBitCast(builder, rgba_in[chan],
+                                      float_bld.vec_type, "");
+      }
+      words[0] = lp_build_float_to_r11g11b10(gallivm, rgb);
+   }
+   else {
+      assert(format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN);
+
+      for (chan = 0; chan < format_desc->nr_channels; chan++) {
+         const struct util_format_channel_description *chan_desc =
+            &format_desc->channel[chan];
+         const unsigned width = chan_desc->size;
+         LLVMValueRef src = NULL;
+         LLVMValueRef value;
+
+         for (i = 0; i < 4; i++) {
+            if (format_desc->swizzle[i] == chan) {
+               src = rgba_in[i];
+               break;
+            }
+         }
+         if (!src || chan_desc->type == UTIL_FORMAT_TYPE_VOID) {
+            continue;
+         }
+
+         assert(width <= 32);
+         assert(chan_desc->shift / 32 == (chan_desc->shift + width - 1) / 32);
+
+         if (chan_desc->pure_integer) {
+            if (chan_desc->type == UTIL_FORMAT_TYPE_SIGNED) {
+               value = LLVMBuildBitCast(builder, src, int_bld.vec_type, "");
+               if (width < 32) {
+                  value = lp_build_clamp(&int_bld, value,
+                             lp_build_const_int_vec(gallivm, int_bld.type,
+                                                    -(1LL << (width - 1))),
+                             lp_build_const_int_vec(gallivm, int_bld.type,
+                                                    (1LL << (width - 1)) - 1));
+               }
+            }
+            else {
+               value = LLVMBuildBitCast(builder, src, uint_bld.vec_type, "");
+               if (width < 32) {
+                  value = lp_build_min(&uint_bld, value,
+                             lp_build_const_int_vec(gallivm, uint_bld.type,
+                                                    (1LL << width) - 1));
+               }
+               value = LLVMBuildBitCast(builder, value, int_bld.vec_type, "");
+            }
+         }
+         else {
+            src = LLVMBuildBitCast(builder, src, float_bld.vec_type, "");
+
+            switch (chan_desc->type) {
+            case UTIL_FORMAT_TYPE_FLOAT:
+               if (width == 32) {
+                  value = LLVMBuildBitCast(builder, src, int_bld.vec_type, "");
+               }
+               else {
+                  assert(width == 16);
+                  value = lp_build_float_to_half(gallivm, src);
+                  value = LLVMBuildZExt(builder, value, int_bld.vec_type, "");
+               }
+               break;
+            case UTIL_FORMAT_TYPE_UNSIGNED:
+               if (chan_desc->normalized) {
+                  value = lp_build_clamped_float_to_unsigned_norm(gallivm,
+                                                                  float_bld.type,
+                                                                  width, src);
+               }
+               else {
+                  value = lp_build_max(&float_bld, src, float_bld.zero);
+                  value = lp_build_iround(&float_bld, value);
+               }
+               break;
+            case UTIL_FORMAT_TYPE_SIGNED:
+               if (chan_desc->normalized) {
+                  value = lp_build_clamp(&float_bld, src,
+                                         lp_build_const_vec(gallivm, float_bld.type, -1.0),
+                                         float_bld.one);
+                  value = lp_build_mul(&float_bld, value,
+                             lp_build_const_vec(gallivm, float_bld.type,
+                                                (double)((1LL << (width - 1)) - 1)));
+               }
+               else {
+                  value = src;
+               }
+               value = lp_build_iround(&float_bld, value);
+               break;
+            default:
+               assert(0);
+               value = int_bld.zero;
+               break;
+            }
+         }
+
+         if (width < 32) {
+            value = LLVMBuildAnd(builder, value,
+                                 lp_build_const_int_vec(gallivm, int_bld.type,
+                                                        (1LL << width) - 1), "");
+         }
+         if (chan_desc->shift % 32) {
+            value = lp_build_shl_imm(&int_bld, value, chan_desc->shift % 32);
+         }
+         words[chan_desc->shift / 32] =
+            LLVMBuildOr(builder, words[chan_desc->shift / 32], value, "");
+      }
+   }
+
+   for (i = 0; i < num_words; i++) {
+      LLVMValueRef word_offsets = offsets;
+      LLVMValueRef value = words[i];
+
+      if (i) {
+         word_offsets = lp_build_add(&int_bld, offsets,
+                                     lp_build_const_int_vec(gallivm,
+                                                            int_bld.type,
+                                                            4 * i));
+      }
+      if (format_desc->block.bits < 32) {
+         LLVMTypeRef small_type =
+            LLVMIntTypeInContext(gallivm->context, format_desc->block.bits);
+         value = LLVMBuildTrunc(builder, value,
+                                LLVMVectorType(small_type, type.length), "");
+      }
+      lp_build_scatter_masked(gallivm, type.length, base_ptr, word_offsets,
+                              value, exec_mask);
+   }
+}
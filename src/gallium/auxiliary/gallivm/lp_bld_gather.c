@@ -31,6 +31,7 @@
 #include "util/u_math.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_const.h"
+#include "lp_bld_flow.h"
 #include "lp_bld_format.h"
 #include "lp_bld_gather.h"
 #include "lp_bld_swizzle.h"
@@ -571,3 +572,130 @@ lp_build_gather_values(struct gallivm_state * gallivm,
    }
    return vec;
 }
+
+
+/**
+ * Scatter a vector to memory, storing element i of \p values at the byte
+ * offset offsets[i] of base_ptr, for the elements enabled in \p mask only.
+ *
+ * Unlike a masked read-modify-write of the whole vector the disabled
+ * elements don't touch memory at all, which matters when other threads may
+ * be writing the same memory.
+ *
+ * @param mask  integer vector of all ones / all zeros, may be NULL
+ */
+void
+lp_build_scatter_masked(struct gallivm_state *gallivm,
+                        unsigned length,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        LLVMValueRef values,
+                        LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned i;
+
+   for (i = 0; i < length; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef ptr, val;
+      struct lp_build_if_state ifthen;
+
+      if (mask) {
+         LLVMValueRef cond = length == 1 ? mask :
+                             LLVMBuildExtractElement(builder, mask, index, "");
+         cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                              LLVMConstNull(LLVMTypeOf(cond)), "");
+         lp_build_if(&ifthen, gallivm, cond);
+      }
+
+      ptr = lp_build_gather_elem_ptr(gallivm, length, base_ptr, offsets, i);
+      val = length == 1 ? values :
+            LLVMBuildExtractElement(builder, values, index, "");
+      ptr = LLVMBuildBitCast(builder, ptr,
+                             LLVMPointerType(LLVMTypeOf(val), 0), "");
+      LLVMBuildStore(builder, val, ptr);
+
+      if (mask) {
+         lp_build_endif(&ifthen);
+      }
+   }
+}
+
+
+/**
+ * Perform an atomic operation on the 32 bit integers at the byte offsets
+ * \p offsets of base_ptr, for the enabled elements of \p mask, and return
+ * the original values (zero for the disabled elements).
+ *
+ * If \p cmp_values is given this is a compare-and-swap, storing \p values
+ * where the memory matches \p cmp_values, and \p op is ignored.
+ *
+ * Elements are processed in order, so several elements addressing the same
+ * location behave as if they were executed one after the other.
+ */
+LLVMValueRef
+lp_build_atomic_masked(struct gallivm_state *gallivm,
+                       struct lp_type type,
+                       LLVMAtomicRMWBinOp op,
+                       LLVMValueRef base_ptr,
+                       LLVMValueRef offsets,
+                       LLVMValueRef values,
+                       LLVMValueRef cmp_values,
+                       LLVMValueRef mask)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef elem_type = lp_build_elem_type(gallivm, type);
+   LLVMValueRef res_ptr = lp_build_alloca(gallivm, vec_type, "atomic_res");
+   unsigned i;
+
+   assert(type.width == 32 && !type.floating);
+
+   for (i = 0; i < type.length; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef ptr, val, res;
+      struct lp_build_if_state ifthen;
+
+      if (mask) {
+         LLVMValueRef cond = LLVMBuildExtractElement(builder, mask, index, "");
+         cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                              LLVMConstNull(LLVMTypeOf(cond)), "");
+         lp_build_if(&ifthen, gallivm, cond);
+      }
+
+      ptr = lp_build_gather_elem_ptr(gallivm, type.length, base_ptr,
+                                     offsets, i);
+      ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(elem_type, 0), "");
+      val = LLVMBuildExtractElement(builder, values, index, "");
+
+      if (cmp_values) {
+#if HAVE_LLVM >= 0x0309
+         LLVMValueRef cmp = LLVMBuildExtractElement(builder, cmp_values,
+                                                    index, "");
+         res = LLVMBuildAtomicCmpXchg(builder, ptr, cmp, val,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         res = LLVMBuildExtractValue(builder, res, 0, "");
+#else
+         assert(!"compare-and-swap requires LLVM 3.9");
+         res = LLVMGetUndef(elem_type);
+#endif
+      }
+      else {
+         res = LLVMBuildAtomicRMW(builder, op, ptr, val,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+
+      val = LLVMBuildLoad(builder, res_ptr, "");
+      val = LLVMBuildInsertElement(builder, val, res, index, "");
+      LLVMBuildStore(builder, val, res_ptr);
+
+      if (mask) {
+         lp_build_endif(&ifthen);
+      }
+   }
+
+   return LLVMBuildLoad(builder, res_ptr, "");
+}
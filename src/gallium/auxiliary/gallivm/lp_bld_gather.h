@@ -31,6 +31,7 @@
 
 
 #include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_type.h"
 
 
 LLVMValueRef
@@ -66,4 +67,22 @@ lp_build_gather_values(struct gallivm_state * gallivm,
                        LLVMValueRef * values,
                        unsigned value_count);
 
+void
+lp_build_scatter_masked(struct gallivm_state *gallivm,
+                        unsigned length,
+                        LLVMValueRef base_ptr,
+                        LLVMValueRef offsets,
+                        LLVMValueRef values,
+                        LLVMValueRef mask);
+
+LLVMValueRef
+lp_build_atomic_masked(struct gallivm_state *gallivm,
+                       struct lp_type type,
+                       LLVMAtomicRMWBinOp op,
+                       LLVMValueRef base_ptr,
+                       LLVMValueRef offsets,
+                       LLVMValueRef values,
+                       LLVMValueRef cmp_values,
+                       LLVMValueRef mask);
+
 #endif /* LP_BLD_GATHER_H_ */
@@ -37,6 +37,8 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
+#include "lp_bld_type.h"
+#include "lp_bld_format.h"
 
 #include <llvm-c/Analysis.h>
 #include <llvm-c/Transforms/Scalar.h>
@@ -145,7 +147,18 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMSetDataLayout(gallivm->module, "");
 #endif
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   return TRUE;
+}
+
+
+/**
+ * Install the optimization passes.  This is deferred until compilation so
+ * that gallivm users can still set gallivm_state::no_opt after creation.
+ */
+static void
+add_passes(struct gallivm_state *gallivm)
+{
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 && !gallivm->no_opt) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
@@ -165,8 +178,6 @@ create_pass_manager(struct gallivm_state *gallivm)
        */
       LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
    }
-
-   return TRUE;
 }
 
 
@@ -188,6 +199,11 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   if (gallivm->cache && gallivm->cache->jit_obj_cache) {
+      lp_free_objcache(gallivm->cache->jit_obj_cache);
+      gallivm->cache->jit_obj_cache = NULL;
+   }
+
    FREE(gallivm->module_name);
 
    if (!USE_MCJIT) {
@@ -236,7 +252,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->no_opt) {
          optlevel = None;
       }
       else {
@@ -247,6 +263,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
                                                     &gallivm->code,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
+                                                    gallivm->cache,
                                                     (unsigned) optlevel,
                                                     USE_MCJIT,
                                                     &error);
@@ -421,6 +438,11 @@ lp_build_init(void)
       util_cpu_caps.has_avx2 = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512cd = 0;
+      util_cpu_caps.has_avx512bw = 0;
+      util_cpu_caps.has_avx512dq = 0;
+      util_cpu_caps.has_avx512vl = 0;
    }
 #endif
 
@@ -443,6 +465,33 @@ lp_build_init(void)
  
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
                                                  lp_native_vector_width);
+   lp_native_vector_width = MIN2(lp_native_vector_width, LP_MAX_VECTOR_WIDTH);
+
+   /* 512-bit vectors, i.e. a whole 4x4 fragment stamp per 16 x float vector,
+    * are still experimental and only used when explicitly asked for with
+    * LP_NATIVE_VECTOR_WIDTH=512.  The byte and word instructions (bw) are
+    * needed for blending packed colors, and vl for the 128/256-bit vectors
+    * we still use elsewhere.
+    */
+   if (lp_native_vector_width > 256 &&
+       !(HAVE_LLVM >= 0x0309 && USE_MCJIT &&
+         util_cpu_caps.has_avx512f &&
+         util_cpu_caps.has_avx512bw &&
+         util_cpu_caps.has_avx512dq &&
+         util_cpu_caps.has_avx512vl)) {
+      lp_native_vector_width = 256;
+   }
+
+   if (lp_native_vector_width <= 256) {
+      /* Same as for AVX below: 512-bit intrinsics are only guarded by the
+       * avx512 caps.
+       */
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512cd = 0;
+      util_cpu_caps.has_avx512bw = 0;
+      util_cpu_caps.has_avx512dq = 0;
+      util_cpu_caps.has_avx512vl = 0;
+   }
 
    if (lp_native_vector_width <= 128) {
       /* Hide AVX support, as often LLVM AVX intrinsics are only guarded by
@@ -457,6 +506,18 @@ lp_build_init(void)
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
    }
+   /* Decoded block cache, see lp_bld_format_cached.c */
+   lp_build_format_cache_size = debug_get_num_option("LP_TEX_CACHE_SIZE", 128);
+   lp_build_format_cache_ways = debug_get_num_option("LP_TEX_CACHE_WAYS", 4);
+   if (lp_build_format_cache_size) {
+      lp_build_format_cache_size =
+         util_next_power_of_two(MIN2(lp_build_format_cache_size, 4096));
+      lp_build_format_cache_ways =
+         util_next_power_of_two(CLAMP(lp_build_format_cache_ways, 1, 16));
+      lp_build_format_cache_ways = MIN2(lp_build_format_cache_ways,
+                                        lp_build_format_cache_size);
+   }
+
    if (HAVE_LLVM < 0x0304 || !USE_MCJIT) {
       /* AVX2 support has only been tested with LLVM 3.4, and it requires
        * MCJIT. */
@@ -569,7 +630,15 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
+   /*
+    * When the object code is already cached the IR is only needed to look
+    * up the functions by name, so don't bother optimizing it.
+    */
+   if (HAVE_LLVM >= 0x0306 && gallivm->cache && gallivm->cache->data)
+      goto skip_opt;
+
    /* Run optimization passes */
+   add_passes(gallivm);
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
    while (func) {
@@ -599,6 +668,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    gallivm->module_name, time_msec);
    }
 
+skip_opt:
+
    /* Dump byte code to a file */
    if (gallivm_debug & GALLIVM_DEBUG_DUMP_BC) {
       char filename[256];
@@ -39,6 +39,27 @@
 extern "C" {
 #endif
 
+/**
+ * Machine code of a module, to be stored in or loaded from a persistent
+ * shader cache by the gallivm user.
+ *
+ * Before compiling, set data/data_size to the object code previously
+ * retrieved for this module to skip optimization and code generation.
+ * Otherwise, once code has been generated (i.e. after the first
+ * gallivm_jit_function() call), data is set to a malloc'ed copy of the
+ * object code, unless the module references process-specific addresses
+ * (dont_cache).
+ * The caller owns data in both cases and releases it with free().
+ */
+struct lp_cached_code
+{
+   void *data;
+   size_t data_size;
+   boolean dont_cache;
+   void *jit_obj_cache;  /**< llvm::ObjectCache, private to gallivm */
+};
+
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,6 +71,8 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;  /**< optional, may be NULL */
+   boolean no_opt;  /**< generate code quickly rather than fast code */
    unsigned compiled;
 };
 
@@ -319,7 +319,9 @@ lp_build_select(struct lp_build_context *bld,
    }
    else if (!(HAVE_LLVM == 0x0307) &&
             (LLVMIsConstant(mask) ||
-             LLVMGetInstructionOpcode(mask) == LLVMSExt)) {
+             LLVMGetInstructionOpcode(mask) == LLVMSExt ||
+             (util_cpu_caps.has_avx512f &&
+              type.width * type.length == 512))) {
       /* Generate a vector select.
        *
        * Using vector selects should avoid emitting intrinsics hence avoid
@@ -327,6 +329,8 @@ lp_build_select(struct lp_build_context *bld,
        * supported yet for a long time, and LLVM will generate poor code when
        * the mask is not the result of a comparison.
        * Also, llvm 3.7 may miscompile them (bug 94972).
+       * With AVX-512 there is no blendv for 512-bit vectors, the mask
+       * ends up in a mask register either way.
        */
 
       /* Convert the mask to a vector of booleans.
@@ -118,6 +118,7 @@ lp_sampler_static_texture_state(struct lp_static_texture_state *state,
    state->pot_height        = util_is_power_of_two(texture->height0);
    state->pot_depth         = util_is_power_of_two(texture->depth0);
    state->level_zero_only   = !view->u.tex.last_level;
+   state->tiled             = !!(texture->flags & LP_RESOURCE_FLAG_TILED);
 
    /*
     * the layer / element / level parameters are all either dynamic
@@ -2015,16 +2016,65 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along the x or y axis of a tiled
+ * texture (see LP_RESOURCE_FLAG_TILED).
+ *
+ * The tiled offset of texel (x, y) is the sum of
+ *
+ *   x + (T - 1) * (x & ~(T - 1))                   texels along x, and
+ *   (y & ~(T - 1)) * row_stride + (y & (T - 1)) * T texels along y,
+ *
+ * with T = LP_SAMPLER_TILE_SIZE, so it can still be computed per axis.
+ *
+ * @param texel_size  size of a texel in bytes
+ * @param coord       coordinate in texels
+ * @param row_stride  row stride in bytes for the y axis, NULL for the x axis
+ * @param out_offset  resulting relative offset in bytes
+ */
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned texel_size,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef row_stride,
+                                     LLVMValueRef *out_offset)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef tile_mask = lp_build_const_int_vec(gallivm, bld->type,
+                                                   LP_SAMPLER_TILE_SIZE - 1);
+   LLVMValueRef lo = LLVMBuildAnd(builder, coord, tile_mask, "");
+   LLVMValueRef hi = LLVMBuildSub(builder, coord, lo, "");
+   LLVMValueRef offset;
+
+   if (row_stride) {
+      offset = lp_build_mul(bld, hi, row_stride);
+      lo = lp_build_mul_imm(bld, lo, LP_SAMPLER_TILE_SIZE * texel_size);
+      offset = lp_build_add(bld, offset, lo);
+   }
+   else {
+      offset = lp_build_mul_imm(bld, hi, LP_SAMPLER_TILE_SIZE - 1);
+      offset = lp_build_add(bld, offset, coord);
+      offset = lp_build_mul_imm(bld, offset, texel_size);
+   }
+
+   *out_offset = offset;
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
  * x, y, z, y_stride, z_stride are vectors, and they refer to pixels.
+ * If tiled is set the texture uses the tiled layout (only possible for
+ * formats with 1x1 blocks).
  *
  * Returns the relative offset and i,j sub-block coordinates
  */
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2037,24 +2087,40 @@ lp_build_sample_offset(struct lp_build_context *bld,
    LLVMValueRef x_stride;
    LLVMValueRef offset;
 
-   x_stride = lp_build_const_vec(bld->gallivm, bld->type,
-                                 format_desc->block.bits/8);
+   if (tiled) {
+      assert(format_desc->block.width == 1 && format_desc->block.height == 1);
 
-   lp_build_sample_partial_offset(bld,
-                                  format_desc->block.width,
-                                  x, x_stride,
-                                  &offset, out_i);
-
-   if (y && y_stride) {
-      LLVMValueRef y_offset;
-      lp_build_sample_partial_offset(bld,
-                                     format_desc->block.height,
-                                     y, y_stride,
-                                     &y_offset, out_j);
-      offset = lp_build_add(bld, offset, y_offset);
+      lp_build_sample_tiled_partial_offset(bld, format_desc->block.bits/8,
+                                           x, NULL, &offset);
+      if (y && y_stride) {
+         LLVMValueRef y_offset;
+         lp_build_sample_tiled_partial_offset(bld, format_desc->block.bits/8,
+                                              y, y_stride, &y_offset);
+         offset = lp_build_add(bld, offset, y_offset);
+      }
+      *out_i = bld->zero;
+      *out_j = bld->zero;
    }
    else {
-      *out_j = bld->zero;
+      x_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                    format_desc->block.bits/8);
+
+      lp_build_sample_partial_offset(bld,
+                                     format_desc->block.width,
+                                     x, x_stride,
+                                     &offset, out_i);
+
+      if (y && y_stride) {
+         LLVMValueRef y_offset;
+         lp_build_sample_partial_offset(bld,
+                                        format_desc->block.height,
+                                        y, y_stride,
+                                        &y_offset, out_j);
+         offset = lp_build_add(bld, offset, y_offset);
+      }
+      else {
+         *out_j = bld->zero;
+      }
    }
 
    if (z && z_stride) {
@@ -54,6 +54,18 @@ struct lp_type;
 struct lp_build_context;
 
 
+/**
+ * Textures flagged with this in pipe_resource::flags are laid out in tiles
+ * of LP_SAMPLER_TILE_SIZE x LP_SAMPLER_TILE_SIZE texels instead of linear
+ * rows.  Tiles are stored in row-major order, as are the texels within a
+ * tile, so a row of tiles takes LP_SAMPLER_TILE_SIZE times the row stride.
+ * Only used for formats with 1x1 blocks, and 2D/3D/cube/array targets.
+ */
+#define LP_RESOURCE_FLAG_TILED (PIPE_RESOURCE_FLAG_DRV_PRIV << 0)
+
+#define LP_SAMPLER_TILE_SIZE 4
+
+
 /**
  * Helper struct holding all derivatives needed for sampling
  */
@@ -121,6 +133,37 @@ struct lp_sampler_size_query_params
    LLVMValueRef explicit_lod;
    LLVMValueRef *sizes_out;
 };
+
+enum lp_img_op {
+   LP_IMG_LOAD,
+   LP_IMG_STORE,
+   LP_IMG_ATOMIC,
+   LP_IMG_ATOMIC_CAS
+};
+
+/**
+ * Parameters of a shader image access.
+ *
+ * coords are integer vectors.  indata, indata2 and outdata are float vectors
+ * holding the raw bits of the values, as TGSI registers do: floats for float
+ * and normalized formats, (bitcast) integers for pure integer formats.
+ */
+struct lp_img_params
+{
+   struct lp_type type;
+   unsigned image_index;
+   enum lp_img_op img_op;
+   unsigned target;             /**< PIPE_TEXTURE_* */
+   LLVMAtomicRMWBinOp op;       /**< for LP_IMG_ATOMIC */
+   LLVMValueRef exec_mask;
+   LLVMValueRef context_ptr;
+   const LLVMValueRef *coords;
+   LLVMValueRef indata[4];
+   LLVMValueRef indata2[4];     /**< new value for LP_IMG_ATOMIC_CAS, indata
+                                     being the comparand */
+   LLVMValueRef *outdata;
+};
+
 /**
  * Texture static state.
  *
@@ -142,6 +185,7 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< see LP_RESOURCE_FLAG_TILED */
 };
 
 
@@ -582,9 +626,18 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     unsigned texel_size,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef row_stride,
+                                     LLVMValueRef *out_offset);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -618,6 +671,12 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                         struct lp_sampler_dynamic_state *dynamic_state,
                         const struct lp_sampler_size_query_params *params);
 
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params);
+
 void
 lp_build_sample_nop(struct gallivm_state *gallivm, 
                     struct lp_type type,
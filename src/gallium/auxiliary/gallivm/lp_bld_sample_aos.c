@@ -811,6 +811,7 @@ lp_build_sample_image_nearest_afloat(struct lp_build_sample_context *bld,
     */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x_icoord, y_icoord,
                           z_icoord,
                           row_stride_vec, img_stride_vec,
@@ -1306,14 +1307,25 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
     * cannot do offset calc with floats, difficult for block-based formats,
     * and not enough precision anyway.
     */
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord0, x_stride,
-                                  &x_offset0, &x_subcoord[0]);
-   lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                  bld->format_desc->block.width,
-                                  x_icoord1, x_stride,
-                                  &x_offset1, &x_subcoord[1]);
+   if (bld->static_texture_state->tiled) {
+      lp_build_sample_tiled_partial_offset(&bld->int_coord_bld,
+                                           bld->format_desc->block.bits/8,
+                                           x_icoord0, NULL, &x_offset0);
+      lp_build_sample_tiled_partial_offset(&bld->int_coord_bld,
+                                           bld->format_desc->block.bits/8,
+                                           x_icoord1, NULL, &x_offset1);
+      x_subcoord[0] = x_subcoord[1] = bld->int_coord_bld.zero;
+   }
+   else {
+      lp_build_sample_partial_offset(&bld->int_coord_bld,
+                                     bld->format_desc->block.width,
+                                     x_icoord0, x_stride,
+                                     &x_offset0, &x_subcoord[0]);
+      lp_build_sample_partial_offset(&bld->int_coord_bld,
+                                     bld->format_desc->block.width,
+                                     x_icoord1, x_stride,
+                                     &x_offset1, &x_subcoord[1]);
+   }
 
    /* add potential cube/array/mip offsets now as they are constant per pixel */
    if (has_layer_coord(bld->static_texture_state->target)) {
@@ -1336,14 +1348,25 @@ lp_build_sample_image_linear_afloat(struct lp_build_sample_context *bld,
    }
 
    if (dims >= 2) {
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord0, y_stride,
-                                     &y_offset0, &y_subcoord[0]);
-      lp_build_sample_partial_offset(&bld->int_coord_bld,
-                                     bld->format_desc->block.height,
-                                     y_icoord1, y_stride,
-                                     &y_offset1, &y_subcoord[1]);
+      if (bld->static_texture_state->tiled) {
+         lp_build_sample_tiled_partial_offset(&bld->int_coord_bld,
+                                              bld->format_desc->block.bits/8,
+                                              y_icoord0, y_stride, &y_offset0);
+         lp_build_sample_tiled_partial_offset(&bld->int_coord_bld,
+                                              bld->format_desc->block.bits/8,
+                                              y_icoord1, y_stride, &y_offset1);
+         y_subcoord[0] = y_subcoord[1] = bld->int_coord_bld.zero;
+      }
+      else {
+         lp_build_sample_partial_offset(&bld->int_coord_bld,
+                                        bld->format_desc->block.height,
+                                        y_icoord0, y_stride,
+                                        &y_offset0, &y_subcoord[0]);
+         lp_build_sample_partial_offset(&bld->int_coord_bld,
+                                        bld->format_desc->block.height,
+                                        y_icoord1, y_stride,
+                                        &y_offset1, &y_subcoord[1]);
+      }
       for (z = 0; z < 2; z++) {
          for (x = 0; x < 2; x++) {
             offset[z][0][x] = lp_build_add(&bld->int_coord_bld,
@@ -1413,9 +1436,13 @@ lp_build_sample_mipmap(struct lp_build_sample_context *bld,
    LLVMValueRef mipoff1 = NULL;
    LLVMValueRef colors0;
    LLVMValueRef colors1;
-   boolean use_floats = util_cpu_caps.has_avx &&
-                        !util_cpu_caps.has_avx2 &&
-                        bld->coord_type.length > 4;
+   /* The integer coord paths step offsets by the row stride, which only
+    * works for linear layouts.
+    */
+   boolean use_floats = (util_cpu_caps.has_avx &&
+                         !util_cpu_caps.has_avx2 &&
+                         bld->coord_type.length > 4) ||
+                        bld->static_texture_state->tiled;
 
    /* sample the first mipmap level */
    lp_build_mipmap_level_sizes(bld, ilevel0,
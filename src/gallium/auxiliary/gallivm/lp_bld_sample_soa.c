@@ -139,6 +139,7 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, y_stride, z_stride,
                           &offset, &i, &j);
    if (mipoffsets) {
@@ -2394,6 +2395,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
 
    lp_build_sample_offset(int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
@@ -3641,3 +3643,167 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                                         num_levels);
    }
 }
+
+
+/**
+ * Build the code of a shader image load, store or atomic operation.
+ *
+ * Images have a single level and are accessed at integer coordinates.
+ * Out of bounds loads return zero, out of bounds stores and atomics are
+ * discarded.
+ */
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned target = params->target;
+   const unsigned image_index = params->image_index;
+   LLVMValueRef context_ptr = params->context_ptr;
+   const struct util_format_description *format_desc;
+   struct lp_build_context int_bld;
+   struct lp_type texel_type;
+   LLVMValueRef x = params->coords[0];
+   LLVMValueRef y = NULL, z = NULL;
+   LLVMValueRef size, row_stride = NULL, img_stride = NULL;
+   LLVMValueRef base_ptr, offset, i, j, out_of_bounds, exec_mask;
+   unsigned chan;
+
+   lp_build_context_init(&int_bld, gallivm, lp_int_type(params->type));
+
+   if (static_texture_state->format == PIPE_FORMAT_NONE) {
+      /* Nothing bound: loads return zero, stores do nothing */
+      if (params->img_op != LP_IMG_STORE) {
+         for (chan = 0; chan < 4; chan++) {
+            params->outdata[chan] = lp_build_zero(gallivm, params->type);
+         }
+      }
+      return;
+   }
+
+   format_desc = util_format_description(static_texture_state->format);
+
+   /* The layer of 1D arrays is the second coordinate */
+   if (target == PIPE_TEXTURE_1D_ARRAY) {
+      z = params->coords[1];
+   }
+   else if (target != PIPE_BUFFER && target != PIPE_TEXTURE_1D) {
+      y = params->coords[1];
+      if (target != PIPE_TEXTURE_2D && target != PIPE_TEXTURE_RECT) {
+         z = params->coords[2];
+      }
+   }
+
+   size = dynamic_state->width(dynamic_state, gallivm,
+                               context_ptr, image_index);
+   size = lp_build_broadcast_scalar(&int_bld, size);
+   out_of_bounds = lp_build_cmp(&int_bld, PIPE_FUNC_LESS, x, int_bld.zero);
+   out_of_bounds = lp_build_or(&int_bld, out_of_bounds,
+                               lp_build_cmp(&int_bld, PIPE_FUNC_GEQUAL,
+                                            x, size));
+
+   if (y) {
+      size = dynamic_state->height(dynamic_state, gallivm,
+                                   context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_bld, size);
+      out_of_bounds = lp_build_or(&int_bld, out_of_bounds,
+                                  lp_build_cmp(&int_bld, PIPE_FUNC_LESS,
+                                               y, int_bld.zero));
+      out_of_bounds = lp_build_or(&int_bld, out_of_bounds,
+                                  lp_build_cmp(&int_bld, PIPE_FUNC_GEQUAL,
+                                               y, size));
+      row_stride = dynamic_state->row_stride(dynamic_state, gallivm,
+                                             context_ptr, image_index);
+      row_stride = lp_build_broadcast_scalar(&int_bld, row_stride);
+   }
+
+   if (z) {
+      size = dynamic_state->depth(dynamic_state, gallivm,
+                                  context_ptr, image_index);
+      size = lp_build_broadcast_scalar(&int_bld, size);
+      out_of_bounds = lp_build_or(&int_bld, out_of_bounds,
+                                  lp_build_cmp(&int_bld, PIPE_FUNC_LESS,
+                                               z, int_bld.zero));
+      out_of_bounds = lp_build_or(&int_bld, out_of_bounds,
+                                  lp_build_cmp(&int_bld, PIPE_FUNC_GEQUAL,
+                                               z, size));
+      img_stride = dynamic_state->img_stride(dynamic_state, gallivm,
+                                             context_ptr, image_index);
+      img_stride = lp_build_broadcast_scalar(&int_bld, img_stride);
+   }
+
+   base_ptr = dynamic_state->base_ptr(dynamic_state, gallivm,
+                                      context_ptr, image_index);
+
+   lp_build_sample_offset(&int_bld, format_desc,
+                          static_texture_state->tiled,
+                          x, y, z, row_stride, img_stride,
+                          &offset, &i, &j);
+   offset = lp_build_andnot(&int_bld, offset, out_of_bounds);
+
+   exec_mask = LLVMBuildBitCast(builder, params->exec_mask,
+                                int_bld.vec_type, "");
+   exec_mask = lp_build_andnot(&int_bld, exec_mask, out_of_bounds);
+
+   switch (params->img_op) {
+   case LP_IMG_LOAD:
+      texel_type = params->type;
+      if (format_desc->channel[0].pure_integer) {
+         if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED) {
+            texel_type = lp_int_type(params->type);
+         }
+         else {
+            texel_type = lp_uint_type(params->type);
+         }
+      }
+
+      lp_build_fetch_rgba_soa(gallivm, format_desc, texel_type, TRUE,
+                              base_ptr, offset, i, j, NULL,
+                              params->outdata);
+
+      for (chan = 0; chan < 4; chan++) {
+         LLVMValueRef texel = LLVMBuildBitCast(builder, params->outdata[chan],
+                                               int_bld.vec_type, "");
+         texel = lp_build_andnot(&int_bld, texel, out_of_bounds);
+         params->outdata[chan] =
+            LLVMBuildBitCast(builder, texel,
+                             lp_build_vec_type(gallivm, params->type), "");
+      }
+      break;
+
+   case LP_IMG_STORE:
+      lp_build_store_rgba_soa(gallivm, format_desc, params->type, exec_mask,
+                              base_ptr, offset, params->indata);
+      break;
+
+   case LP_IMG_ATOMIC:
+   case LP_IMG_ATOMIC_CAS:
+   {
+      /* Only the 32 bit single channel formats support atomics */
+      LLVMValueRef value, cmp = NULL, res;
+
+      assert(format_desc->block.bits == 32 && format_desc->nr_channels == 1);
+
+      value = LLVMBuildBitCast(builder, params->indata[0],
+                               int_bld.vec_type, "");
+      if (params->img_op == LP_IMG_ATOMIC_CAS) {
+         cmp = value;
+         value = LLVMBuildBitCast(builder, params->indata2[0],
+                                  int_bld.vec_type, "");
+      }
+
+      res = lp_build_atomic_masked(gallivm, int_bld.type, params->op,
+                                   base_ptr, offset, value, cmp, exec_mask);
+
+      params->outdata[0] =
+         LLVMBuildBitCast(builder, res,
+                          lp_build_vec_type(gallivm, params->type), "");
+      for (chan = 1; chan < 4; chan++) {
+         params->outdata[chan] = lp_build_zero(gallivm, params->type);
+      }
+      break;
+   }
+   }
+}
@@ -38,6 +38,7 @@
 #define LP_BLD_TGSI_H
 
 #include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_flow.h"
 #include "gallivm/lp_bld_tgsi_action.h"
 #include "gallivm/lp_bld_limits.h"
 #include "gallivm/lp_bld_sample.h"
@@ -67,6 +68,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +172,10 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   LLVMValueRef thread_id[3];   /**< vectors */
+   LLVMValueRef block_id[3];    /**< scalars */
+   LLVMValueRef grid_size[3];   /**< scalars */
+   LLVMValueRef block_size[3];  /**< scalars */
 };
 
 
@@ -198,6 +204,29 @@ struct lp_build_sampler_soa
 };
 
 
+/**
+ * Shader image code generation interface.
+ *
+ * The image counterpart of lp_build_sampler_soa, used for the LOAD, STORE,
+ * RESQ and ATOM* opcodes on TGSI_FILE_IMAGE.
+ */
+struct lp_build_image_soa
+{
+   void
+   (*destroy)( struct lp_build_image_soa *image );
+
+   void
+   (*emit_op)(const struct lp_build_image_soa *image,
+              struct gallivm_state *gallivm,
+              const struct lp_img_params *params);
+
+   void
+   (*emit_size_query)( const struct lp_build_image_soa *image,
+                       struct gallivm_state *gallivm,
+                       const struct lp_sampler_size_query_params *params);
+};
+
+
 struct lp_build_sampler_aos
 {
    LLVMValueRef
@@ -230,7 +259,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
 
 
 void
@@ -397,6 +427,11 @@ struct lp_build_tgsi_context
      */
    void (*emit_prologue)(struct lp_build_tgsi_context*);
 
+   /** Like emit_prologue, but called once the declarations have been
+     * emitted.  Optional.
+     */
+   void (*emit_prologue_post_decl)(struct lp_build_tgsi_context*);
+
    /** This function allows the user to insert some instructions at the end of
      * the program.  This callback is intended to be used for emitting
      * instructions to handle the export for the output registers, but it can
@@ -429,6 +464,46 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Compute shader interface: resources which only exist in compute shaders.
+ *
+ * All the memory accesses are emitted by the TGSI translator itself, the
+ * callbacks only need to locate the memory.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   /** Shader image code generator, may be NULL if no images are used */
+   const struct lp_build_image_soa *image;
+
+   /**
+    * Return a pointer (i8 *) to the shader buffer of (scalar int32) index
+    * \p index and its size in bytes in \p size.  Unbound buffers must
+    * report a zero size but still point to some readable memory.
+    */
+   LLVMValueRef (*fetch_ssbo)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                              struct lp_build_tgsi_context * bld_base,
+                              LLVMValueRef index,
+                              LLVMValueRef *size);
+   /**
+    * Return a pointer (i8 *) to the shared memory of the work group and its
+    * size in bytes in \p size.
+    */
+   LLVMValueRef (*fetch_shared)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                struct lp_build_tgsi_context * bld_base,
+                                LLVMValueRef *size);
+   /**
+    * Return a pointer (i8 *) to the scratch memory holding the temporaries
+    * of the whole work group, see lp_build_tgsi_cs_scratch_size().
+    * Only called for shaders with barriers.
+    */
+   LLVMValueRef (*fetch_scratch)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                                 struct lp_build_tgsi_context * bld_base);
+};
+
+unsigned
+lp_build_tgsi_cs_scratch_size(const struct tgsi_shader_info *info,
+                              struct lp_type type);
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -442,6 +517,13 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+   /* Loop over the SIMD vectors of the work group, restarted at barriers */
+   struct lp_build_loop_state cs_loop;
+   struct lp_build_mask_context cs_mask;
+   LLVMValueRef cs_num_vectors;
+   LLVMValueRef cs_scratch;
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
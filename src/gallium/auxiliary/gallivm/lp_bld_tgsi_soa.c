@@ -1690,6 +1690,36 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_id[swizzle]) :
+            bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.grid_size[swizzle]) :
+            bld_base->uint_bld.one;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = swizzle < 3 ?
+            lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                      bld->system_values.block_size[swizzle]) :
+            bld_base->uint_bld.one;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -3755,12 +3785,560 @@ cont_emit(
    lp_exec_continue(&bld->exec_mask);
 }
 
+/*
+ * Compute shaders.
+ *
+ * A compute shader function runs a whole work group, one SIMD vector of
+ * invocations at a time, each lane being an invocation.  Barriers split the
+ * shader into regions, each of them being a loop over all the vectors of the
+ * work group, so that all the invocations complete a region before any of
+ * them starts the next one.  Temporaries then live in per-vector scratch
+ * memory instead of allocas; address and predicate registers must not be
+ * live across barriers.
+ *
+ * Barriers are only honored outside of flow control (which is where GLSL
+ * allows them anyway), elsewhere they only act as memory barriers.
+ */
+
+static boolean
+cs_has_barriers(const struct lp_build_tgsi_soa_context *bld)
+{
+   return bld->cs_iface &&
+          bld->bld_base.info->opcode_count[TGSI_OPCODE_BARRIER] > 0;
+}
+
+
+/**
+ * Size in bytes of the scratch memory needed for each SIMD vector of
+ * invocations of a compute shader, zero if it doesn't need any.
+ */
+unsigned
+lp_build_tgsi_cs_scratch_size(const struct tgsi_shader_info *info,
+                              struct lp_type type)
+{
+   if (!info->opcode_count[TGSI_OPCODE_BARRIER])
+      return 0;
+
+   return (info->file_max[TGSI_FILE_TEMPORARY] + 1) * TGSI_NUM_CHANNELS *
+          type.length * type.width / 8;
+}
+
+
+static void
+cs_region_begin(struct lp_build_tgsi_soa_context *bld)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   const struct lp_type type = bld->bld_base.base.type;
+   LLVMValueRef *block_size = bld->system_values.block_size;
+   LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef invocation, num_invocations, width, height, tmp;
+   unsigned i;
+
+   lp_build_loop_begin(&bld->cs_loop, gallivm,
+                       lp_build_const_int32(gallivm, 0));
+
+   /* Flattened index of the invocation of each lane */
+   for (i = 0; i < type.length; i++) {
+      lanes[i] = lp_build_const_int32(gallivm, i);
+   }
+   tmp = LLVMBuildMul(builder, bld->cs_loop.counter,
+                      lp_build_const_int32(gallivm, type.length), "");
+   invocation = LLVMBuildAdd(builder,
+                             lp_build_broadcast_scalar(uint_bld, tmp),
+                             LLVMConstVector(lanes, type.length), "");
+
+   width = lp_build_broadcast_scalar(uint_bld, block_size[0]);
+   height = lp_build_broadcast_scalar(uint_bld, block_size[1]);
+   bld->system_values.thread_id[0] =
+      LLVMBuildURem(builder, invocation, width, "");
+   tmp = LLVMBuildUDiv(builder, invocation, width, "");
+   bld->system_values.thread_id[1] = LLVMBuildURem(builder, tmp, height, "");
+   bld->system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, height, "");
+
+   /* The last vector may be partially filled */
+   num_invocations = LLVMBuildMul(builder, block_size[0], block_size[1], "");
+   num_invocations = LLVMBuildMul(builder, num_invocations, block_size[2], "");
+   num_invocations = lp_build_broadcast_scalar(uint_bld, num_invocations);
+   lp_build_mask_begin(&bld->cs_mask, gallivm, type,
+                       lp_build_cmp(uint_bld, PIPE_FUNC_LESS,
+                                    invocation, num_invocations));
+
+   if (bld->cs_scratch) {
+      LLVMValueRef offset =
+         lp_build_const_int32(gallivm,
+               (bld->bld_base.info->file_max[TGSI_FILE_TEMPORARY] + 1) * 4);
+      offset = LLVMBuildMul(builder, bld->cs_loop.counter, offset, "");
+      bld->temps_array = LLVMBuildGEP(builder, bld->cs_scratch,
+                                      &offset, 1, "temp_array");
+   }
+}
+
+
+static void
+cs_region_end(struct lp_build_tgsi_soa_context *bld)
+{
+   lp_build_mask_end(&bld->cs_mask);
+   lp_build_loop_end_cond(&bld->cs_loop, bld->cs_num_vectors, NULL,
+                          LLVMIntUGE);
+}
+
+
+static void
+emit_prologue_post_decl(struct lp_build_tgsi_context * bld_base)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state * gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const LLVMValueRef *block_size = bld->system_values.block_size;
+   LLVMValueRef tmp;
+
+   if (!bld->cs_iface)
+      return;
+
+   /* number of SIMD vectors in the work group, rounding up */
+   tmp = LLVMBuildMul(builder, block_size[0], block_size[1], "");
+   tmp = LLVMBuildMul(builder, tmp, block_size[2], "");
+   tmp = LLVMBuildAdd(builder, tmp,
+                      lp_build_const_int32(gallivm,
+                                           bld_base->base.type.length - 1), "");
+   bld->cs_num_vectors =
+      LLVMBuildUDiv(builder, tmp,
+                    lp_build_const_int32(gallivm,
+                                         bld_base->base.type.length), "");
+
+   if (cs_has_barriers(bld)) {
+      tmp = bld->cs_iface->fetch_scratch(bld->cs_iface, bld_base);
+      bld->cs_scratch =
+         LLVMBuildBitCast(builder, tmp,
+                          LLVMPointerType(bld_base->base.vec_type, 0), "");
+   }
+
+   cs_region_begin(bld);
+}
+
+
+static void
+emit_memory_fence(struct gallivm_state *gallivm)
+{
+#if HAVE_LLVM >= 0x0309
+   LLVMBuildFence(gallivm->builder, LLVMAtomicOrderingSequentiallyConsistent,
+                  FALSE, "");
+#endif
+}
+
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct lp_exec_mask *mask = &bld->exec_mask;
+   struct function_ctx *ctx = func_ctx(mask);
+
+   emit_memory_fence(bld_base->base.gallivm);
+
+   if (ctx->cond_stack_size || ctx->loop_stack_size ||
+       ctx->switch_stack_size || mask->function_stack_size > 1) {
+      _debug_printf("warning: barrier within flow control is only "
+                    "a memory barrier\n");
+      return;
+   }
+
+   cs_region_end(bld);
+
+   /* GLSL doesn't allow barriers after a return from main */
+   mask->ret_in_main = FALSE;
+   mask->ret_mask = LLVMConstAllOnes(mask->int_vec_type);
+   lp_exec_mask_update(mask);
+
+   cs_region_begin(bld);
+}
+
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   emit_memory_fence(bld_base->base.gallivm);
+}
+
+
+/**
+ * Return the base pointer (i8 *) and the size in bytes of the shader buffer
+ * or the shared memory accessed by a memory instruction.
+ */
+static LLVMValueRef
+get_memory_ptr(struct lp_build_tgsi_soa_context *bld,
+               unsigned file, unsigned index,
+               const struct tgsi_ind_register *indirect_reg,
+               LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMValueRef buffer_index;
+
+   if (file == TGSI_FILE_MEMORY) {
+      return bld->cs_iface->fetch_shared(bld->cs_iface, &bld->bld_base, size);
+   }
+
+   assert(file == TGSI_FILE_BUFFER);
+   if (indirect_reg) {
+      /* the index must be dynamically uniform, so use the first lane */
+      buffer_index = get_indirect_index(bld, file, index, indirect_reg);
+      buffer_index = LLVMBuildExtractElement(gallivm->builder, buffer_index,
+                                             lp_build_const_int32(gallivm, 0),
+                                             "");
+   }
+   else {
+      buffer_index = lp_build_const_int32(gallivm, index);
+   }
+
+   return bld->cs_iface->fetch_ssbo(bld->cs_iface, &bld->bld_base,
+                                    buffer_index, size);
+}
+
+
+/**
+ * Return the mask of the lanes for which the 32 bit word at byte offset
+ * offset + 4 * chan is outside of a memory of the given size.
+ */
+static LLVMValueRef
+memory_overflow_mask(struct lp_build_tgsi_soa_context *bld,
+                     LLVMValueRef offset,
+                     unsigned chan,
+                     LLVMValueRef size)
+{
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   struct gallivm_state *gallivm = uint_bld->gallivm;
+   LLVMValueRef size_vec = lp_build_broadcast_scalar(uint_bld, size);
+   LLVMValueRef end, overflow;
+
+   end = lp_build_add(uint_bld, offset,
+                      lp_build_const_int_vec(gallivm, uint_bld->type,
+                                             chan * 4 + 4));
+   overflow = lp_build_cmp(uint_bld, PIPE_FUNC_GEQUAL, offset, size_vec);
+   return lp_build_or(uint_bld, overflow,
+                      lp_build_cmp(uint_bld, PIPE_FUNC_GREATER, end, size_vec));
+}
+
+
+static unsigned
+image_coord_count(unsigned tgsi_target)
+{
+   switch (tgsi_target) {
+   case TGSI_TEXTURE_BUFFER:
+   case TGSI_TEXTURE_1D:
+      return 1;
+   case TGSI_TEXTURE_2D:
+   case TGSI_TEXTURE_RECT:
+   case TGSI_TEXTURE_1D_ARRAY:
+      return 2;
+   default:
+      return 3;
+   }
+}
+
+
+static void
+emit_image_op(struct lp_build_tgsi_soa_context *bld,
+              const struct tgsi_full_instruction *inst,
+              enum lp_img_op img_op,
+              LLVMValueRef *outdata)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   const unsigned coord_src = img_op == LP_IMG_STORE ? 0 : 1;
+   struct lp_img_params params;
+   LLVMValueRef coords[3];
+   unsigned i;
+
+   if (!bld->cs_iface->image) {
+      _debug_printf("warning: found image instruction but no image generator supplied\n");
+      for (i = 0; i < 4; i++)
+         outdata[i] = bld_base->base.undef;
+      return;
+   }
+
+   for (i = 0; i < 3; i++) {
+      if (i < image_coord_count(inst->Memory.Texture)) {
+         coords[i] = lp_build_emit_fetch(bld_base, inst, coord_src, i);
+         coords[i] = LLVMBuildBitCast(builder, coords[i],
+                                      bld_base->int_bld.vec_type, "");
+      }
+      else {
+         coords[i] = bld_base->int_bld.zero;
+      }
+   }
+
+   memset(&params, 0, sizeof params);
+   params.type = bld_base->base.type;
+   params.image_index = img_op == LP_IMG_STORE ?
+                        inst->Dst[0].Register.Index :
+                        inst->Src[0].Register.Index;
+   params.img_op = img_op;
+   params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+   params.exec_mask = mask_vec(bld_base);
+   params.context_ptr = bld->context_ptr;
+   params.coords = coords;
+   params.outdata = outdata;
+
+   if (img_op == LP_IMG_STORE) {
+      for (i = 0; i < 4; i++)
+         params.indata[i] = lp_build_emit_fetch(bld_base, inst, 1, i);
+   }
+   else if (img_op != LP_IMG_LOAD) {
+      for (i = 0; i < 4; i++)
+         params.indata[i] = lp_build_emit_fetch(bld_base, inst, 2, i);
+      if (img_op == LP_IMG_ATOMIC_CAS) {
+         for (i = 0; i < 4; i++)
+            params.indata2[i] = lp_build_emit_fetch(bld_base, inst, 3, i);
+      }
+   }
+
+   bld->cs_iface->image->emit_op(bld->cs_iface->image,
+                                 bld_base->base.gallivm,
+                                 &params);
+}
+
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *reg = &inst->Src[0];
+   LLVMValueRef base_ptr, size, offset, exec_mask;
+   unsigned chan;
+
+   if (reg->Register.File == TGSI_FILE_IMAGE) {
+      emit_image_op(bld, inst, LP_IMG_LOAD, emit_data->output);
+      return;
+   }
+
+   base_ptr = get_memory_ptr(bld, reg->Register.File, reg->Register.Index,
+                             reg->Register.Indirect ? &reg->Indirect : NULL,
+                             &size);
+   base_ptr = LLVMBuildBitCast(builder, base_ptr,
+                               LLVMPointerType(bld_base->base.elem_type, 0),
+                               "");
+   offset = lp_build_emit_fetch(bld_base, inst, 1, TGSI_CHAN_X);
+   offset = LLVMBuildBitCast(builder, offset, bld_base->uint_bld.vec_type, "");
+   exec_mask = mask_vec(bld_base);
+
+   /* Out of bounds and disabled lanes return zero without touching memory */
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef overflow, index;
+
+      overflow = memory_overflow_mask(bld, offset, chan, size);
+      overflow = lp_build_or(&bld_base->uint_bld, overflow,
+                             lp_build_not(&bld_base->uint_bld, exec_mask));
+      index = lp_build_shr_imm(&bld_base->uint_bld, offset, 2);
+      index = lp_build_add(&bld_base->uint_bld, index,
+                           lp_build_const_int_vec(bld_base->base.gallivm,
+                                                  bld_base->uint_bld.type,
+                                                  chan));
+      emit_data->output[chan] = build_gather(bld_base, base_ptr, index,
+                                             overflow, NULL);
+   }
+}
+
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_dst_register *reg = &inst->Dst[0];
+   LLVMValueRef base_ptr, size, offset, exec_mask;
+   unsigned chan;
+
+   if (reg->Register.File == TGSI_FILE_IMAGE) {
+      emit_image_op(bld, inst, LP_IMG_STORE, emit_data->output);
+      return;
+   }
+
+   base_ptr = get_memory_ptr(bld, reg->Register.File, reg->Register.Index,
+                             reg->Register.Indirect ? &reg->Indirect : NULL,
+                             &size);
+   offset = lp_build_emit_fetch(bld_base, inst, 0, TGSI_CHAN_X);
+   offset = LLVMBuildBitCast(builder, offset, bld_base->uint_bld.vec_type, "");
+   exec_mask = mask_vec(bld_base);
+
+   TGSI_FOR_EACH_DST0_ENABLED_CHANNEL(inst, chan) {
+      LLVMValueRef value, store_mask, chan_offset;
+
+      value = lp_build_emit_fetch(bld_base, inst, 1, chan);
+      value = LLVMBuildBitCast(builder, value, bld_base->uint_bld.vec_type, "");
+      store_mask = lp_build_andnot(&bld_base->uint_bld, exec_mask,
+                                   memory_overflow_mask(bld, offset, chan,
+                                                        size));
+      chan_offset = lp_build_add(&bld_base->uint_bld, offset,
+                                 lp_build_const_int_vec(gallivm,
+                                                        bld_base->uint_bld.type,
+                                                        chan * 4));
+      lp_build_scatter_masked(gallivm, bld_base->base.type.length, base_ptr,
+                              chan_offset, value, store_mask);
+   }
+}
+
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *reg = &inst->Src[0];
+   unsigned chan;
+
+   if (reg->Register.File == TGSI_FILE_IMAGE) {
+      struct lp_sampler_size_query_params params;
+      LLVMValueRef sizes[4];
+
+      if (!bld->cs_iface->image) {
+         for (chan = 0; chan < 4; chan++)
+            emit_data->output[chan] = bld_base->base.undef;
+         return;
+      }
+
+      memset(&params, 0, sizeof params);
+      params.int_type = bld_base->int_bld.type;
+      params.texture_unit = reg->Register.Index;
+      params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+      params.context_ptr = bld->context_ptr;
+      params.is_sviewinfo = TRUE;
+      params.lod_property = LP_SAMPLER_LOD_SCALAR;
+      params.sizes_out = sizes;
+      bld->cs_iface->image->emit_size_query(bld->cs_iface->image,
+                                            bld_base->base.gallivm,
+                                            &params);
+      for (chan = 0; chan < 4; chan++)
+         emit_data->output[chan] = LLVMBuildBitCast(builder, sizes[chan],
+                                                    bld_base->base.vec_type,
+                                                    "");
+   }
+   else {
+      LLVMValueRef size;
+
+      get_memory_ptr(bld, reg->Register.File, reg->Register.Index,
+                     reg->Register.Indirect ? &reg->Indirect : NULL, &size);
+      size = lp_build_broadcast_scalar(&bld_base->uint_bld, size);
+      emit_data->output[TGSI_CHAN_X] =
+         LLVMBuildBitCast(builder, size, bld_base->base.vec_type, "");
+      for (chan = 1; chan < 4; chan++)
+         emit_data->output[chan] = bld_base->base.zero;
+   }
+}
+
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *reg = &inst->Src[0];
+   const boolean is_cas = inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS;
+   LLVMAtomicRMWBinOp op;
+   LLVMValueRef base_ptr, size, offset, value, cmp, atomic_mask, res;
+   unsigned chan;
+
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      op = LLVMAtomicRMWBinOpAdd;
+      break;
+   case TGSI_OPCODE_ATOMXCHG:
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   case TGSI_OPCODE_ATOMAND:
+      op = LLVMAtomicRMWBinOpAnd;
+      break;
+   case TGSI_OPCODE_ATOMOR:
+      op = LLVMAtomicRMWBinOpOr;
+      break;
+   case TGSI_OPCODE_ATOMXOR:
+      op = LLVMAtomicRMWBinOpXor;
+      break;
+   case TGSI_OPCODE_ATOMUMIN:
+      op = LLVMAtomicRMWBinOpUMin;
+      break;
+   case TGSI_OPCODE_ATOMUMAX:
+      op = LLVMAtomicRMWBinOpUMax;
+      break;
+   case TGSI_OPCODE_ATOMIMIN:
+      op = LLVMAtomicRMWBinOpMin;
+      break;
+   case TGSI_OPCODE_ATOMIMAX:
+      op = LLVMAtomicRMWBinOpMax;
+      break;
+   default:
+      /* compare-and-swap, op is unused */
+      assert(is_cas);
+      op = LLVMAtomicRMWBinOpXchg;
+      break;
+   }
+
+   if (reg->Register.File == TGSI_FILE_IMAGE) {
+      emit_image_op(bld, inst, is_cas ? LP_IMG_ATOMIC_CAS : LP_IMG_ATOMIC,
+                    emit_data->output);
+      return;
+   }
+
+   base_ptr = get_memory_ptr(bld, reg->Register.File, reg->Register.Index,
+                             reg->Register.Indirect ? &reg->Indirect : NULL,
+                             &size);
+   offset = lp_build_emit_fetch(bld_base, inst, 1, TGSI_CHAN_X);
+   offset = LLVMBuildBitCast(builder, offset, bld_base->uint_bld.vec_type, "");
+
+   value = lp_build_emit_fetch(bld_base, inst, 2, TGSI_CHAN_X);
+   value = LLVMBuildBitCast(builder, value, bld_base->uint_bld.vec_type, "");
+   cmp = NULL;
+   if (is_cas) {
+      /* Src[2] is the comparand, Src[3] the new value */
+      cmp = value;
+      value = lp_build_emit_fetch(bld_base, inst, 3, TGSI_CHAN_X);
+      value = LLVMBuildBitCast(builder, value, bld_base->uint_bld.vec_type, "");
+   }
+
+   atomic_mask = lp_build_andnot(&bld_base->uint_bld, mask_vec(bld_base),
+                                 memory_overflow_mask(bld, offset, 0, size));
+
+   res = lp_build_atomic_masked(gallivm, bld_base->uint_bld.type, op,
+                                base_ptr, offset, value, cmp, atomic_mask);
+   res = LLVMBuildBitCast(builder, res, bld_base->base.vec_type, "");
+   for (chan = 0; chan < 4; chan++)
+      emit_data->output[chan] = res;
+}
+
 static void emit_prologue(struct lp_build_tgsi_context * bld_base)
 {
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    struct gallivm_state * gallivm = bld_base->base.gallivm;
 
-   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY)) {
+   /* with barriers temporaries live in the compute shader scratch memory */
+   if (bld->indirect_files & (1 << TGSI_FILE_TEMPORARY) &&
+       !cs_has_barriers(bld)) {
       LLVMValueRef array_size =
          lp_build_const_int32(gallivm,
                          bld_base->info->file_max[TGSI_FILE_TEMPORARY] * 4 + 4);
@@ -3851,6 +4429,10 @@ static void emit_epilogue(struct lp_build_tgsi_context * bld_base)
    struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
    LLVMBuilderRef builder = bld_base->base.gallivm->builder;
 
+   if (bld->cs_iface) {
+      cs_region_end(bld);
+   }
+
    if (DEBUG_EXECUTION) {
       /* for debugging */
       if (0) {
@@ -3898,7 +4480,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3978,6 +4561,7 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
    bld.bld_base.emit_immediate = lp_emit_immediate_soa;
 
    bld.bld_base.emit_prologue = emit_prologue;
+   bld.bld_base.emit_prologue_post_decl = emit_prologue_post_decl;
    bld.bld_base.emit_epilogue = emit_epilogue;
 
    /* Set opcode actions */
@@ -4051,6 +4635,32 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      /* the translator iterates over the invocations of the work group */
+      assert(!mask);
+      bld.cs_iface = cs_iface;
+      bld.mask = &bld.cs_mask;
+      if (cs_has_barriers(&bld)) {
+         bld.indirect_files |= (1 << TGSI_FILE_TEMPORARY);
+      }
+
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
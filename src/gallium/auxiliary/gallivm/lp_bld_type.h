@@ -54,8 +54,15 @@ extern unsigned lp_native_vector_width;
  *
  * Should only be used when lp_native_vector_width isn't available,
  * i.e. sizing/alignment of non-malloced variables.
+ *
+ * 512-bit vectors are experimental, and only built in with
+ * --enable-gallivm-avx512.
  */
+#ifdef USE_GALLIVM_AVX512
+#define LP_MAX_VECTOR_WIDTH 512
+#else
 #define LP_MAX_VECTOR_WIDTH 256
+#endif
 
 /**
  * Minimum vector alignment for static variable alignment
@@ -63,7 +70,11 @@ extern unsigned lp_native_vector_width;
  * It should always be a constant equal to LP_MAX_VECTOR_WIDTH/8.  An
  * expression is non-portable.
  */
+#ifdef USE_GALLIVM_AVX512
+#define LP_MIN_VECTOR_ALIGN 64
+#else
 #define LP_MIN_VECTOR_ALIGN 32
+#endif
 
 /**
  * Several functions can only cope with vectors of length up to this value.
@@ -97,6 +97,62 @@ static inline void pipe_thread_setname( const char *name )
 }
 
 
+/**
+ * Restrict the calling thread to the CPUs set in the given mask, where
+ * bit i of mask[j] stands for CPU 32 * j + i.
+ * Returns FALSE if this failed or isn't supported on this platform.
+ */
+static inline boolean pipe_thread_set_affinity( const uint32_t *mask,
+                                                unsigned num_words )
+{
+#if defined(HAVE_PTHREAD) && defined(__GLIBC__) && defined(CPU_SET)
+   cpu_set_t cpuset;
+   unsigned i;
+
+   CPU_ZERO(&cpuset);
+   for (i = 0; i < num_words * 32 && i < CPU_SETSIZE; i++) {
+      if (mask[i / 32] & (1u << (i % 32)))
+         CPU_SET(i, &cpuset);
+   }
+   return pthread_setaffinity_np(pthread_self(), sizeof cpuset, &cpuset) == 0;
+#else
+   (void)mask;
+   (void)num_words;
+   return FALSE;
+#endif
+}
+
+
+/**
+ * Get the CPUs the calling thread may run on, as restricted by e.g.
+ * taskset or cgroups, in the same format as pipe_thread_set_affinity().
+ * Returns FALSE if this failed or isn't supported on this platform.
+ */
+static inline boolean pipe_thread_get_affinity( uint32_t *mask,
+                                                unsigned num_words )
+{
+#if defined(HAVE_PTHREAD) && defined(__GLIBC__) && defined(CPU_SET)
+   cpu_set_t cpuset;
+   unsigned i;
+
+   if (sched_getaffinity(0, sizeof cpuset, &cpuset) != 0)
+      return FALSE;
+
+   for (i = 0; i < num_words; i++)
+      mask[i] = 0;
+   for (i = 0; i < num_words * 32 && i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &cpuset))
+         mask[i / 32] |= 1u << (i % 32);
+   }
+   return TRUE;
+#else
+   (void)mask;
+   (void)num_words;
+   return FALSE;
+#endif
+}
+
+
 static inline int pipe_thread_is_self( pipe_thread thread )
 {
 #if defined(HAVE_PTHREAD)
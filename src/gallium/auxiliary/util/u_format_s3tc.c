@@ -23,140 +23,19 @@
  *
  **************************************************************************/
 
-#include "u_dl.h"
 #include "u_math.h"
 #include "u_format.h"
 #include "u_format_s3tc.h"
 #include "util/format_srgb.h"
 
 
-#if defined(_WIN32) || defined(WIN32)
-#define DXTN_LIBNAME "dxtn.dll"
-#elif defined(__CYGWIN__)
-#define DXTN_LIBNAME "cygtxc_dxtn.dll"
-#elif defined(__APPLE__)
-#define DXTN_LIBNAME "libtxc_dxtn.dylib"
-#else
-#define DXTN_LIBNAME "libtxc_dxtn.so"
-#endif
-
-
-static void
-util_format_dxt1_rgb_fetch_stub(int src_stride,
-                                const uint8_t *src,
-                                int col, int row,
-                                uint8_t *dst)
-{
-   assert(0);
-}
-
-
-static void
-util_format_dxt1_rgba_fetch_stub(int src_stride,
-                                 const uint8_t *src,
-                                 int col, int row,
-                                 uint8_t *dst )
-{
-   assert(0);
-}
-
-
-static void
-util_format_dxt3_rgba_fetch_stub(int src_stride,
-                                 const uint8_t *src,
-                                 int col, int row,
-                                 uint8_t *dst )
-{
-   assert(0);
-}
-
-
-static void
-util_format_dxt5_rgba_fetch_stub(int src_stride,
-                                 const uint8_t *src,
-                                 int col, int row,
-                                 uint8_t *dst )
-{
-   assert(0);
-}
-
-
-static void
-util_format_dxtn_pack_stub(int src_comps,
-                           int width, int height,
-                           const uint8_t *src,
-                           enum util_format_dxtn dst_format,
-                           uint8_t *dst,
-                           int dst_stride)
-{
-   assert(0);
-}
-
-
-boolean util_format_s3tc_enabled = FALSE;
-
-util_format_dxtn_fetch_t util_format_dxt1_rgb_fetch = util_format_dxt1_rgb_fetch_stub;
-util_format_dxtn_fetch_t util_format_dxt1_rgba_fetch = util_format_dxt1_rgba_fetch_stub;
-util_format_dxtn_fetch_t util_format_dxt3_rgba_fetch = util_format_dxt3_rgba_fetch_stub;
-util_format_dxtn_fetch_t util_format_dxt5_rgba_fetch = util_format_dxt5_rgba_fetch_stub;
-
-util_format_dxtn_pack_t util_format_dxtn_pack = util_format_dxtn_pack_stub;
+/* The codec is built in, so DXTn formats are always available. */
+boolean util_format_s3tc_enabled = TRUE;
 
 
 void
 util_format_s3tc_init(void)
 {
-   static boolean first_time = TRUE;
-   struct util_dl_library *library = NULL;
-   util_dl_proc fetch_2d_texel_rgb_dxt1;
-   util_dl_proc fetch_2d_texel_rgba_dxt1;
-   util_dl_proc fetch_2d_texel_rgba_dxt3;
-   util_dl_proc fetch_2d_texel_rgba_dxt5;
-   util_dl_proc tx_compress_dxtn;
-
-   if (!first_time)
-      return;
-   first_time = FALSE;
-
-   if (util_format_s3tc_enabled)
-      return;
-
-   library = util_dl_open(DXTN_LIBNAME);
-   if (!library) {
-      debug_printf("couldn't open " DXTN_LIBNAME ", software DXTn "
-                   "compression/decompression unavailable\n");
-      return;
-   }
-
-   fetch_2d_texel_rgb_dxt1 =
-         util_dl_get_proc_address(library, "fetch_2d_texel_rgb_dxt1");
-   fetch_2d_texel_rgba_dxt1 =
-         util_dl_get_proc_address(library, "fetch_2d_texel_rgba_dxt1");
-   fetch_2d_texel_rgba_dxt3 =
-         util_dl_get_proc_address(library, "fetch_2d_texel_rgba_dxt3");
-   fetch_2d_texel_rgba_dxt5 =
-         util_dl_get_proc_address(library, "fetch_2d_texel_rgba_dxt5");
-   tx_compress_dxtn =
-         util_dl_get_proc_address(library, "tx_compress_dxtn");
-
-   if (!util_format_dxt1_rgb_fetch ||
-       !util_format_dxt1_rgba_fetch ||
-       !util_format_dxt3_rgba_fetch ||
-       !util_format_dxt5_rgba_fetch ||
-       !util_format_dxtn_pack) {
-      debug_printf("couldn't reference all symbols in " DXTN_LIBNAME
-                   ", software DXTn compression/decompression "
-                   "unavailable\n");
-      util_dl_close(library);
-      return;
-   }
-
-   util_format_dxt1_rgb_fetch = (util_format_dxtn_fetch_t)fetch_2d_texel_rgb_dxt1;
-   util_format_dxt1_rgba_fetch = (util_format_dxtn_fetch_t)fetch_2d_texel_rgba_dxt1;
-   util_format_dxt3_rgba_fetch = (util_format_dxtn_fetch_t)fetch_2d_texel_rgba_dxt3;
-   util_format_dxt5_rgba_fetch = (util_format_dxtn_fetch_t)fetch_2d_texel_rgba_dxt5;
-   util_format_dxtn_pack = (util_format_dxtn_pack_t)tx_compress_dxtn;
-   util_format_s3tc_enabled = TRUE;
 }
 
 
@@ -167,32 +46,32 @@ util_format_s3tc_init(void)
 void
 util_format_dxt1_rgb_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
-   util_format_dxt1_rgb_fetch(0, src, i, j, dst);
+   util_format_fetch_texel_dxt1_rgb(0, src, i, j, dst);
 }
 
 void
 util_format_dxt1_rgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
-   util_format_dxt1_rgba_fetch(0, src, i, j, dst);
+   util_format_fetch_texel_dxt1_rgba(0, src, i, j, dst);
 }
 
 void
 util_format_dxt3_rgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
-   util_format_dxt3_rgba_fetch(0, src, i, j, dst);
+   util_format_fetch_texel_dxt3_rgba(0, src, i, j, dst);
 }
 
 void
 util_format_dxt5_rgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
-   util_format_dxt5_rgba_fetch(0, src, i, j, dst);
+   util_format_fetch_texel_dxt5_rgba(0, src, i, j, dst);
 }
 
 void
 util_format_dxt1_rgb_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgb_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgb(0, src, i, j, tmp);
    dst[0] = ubyte_to_float(tmp[0]);
    dst[1] = ubyte_to_float(tmp[1]);
    dst[2] = ubyte_to_float(tmp[2]);
@@ -203,7 +82,7 @@ void
 util_format_dxt1_rgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgba(0, src, i, j, tmp);
    dst[0] = ubyte_to_float(tmp[0]);
    dst[1] = ubyte_to_float(tmp[1]);
    dst[2] = ubyte_to_float(tmp[2]);
@@ -214,7 +93,7 @@ void
 util_format_dxt3_rgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt3_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt3_rgba(0, src, i, j, tmp);
    dst[0] = ubyte_to_float(tmp[0]);
    dst[1] = ubyte_to_float(tmp[1]);
    dst[2] = ubyte_to_float(tmp[2]);
@@ -225,7 +104,7 @@ void
 util_format_dxt5_rgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt5_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt5_rgba(0, src, i, j, tmp);
    dst[0] = ubyte_to_float(tmp[0]);
    dst[1] = ubyte_to_float(tmp[1]);
    dst[2] = ubyte_to_float(tmp[2]);
@@ -241,22 +120,36 @@ static inline void
 util_format_dxtn_rgb_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
                                         const uint8_t *src_row, unsigned src_stride,
                                         unsigned width, unsigned height,
-                                        util_format_dxtn_fetch_t fetch,
+                                        enum util_format_dxtn format,
                                         unsigned block_size, boolean srgb)
 {
    const unsigned bw = 4, bh = 4, comps = 4;
    unsigned x, y, i, j;
    for(y = 0; y < height; y += bh) {
       const uint8_t *src = src_row;
+      const unsigned h = MIN2(height - y, bh);
       for(x = 0; x < width; x += bw) {
-         for(j = 0; j < bh; ++j) {
-            for(i = 0; i < bw; ++i) {
-               uint8_t *dst = dst_row + (y + j)*dst_stride/sizeof(*dst_row) + (x + i)*comps;
-               fetch(0, src, i, j, dst);
-               if (srgb) {
-                  dst[0] = util_format_srgb_to_linear_8unorm(dst[0]);
-                  dst[1] = util_format_srgb_to_linear_8unorm(dst[1]);
-                  dst[2] = util_format_srgb_to_linear_8unorm(dst[2]);
+         uint8_t *dst = dst_row + y*dst_stride/sizeof(*dst_row) + x*comps;
+         const unsigned w = MIN2(width - x, bw);
+         if (w == bw && h == bh && !srgb) {
+            /* whole block, decode in place */
+            util_format_decode_block_dxtn(format, src, dst, dst_stride);
+         }
+         else {
+            uint8_t tmp[4][4][4];  /* [bh][bw][comps] */
+            util_format_decode_block_dxtn(format, src, &tmp[0][0][0], bw*comps);
+            for(j = 0; j < h; ++j) {
+               for(i = 0; i < w; ++i) {
+                  uint8_t *texel = dst + j*dst_stride/sizeof(*dst_row) + i*comps;
+                  if (srgb) {
+                     texel[0] = util_format_srgb_to_linear_8unorm(tmp[j][i][0]);
+                     texel[1] = util_format_srgb_to_linear_8unorm(tmp[j][i][1]);
+                     texel[2] = util_format_srgb_to_linear_8unorm(tmp[j][i][2]);
+                     texel[3] = tmp[j][i][3];
+                  }
+                  else {
+                     memcpy(texel, tmp[j][i], comps);
+                  }
                }
             }
          }
@@ -274,7 +167,7 @@ util_format_dxt1_rgb_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt1_rgb_fetch,
+                                           UTIL_FORMAT_DXT1_RGB,
                                            8, FALSE);
 }
 
@@ -286,7 +179,7 @@ util_format_dxt1_rgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt1_rgba_fetch,
+                                           UTIL_FORMAT_DXT1_RGBA,
                                            8, FALSE);
 }
 
@@ -298,7 +191,7 @@ util_format_dxt3_rgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt3_rgba_fetch,
+                                           UTIL_FORMAT_DXT3_RGBA,
                                            16, FALSE);
 }
 
@@ -310,7 +203,7 @@ util_format_dxt5_rgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt5_rgba_fetch,
+                                           UTIL_FORMAT_DXT5_RGBA,
                                            16, FALSE);
 }
 
@@ -318,29 +211,31 @@ static inline void
 util_format_dxtn_rgb_unpack_rgba_float(float *dst_row, unsigned dst_stride,
                                        const uint8_t *src_row, unsigned src_stride,
                                        unsigned width, unsigned height,
-                                       util_format_dxtn_fetch_t fetch,
+                                       enum util_format_dxtn format,
                                        unsigned block_size, boolean srgb)
 {
    unsigned x, y, i, j;
    for(y = 0; y < height; y += 4) {
       const uint8_t *src = src_row;
+      const unsigned h = MIN2(height - y, 4);
       for(x = 0; x < width; x += 4) {
-         for(j = 0; j < 4; ++j) {
-            for(i = 0; i < 4; ++i) {
+         const unsigned w = MIN2(width - x, 4);
+         uint8_t tmp[4][4][4];
+         util_format_decode_block_dxtn(format, src, &tmp[0][0][0], 16);
+         for(j = 0; j < h; ++j) {
+            for(i = 0; i < w; ++i) {
                float *dst = dst_row + (y + j)*dst_stride/sizeof(*dst_row) + (x + i)*4;
-               uint8_t tmp[4];
-               fetch(0, src, i, j, tmp);
                if (srgb) {
-                  dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[0]);
-                  dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[1]);
-                  dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[2]);
+                  dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[j][i][0]);
+                  dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[j][i][1]);
+                  dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[j][i][2]);
                }
                else {
-                  dst[0] = ubyte_to_float(tmp[0]);
-                  dst[1] = ubyte_to_float(tmp[1]);
-                  dst[2] = ubyte_to_float(tmp[2]);
+                  dst[0] = ubyte_to_float(tmp[j][i][0]);
+                  dst[1] = ubyte_to_float(tmp[j][i][1]);
+                  dst[2] = ubyte_to_float(tmp[j][i][2]);
                }
-               dst[3] = ubyte_to_float(tmp[3]);
+               dst[3] = ubyte_to_float(tmp[j][i][3]);
             }
          }
          src += block_size;
@@ -357,7 +252,7 @@ util_format_dxt1_rgb_unpack_rgba_float(float *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt1_rgb_fetch,
+                                          UTIL_FORMAT_DXT1_RGB,
                                           8, FALSE);
 }
 
@@ -369,7 +264,7 @@ util_format_dxt1_rgba_unpack_rgba_float(float *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt1_rgba_fetch,
+                                          UTIL_FORMAT_DXT1_RGBA,
                                           8, FALSE);
 }
 
@@ -381,7 +276,7 @@ util_format_dxt3_rgba_unpack_rgba_float(float *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt3_rgba_fetch,
+                                          UTIL_FORMAT_DXT3_RGBA,
                                           16, FALSE);
 }
 
@@ -393,7 +288,7 @@ util_format_dxt5_rgba_unpack_rgba_float(float *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt5_rgba_fetch,
+                                          UTIL_FORMAT_DXT5_RGBA,
                                           16, FALSE);
 }
 
@@ -414,30 +309,37 @@ util_format_dxtn_pack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    for(y = 0; y < height; y += bh) {
       uint8_t *dst = dst_row;
       for(x = 0; x < width; x += bw) {
-         uint8_t tmp[4][4][4];  /* [bh][bw][comps] */
-         for(j = 0; j < bh; ++j) {
-            for(i = 0; i < bw; ++i) {
-               uint8_t src_tmp;
-               for(k = 0; k < 3; ++k) {
-                  src_tmp = src[(y + j)*src_stride/sizeof(*src) + (x+i)*comps + k];
-                  if (srgb) {
-                     tmp[j][i][k] = util_format_linear_to_srgb_8unorm(src_tmp);
-                  }
-                  else {
-                     tmp[j][i][k] = src_tmp;
+         if (x + bw <= width && y + bh <= height && !srgb) {
+            /* whole block, encode in place */
+            util_format_encode_block_dxtn(format,
+                                          src + y*src_stride/sizeof(*src) + x*comps,
+                                          src_stride, dst);
+         }
+         else {
+            uint8_t tmp[4][4][4];  /* [bh][bw][comps] */
+            for(j = 0; j < bh; ++j) {
+               for(i = 0; i < bw; ++i) {
+                  /* replicate the last row and column into partial blocks */
+                  const uint8_t *texel = src + MIN2(y + j, height - 1)*src_stride/sizeof(*src) +
+                                         MIN2(x + i, width - 1)*comps;
+                  for(k = 0; k < 3; ++k) {
+                     if (srgb) {
+                        tmp[j][i][k] = util_format_linear_to_srgb_8unorm(texel[k]);
+                     }
+                     else {
+                        tmp[j][i][k] = texel[k];
+                     }
                   }
+                  /* for sake of simplicity there's an unneeded 4th component for dxt1_rgb */
+                  tmp[j][i][3] = texel[3];
                }
-               /* for sake of simplicity there's an unneeded 4th component for dxt1_rgb */
-               tmp[j][i][3] = src[(y + j)*src_stride/sizeof(*src) + (x+i)*comps + 3];
             }
+            util_format_encode_block_dxtn(format, &tmp[0][0][0], bw*comps, dst);
          }
-         /* even for dxt1_rgb have 4 src comps */
-         util_format_dxtn_pack(4, 4, 4, &tmp[0][0][0], format, dst, 0);
          dst += block_size;
       }
       dst_row += dst_stride / sizeof(*dst_row);
    }
-
 }
 
 void
@@ -494,25 +396,25 @@ util_format_dxtn_pack_rgba_float(uint8_t *dst_row, unsigned dst_stride,
          uint8_t tmp[4][4][4];
          for(j = 0; j < 4; ++j) {
             for(i = 0; i < 4; ++i) {
-               float src_tmp;
+               /* replicate the last row and column into partial blocks */
+               const float *texel = src + MIN2(y + j, height - 1)*src_stride/sizeof(*src) +
+                                    MIN2(x + i, width - 1)*4;
                for(k = 0; k < 3; ++k) {
-                  src_tmp = src[(y + j)*src_stride/sizeof(*src) + (x+i)*4 + k];
                   if (srgb) {
-                     tmp[j][i][k] = util_format_linear_float_to_srgb_8unorm(src_tmp);
+                     tmp[j][i][k] = util_format_linear_float_to_srgb_8unorm(texel[k]);
                   }
                   else {
-                     tmp[j][i][k] = float_to_ubyte(src_tmp);
+                     tmp[j][i][k] = float_to_ubyte(texel[k]);
                   }
                }
                /* for sake of simplicity there's an unneeded 4th component for dxt1_rgb */
-               src_tmp = src[(y + j)*src_stride/sizeof(*src) + (x+i)*4 + 3];
-               tmp[j][i][3] = float_to_ubyte(src_tmp);
+               tmp[j][i][3] = float_to_ubyte(texel[3]);
             }
          }
-         util_format_dxtn_pack(4, 4, 4, &tmp[0][0][0], format, dst, 0);
+         util_format_encode_block_dxtn(format, &tmp[0][0][0], 16, dst);
          dst += block_size;
       }
-      dst_row += 4*dst_stride/sizeof(*dst_row);
+      dst_row += dst_stride / sizeof(*dst_row);
    }
 }
 
@@ -565,7 +467,7 @@ void
 util_format_dxt1_srgb_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgb_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgb(0, src, i, j, tmp);
    dst[0] = util_format_srgb_to_linear_8unorm(tmp[0]);
    dst[1] = util_format_srgb_to_linear_8unorm(tmp[1]);
    dst[2] = util_format_srgb_to_linear_8unorm(tmp[2]);
@@ -576,7 +478,7 @@ void
 util_format_dxt1_srgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_to_linear_8unorm(tmp[0]);
    dst[1] = util_format_srgb_to_linear_8unorm(tmp[1]);
    dst[2] = util_format_srgb_to_linear_8unorm(tmp[2]);
@@ -587,7 +489,7 @@ void
 util_format_dxt3_srgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt3_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt3_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_to_linear_8unorm(tmp[0]);
    dst[1] = util_format_srgb_to_linear_8unorm(tmp[1]);
    dst[2] = util_format_srgb_to_linear_8unorm(tmp[2]);
@@ -598,7 +500,7 @@ void
 util_format_dxt5_srgba_fetch_rgba_8unorm(uint8_t *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt5_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt5_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_to_linear_8unorm(tmp[0]);
    dst[1] = util_format_srgb_to_linear_8unorm(tmp[1]);
    dst[2] = util_format_srgb_to_linear_8unorm(tmp[2]);
@@ -609,7 +511,7 @@ void
 util_format_dxt1_srgb_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgb_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgb(0, src, i, j, tmp);
    dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[0]);
    dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[1]);
    dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[2]);
@@ -620,7 +522,7 @@ void
 util_format_dxt1_srgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt1_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt1_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[0]);
    dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[1]);
    dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[2]);
@@ -631,7 +533,7 @@ void
 util_format_dxt3_srgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt3_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt3_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[0]);
    dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[1]);
    dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[2]);
@@ -642,7 +544,7 @@ void
 util_format_dxt5_srgba_fetch_rgba_float(float *dst, const uint8_t *src, unsigned i, unsigned j)
 {
    uint8_t tmp[4];
-   util_format_dxt5_rgba_fetch(0, src, i, j, tmp);
+   util_format_fetch_texel_dxt5_rgba(0, src, i, j, tmp);
    dst[0] = util_format_srgb_8unorm_to_linear_float(tmp[0]);
    dst[1] = util_format_srgb_8unorm_to_linear_float(tmp[1]);
    dst[2] = util_format_srgb_8unorm_to_linear_float(tmp[2]);
@@ -655,7 +557,7 @@ util_format_dxt1_srgb_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt1_rgb_fetch,
+                                           UTIL_FORMAT_DXT1_RGB,
                                            8, TRUE);
 }
 
@@ -665,7 +567,7 @@ util_format_dxt1_srgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt1_rgba_fetch,
+                                           UTIL_FORMAT_DXT1_RGBA,
                                            8, TRUE);
 }
 
@@ -675,7 +577,7 @@ util_format_dxt3_srgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt3_rgba_fetch,
+                                           UTIL_FORMAT_DXT3_RGBA,
                                            16, TRUE);
 }
 
@@ -685,7 +587,7 @@ util_format_dxt5_srgba_unpack_rgba_8unorm(uint8_t *dst_row, unsigned dst_stride,
    util_format_dxtn_rgb_unpack_rgba_8unorm(dst_row, dst_stride,
                                            src_row, src_stride,
                                            width, height,
-                                           util_format_dxt5_rgba_fetch,
+                                           UTIL_FORMAT_DXT5_RGBA,
                                            16, TRUE);
 }
 
@@ -695,7 +597,7 @@ util_format_dxt1_srgb_unpack_rgba_float(float *dst_row, unsigned dst_stride, con
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt1_rgb_fetch,
+                                          UTIL_FORMAT_DXT1_RGB,
                                           8, TRUE);
 }
 
@@ -705,7 +607,7 @@ util_format_dxt1_srgba_unpack_rgba_float(float *dst_row, unsigned dst_stride, co
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt1_rgba_fetch,
+                                          UTIL_FORMAT_DXT1_RGBA,
                                           8, TRUE);
 }
 
@@ -715,7 +617,7 @@ util_format_dxt3_srgba_unpack_rgba_float(float *dst_row, unsigned dst_stride, co
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt3_rgba_fetch,
+                                          UTIL_FORMAT_DXT3_RGBA,
                                           16, TRUE);
 }
 
@@ -725,7 +627,7 @@ util_format_dxt5_srgba_unpack_rgba_float(float *dst_row, unsigned dst_stride, co
    util_format_dxtn_rgb_unpack_rgba_float(dst_row, dst_stride,
                                           src_row, src_stride,
                                           width, height,
-                                          util_format_dxt5_rgba_fetch,
+                                          UTIL_FORMAT_DXT5_RGBA,
                                           16, TRUE);
 }
 
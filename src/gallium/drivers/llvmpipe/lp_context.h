@@ -48,6 +48,7 @@ struct draw_context;
 struct draw_stage;
 struct draw_vertex_shader;
 struct lp_fragment_shader;
+struct lp_compute_shader;
 struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
@@ -67,6 +68,7 @@ struct llvmpipe_context {
    const struct lp_geometry_shader *gs;
    const struct lp_velems_state *velems;
    const struct lp_so_state *so;
+   struct lp_compute_shader *cs;
 
    /** Other rendering state */
    unsigned sample_mask;
@@ -83,6 +85,10 @@ struct llvmpipe_context {
    struct pipe_vertex_buffer vertex_buffer[PIPE_MAX_ATTRIBS];
    struct pipe_index_buffer index_buffer;
 
+   /** Resources only compute shaders can access */
+   struct pipe_shader_buffer cs_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   struct pipe_image_view cs_images[LP_MAX_TGSI_SHADER_IMAGES];
+
    unsigned num_samplers[PIPE_SHADER_TYPES];
    unsigned num_sampler_views[PIPE_SHADER_TYPES];
 
@@ -144,6 +150,15 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Variant bound by the last llvmpipe_update_fs() */
+   struct lp_fragment_shader_variant *fs_variant;
+   /** Draws done while fs_variant still ran unoptimized code */
+   uint64_t nr_fs_fallback_draws;
+
+   /** Compute shader variants of all the shaders, see lp_state_cs.c */
+   unsigned nr_cs_variants;
+   unsigned nr_cs_instrs;
+
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
 
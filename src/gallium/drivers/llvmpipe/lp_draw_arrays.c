@@ -35,6 +35,7 @@
 #include "pipe/p_context.h"
 #include "util/u_draw.h"
 #include "util/u_prim.h"
+#include "util/u_atomic.h"
 
 #include "lp_context.h"
 #include "lp_state.h"
@@ -69,6 +70,9 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   if (lp->fs_variant && p_atomic_read(&lp->fs_variant->code->fallback))
+      lp->nr_fs_fallback_draws++;
+
    /*
     * Map vertex buffers
     */
@@ -61,7 +61,18 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Upper bound for the number of rasterizer threads.  The actual number is
+ * chosen at screen creation, and per-thread storage is sized from it.
+ */
+#define LP_MAX_THREADS 256
+
+
+/**
+ * Max number of scenes per setup context.  While the rasterizer threads
+ * work on one scene the setup module can bin the next ones.
+ */
+#define LP_MAX_SCENES 4
 
 
 /**
@@ -93,4 +104,10 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+/**
+ * Max number of variants of a single compute shader that will be kept
+ * around.  They only differ by the sampler and image state.
+ */
+#define LP_MAX_CS_VARIANTS 16
+
 #endif /* LP_LIMITS_H */
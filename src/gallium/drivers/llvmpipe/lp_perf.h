@@ -58,6 +58,7 @@ struct lp_counters
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_disk_cache_hits;
 
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
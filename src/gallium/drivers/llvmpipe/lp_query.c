@@ -48,19 +48,131 @@ static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
    return (struct llvmpipe_query *)p;
 }
 
+
+/**
+ * Decode a LP_QUERY_RAST_x query type.
+ * \param thread  returns the thread index, or -1 for all threads
+ */
+static boolean
+is_rast_time_query(unsigned type, boolean *idle, int *thread)
+{
+   switch (type) {
+   case LP_QUERY_RAST_BUSY_TIME:
+   case LP_QUERY_RAST_IDLE_TIME:
+      *idle = type == LP_QUERY_RAST_IDLE_TIME;
+      *thread = -1;
+      return TRUE;
+   default:
+      if (type >= LP_QUERY_RAST_THREAD_TIME &&
+          type < LP_QUERY_RAST_THREAD_TIME + 2 * LP_MAX_THREADS) {
+         *idle = (type - LP_QUERY_RAST_THREAD_TIME) & 1;
+         *thread = (type - LP_QUERY_RAST_THREAD_TIME) / 2;
+         return TRUE;
+      }
+      return FALSE;
+   }
+}
+
+
+static boolean
+is_tex_cache_query(unsigned type)
+{
+   return type == LP_QUERY_TEX_CACHE_HITS ||
+          type == LP_QUERY_TEX_CACHE_MISSES;
+}
+
+
+/**
+ * Sample a LP_QUERY_TEX_CACHE_x counter.  These are updated by the
+ * rasterizer threads as they go, so the results are only approximate
+ * while scenes are in flight.
+ */
+static uint64_t
+get_tex_cache_counter(struct pipe_context *pipe, unsigned type)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   uint64_t accesses, misses;
+
+   lp_rast_get_texture_cache_stats(screen->rast, &accesses, &misses);
+
+   return type == LP_QUERY_TEX_CACHE_HITS ? accesses - misses : misses;
+}
+
+
+static boolean
+is_vcache_query(unsigned type)
+{
+   return type == LP_QUERY_VCACHE_HITS ||
+          type == LP_QUERY_VCACHE_MISSES;
+}
+
+
+/**
+ * Sample a LP_QUERY_VCACHE_x counter.  The draw module updates these as it
+ * runs the vertex shaders, which happens before draw_vbo returns.
+ */
+static uint64_t
+get_vcache_counter(struct llvmpipe_context *llvmpipe, unsigned type)
+{
+   struct draw_vcache_statistics stats;
+
+   draw_get_vcache_statistics(llvmpipe->draw, &stats);
+
+   return type == LP_QUERY_VCACHE_HITS ? stats.hits : stats.misses;
+}
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
+   unsigned num_queries = LP_QUERY_NUM_GLOBAL + 2 * num_threads;
+
+   if (!info)
+      return num_queries;
+
+   if (index >= num_queries)
+      return 0;
+
+   memset(info, 0, sizeof *info);
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+   if (info->query_type == LP_QUERY_FS_FALLBACK_DRAWS ||
+       is_tex_cache_query(info->query_type) ||
+       is_vcache_query(info->query_type)) {
+      info->type = PIPE_DRIVER_QUERY_TYPE_UINT64;
+      info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE;
+   } else {
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE;
+   }
+   info->name = screen->query_names[index];
+
+   return 1;
+}
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe, 
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          type >= PIPE_QUERY_DRIVER_SPECIFIC);
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* the per-thread counters follow the query in the same allocation */
+   pq = CALLOC(1, sizeof *pq + 2 * num_threads * sizeof(uint64_t));
 
    if (pq) {
       pq->type = type;
+      pq->num_threads = num_threads;
+      pq->start = (uint64_t *)(pq + 1);
+      pq->end = pq->start + num_threads;
    }
 
    return (struct pipe_query *) pq;
@@ -99,7 +211,8 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
    unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
    uint64_t *result = (uint64_t *)vresult;
-   int i;
+   boolean idle;
+   int i, thread;
 
    if (pq->fence) {
       /* only have a fence if there was a scene */
@@ -175,8 +288,25 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_FS_FALLBACK_DRAWS:
+   case LP_QUERY_TEX_CACHE_HITS:
+   case LP_QUERY_TEX_CACHE_MISSES:
+   case LP_QUERY_VCACHE_HITS:
+   case LP_QUERY_VCACHE_MISSES:
+      *result = pq->end[0] - pq->start[0];
+      break;
    default:
-      assert(0);
+      if (is_rast_time_query(pq->type, &idle, &thread)) {
+         for (i = 0; i < num_threads; i++) {
+            if (thread < 0 || thread == i)
+               *result += pq->end[i] - pq->start[i];
+         }
+         /* nanoseconds to microseconds */
+         *result /= 1000;
+      }
+      else {
+         assert(0);
+      }
       break;
    }
 
@@ -189,6 +319,27 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   boolean idle;
+   int thread;
+
+   /* These are sampled on the CPU and never binned. */
+   if (is_rast_time_query(pq->type, &idle, &thread)) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+      lp_rast_get_thread_times(screen->rast, idle, pq->start);
+      return true;
+   }
+   if (pq->type == LP_QUERY_FS_FALLBACK_DRAWS) {
+      pq->start[0] = llvmpipe->nr_fs_fallback_draws;
+      return true;
+   }
+   if (is_tex_cache_query(pq->type)) {
+      pq->start[0] = get_tex_cache_counter(pipe, pq->type);
+      return true;
+   }
+   if (is_vcache_query(pq->type)) {
+      pq->start[0] = get_vcache_counter(llvmpipe, pq->type);
+      return true;
+   }
 
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
@@ -199,8 +350,8 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_threads * sizeof(pq->start[0]));
+   memset(pq->end, 0, pq->num_threads * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -244,6 +395,26 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   boolean idle;
+   int thread;
+
+   if (is_rast_time_query(pq->type, &idle, &thread)) {
+      struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+      lp_rast_get_thread_times(screen->rast, idle, pq->end);
+      return true;
+   }
+   if (pq->type == LP_QUERY_FS_FALLBACK_DRAWS) {
+      pq->end[0] = llvmpipe->nr_fs_fallback_draws;
+      return true;
+   }
+   if (is_tex_cache_query(pq->type)) {
+      pq->end[0] = get_tex_cache_counter(pipe, pq->type);
+      return true;
+   }
+   if (is_vcache_query(pq->type)) {
+      pq->end[0] = get_vcache_counter(llvmpipe, pq->type);
+      return true;
+   }
 
    lp_setup_end_query(llvmpipe->setup, pq);
 
@@ -39,11 +39,35 @@
 
 
 struct llvmpipe_context;
+struct pipe_screen;
+struct pipe_driver_query_info;
+
+
+/**
+ * Driver specific queries: time spent by the rasterizer threads working
+ * on scenes and waiting for work, in total and for each thread, the
+ * number of draws done with unoptimized fragment shader code, the hits
+ * and misses of the decoded texture block caches, and the hits and misses
+ * of the draw module's post-transform vertex cache.
+ */
+#define LP_QUERY_RAST_BUSY_TIME   (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_RAST_IDLE_TIME   (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_FS_FALLBACK_DRAWS (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+#define LP_QUERY_TEX_CACHE_HITS   (PIPE_QUERY_DRIVER_SPECIFIC + 3)
+#define LP_QUERY_TEX_CACHE_MISSES (PIPE_QUERY_DRIVER_SPECIFIC + 4)
+#define LP_QUERY_VCACHE_HITS      (PIPE_QUERY_DRIVER_SPECIFIC + 5)
+#define LP_QUERY_VCACHE_MISSES    (PIPE_QUERY_DRIVER_SPECIFIC + 6)
+/** Busy time of thread i is query + 2*i, idle time is query + 2*i + 1 */
+#define LP_QUERY_RAST_THREAD_TIME (PIPE_QUERY_DRIVER_SPECIFIC + 7)
+
+/** Number of queries before the per-thread ones */
+#define LP_QUERY_NUM_GLOBAL (LP_QUERY_RAST_THREAD_TIME - PIPE_QUERY_DRIVER_SPECIFIC)
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_threads;            /* size of the start/end arrays */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
@@ -55,6 +79,11 @@ struct llvmpipe_query {
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
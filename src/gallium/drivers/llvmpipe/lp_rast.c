@@ -26,12 +26,14 @@
  **************************************************************************/
 
 #include <limits.h>
+#include <stdio.h>
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
 #include "util/u_string.h"
+#include "util/u_atomic.h"
 
 #include "os/os_time.h"
 
@@ -65,6 +67,7 @@ lp_rast_begin( struct lp_rasterizer *rast,
                struct lp_scene *scene )
 {
    rast->curr_scene = scene;
+   scene->active_threads = rast->num_threads;
 
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
@@ -73,12 +76,25 @@ lp_rast_begin( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * End rasterizing a scene.
+ * Called once per scene by the last thread done with it.
+ * The scene is released before its fence is signalled: the setup module
+ * may start binning into it again as soon as the fence is signalled.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = scene->fence;
+
+   lp_scene_end_rasterization( scene );
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+   }
 }
 
 
@@ -349,7 +365,7 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
          /* run shader on 4x4 block */
          BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
+         variant->code->jit_function[RAST_WHOLE]( &state->jit_context,
                                             tile_x + x, tile_y + y,
                                             inputs->frontfacing,
                                             GET_A0(inputs),
@@ -454,7 +470,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
+      variant->code->jit_function[RAST_EDGE_TEST](&state->jit_context,
                                             x, y,
                                             inputs->frontfacing,
                                             GET_A0(inputs),
@@ -665,16 +681,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
-   /* Clear the cache tags. This should not always be necessary but
-      simpler for now. */
-#if LP_USE_TEXTURE_CACHE
-   memset(task->thread_data.cache->cache_tags, 0,
-          sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   task->thread_data.cache->cache_access_total = 0;
-   task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
+   /* Textures may have changed since the previous scene */
+   lp_build_format_cache_invalidate(task->thread_data.cache);
 
    if (!task->rast->no_rast && !scene->discard) {
       /* loop over scene bins, rasterize each */
@@ -691,24 +699,6 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
-   }
-#endif
-
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -725,6 +715,7 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
    if (rast->num_threads == 0) {
       /* no threading */
       unsigned fpstate = util_fpstate_get();
+      int64_t start = os_time_get_nano();
 
       /* Make sure that denorms are treated like zeros. This is 
        * the behavior required by D3D10. OpenGL doesn't care.
@@ -737,9 +728,9 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 
       lp_rast_end( rast );
 
-      util_fpstate_set(fpstate);
+      p_atomic_add(&rast->tasks[0].busy_time, os_time_get_nano() - start);
 
-      rast->curr_scene = NULL;
+      util_fpstate_set(fpstate);
    }
    else {
       /* threaded rendering! */
@@ -757,29 +748,158 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Get the next scene for the calling thread to work on.
+ * Scenes must be rasterized one after another as they may touch the same
+ * tiles, so if the previous scene is still being worked on by other
+ * threads, wait for it to be released.  The first thread to get here once
+ * the previous scene is done begins the next one, there is no need for
+ * all threads to meet.
+ */
+static struct lp_scene *
+lp_rast_get_next_scene( struct lp_rasterizer_task *task )
+{
+   struct lp_rasterizer *rast = task->rast;
+   struct lp_scene *scene;
+
+   pipe_mutex_lock(rast->scene_mutex);
+
+   while (task->scene_seq == rast->scene_seq) {
+      if (!rast->curr_scene) {
+         lp_rast_begin( rast,
+                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+         rast->scene_seq++;
+         break;
+      }
+      pipe_condvar_wait(rast->scene_done, rast->scene_mutex);
+   }
+
+   scene = rast->curr_scene;
+   task->scene_seq = rast->scene_seq;
+
+   pipe_mutex_unlock(rast->scene_mutex);
+
+   return scene;
+}
+
+
+/**
+ * Called by each thread once done with its share of the scene's bins.
+ * The last thread releases the scene.
+ */
+static void
+lp_rast_put_scene( struct lp_rasterizer_task *task,
+                   struct lp_scene *scene )
+{
+   struct lp_rasterizer *rast = task->rast;
+
+   if (p_atomic_dec_zero(&scene->active_threads)) {
+      pipe_mutex_lock(rast->scene_mutex);
+      assert(rast->curr_scene == scene);
+      lp_rast_end( rast );
+      pipe_condvar_broadcast(rast->scene_done);
+      pipe_mutex_unlock(rast->scene_mutex);
+   }
+}
+
+
+/**
+ * Get the busy or idle time of each rasterizer thread, in nanoseconds.
+ * \param times  returns one value per thread, MAX2(1, num_threads) values
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_get_thread_times( struct lp_rasterizer *rast,
+                          boolean idle,
+                          uint64_t *times )
 {
-   if (rast->num_threads == 0) {
-      /* nothing to do */
+   unsigned i;
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      const struct lp_rasterizer_task *task = &rast->tasks[i];
+      times[i] = idle ? p_atomic_read(&task->idle_time) :
+                        p_atomic_read(&task->busy_time);
    }
-   else {
-      int i;
+}
 
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
+
+/**
+ * Return the number of texel fetches through the decoded block caches and
+ * of the misses among them, summed over all threads.  Only approximate
+ * while scenes are being rasterized.
+ */
+void
+lp_rast_get_texture_cache_stats( struct lp_rasterizer *rast,
+                                 uint64_t *accesses,
+                                 uint64_t *misses )
+{
+   unsigned i;
+
+   *accesses = 0;
+   *misses = 0;
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      const struct lp_build_format_cache *cache = rast->tasks[i].thread_data.cache;
+      if (cache) {
+         *accesses += p_atomic_read(&cache->access_total);
+         *misses += p_atomic_read(&cache->access_miss);
       }
    }
 }
 
 
+/**
+ * Run a job on all the rasterizer threads and wait for it to complete.
+ *
+ * Each thread calls \p func exactly once. Scenes queued before the job
+ * may be rasterized before or after it, so callers needing ordering must
+ * wait on the relevant fences first.  Jobs must not be queued concurrently,
+ * callers serialize on the screen's rast_mutex.
+ */
+void
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data )
+{
+   unsigned i;
+
+   if (rast->num_threads == 0) {
+      /* no threading */
+      unsigned fpstate = util_fpstate_get();
+      int64_t start = os_time_get_nano();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+
+      lp_build_format_cache_invalidate(rast->tasks[0].thread_data.cache);
+      func(data, 0, rast->tasks[0].thread_data.cache);
+
+      p_atomic_add(&rast->tasks[0].busy_time, os_time_get_nano() - start);
+
+      util_fpstate_set(fpstate);
+      return;
+   }
+
+   rast->job_func = func;
+   rast->job_data = data;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      rast->tasks[i].job_pending = TRUE;
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_wait(&rast->job_done);
+   }
+
+   rast->job_func = NULL;
+   rast->job_data = NULL;
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
  *   1. wait for work
  *   2. do work
- *   3. signal that we're done
+ * Completion of a scene is signalled through the scene's fence.
  */
 static PIPE_THREAD_ROUTINE( thread_function, init_data )
 {
@@ -792,6 +912,19 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    pipe_thread_setname(thread_name);
 
+   if (rast->pin_threads) {
+      pipe_thread_set_affinity(rast->numa_node_cpus[task->numa_node],
+                               LP_MAX_CPUS / 32);
+   }
+
+   /* Allocate the per-thread data from the thread itself, once placed,
+    * so that it is first touched from, and hence allocated on, the
+    * thread's own node.  lp_rast_create() waits for this, and destroys
+    * the rasterizer again if the allocation failed.
+    */
+   task->thread_data.cache = lp_build_format_cache_create();
+   pipe_semaphore_signal(&task->work_done);
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -799,49 +932,56 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
    util_fpstate_set_denorms_to_zero(fpstate);
 
    while (1) {
+      struct lp_scene *scene;
+      int64_t start, end;
+
       /* wait for work */
       if (debug)
          debug_printf("thread %d waiting for work\n", task->thread_index);
+
+      start = os_time_get_nano();
       pipe_semaphore_wait(&task->work_ready);
 
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin( rast, 
-                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+      if (task->job_pending) {
+         task->job_pending = FALSE;
+
+         end = os_time_get_nano();
+         p_atomic_add(&task->idle_time, end - start);
+         start = end;
+
+         lp_build_format_cache_invalidate(task->thread_data.cache);
+         rast->job_func(rast->job_data, task->thread_index,
+                        task->thread_data.cache);
+
+         end = os_time_get_nano();
+         p_atomic_add(&task->busy_time, end - start);
+
+         pipe_semaphore_signal(&rast->job_done);
+         continue;
       }
 
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
-       */
-      pipe_barrier_wait( &rast->barrier );
+      scene = lp_rast_get_next_scene(task);
+
+      end = os_time_get_nano();
+      p_atomic_add(&task->idle_time, end - start);
+      start = end;
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task,
-                      rast->curr_scene);
-      
-      /* wait for all threads to finish with this scene */
-      pipe_barrier_wait( &rast->barrier );
+      rasterize_scene(task, scene);
 
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end( rast );
-      }
+      lp_rast_put_scene(task, scene);
+
+      end = os_time_get_nano();
+      p_atomic_add(&task->busy_time, end - start);
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -853,20 +993,134 @@ static PIPE_THREAD_ROUTINE( thread_function, init_data )
 
 
 /**
- * Initialize semaphores and spawn the threads.
+ * Parse a sysfs CPU or node list such as "0-7,16-23" into a bit mask.
  */
 static void
+parse_cpu_list(const char *list, uint32_t *mask)
+{
+   const char *p = list;
+
+   while (*p) {
+      char *end;
+      unsigned first, last, cpu;
+
+      first = last = strtoul(p, &end, 10);
+      if (end == p)
+         break;
+      p = end;
+      if (*p == '-') {
+         last = strtoul(p + 1, &end, 10);
+         p = end;
+      }
+      for (cpu = first; cpu <= last && cpu < LP_MAX_CPUS; cpu++)
+         mask[cpu / 32] |= 1u << (cpu % 32);
+      if (*p != ',')
+         break;
+      p++;
+   }
+}
+
+
+/**
+ * Read the first line of a sysfs file.
+ */
+static boolean
+read_sysfs_line(const char *path, char *line, unsigned size)
+{
+   FILE *f = fopen(path, "r");
+   boolean ok;
+
+   if (!f)
+      return FALSE;
+   ok = fgets(line, size, f) != NULL;
+   fclose(f);
+   return ok;
+}
+
+
+/**
+ * Find out which CPUs belong to which NUMA node.
+ * The node CPU lists are read from sysfs, for the online nodes, whose IDs
+ * need not be contiguous.  Only the CPUs the process may run on are kept,
+ * and nodes without any such CPUs are skipped, so that pinning the threads
+ * never overrides an affinity mask the process was given.  Leaves
+ * num_numa_nodes at zero if the topology is unknown.
+ */
+static void
+detect_numa_nodes(struct lp_rasterizer *rast)
+{
+#if defined(PIPE_OS_LINUX)
+   uint32_t online[LP_MAX_CPUS / 32] = {0};
+   uint32_t allowed[LP_MAX_CPUS / 32];
+   char list[1024];
+   unsigned node, i;
+
+   if (!read_sysfs_line("/sys/devices/system/node/online", list, sizeof list))
+      return;
+   parse_cpu_list(list, online);
+
+   if (!pipe_thread_get_affinity(allowed, LP_MAX_CPUS / 32))
+      memset(allowed, 0xff, sizeof allowed);
+
+   for (node = 0;
+        node < LP_MAX_CPUS && rast->num_numa_nodes < LP_MAX_NUMA_NODES;
+        node++) {
+      uint32_t *cpus = rast->numa_node_cpus[rast->num_numa_nodes];
+      char path[64];
+      boolean usable = FALSE;
+
+      if (!(online[node / 32] & (1u << (node % 32))))
+         continue;
+
+      util_snprintf(path, sizeof path,
+                    "/sys/devices/system/node/node%u/cpulist", node);
+      if (!read_sysfs_line(path, list, sizeof list))
+         continue;
+
+      parse_cpu_list(list, cpus);
+      for (i = 0; i < LP_MAX_CPUS / 32; i++) {
+         cpus[i] &= allowed[i];
+         if (cpus[i])
+            usable = TRUE;
+      }
+
+      if (usable)
+         rast->num_numa_nodes++;
+      else
+         memset(cpus, 0, sizeof rast->numa_node_cpus[0]);
+   }
+#endif
+}
+
+
+/**
+ * Initialize semaphores and spawn the threads.
+ * Threads are spread round-robin over the NUMA nodes.
+ * \return FALSE if a thread failed to set itself up
+ */
+static boolean
 create_rast_threads(struct lp_rasterizer *rast)
 {
+   boolean ok = TRUE;
    unsigned i;
 
    /* NOTE: if num_threads is zero, we won't use any threads */
    for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_init(&rast->tasks[i].work_ready, 0);
-      pipe_semaphore_init(&rast->tasks[i].work_done, 0);
-      rast->threads[i] = pipe_thread_create(thread_function,
-                                            (void *) &rast->tasks[i]);
+      struct lp_rasterizer_task *task = &rast->tasks[i];
+      task->numa_node = rast->num_numa_nodes ? i % rast->num_numa_nodes : 0;
+      pipe_semaphore_init(&task->work_ready, 0);
+      pipe_semaphore_init(&task->work_done, 0);
+      rast->threads[i] = pipe_thread_create(thread_function, (void *) task);
    }
+
+   /* wait for the threads to allocate their data */
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_wait(&rast->tasks[i].work_done);
+      if (!rast->tasks[i].thread_data.cache)
+         ok = FALSE;
+   }
+
+   return ok;
 }
 
 
@@ -892,39 +1146,61 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof rast->tasks[0]);
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   if (num_threads) {
+      rast->threads = CALLOC(num_threads, sizeof rast->threads[0]);
+      if (!rast->threads) {
+         goto no_threads;
+      }
+   }
+   else {
+      /* no threads, the task data is used from the calling thread */
+      rast->tasks[0].thread_data.cache = lp_build_format_cache_create();
+      if (!rast->tasks[0].thread_data.cache) {
+         goto no_threads;
+      }
+   }
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
-      task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
-                                             16);
-      if (!task->thread_data.cache) {
-         goto no_thread_data_cache;
-      }
    }
 
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
-   create_rast_threads(rast);
+   /* Only pin threads by default when there's more than one node to
+    * place them on.
+    */
+   detect_numa_nodes(rast);
+   rast->pin_threads = debug_get_bool_option("LP_PIN_THREADS",
+                                             rast->num_numa_nodes > 1);
+   if (!rast->num_numa_nodes)
+      rast->pin_threads = FALSE;
 
    /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      pipe_barrier_init( &rast->barrier, rast->num_threads );
-   }
+   pipe_mutex_init(rast->scene_mutex);
+   pipe_condvar_init(rast->scene_done);
+   pipe_semaphore_init(&rast->job_done, 0);
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
-   return rast;
-
-no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
-      }
+   if (!create_rast_threads(rast)) {
+      lp_rast_destroy(rast);
+      return NULL;
    }
 
+   return rast;
+
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
@@ -965,16 +1241,19 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       pipe_semaphore_destroy(&rast->tasks[i].work_done);
    }
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      align_free(rast->tasks[i].thread_data.cache);
+      if (rast->tasks[i].thread_data.cache)
+         lp_build_format_cache_destroy(rast->tasks[i].thread_data.cache);
    }
 
    /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      pipe_barrier_destroy( &rast->barrier );
-   }
+   pipe_mutex_destroy(rast->scene_mutex);
+   pipe_condvar_destroy(rast->scene_done);
+   pipe_semaphore_destroy(&rast->job_done);
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
 
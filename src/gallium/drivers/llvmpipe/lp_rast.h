@@ -167,7 +167,32 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_get_thread_times( struct lp_rasterizer *rast,
+                          boolean idle,
+                          uint64_t *times );
+
+void
+lp_rast_get_texture_cache_stats( struct lp_rasterizer *rast,
+                                 uint64_t *accesses,
+                                 uint64_t *misses );
+
+
+struct lp_build_format_cache;
+
+/**
+ * A piece of non-rasterization work run once on each rasterizer thread,
+ * e.g. a compute grid.  The function is expected to pick its own share of
+ * the work from \p data.
+ */
+typedef void
+(*lp_rast_job_func)( void *data,
+                     unsigned thread_index,
+                     struct lp_build_format_cache *cache );
+
+void
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data );
 
 
 union lp_rast_cmd_arg {
@@ -76,6 +76,13 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+/**
+ * Limits for the CPU topology detection.
+ */
+#define LP_MAX_NUMA_NODES 16
+#define LP_MAX_CPUS 1024
+
+
 /**
  * Per-thread rasterization state
  */
@@ -97,13 +104,26 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** NUMA node the thread is placed on */
+   unsigned numa_node;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
    uint8_t ps_inv_multiplier;
 
+   /** Number of scenes this thread has taken part in */
+   unsigned scene_seq;
+
+   /** Time spent rasterizing and waiting for work, in nanoseconds */
+   uint64_t busy_time;
+   uint64_t idle_time;
+
+   /** Set by lp_rast_run_job() when rast->job is for this thread to run */
+   boolean job_pending;
+
    pipe_semaphore work_ready;
-   pipe_semaphore work_done;
+   pipe_semaphore work_done;  /**< only signalled on thread exit */
 };
 
 
@@ -123,14 +143,32 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** Number of scenes begun so far */
+   unsigned scene_seq;
+
+   /** Protects curr_scene and scene_seq */
+   pipe_mutex scene_mutex;
+
+   /** Broadcast whenever curr_scene has been released */
+   pipe_condvar scene_done;
+
+   /** The job being run by lp_rast_run_job(), see lp_rast_job_func */
+   lp_rast_job_func job_func;
+   void *job_data;
+
+   /** Signalled by each thread when it has finished its part of the job */
+   pipe_semaphore job_done;
+
+   /** A task object for each rasterization thread, MAX2(1, num_threads) */
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   pipe_thread threads[LP_MAX_THREADS];
+   pipe_thread *threads;
 
-   /** For synchronizing the rasterization threads */
-   pipe_barrier barrier;
+   /** Pin the threads to the CPUs of their NUMA node */
+   boolean pin_threads;
+   unsigned num_numa_nodes;
+   uint32_t numa_node_cpus[LP_MAX_NUMA_NODES][LP_MAX_CPUS / 32];
 };
 
 
@@ -268,7 +306,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_WHOLE]( &state->jit_context,
+      variant->code->jit_function[RAST_WHOLE]( &state->jit_context,
                                          x, y,
                                          inputs->frontfacing,
                                          GET_A0(inputs),
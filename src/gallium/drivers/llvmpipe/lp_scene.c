@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_inlines.h"
+#include "util/u_atomic.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
 #include "lp_scene.h"
@@ -205,6 +206,9 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 /**
  * Free all the temporary data in a scene.
+ * Called by the rasterizer once the scene is done.  Note that the scene's
+ * fence is left alone, it belongs to the setup module which waits on it
+ * before reusing the scene.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
@@ -249,6 +253,11 @@ lp_scene_end_rasterization(struct lp_scene *scene )
     */
    assert(lp_scene_is_empty(scene));
 
+   /* The setup module may be looking at the resource references of an
+    * in-flight scene, see lp_scene_is_resource_referenced().
+    */
+   pipe_mutex_lock(scene->mutex);
+
    /* Decrement texture ref counts
     */
    {
@@ -289,8 +298,6 @@ lp_scene_end_rasterization(struct lp_scene *scene )
       list->head->used = 0;
    }
 
-   lp_fence_reference(&scene->fence, NULL);
-
    scene->resources = NULL;
    scene->scene_size = 0;
    scene->resource_reference_size = 0;
@@ -298,6 +305,8 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    scene->alloc_failed = FALSE;
 
    util_unreference_framebuffer_state( &scene->fb );
+
+   pipe_mutex_unlock(scene->mutex);
 }
 
 
@@ -429,81 +438,94 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 /**
  * Does this scene have a reference to the given resource?
+ * The scene may be in the middle of rasterization on another thread.
+ * \return bitmask of LP_REFERENCED_FOR_READ/WRITE
  */
-boolean
-lp_scene_is_resource_referenced(const struct lp_scene *scene,
+unsigned
+lp_scene_is_resource_referenced(struct lp_scene *scene,
                                 const struct pipe_resource *resource)
 {
    const struct resource_ref *ref;
+   unsigned referenced = LP_UNREFERENCED;
    int i;
 
+   pipe_mutex_lock(scene->mutex);
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource) {
+         referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+         goto end;
+      }
+   }
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource) {
+      referenced = LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      goto end;
+   }
+
    for (ref = scene->resources; ref; ref = ref->next) {
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
-            return TRUE;
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            referenced = LP_REFERENCED_FOR_READ;
+            goto end;
+         }
+      }
    }
 
-   return FALSE;
+end:
+   pipe_mutex_unlock(scene->mutex);
+   return referenced;
 }
 
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
-{
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
-}
-
-
 void
 lp_scene_bin_iter_begin( struct lp_scene *scene )
 {
-   scene->curr_x = scene->curr_y = -1;
+   scene->curr_bin = 0;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  The bins are handed out most expensive
+ * first, so that the threads finish the scene at about the same time.
+ * This is lock-free: lp_scene::curr_bin is advanced atomically.
  */
 struct cmd_bin *
 lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
-
-   pipe_mutex_lock(scene->mutex);
+   const struct lp_bin_ref *ref;
+   unsigned i = p_atomic_inc_return(&scene->curr_bin) - 1;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
+   if (i >= scene->num_bins) {
       /* no more bins left */
-      goto end;
+      return NULL;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   ref = &scene->bin_order[i];
+   *x = ref->x;
+   *y = ref->y;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   pipe_mutex_unlock(scene->mutex);
-   return bin;
+   return lp_scene_get_bin(scene, ref->x, ref->y);
+}
+
+
+/**
+ * Sort bins by decreasing cost, and in raster order for equal costs.
+ */
+static int
+compare_bin_cost(const void *a, const void *b)
+{
+   const struct lp_bin_ref *ra = (const struct lp_bin_ref *)a;
+   const struct lp_bin_ref *rb = (const struct lp_bin_ref *)b;
+
+   if (ra->cost != rb->cost)
+      return ra->cost < rb->cost ? 1 : -1;
+   if (ra->y != rb->y)
+      return ra->y < rb->y ? -1 : 1;
+   return ra->x < rb->x ? -1 : ra->x > rb->x;
 }
 
 
@@ -551,6 +573,33 @@ void lp_scene_begin_binning( struct lp_scene *scene,
 
 void lp_scene_end_binning( struct lp_scene *scene )
 {
+   unsigned x, y;
+
+   /* Gather the non-empty bins, using the number of commands in each as
+    * an estimate of how long it takes to rasterize.
+    */
+   scene->num_bins = 0;
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+         const struct cmd_block *block;
+         struct lp_bin_ref *ref;
+
+         if (!bin->head)
+            continue;
+
+         ref = &scene->bin_order[scene->num_bins++];
+         ref->x = x;
+         ref->y = y;
+         ref->cost = 0;
+         for (block = bin->head; block; block = block->next)
+            ref->cost += block->count;
+      }
+   }
+
+   qsort(scene->bin_order, scene->num_bins, sizeof scene->bin_order[0],
+         compare_bin_cost);
+
    if (LP_DEBUG & DEBUG_SCENE) {
       debug_printf("rasterize scene:\n");
       debug_printf("  scene_size: %u\n",
@@ -98,6 +98,16 @@ struct cmd_bin {
    struct cmd_block *head;
    struct cmd_block *tail;
 };
+
+
+/**
+ * Position and estimated cost of a non-empty bin, used to hand out the
+ * most expensive bins to the rasterizer threads first.
+ */
+struct lp_bin_ref {
+   uint16_t x, y;
+   unsigned cost;  /**< number of commands in the bin */
+};
    
 
 /**
@@ -173,10 +183,17 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
    pipe_mutex mutex;
 
+   /** Number of rasterizer threads still working on the scene */
+   int active_threads;
+
+   /** Non-empty bins, most expensive first, built by end_binning() */
+   unsigned num_bins;
+   int curr_bin;  /**< for iterating over bins, atomically incremented */
+
    struct cmd_bin tile[TILES_X][TILES_Y];
+   struct lp_bin_ref bin_order[TILES_X * TILES_Y];
    struct data_block_list data;
 };
 
@@ -199,8 +216,8 @@ boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
                                         boolean initializing_scene);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+unsigned lp_scene_is_resource_referenced(struct lp_scene *scene,
+                                         const struct pipe_resource *resource );
 
 
 /**
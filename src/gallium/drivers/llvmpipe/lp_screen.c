@@ -36,6 +36,10 @@
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_format.h"
+#include "util/mesa-sha1.h"
 
 #include "os/os_misc.h"
 #include "os/os_time.h"
@@ -48,9 +52,16 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_query.h"
+#include "lp_perf.h"
 
 #include "state_tracker/sw_winsys.h"
 
+#if defined(ENABLE_SHADER_CACHE) && defined(HAVE_DLOPEN)
+#include <dlfcn.h>
+#include <sys/stat.h>
+#endif
+
 #ifdef DEBUG
 int LP_DEBUG = 0;
 
@@ -212,7 +223,16 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
+      /* Shared memory and buffer atomics need atomicrmw/cmpxchg lowering
+       * that only works reliably from LLVM 3.9 on.
+       */
+#if HAVE_LLVM >= 0x0309
+      return 1;
+#else
       return 0;
+#endif
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      return 4;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
    case PIPE_CAP_USER_INDEX_BUFFERS:
       return 1;
@@ -319,7 +339,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -357,6 +376,15 @@ llvmpipe_get_shader_param(struct pipe_screen *screen, unsigned shader, enum pipe
       default:
          return gallivm_get_shader_param(param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         return LP_MAX_TGSI_SHADER_IMAGES;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    case PIPE_SHADER_VERTEX:
    case PIPE_SHADER_GEOMETRY:
       switch (param) {
@@ -382,6 +410,69 @@ llvmpipe_get_shader_param(struct pipe_screen *screen, unsigned shader, enum pipe
    }
 }
 
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 1024;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+      if (ret) {
+         uint32_t *max_compute_units = ret;
+         *max_compute_units = MAX2(1, llvmpipe_screen(_screen)->num_threads);
+      }
+      return sizeof(uint32_t);
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+      if (ret) {
+         uint32_t *images_supported = ret;
+         *images_supported = 1;
+      }
+      return sizeof(uint32_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -535,6 +626,19 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
+   struct lp_fence *fence = NULL;
+
+   /* Scenes are rasterized asynchronously, so wait for everything queued
+    * so far before handing the displaytarget over to the winsys.
+    */
+   pipe_mutex_lock(screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   pipe_mutex_unlock(screen->rast_mutex);
+
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 
    assert(texture->dt);
    if (texture->dt)
@@ -547,9 +651,20 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
 
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_destroy(&screen->compile_queue);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   lp_fence_reference(&screen->last_fence, NULL);
+
+   llvmpipe_destroy_fs_code_table(screen);
+
+   if (screen->disk_cache)
+      disk_cache_destroy(screen->disk_cache);
+   pipe_mutex_destroy(screen->disk_cache_mutex);
+
    lp_jit_screen_cleanup(screen);
 
    if(winsys->destroy)
@@ -557,12 +672,138 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
 
    pipe_mutex_destroy(screen->rast_mutex);
 
+   FREE(screen->query_names);
    FREE(screen);
 }
 
 
 
 
+#ifdef ENABLE_SHADER_CACHE
+
+/**
+ * Compute the hash of everything besides the shader and its variant key
+ * that affects the generated code, so that objects produced by a different
+ * build, LLVM version or CPU sharing the same cache directory are ignored.
+ */
+static void
+lp_disk_cache_init_id(struct llvmpipe_screen *screen)
+{
+   struct mesa_sha1 *ctx;
+   unsigned llvm_version = HAVE_LLVM << 8 | MESA_LLVM_VERSION_PATCH;
+   unsigned vector_width = lp_native_vector_width;
+   unsigned tex_cache[2] = { lp_build_format_cache_size,
+                             lp_build_format_cache_ways };
+   unsigned debug_flags[2] = { gallivm_debug, LP_PERF };
+
+   ctx = _mesa_sha1_init();
+   if (!ctx)
+      return;
+
+   _mesa_sha1_update(ctx, "llvmpipe", 8);
+#ifdef PACKAGE_VERSION
+   _mesa_sha1_update(ctx, PACKAGE_VERSION, strlen(PACKAGE_VERSION));
+#endif
+#ifdef HAVE_DLOPEN
+   {
+      /* Tell development builds of the same version apart */
+      Dl_info info;
+      struct stat st;
+
+      if (dladdr((void *) lp_disk_cache_init_id, &info) &&
+          info.dli_fname && stat(info.dli_fname, &st) == 0) {
+         _mesa_sha1_update(ctx, &st.st_mtime, sizeof st.st_mtime);
+      }
+   }
+#endif
+   _mesa_sha1_update(ctx, &llvm_version, sizeof llvm_version);
+   _mesa_sha1_update(ctx, &util_cpu_caps, sizeof util_cpu_caps);
+   _mesa_sha1_update(ctx, &vector_width, sizeof vector_width);
+   _mesa_sha1_update(ctx, tex_cache, sizeof tex_cache);
+   _mesa_sha1_update(ctx, debug_flags, sizeof debug_flags);
+   _mesa_sha1_final(ctx, screen->disk_cache_id);
+}
+
+#endif /* ENABLE_SHADER_CACHE */
+
+
+/**
+ * Compute the cache key of the code generated for a shader and variant.
+ * \param kind  distinguishes the kinds of generated functions
+ */
+void
+lp_disk_cache_compute_key(const struct llvmpipe_screen *screen,
+                          const char *kind,
+                          const void *shader, size_t shader_size,
+                          const void *variant_key, size_t variant_key_size,
+                          cache_key key)
+{
+#ifdef ENABLE_SHADER_CACHE
+   struct mesa_sha1 *ctx;
+
+   memset(key, 0, CACHE_KEY_SIZE);
+
+   ctx = _mesa_sha1_init();
+   if (!ctx)
+      return;
+
+   _mesa_sha1_update(ctx, screen->disk_cache_id, CACHE_KEY_SIZE);
+   _mesa_sha1_update(ctx, kind, strlen(kind));
+   if (shader_size)
+      _mesa_sha1_update(ctx, shader, shader_size);
+   _mesa_sha1_update(ctx, variant_key, variant_key_size);
+   _mesa_sha1_final(ctx, key);
+#else
+   memset(key, 0, CACHE_KEY_SIZE);
+#endif
+}
+
+
+/**
+ * Look up previously generated code, to be passed to gallivm through
+ * gallivm_state::cache.
+ */
+void
+lp_disk_cache_find_code(struct llvmpipe_screen *screen,
+                        struct lp_cached_code *cached,
+                        cache_key key)
+{
+   memset(cached, 0, sizeof *cached);
+
+   if (!screen->disk_cache)
+      return;
+
+   /* Shaders may be compiled by several threads, see compile_queue */
+   pipe_mutex_lock(screen->disk_cache_mutex);
+   cached->data = disk_cache_get(screen->disk_cache, key, &cached->data_size);
+   pipe_mutex_unlock(screen->disk_cache_mutex);
+   if (cached->data)
+      LP_COUNT(nr_disk_cache_hits);
+}
+
+
+/**
+ * Store newly generated code and release the cached object code.
+ * Must be called once the code has been generated, after the
+ * gallivm_jit_function() calls.
+ */
+void
+lp_disk_cache_insert_code(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cached,
+                          cache_key key)
+{
+   if (screen->disk_cache && cached->data && !cached->dont_cache) {
+      pipe_mutex_lock(screen->disk_cache_mutex);
+      disk_cache_put(screen->disk_cache, key, cached->data, cached->data_size);
+      pipe_mutex_unlock(screen->disk_cache_mutex);
+   }
+
+   free(cached->data);
+   cached->data = NULL;
+   cached->data_size = 0;
+}
+
+
 /**
  * Fence reference counting.
  */
@@ -610,6 +851,7 @@ struct pipe_screen *
 llvmpipe_create_screen(struct sw_winsys *winsys)
 {
    struct llvmpipe_screen *screen;
+   unsigned i;
 
    util_cpu_detect();
 
@@ -637,6 +879,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_device_vendor = llvmpipe_get_vendor; // TODO should be the CPU vendor
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
@@ -646,6 +889,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -656,13 +900,76 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   screen->num_scenes = debug_get_num_option("LP_NUM_SCENES", 2);
+   screen->num_scenes = CLAMP(screen->num_scenes, 1, LP_MAX_SCENES);
+
+   screen->query_names = CALLOC(LP_QUERY_NUM_GLOBAL +
+                                2 * MAX2(1, screen->num_threads),
+                                sizeof screen->query_names[0]);
+   if (!screen->query_names) {
+      lp_jit_screen_cleanup(screen);
+      FREE(screen);
+      return NULL;
+   }
+
+   util_snprintf(screen->query_names[0],
+                 sizeof screen->query_names[0], "rast-busy-time");
+   util_snprintf(screen->query_names[1],
+                 sizeof screen->query_names[1], "rast-idle-time");
+   util_snprintf(screen->query_names[2],
+                 sizeof screen->query_names[2], "fs-fallback-draws");
+   util_snprintf(screen->query_names[3],
+                 sizeof screen->query_names[3], "tex-cache-hits");
+   util_snprintf(screen->query_names[4],
+                 sizeof screen->query_names[4], "tex-cache-misses");
+   util_snprintf(screen->query_names[5],
+                 sizeof screen->query_names[5], "vertex-cache-hits");
+   util_snprintf(screen->query_names[6],
+                 sizeof screen->query_names[6], "vertex-cache-misses");
+   for (i = 0; i < MAX2(1, screen->num_threads); i++) {
+      util_snprintf(screen->query_names[LP_QUERY_NUM_GLOBAL + 2 * i],
+                    sizeof screen->query_names[0],
+                    "rast-thread%u-busy-time", i);
+      util_snprintf(screen->query_names[LP_QUERY_NUM_GLOBAL + 1 + 2 * i],
+                    sizeof screen->query_names[0],
+                    "rast-thread%u-idle-time", i);
+   }
+
+   if (!llvmpipe_init_fs_code_table(screen)) {
+      lp_jit_screen_cleanup(screen);
+      FREE(screen->query_names);
+      FREE(screen);
+      return NULL;
+   }
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
+      llvmpipe_destroy_fs_code_table(screen);
       lp_jit_screen_cleanup(screen);
+      FREE(screen->query_names);
       FREE(screen);
       return NULL;
    }
    pipe_mutex_init(screen->rast_mutex);
+   pipe_mutex_init(screen->disk_cache_mutex);
+
+#ifdef ENABLE_SHADER_CACHE
+   if (debug_get_bool_option("LP_DISK_CACHE", TRUE)) {
+      screen->disk_cache = disk_cache_create();
+      if (screen->disk_cache)
+         lp_disk_cache_init_id(screen);
+   }
+#endif
+
+   /*
+    * Compile optimized shader variants in the background, leaving most CPUs
+    * to the rasterizer threads.  Failing to start the queue just means
+    * compiling synchronously.
+    */
+   if (debug_get_bool_option("LP_ASYNC_COMPILE", util_cpu_caps.nr_cpus > 1)) {
+      util_queue_init(&screen->compile_queue, "lpcomp", 64,
+                      CLAMP(util_cpu_caps.nr_cpus / 4, 1, 4));
+   }
 
    util_format_s3tc_init();
 
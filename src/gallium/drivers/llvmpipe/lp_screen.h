@@ -37,10 +37,25 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/disk_cache.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
+#include "lp_limits.h"
 
 
 struct sw_winsys;
+struct lp_fence;
+struct lp_cached_code;
+struct lp_fs_variant_code;
+struct util_hash_table;
+
+
+/** doubly-linked list item */
+struct lp_fs_code_list_item
+{
+   struct lp_fs_variant_code *base;
+   struct lp_fs_code_list_item *next, *prev;
+};
 
 
 struct llvmpipe_screen
@@ -50,6 +65,7 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_scenes;  /**< scenes per context, see LP_MAX_SCENES */
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -57,6 +73,31 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    pipe_mutex rast_mutex;
+
+   /** Fence of the last scene queued, protected by rast_mutex */
+   struct lp_fence *last_fence;
+
+   /** Names of the LP_QUERY_x driver queries, see llvmpipe_create_screen() */
+   char (*query_names)[32];
+
+   /** Persistent cache of generated code, NULL if disabled */
+   struct disk_cache *disk_cache;
+   pipe_mutex disk_cache_mutex;
+   /** Hash of the build, LLVM version and CPU the code is generated for */
+   cache_key disk_cache_id;
+
+   /** Background compilation of optimized shader variants, if initialized */
+   struct util_queue compile_queue;
+
+   /**
+    * Fragment shader variant code shared by all contexts, in LRU order.
+    * Protected by fs_code_mutex.
+    */
+   pipe_mutex fs_code_mutex;
+   struct util_hash_table *fs_code_table;
+   struct lp_fs_code_list_item fs_code_list;
+   unsigned nr_fs_codes;
+   unsigned nr_fs_code_instrs;
 };
 
 
@@ -69,5 +110,23 @@ llvmpipe_screen( struct pipe_screen *pipe )
 }
 
 
+void
+lp_disk_cache_compute_key(const struct llvmpipe_screen *screen,
+                          const char *kind,
+                          const void *shader, size_t shader_size,
+                          const void *variant_key, size_t variant_key_size,
+                          cache_key key);
+
+void
+lp_disk_cache_find_code(struct llvmpipe_screen *screen,
+                        struct lp_cached_code *cached,
+                        cache_key key);
+
+void
+lp_disk_cache_insert_code(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cached,
+                          cache_key key);
+
+
 
 #endif /* LP_SCREEN_H */
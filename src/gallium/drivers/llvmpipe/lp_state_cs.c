@@ -0,0 +1,924 @@
+/**************************************************************************
+ *
+ * Copyright 2016 VMware, Inc.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shader state and grid launches.
+ *
+ * A compute shader variant is a function running all the invocations of a
+ * single workgroup, one SIMD lane per invocation (see the compute notes in
+ * lp_bld_tgsi_soa.c).  A grid launch is run synchronously on the
+ * rasterizer threads, which pull workgroups off a shared counter until the
+ * grid is exhausted.  Each thread owns the shared memory and the scratch
+ * space of the workgroup it is running.
+ */
+
+#include "pipe/p_defines.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_math.h"
+#include "util/u_atomic.h"
+#include "util/u_format.h"
+#include "util/u_string.h"
+#include "util/simple_list.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_struct.h"
+#include "gallivm/lp_bld_tgsi.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_jit.h"
+#include "lp_limits.h"
+#include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_setup.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+
+/** counter for tracking number of compute shaders created */
+static unsigned cs_no = 0;
+
+
+/**
+ * The SIMD type compute shaders are run with, one invocation per element.
+ */
+static struct lp_type
+lp_cs_type(void)
+{
+   struct lp_type cs_type;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+
+   return cs_type;
+}
+
+
+/**
+ * This is the bridge between the compute jit context/thread data and the
+ * TGSI translator's compute interface.
+ */
+struct lp_cs_llvm_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+   unsigned shared_size;
+};
+
+
+static LLVMValueRef
+lp_cs_llvm_fetch_ssbo(const struct lp_build_tgsi_cs_iface *cs_iface,
+                      struct lp_build_tgsi_context *bld_base,
+                      LLVMValueRef index,
+                      LLVMValueRef *size)
+{
+   const struct lp_cs_llvm_iface *iface =
+      (const struct lp_cs_llvm_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMTypeRef i8p_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   LLVMValueRef ssbos_ptr, num_ssbos_ptr, ptr;
+
+   ssbos_ptr = lp_jit_cs_context_ssbos(gallivm, iface->context_ptr);
+   num_ssbos_ptr = lp_jit_cs_context_num_ssbos(gallivm, iface->context_ptr);
+
+   ptr = lp_build_array_get(gallivm, ssbos_ptr, index);
+   *size = lp_build_array_get(gallivm, num_ssbos_ptr, index);
+
+   return LLVMBuildBitCast(gallivm->builder, ptr, i8p_type, "");
+}
+
+
+static LLVMValueRef
+lp_cs_llvm_fetch_shared(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context *bld_base,
+                        LLVMValueRef *size)
+{
+   const struct lp_cs_llvm_iface *iface =
+      (const struct lp_cs_llvm_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+
+   *size = lp_build_const_int32(gallivm, iface->shared_size);
+
+   return lp_jit_cs_thread_data_shared(gallivm, iface->thread_data_ptr);
+}
+
+
+static LLVMValueRef
+lp_cs_llvm_fetch_scratch(const struct lp_build_tgsi_cs_iface *cs_iface,
+                         struct lp_build_tgsi_context *bld_base)
+{
+   const struct lp_cs_llvm_iface *iface =
+      (const struct lp_cs_llvm_iface *)cs_iface;
+
+   return lp_jit_cs_thread_data_scratch(bld_base->base.gallivm,
+                                        iface->thread_data_ptr);
+}
+
+
+/**
+ * Generate the function running one workgroup.
+ * Any change to the prototype must be reflected in lp_jit.h's
+ * lp_jit_cs_func function pointer type, and vice-versa.
+ */
+static void
+generate_compute(struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   const struct lp_compute_shader_variant_key *key = &variant->key;
+   struct lp_type cs_type = lp_cs_type();
+   char func_name[64];
+   LLVMTypeRef arg_types[11];
+   LLVMTypeRef func_type;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef function;
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_image_soa *image;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_cs_llvm_iface cs_iface;
+   unsigned i;
+
+   util_snprintf(func_name, sizeof(func_name), "cs%u_variant%u",
+                 shader->no, variant->no);
+
+   arg_types[0] = variant->jit_cs_context_ptr_type;    /* context */
+   arg_types[1] = int32_type;                          /* x */
+   arg_types[2] = int32_type;                          /* y */
+   arg_types[3] = int32_type;                          /* z */
+   arg_types[4] = int32_type;                          /* grid_x */
+   arg_types[5] = int32_type;                          /* grid_y */
+   arg_types[6] = int32_type;                          /* grid_z */
+   arg_types[7] = int32_type;                          /* block_x */
+   arg_types[8] = int32_type;                          /* block_y */
+   arg_types[9] = int32_type;                          /* block_z */
+   arg_types[10] = variant->jit_cs_thread_data_ptr_type;  /* per thread data */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   memset(&system_values, 0, sizeof system_values);
+
+   context_ptr = LLVMGetParam(function, 0);
+   for (i = 0; i < 3; i++) {
+      system_values.block_id[i] = LLVMGetParam(function, 1 + i);
+      system_values.grid_size[i] = LLVMGetParam(function, 4 + i);
+      system_values.block_size[i] = LLVMGetParam(function, 7 + i);
+   }
+   thread_data_ptr = LLVMGetParam(function, 10);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(system_values.block_id[0], "x");
+   lp_build_name(system_values.block_id[1], "y");
+   lp_build_name(system_values.block_id[2], "z");
+   lp_build_name(system_values.grid_size[0], "grid_x");
+   lp_build_name(system_values.grid_size[1], "grid_y");
+   lp_build_name(system_values.grid_size[2], "grid_z");
+   lp_build_name(system_values.block_size[0], "block_x");
+   lp_build_name(system_values.block_size[1], "block_y");
+   lp_build_name(system_values.block_size[2], "block_z");
+   lp_build_name(thread_data_ptr, "thread_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   /* code generated texture sampling and image access */
+   sampler = lp_llvm_cs_sampler_soa_create(key->state);
+   image = lp_llvm_image_soa_create(key->image_state);
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   memset(&cs_iface, 0, sizeof cs_iface);
+   cs_iface.base.image = image;
+   cs_iface.base.fetch_ssbo = lp_cs_llvm_fetch_ssbo;
+   cs_iface.base.fetch_shared = lp_cs_llvm_fetch_shared;
+   cs_iface.base.fetch_scratch = lp_cs_llvm_fetch_scratch;
+   cs_iface.context_ptr = context_ptr;
+   cs_iface.thread_data_ptr = thread_data_ptr;
+   cs_iface.shared_size = shader->req_local_mem;
+
+   lp_build_tgsi_soa(gallivm, shader->base.tokens, cs_type, NULL,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, thread_data_ptr,
+                     sampler, &shader->info.base, NULL, &cs_iface.base);
+
+   LLVMBuildRetVoid(builder);
+
+   sampler->destroy(sampler);
+   image->destroy(image);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+                 shader->no, shader->variants_created);
+
+   variant->gallivm = gallivm_create(module_name, lp->context);
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
+   variant->shader = shader;
+   variant->list_item.base = variant;
+   variant->no = shader->variants_created++;
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs = lp_build_count_ir_module(variant->gallivm->module);
+
+   variant->jit_function = (lp_jit_cs_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return variant;
+}
+
+
+static void
+remove_cs_variant(struct llvmpipe_context *lp,
+                  struct lp_compute_shader_variant *variant)
+{
+   if (LP_DEBUG & DEBUG_FS) {
+      debug_printf("llvmpipe: del cs #%u var %u v created %u v cached %u "
+                   "v total cached %u inst %u total inst %u\n",
+                   variant->shader->no, variant->no,
+                   variant->shader->variants_created,
+                   variant->shader->variants_cached,
+                   lp->nr_cs_variants, variant->nr_instrs, lp->nr_cs_instrs);
+   }
+
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item);
+   variant->shader->nr_variants--;
+   lp->nr_cs_variants--;
+   lp->nr_cs_instrs -= variant->nr_instrs;
+
+   FREE(variant);
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+   int nr_samplers;
+   int nr_sampler_views;
+
+   if (templ->ir_type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   make_empty_list(&shader->variants);
+
+   /* we need to keep a local copy of the tokens */
+   shader->base.tokens = tgsi_dup_tokens(templ->prog);
+   if (!shader->base.tokens) {
+      FREE(shader);
+      return NULL;
+   }
+
+   /* get/save the summary info for this shader */
+   lp_build_tgsi_info(shader->base.tokens, &shader->info);
+
+   shader->req_local_mem = templ->req_local_mem;
+
+   nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+   nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+
+   shader->variant_key_size = Offset(struct lp_compute_shader_variant_key,
+                                     state[MAX2(nr_samplers, nr_sampler_views)]);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->base.tokens, 0);
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = cs;
+   struct lp_cs_variant_list_item *li;
+
+   assert(llvmpipe->cs != shader);
+
+   /* Delete all the variants */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      struct lp_cs_variant_list_item *next = next_elem(li);
+      remove_cs_variant(llvmpipe, li->base);
+      li = next;
+   }
+
+   assert(shader->nr_variants == 0);
+
+   FREE((void *) shader->base.tokens);
+   FREE(shader);
+}
+
+
+/**
+ * The static state of a shader image. Images are always accessed at a
+ * single level, and without swizzles.
+ */
+static void
+lp_cs_static_image_state(struct lp_static_texture_state *state,
+                         const struct pipe_image_view *view)
+{
+   const struct pipe_resource *res = view->resource;
+
+   memset(state, 0, sizeof *state);
+
+   /* Display targets are not mapped while shaders run, leave them unbound */
+   if (!res || llvmpipe_resource_const(res)->dt)
+      return;
+
+   state->format = view->format;
+   state->swizzle_r = PIPE_SWIZZLE_X;
+   state->swizzle_g = PIPE_SWIZZLE_Y;
+   state->swizzle_b = PIPE_SWIZZLE_Z;
+   state->swizzle_a = PIPE_SWIZZLE_W;
+   state->target = res->target;
+   state->level_zero_only = TRUE;
+}
+
+
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant_key *key)
+{
+   unsigned i;
+
+   memset(key, 0, shader->variant_key_size);
+
+   key->nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   /* Same as for fragment shaders, see make_variant_key in lp_state_fs.c */
+   if (shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+
+   key->nr_images = shader->info.base.file_max[TGSI_FILE_IMAGE] + 1;
+   assert(key->nr_images <= LP_MAX_TGSI_SHADER_IMAGES);
+
+   for (i = 0; i < key->nr_images; ++i) {
+      lp_cs_static_image_state(&key->image_state[i], &lp->cs_images[i]);
+   }
+}
+
+
+/**
+ * Find or create the variant of the bound compute shader matching the
+ * current state.
+ */
+static struct lp_compute_shader_variant *
+llvmpipe_update_cs(struct llvmpipe_context *lp)
+{
+   struct lp_compute_shader *shader = lp->cs;
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant = NULL;
+   struct lp_cs_variant_list_item *li;
+
+   make_variant_key(lp, shader, &key);
+
+   /* Search the variants for one which matches the key */
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      /* Move this variant to the head of the list to implement LRU
+       * deletion of shaders when we have too many.
+       */
+      move_to_head(&shader->variants, &variant->list_item);
+      shader->variants_cached++;
+      return variant;
+   }
+
+   /*
+    * Make a new variant, dropping the least recently used one of the
+    * shader if there are too many.
+    */
+   if (shader->nr_variants >= LP_MAX_CS_VARIANTS) {
+      remove_cs_variant(lp, last_elem(&shader->variants)->base);
+   }
+
+   variant = generate_variant(lp, shader, &key);
+   if (!variant)
+      return NULL;
+
+   insert_at_head(&shader->variants, &variant->list_item);
+   shader->nr_variants++;
+   lp->nr_cs_variants++;
+   lp->nr_cs_instrs += variant->nr_instrs;
+
+   return variant;
+}
+
+
+/**
+ * Fill in a jit image for the given image view.
+ * Layered views of array, cube and 3D textures start at their first layer.
+ */
+static void
+lp_cs_jit_image(struct lp_jit_image *jit_image,
+                const struct pipe_image_view *view)
+{
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lp_res = llvmpipe_resource(res);
+
+   if (llvmpipe_resource_is_texture(res)) {
+      unsigned level = view->u.tex.level;
+
+      assert(level <= res->last_level);
+      assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+
+      jit_image->width = u_minify(res->width0, level);
+      jit_image->height = u_minify(res->height0, level);
+      jit_image->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+      jit_image->row_stride = lp_res->row_stride[level];
+      jit_image->img_stride = lp_res->img_stride[level];
+      jit_image->base = (uint8_t *)lp_res->tex_data +
+                        lp_res->mip_offsets[level] +
+                        view->u.tex.first_layer * lp_res->img_stride[level];
+   }
+   else {
+      /* everything specified in number of elements here. */
+      unsigned view_blocksize = util_format_get_blocksize(view->format);
+
+      assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+
+      jit_image->width = view->u.buf.size / view_blocksize;
+      jit_image->height = 1;
+      jit_image->depth = 1;
+      jit_image->row_stride = 0;
+      jit_image->img_stride = 0;
+      jit_image->base = (uint8_t *)lp_res->data + view->u.buf.offset;
+   }
+}
+
+
+/**
+ * Gather the resources bound to the compute stage into a jit context.
+ * Grid launches are synchronous, so the context directly references the
+ * application's memory.
+ */
+static void
+lp_cs_update_jit_context(struct llvmpipe_context *lp,
+                         struct lp_jit_cs_context *jit_context)
+{
+   /*
+    * Unbound buffers still need to point to some readable memory, as
+    * out of bounds lanes may be loaded before being masked out.
+    */
+   static const float fake_const_buf[4];
+   static const uint32_t fake_ssbo_buf[4];
+   unsigned i;
+
+   memset(jit_context, 0, sizeof *jit_context);
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; ++i) {
+      const struct pipe_constant_buffer *cb =
+         &lp->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer) {
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      }
+      else if (cb->user_buffer) {
+         data = (const ubyte *) cb->user_buffer;
+      }
+
+      if (data) {
+         jit_context->constants[i] =
+            (const float *)(data + cb->buffer_offset);
+         jit_context->num_constants[i] =
+            MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE) /
+            (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < lp->num_sampler_views[PIPE_SHADER_COMPUTE]; ++i) {
+      const struct pipe_sampler_view *view =
+         lp->sampler_views[PIPE_SHADER_COMPUTE][i];
+
+      if (view)
+         lp_setup_jit_texture(&jit_context->textures[i], view);
+   }
+
+   for (i = 0; i < lp->num_samplers[PIPE_SHADER_COMPUTE]; ++i) {
+      const struct pipe_sampler_state *sampler =
+         lp->samplers[PIPE_SHADER_COMPUTE][i];
+
+      if (sampler) {
+         struct lp_jit_sampler *jit_sam = &jit_context->samplers[i];
+
+         jit_sam->min_lod = sampler->min_lod;
+         jit_sam->max_lod = sampler->max_lod;
+         jit_sam->lod_bias = sampler->lod_bias;
+         COPY_4V(jit_sam->border_color, sampler->border_color.f);
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_IMAGES; ++i) {
+      const struct pipe_image_view *view = &lp->cs_images[i];
+
+      if (view->resource && !llvmpipe_resource(view->resource)->dt)
+         lp_cs_jit_image(&jit_context->images[i], view);
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; ++i) {
+      const struct pipe_shader_buffer *buf = &lp->cs_ssbos[i];
+
+      if (buf->buffer) {
+         jit_context->ssbos[i] = (const uint32_t *)
+            ((const ubyte *) llvmpipe_resource_data(buf->buffer) +
+             buf->buffer_offset);
+         jit_context->num_ssbos[i] = buf->buffer_size;
+      }
+      else {
+         jit_context->ssbos[i] = fake_ssbo_buf;
+         jit_context->num_ssbos[i] = 0;
+      }
+   }
+}
+
+
+/**
+ * A grid being run on the rasterizer threads.
+ */
+struct lp_cs_job
+{
+   lp_jit_cs_func jit_function;
+   const struct lp_jit_cs_context *jit_context;
+
+   unsigned grid[3];
+   unsigned block[3];
+
+   /** Bytes of shared and scratch memory per workgroup */
+   unsigned shared_size;
+   unsigned scratch_size;
+
+   int64_t num_groups;
+   int64_t next_group;  /**< next workgroup to run, atomically incremented */
+};
+
+
+/**
+ * Run workgroups until the grid is exhausted.  Called once on each
+ * rasterizer thread.
+ */
+static void
+lp_cs_job_run(void *data,
+              unsigned thread_index,
+              struct lp_build_format_cache *cache)
+{
+   struct lp_cs_job *job = (struct lp_cs_job *) data;
+   struct lp_jit_cs_thread_data thread_data;
+   int64_t group;
+
+   thread_data.cache = cache;
+   thread_data.shared = NULL;
+   thread_data.scratch = NULL;
+
+   /* Allocated from the thread itself, so that it lands on its node */
+   if (job->shared_size) {
+      thread_data.shared = align_malloc(job->shared_size, 16);
+      if (!thread_data.shared)
+         goto out;
+   }
+
+   if (job->scratch_size) {
+      thread_data.scratch = align_malloc(job->scratch_size, 64);
+      if (!thread_data.scratch)
+         goto out;
+   }
+
+   /*
+    * The other threads will pick up the workgroups of a thread which failed
+    * to allocate its memory.
+    */
+   while ((group = p_atomic_inc_return(&job->next_group) - 1) <
+          job->num_groups) {
+      unsigned x = group % job->grid[0];
+      unsigned y = (group / job->grid[0]) % job->grid[1];
+      unsigned z = group / ((int64_t)job->grid[0] * job->grid[1]);
+
+      job->jit_function(job->jit_context,
+                        x, y, z,
+                        job->grid[0], job->grid[1], job->grid[2],
+                        job->block[0], job->block[1], job->block[2],
+                        &thread_data);
+   }
+
+out:
+   if (thread_data.shared)
+      align_free(thread_data.shared);
+   if (thread_data.scratch)
+      align_free(thread_data.scratch);
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_jit_cs_context jit_context;
+   struct lp_cs_job job;
+   unsigned block_threads;
+   unsigned i;
+
+   if (!shader)
+      return;
+
+   if (!llvmpipe_check_render_cond(llvmpipe))
+      return;
+
+   /*
+    * Grids are run synchronously: wait for the queued rendering to
+    * finish before the grid touches the resources it used, and the
+    * grid's results are then visible to anything done afterwards.
+    */
+   llvmpipe_finish(pipe, __FUNCTION__);
+
+   memset(&job, 0, sizeof job);
+
+   if (info->indirect) {
+      const uint32_t *indirect = (const uint32_t *)
+         ((const ubyte *) llvmpipe_resource_data(info->indirect) +
+          info->indirect_offset);
+      for (i = 0; i < 3; i++)
+         job.grid[i] = indirect[i];
+   }
+   else {
+      for (i = 0; i < 3; i++)
+         job.grid[i] = info->grid[i];
+   }
+
+   for (i = 0; i < 3; i++)
+      job.block[i] = info->block[i];
+
+   job.num_groups = (int64_t)job.grid[0] * job.grid[1] * job.grid[2];
+   block_threads = job.block[0] * job.block[1] * job.block[2];
+   if (!job.num_groups || !block_threads)
+      return;
+
+   variant = llvmpipe_update_cs(llvmpipe);
+   if (!variant)
+      return;
+
+   lp_cs_update_jit_context(llvmpipe, &jit_context);
+
+   job.jit_function = variant->jit_function;
+   job.jit_context = &jit_context;
+   job.shared_size = shader->req_local_mem;
+   job.scratch_size =
+      lp_build_tgsi_cs_scratch_size(&shader->info.base, lp_cs_type()) *
+      DIV_ROUND_UP(block_threads, lp_cs_type().length);
+
+   pipe_mutex_lock(screen->rast_mutex);
+   lp_rast_run_job(screen->rast, lp_cs_job_run, &job);
+   pipe_mutex_unlock(screen->rast_mutex);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only compute shaders can access buffers */
+   if (shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->cs_ssbos));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->cs_ssbos[start_slot + i];
+
+      if (buffers && buffers[i].buffer) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   /* Only compute shaders can access images */
+   if (shader != PIPE_SHADER_COMPUTE)
+      return;
+
+   assert(start_slot + count <= ARRAY_SIZE(llvmpipe->cs_images));
+
+   for (i = 0; i < count; i++) {
+      struct pipe_image_view *dst = &llvmpipe->cs_images[start_slot + i];
+
+      if (images && images[i].resource) {
+         pipe_resource_reference(&dst->resource, images[i].resource);
+         dst->format = images[i].format;
+         dst->access = images[i].access;
+         dst->u = images[i].u;
+      }
+      else {
+         pipe_resource_reference(&dst->resource, NULL);
+         memset(dst, 0, sizeof *dst);
+      }
+   }
+}
+
+
+/**
+ * Shader memory accesses are always coherent: grids are run synchronously,
+ * after the rendering before them has completed.
+ */
+static void
+llvmpipe_memory_barrier(struct pipe_context *pipe, unsigned flags)
+{
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+   llvmpipe->pipe.memory_barrier = llvmpipe_memory_barrier;
+}
+
+
+/**
+ * Release the buffers and images bound to the compute stage.
+ */
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe)
+{
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->cs_ssbos); i++)
+      pipe_resource_reference(&llvmpipe->cs_ssbos[i].buffer, NULL);
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->cs_images); i++)
+      pipe_resource_reference(&llvmpipe->cs_images[i].resource, NULL);
+}
@@ -62,6 +62,9 @@
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_pointer.h"
+#include "util/u_atomic.h"
+#include "util/u_hash_table.h"
+#include "util/crc32.h"
 #include "util/u_format.h"
 #include "util/u_dump.h"
 #include "util/u_string.h"
@@ -101,6 +104,7 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_screen.h"
 
 
 /** Fragment shader number (for debugging) */
@@ -477,7 +481,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL, NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -1702,7 +1706,8 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   /* fs_type is never wider than 8 x 32 here, see generate_fragment */
+   vector_width    = dst_type.floating ? fs_type.width * fs_type.length : lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2177,8 +2182,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2214,7 +2218,11 @@ generate_fragment(struct llvmpipe_context *lp,
    LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][16 / 4];
    LLVMValueRef function;
    LLVMValueRef facing;
+   LLVMValueRef i32_zero;
+   LLVMTypeRef color_ptr_type;
+   struct lp_type blend_fs_type;
    unsigned num_fs;
+   unsigned num_blend_fs;
    unsigned i;
    unsigned chan;
    unsigned cbuf;
@@ -2249,6 +2257,10 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
    fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   if (key->resource_1d && fs_type.length == 16) {
+      /* only the upper half of the stamp is shaded for 1d resources */
+      fs_type.length = 8;
+   }
 
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
@@ -2266,8 +2278,17 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /*
+    * Functions are resolved by name in cached object code, so don't let the
+    * name depend on the order shaders and variants were created in.
+    */
+   if (gallivm->cache) {
+      util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                    partial_mask ? "partial" : "whole");
+   } else {
+      util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
+                    shader->no, variant->no, partial_mask ? "partial" : "whole");
+   }
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2337,6 +2358,8 @@ generate_fragment(struct llvmpipe_context *lp,
    /* code generated texture sampling */
    sampler = lp_llvm_sampler_soa_create(key->state);
 
+   i32_zero = lp_build_const_int32(gallivm, 0);
+
    num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
    /* for 1d resources only run "upper half" of stamp */
    if (key->resource_1d)
@@ -2397,26 +2420,48 @@ generate_fragment(struct llvmpipe_context *lp,
                        facing,
                        thread_data_ptr);
 
-      for (i = 0; i < num_fs; i++) {
+      /*
+       * Blending works on at most 8 pixels per vector.  A 16-wide vector
+       * holds the whole 4x4 stamp, in the same pixel order as two 8-wide
+       * ones, so simply hand it over as two halves.
+       */
+      blend_fs_type = fs_type;
+      num_blend_fs = num_fs;
+      if (fs_type.length == 16) {
+         blend_fs_type.length = 8;
+         num_blend_fs = 2;
+      }
+      color_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, blend_fs_type), 0);
+
+      for (i = 0; i < num_blend_fs; i++) {
          LLVMValueRef indexi = lp_build_const_int32(gallivm, i);
-         LLVMValueRef ptr = LLVMBuildGEP(builder, mask_store,
-                                         &indexi, 1, "");
-         fs_mask[i] = LLVMBuildLoad(builder, ptr, "mask");
+         LLVMValueRef ptr;
+         if (fs_type.length == 16) {
+            ptr = LLVMBuildGEP(builder, mask_store, &i32_zero, 1, "");
+            fs_mask[i] = lp_build_extract_range(gallivm,
+                                                LLVMBuildLoad(builder, ptr, "mask"),
+                                                i * 8, 8);
+         }
+         else {
+            ptr = LLVMBuildGEP(builder, mask_store, &indexi, 1, "");
+            fs_mask[i] = LLVMBuildLoad(builder, ptr, "mask");
+         }
          /* This is fucked up need to reorganize things */
          for (cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
-               ptr = LLVMBuildGEP(builder,
-                                  color_store[cbuf * !cbuf0_write_all][chan],
-                                  &indexi, 1, "");
+               ptr = LLVMBuildBitCast(builder,
+                                      color_store[cbuf * !cbuf0_write_all][chan],
+                                      color_ptr_type, "");
+               ptr = LLVMBuildGEP(builder, ptr, &indexi, 1, "");
                fs_out_color[cbuf][chan][i] = ptr;
             }
          }
          if (dual_source_blend) {
             /* only support one dual source blend target hence always use output 1 */
             for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
-               ptr = LLVMBuildGEP(builder,
-                                  color_store[1][chan],
-                                  &indexi, 1, "");
+               ptr = LLVMBuildBitCast(builder, color_store[1][chan],
+                                      color_ptr_type, "");
+               ptr = LLVMBuildGEP(builder, ptr, &indexi, 1, "");
                fs_out_color[1][chan][i] = ptr;
             }
          }
@@ -2451,7 +2496,8 @@ generate_fragment(struct llvmpipe_context *lp,
 
          generate_unswizzled_blend(gallivm, cbuf, variant,
                                    key->cbuf_format[cbuf],
-                                   num_fs, fs_type, fs_mask, fs_out_color,
+                                   num_blend_fs, blend_fs_type,
+                                   fs_mask, fs_out_color,
                                    context_ptr, color_ptr, stride,
                                    partial_mask, do_branch);
       }
@@ -2566,6 +2612,379 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Compute the disk cache key of a variant's code.
+ */
+static void
+get_variant_cache_key(struct llvmpipe_screen *screen,
+                      const struct lp_fragment_shader_variant *variant,
+                      cache_key sha1)
+{
+   const struct lp_fragment_shader *shader = variant->shader;
+
+   lp_disk_cache_compute_key(screen, "fs", shader->base.tokens,
+                             tgsi_num_tokens(shader->base.tokens) *
+                             sizeof(struct tgsi_token),
+                             &variant->key, shader->variant_key_size, sha1);
+}
+
+
+static void
+fs_code_destroy(struct lp_fs_variant_code *code)
+{
+   if (code->gallivm)
+      gallivm_destroy(code->gallivm);
+   if (code->fallback_gallivm)
+      gallivm_destroy(code->fallback_gallivm);
+   FREE((void *) code->tokens);
+   FREE(code);
+}
+
+
+static inline void
+fs_code_reference(struct lp_fs_variant_code **ptr,
+                  struct lp_fs_variant_code *code)
+{
+   struct lp_fs_variant_code *old = *ptr;
+
+   if (pipe_reference(old ? &old->reference : NULL,
+                      code ? &code->reference : NULL)) {
+      fs_code_destroy(old);
+   }
+   *ptr = code;
+}
+
+
+static unsigned
+fs_code_hash(void *key)
+{
+   struct lp_fs_variant_code *code = key;
+   return code->hash;
+}
+
+
+static int
+fs_code_compare(void *key1, void *key2)
+{
+   struct lp_fs_variant_code *a = key1;
+   struct lp_fs_variant_code *b = key2;
+
+   return a->hash != b->hash ||
+          a->key_size != b->key_size ||
+          a->num_tokens != b->num_tokens ||
+          memcmp(a->key, b->key, a->key_size) != 0 ||
+          memcmp(a->tokens, b->tokens,
+                 a->num_tokens * sizeof(struct tgsi_token)) != 0;
+}
+
+
+boolean
+llvmpipe_init_fs_code_table(struct llvmpipe_screen *screen)
+{
+   screen->fs_code_table = util_hash_table_create(fs_code_hash,
+                                                  fs_code_compare);
+   if (!screen->fs_code_table)
+      return FALSE;
+
+   make_empty_list(&screen->fs_code_list);
+   pipe_mutex_init(screen->fs_code_mutex);
+   return TRUE;
+}
+
+
+/**
+ * Remove code from the screen's table and drop the table's reference.
+ * Contexts still using the code keep it alive.
+ */
+static void
+fs_code_table_remove(struct llvmpipe_screen *screen,
+                     struct lp_fs_variant_code *code)
+{
+   util_hash_table_remove(screen->fs_code_table, code);
+   remove_from_list(&code->list_item);
+   screen->nr_fs_codes--;
+   screen->nr_fs_code_instrs -= code->nr_instrs;
+   fs_code_reference(&code, NULL);
+}
+
+
+void
+llvmpipe_destroy_fs_code_table(struct llvmpipe_screen *screen)
+{
+   if (!screen->fs_code_table)
+      return;
+
+   while (!is_empty_list(&screen->fs_code_list)) {
+      fs_code_table_remove(screen, last_elem(&screen->fs_code_list)->base);
+   }
+
+   util_hash_table_destroy(screen->fs_code_table);
+   pipe_mutex_destroy(screen->fs_code_mutex);
+}
+
+
+/**
+ * Look up code compiled by any context of the screen.
+ * \return a new reference to the code, or NULL
+ */
+static struct lp_fs_variant_code *
+fs_code_table_find(struct llvmpipe_screen *screen,
+                   struct lp_fs_variant_code *templ)
+{
+   struct lp_fs_variant_code *code = NULL;
+   struct lp_fs_variant_code *found;
+
+   pipe_mutex_lock(screen->fs_code_mutex);
+   found = util_hash_table_get(screen->fs_code_table, templ);
+   if (found) {
+      move_to_head(&screen->fs_code_list, &found->list_item);
+      fs_code_reference(&code, found);
+   }
+   pipe_mutex_unlock(screen->fs_code_mutex);
+
+   return code;
+}
+
+
+/**
+ * Share newly compiled code with the other contexts.  If the table is
+ * full, free 25% of it (the least recently used code).
+ */
+static void
+fs_code_table_insert(struct llvmpipe_screen *screen,
+                     struct lp_fs_variant_code *code)
+{
+   pipe_mutex_lock(screen->fs_code_mutex);
+
+   /* Another context may have compiled the same code meanwhile */
+   if (!util_hash_table_get(screen->fs_code_table, code)) {
+      unsigned to_cull, i;
+
+      to_cull = screen->nr_fs_codes >= LP_MAX_SHADER_VARIANTS ?
+                LP_MAX_SHADER_VARIANTS / 4 : 0;
+
+      for (i = 0; i < to_cull ||
+                  screen->nr_fs_code_instrs >= LP_MAX_SHADER_INSTRUCTIONS; i++) {
+         if (is_empty_list(&screen->fs_code_list))
+            break;
+         fs_code_table_remove(screen, last_elem(&screen->fs_code_list)->base);
+      }
+
+      /* The table's reference */
+      pipe_reference(NULL, &code->reference);
+      util_hash_table_set(screen->fs_code_table, code, code);
+      insert_at_head(&screen->fs_code_list, &code->list_item);
+      screen->nr_fs_codes++;
+      screen->nr_fs_code_instrs += code->nr_instrs;
+   }
+
+   pipe_mutex_unlock(screen->fs_code_mutex);
+}
+
+
+/**
+ * Generate and compile the code of a variant in the given LLVM context,
+ * and make variant->code->jit_function[] point to it.
+ * \param cached  disk cache entry of the code, or NULL to not use the cache
+ * \param no_opt  generate unoptimized code quickly, as the fallback code
+ * \return number of LLVM instructions generated, zero on failure
+ */
+static unsigned
+compile_variant(struct lp_fragment_shader_variant *variant,
+                LLVMContextRef context,
+                struct lp_cached_code *cached,
+                cache_key sha1,
+                boolean no_opt)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   struct lp_fs_variant_code *code = variant->code;
+   struct gallivm_state *gallivm;
+   lp_jit_frag_func jit_function[2];
+   char module_name[64];
+   unsigned nr_instrs;
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+                 shader->no, variant->no);
+
+   gallivm = gallivm_create(module_name, context);
+   if (!gallivm)
+      return 0;
+
+   gallivm->cache = cached;
+   gallivm->no_opt = no_opt;
+
+   /* Types and functions of any previous compilation belong to its context */
+   variant->gallivm = gallivm;
+   variant->jit_context_ptr_type = NULL;
+   variant->jit_thread_data_ptr_type = NULL;
+   variant->jit_linear_context_ptr_type = NULL;
+   variant->function[RAST_WHOLE] = NULL;
+   variant->function[RAST_EDGE_TEST] = NULL;
+
+   lp_jit_init_types(variant);
+
+   generate_fragment(shader, variant, RAST_EDGE_TEST);
+
+   if (variant->opaque) {
+      /* Specialized shader, which doesn't need to read the color buffer. */
+      generate_fragment(shader, variant, RAST_WHOLE);
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(gallivm);
+
+   nr_instrs = lp_build_count_ir_module(gallivm->module);
+
+   jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+         gallivm_jit_function(gallivm, variant->function[RAST_EDGE_TEST]);
+
+   if (variant->function[RAST_WHOLE]) {
+      jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+            gallivm_jit_function(gallivm, variant->function[RAST_WHOLE]);
+   } else {
+      jit_function[RAST_WHOLE] = jit_function[RAST_EDGE_TEST];
+   }
+
+   if (cached)
+      lp_disk_cache_insert_code(variant->screen, cached, sha1);
+
+   gallivm_free_ir(gallivm);
+   gallivm->cache = NULL;
+   variant->gallivm = NULL;
+
+   if (no_opt)
+      code->fallback_gallivm = gallivm;
+   else
+      code->gallivm = gallivm;
+
+   /*
+    * The rasterizer threads may still be running the fallback code;
+    * they'll pick up the new code with the next tile.
+    */
+   code->jit_function[RAST_WHOLE] = jit_function[RAST_WHOLE];
+   code->jit_function[RAST_EDGE_TEST] = jit_function[RAST_EDGE_TEST];
+
+   return nr_instrs;
+}
+
+
+/**
+ * util_queue job compiling the optimized code of a variant, using its own
+ * LLVM context as the contexts are not thread safe.
+ */
+static void
+compile_variant_async(void *data, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+   struct llvmpipe_screen *screen = variant->screen;
+   struct lp_cached_code cached;
+   LLVMContextRef context;
+   cache_key sha1;
+
+   context = LLVMContextCreate();
+   if (!context)
+      return;
+
+   memset(&cached, 0, sizeof cached);
+   if (screen->disk_cache)
+      get_variant_cache_key(screen, variant, sha1);
+
+   if (compile_variant(variant, context,
+                       screen->disk_cache ? &cached : NULL, sha1, FALSE)) {
+      p_atomic_set(&variant->code->fallback, 0);
+   }
+
+   LLVMContextDispose(context);
+}
+
+
+/**
+ * Get the code of a variant, either compiled by another context or by
+ * compiling it now.
+ * \return FALSE on failure
+ */
+static boolean
+get_variant_code(struct llvmpipe_context *lp,
+                 struct lp_fragment_shader_variant *variant)
+{
+   struct llvmpipe_screen *screen = variant->screen;
+   struct lp_fragment_shader *shader = variant->shader;
+   struct lp_fs_variant_code templ, *code;
+   struct lp_cached_code cached;
+   cache_key sha1;
+
+   memset(&templ, 0, sizeof templ);
+   templ.tokens = shader->base.tokens;
+   templ.num_tokens = tgsi_num_tokens(shader->base.tokens);
+   templ.key = &variant->key;
+   templ.key_size = shader->variant_key_size;
+   templ.hash = util_hash_crc32(templ.tokens,
+                                templ.num_tokens * sizeof(struct tgsi_token)) ^
+                util_hash_crc32(templ.key, templ.key_size);
+
+   variant->code = fs_code_table_find(screen, &templ);
+   if (variant->code)
+      return TRUE;
+
+   /* The key copy follows the code in the same allocation */
+   code = CALLOC(1, sizeof *code + templ.key_size);
+   if (!code)
+      return FALSE;
+
+   pipe_reference_init(&code->reference, 1);
+   code->tokens = tgsi_dup_tokens(templ.tokens);
+   code->num_tokens = templ.num_tokens;
+   code->key = memcpy(code + 1, templ.key, templ.key_size);
+   code->key_size = templ.key_size;
+   code->hash = templ.hash;
+   code->list_item.base = code;
+   variant->code = code;
+   if (!code->tokens)
+      goto fail;
+
+   memset(&cached, 0, sizeof cached);
+   if (screen->disk_cache) {
+      get_variant_cache_key(screen, variant, sha1);
+      lp_disk_cache_find_code(screen, &cached, sha1);
+   }
+
+   if (util_queue_is_initialized(&screen->compile_queue) && !cached.data) {
+      /*
+       * Don't stall the draw on LLVM optimizations: serve it with quickly
+       * generated code and swap in the optimized code once it's compiled.
+       */
+      code->nr_instrs = compile_variant(variant, lp->context,
+                                        NULL, NULL, TRUE);
+      if (!code->nr_instrs)
+         goto fail;
+
+      code->fallback = 1;
+      util_queue_add_job(&screen->compile_queue, variant,
+                         &variant->compile_fence,
+                         compile_variant_async, NULL);
+   }
+   else {
+      code->nr_instrs = compile_variant(variant, lp->context,
+                                        screen->disk_cache ? &cached : NULL,
+                                        sha1, FALSE);
+      if (!code->nr_instrs) {
+         free(cached.data);
+         goto fail;
+      }
+   }
+
+   fs_code_table_insert(screen, code);
+   return TRUE;
+
+fail:
+   fs_code_reference(&variant->code, NULL);
+   return FALSE;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
@@ -2578,25 +2997,17 @@ generate_variant(struct llvmpipe_context *lp,
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
-
    variant->shader = shader;
+   variant->screen = llvmpipe_screen(lp->pipe.screen);
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
+   util_queue_fence_init(&variant->compile_fence);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -2631,42 +3042,12 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   /*
-    * Compile everything
-    */
-
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
-   }
-
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   if (!get_variant_code(lp, variant)) {
+      util_queue_fence_destroy(&variant->compile_fence);
+      FREE(variant);
+      return NULL;
    }
 
-   gallivm_free_ir(variant->gallivm);
-
    return variant;
 }
 
@@ -2802,7 +3183,12 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants);
    }
 
-   gallivm_destroy(variant->gallivm);
+   /* The optimized code may still be compiling */
+   util_queue_job_wait(&variant->compile_fence);
+   util_queue_fence_destroy(&variant->compile_fence);
+
+   lp->nr_fs_instrs -= variant->code->nr_instrs;
+   fs_code_reference(&variant->code, NULL);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -2810,8 +3196,9 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 
    /* remove from context's list */
    remove_from_list(&variant->list_item_global);
+   if (lp->fs_variant == variant)
+      lp->fs_variant = NULL;
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
 
    FREE(variant);
 }
@@ -2894,7 +3281,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3212,12 +3599,13 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
+         lp->nr_fs_instrs += variant->code->nr_instrs;
          shader->variants_cached++;
       }
    }
 
    /* Bind this variant */
+   lp->fs_variant = variant;
    lp_setup_set_fs_variant(lp->setup, variant);
 }
 
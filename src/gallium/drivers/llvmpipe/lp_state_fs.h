@@ -35,11 +35,17 @@
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "util/u_queue.h"
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
+#include "lp_jit.h" /* for lp_jit_frag_func */
+#include "lp_screen.h" /* for struct lp_fs_code_list_item */
 
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_variant_code;
+struct llvmpipe_context;
+struct llvmpipe_screen;
 
 
 /** Indexes into jit_function[] array */
@@ -93,6 +99,43 @@ struct lp_fs_variant_list_item
 };
 
 
+/**
+ * Compiled code of a fragment shader variant.
+ *
+ * The variants of all the contexts of a screen with the same shader tokens
+ * and variant key share it through the screen's fs_code_table.
+ */
+struct lp_fs_variant_code
+{
+   struct pipe_reference reference;
+
+   /* Lookup key */
+   const struct tgsi_token *tokens;
+   unsigned num_tokens;
+   const struct lp_fragment_shader_variant_key *key;
+   unsigned key_size;
+   unsigned hash;
+
+   lp_jit_frag_func jit_function[2];
+
+   struct gallivm_state *gallivm;
+
+   /**
+    * While the optimized code is being compiled in the background,
+    * jit_function[] points to quickly generated unoptimized code, which
+    * must be kept around until the code is destroyed.
+    */
+   struct gallivm_state *fallback_gallivm;
+   int fallback;  /**< non-zero until the optimized code is in use */
+
+   /* Total number of LLVM instructions generated */
+   unsigned nr_instrs;
+
+   /** in the screen's LRU list, if in fs_code_table */
+   struct lp_fs_code_list_item list_item;
+};
+
+
 struct lp_fragment_shader_variant
 {
    struct lp_fragment_shader_variant_key key;
@@ -100,6 +143,13 @@ struct lp_fragment_shader_variant
    boolean opaque;
    uint8_t ps_inv_multiplier;
 
+   struct lp_fs_variant_code *code;
+
+   /** Background compilation of the optimized code, if any */
+   struct util_queue_fence compile_fence;
+   struct llvmpipe_screen *screen;
+
+   /* Module being built, during compilation */
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -108,11 +158,6 @@ struct lp_fragment_shader_variant
 
    LLVMValueRef function[2];
 
-   lp_jit_frag_func jit_function[2];
-
-   /* Total number of LLVM instructions generated */
-   unsigned nr_instrs;
-
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -153,5 +198,11 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 boolean
 llvmpipe_rasterization_disabled(struct llvmpipe_context *lp);
 
+boolean
+llvmpipe_init_fs_code_table(struct llvmpipe_screen *screen);
+
+void
+llvmpipe_destroy_fs_code_table(struct llvmpipe_screen *screen);
+
 
 #endif /* LP_STATE_FS_H_ */
@@ -707,9 +707,12 @@ static struct lp_setup_variant *
 generate_setup_variant(struct lp_setup_variant_key *key,
                        struct llvmpipe_context *lp)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_setup_variant *variant = NULL;
    struct gallivm_state *gallivm;
    struct lp_setup_args args;
+   struct lp_cached_code cached;
+   cache_key sha1;
    char func_name[64];
    LLVMTypeRef vec4f_type;
    LLVMTypeRef func_type;
@@ -744,6 +747,16 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    memcpy(&variant->key, key, key->size);
    variant->list_item_global.base = variant;
 
+   if (screen->disk_cache) {
+      lp_disk_cache_compute_key(screen, "setup", NULL, 0,
+                                &variant->key, key->size, sha1);
+      lp_disk_cache_find_code(screen, &cached, sha1);
+      gallivm->cache = &cached;
+
+      /* Cached code is looked up by name, so don't number it */
+      util_snprintf(func_name, sizeof(func_name), "setup_variant");
+   }
+
    /* Currently always deal with full 4-wide vertex attributes from
     * the vertices.
     */
@@ -805,7 +818,11 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (gallivm->cache)
+      lp_disk_cache_insert_code(screen, &cached, sha1);
+
    gallivm_free_ir(variant->gallivm);
+   gallivm->cache = NULL;
 
    /*
     * Update timing information:
@@ -821,6 +838,8 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 fail:
    if (variant) {
       if (variant->gallivm) {
+         if (variant->gallivm->cache)
+            free(cached.data);
          gallivm_destroy(variant->gallivm);
       }
       FREE(variant);
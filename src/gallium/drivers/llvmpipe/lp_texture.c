@@ -43,6 +43,8 @@
 #include "util/simple_list.h"
 #include "util/u_transfer.h"
 
+#include "gallivm/lp_bld_sample.h"
+
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
@@ -59,6 +61,8 @@ static struct llvmpipe_resource resource_list;
 #endif
 static unsigned id_counter = 0;
 
+DEBUG_GET_ONCE_BOOL_OPTION(lp_tiled_textures, "LP_TILED_TEXTURES", FALSE)
+
 
 /**
  * Conventional allocation path for non-display textures:
@@ -236,6 +240,53 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * Whether a texture may be stored in LP_SAMPLER_TILE_SIZE square tiles.
+ * Only textures nothing but the samplers ever address are eligible, since
+ * the rasterizer, images and persistent mappings all expect linear rows.
+ */
+static boolean
+llvmpipe_texture_can_tile(const struct pipe_resource *templat)
+{
+   const struct util_format_description *desc =
+      util_format_description(templat->format);
+
+   /* relies on levels being padded to LP_RASTER_BLOCK_SIZE */
+   STATIC_ASSERT(LP_SAMPLER_TILE_SIZE == LP_RASTER_BLOCK_SIZE);
+
+   if (!debug_get_option_lp_tiled_textures())
+      return FALSE;
+
+   if (templat->bind & ~PIPE_BIND_SAMPLER_VIEW)
+      return FALSE;
+
+   switch (templat->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+   case PIPE_TEXTURE_3D:
+      break;
+   default:
+      return FALSE;
+   }
+
+   if (desc->block.width != 1 || desc->block.height != 1 ||
+       desc->layout == UTIL_FORMAT_LAYOUT_S3TC ||
+       desc->layout == UTIL_FORMAT_LAYOUT_RGTC ||
+       desc->layout == UTIL_FORMAT_LAYOUT_ETC ||
+       desc->layout == UTIL_FORMAT_LAYOUT_BPTC ||
+       desc->layout == UTIL_FORMAT_LAYOUT_ASTC)
+      return FALSE;
+
+   return templat->nr_samples <= 1 &&
+          templat->usage != PIPE_USAGE_STAGING &&
+          !(templat->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                              PIPE_RESOURCE_FLAG_MAP_COHERENT));
+}
+
+
 static struct pipe_resource *
 llvmpipe_resource_create_front(struct pipe_screen *_screen,
                                const struct pipe_resource *templat,
@@ -262,6 +313,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       }
       else {
          /* texture map */
+         if (llvmpipe_texture_can_tile(templat))
+            lpr->base.flags |= LP_RESOURCE_FLAG_TILED;
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
       }
@@ -483,6 +536,64 @@ no_lpr:
 }
 
 
+/**
+ * Wrap user memory as a single level 2D texture, with tightly packed rows.
+ * This is used to render directly into application memory (OSMesa), so
+ * only render targets backed by a winsys display target are supported.
+ */
+static struct pipe_resource *
+llvmpipe_resource_from_user_memory(struct pipe_screen *_screen,
+                                   const struct pipe_resource *templat,
+                                   void *user_memory)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+   struct sw_winsys *winsys = screen->winsys;
+   struct llvmpipe_resource *lpr;
+
+   if (!winsys->displaytarget_create_mapped ||
+       !llvmpipe_resource_is_texture(templat) ||
+       templat->target == PIPE_TEXTURE_3D ||
+       templat->target == PIPE_TEXTURE_CUBE ||
+       templat->last_level != 0 ||
+       templat->array_size != 1 ||
+       templat->nr_samples > 1 ||
+       util_format_is_depth_or_stencil(templat->format)) {
+      return NULL;
+   }
+
+   lpr = CALLOC_STRUCT(llvmpipe_resource);
+   if (!lpr)
+      return NULL;
+
+   lpr->base = *templat;
+   pipe_reference_init(&lpr->base.reference, 1);
+   lpr->base.screen = _screen;
+
+   lpr->row_stride[0] = util_format_get_stride(templat->format,
+                                               templat->width0);
+
+   lpr->dt = winsys->displaytarget_create_mapped(winsys,
+                                                 templat->bind,
+                                                 templat->format,
+                                                 templat->width0,
+                                                 templat->height0,
+                                                 lpr->row_stride[0],
+                                                 user_memory);
+   if (!lpr->dt) {
+      FREE(lpr);
+      return NULL;
+   }
+
+   lpr->id = id_counter++;
+
+#ifdef DEBUG
+   insert_at_tail(&resource_list, lpr);
+#endif
+
+   return &lpr->base;
+}
+
+
 static boolean
 llvmpipe_resource_get_handle(struct pipe_screen *screen,
                              struct pipe_context *ctx,
@@ -501,6 +612,66 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Byte offset of texel (x, y) within a tiled image.  Images are padded to
+ * whole tiles and the row stride covers a row of tiles, so each tile is
+ * LP_SAMPLER_TILE_SIZE texels wide and row_stride bytes apart vertically
+ * every LP_SAMPLER_TILE_SIZE rows.  Must match lp_build_sample_offset().
+ */
+static inline unsigned
+tiled_texel_offset(unsigned x, unsigned y, unsigned row_stride, unsigned bpp)
+{
+   const unsigned mask = LP_SAMPLER_TILE_SIZE - 1;
+
+   return (y & ~mask) * row_stride +
+          ((x & ~mask) * LP_SAMPLER_TILE_SIZE +
+           (y & mask) * LP_SAMPLER_TILE_SIZE +
+           (x & mask)) * bpp;
+}
+
+
+/**
+ * Copy a box between a tiled texture level and a linear staging buffer.
+ */
+static void
+llvmpipe_copy_tiled_box(struct llvmpipe_resource *lpr,
+                        unsigned level,
+                        const struct pipe_box *box,
+                        ubyte *linear,
+                        unsigned stride,
+                        unsigned layer_stride,
+                        boolean to_tiled)
+{
+   const unsigned bpp = util_format_get_blocksize(lpr->base.format);
+   const unsigned row_stride = lpr->row_stride[level];
+   int x, y, z;
+
+   for (z = 0; z < box->depth; z++) {
+      ubyte *image = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                         level);
+      for (y = 0; y < box->height; y++) {
+         ubyte *row = linear + z * layer_stride + y * stride;
+
+         for (x = 0; x < box->width; ) {
+            /* contiguous run up to the end of the tile row */
+            unsigned tx = box->x + x;
+            unsigned n = MIN2(LP_SAMPLER_TILE_SIZE -
+                              (tx & (LP_SAMPLER_TILE_SIZE - 1)),
+                              box->width - x);
+            ubyte *texel = image + tiled_texel_offset(tx, box->y + y,
+                                                      row_stride, bpp);
+
+            if (to_tiled)
+               memcpy(texel, row + x * bpp, n * bpp);
+            else
+               memcpy(row + x * bpp, texel, n * bpp);
+            x += n;
+         }
+      }
+   }
+}
+
+
 static void *
 llvmpipe_transfer_map( struct pipe_context *pipe,
                        struct pipe_resource *resource,
@@ -522,6 +693,11 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* Tiled textures can only be accessed through a linear copy */
+   if ((resource->flags & LP_RESOURCE_FLAG_TILED) &&
+       (usage & PIPE_TRANSFER_MAP_DIRECTLY))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
@@ -608,6 +784,24 @@ llvmpipe_transfer_map( struct pipe_context *pipe,
       screen->timestamp++;
    }
 
+   if (resource->flags & LP_RESOURCE_FLAG_TILED) {
+      pt->stride = util_format_get_stride(format, box->width);
+      pt->layer_stride = pt->stride * box->height;
+      lpt->linear = MALLOC(pt->layer_stride * box->depth);
+      if (!lpt->linear) {
+         llvmpipe_resource_unmap(resource, level, box->z);
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE))) {
+         llvmpipe_copy_tiled_box(lpr, level, box, lpt->linear,
+                                 pt->stride, pt->layer_stride, FALSE);
+      }
+      return lpt->linear;
+   }
+
    map +=
       box->y / util_format_get_blockheight(format) * pt->stride +
       box->x / util_format_get_blockwidth(format) * util_format_get_blocksize(format);
@@ -620,15 +814,28 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if (lpt->linear) {
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         llvmpipe_copy_tiled_box(llvmpipe_resource(transfer->resource),
+                                 transfer->level, &transfer->box,
+                                 lpt->linear, transfer->stride,
+                                 transfer->layer_stride, TRUE);
+      }
+      FREE(lpt->linear);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
 
    /* Effectively do the texture_update work here - if texture images
     * needed post-processing to put them into hardware layout, this is
-    * where it would happen.  For llvmpipe, nothing to do.
+    * where it would happen.  For llvmpipe, only tiled textures need it,
+    * see above.
     */
    assert (transfer->resource);
    pipe_resource_reference(&transfer->resource, NULL);
@@ -805,6 +1012,7 @@ llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen)
 /*   screen->resource_create_front = llvmpipe_resource_create_front; */
    screen->resource_destroy = llvmpipe_resource_destroy;
    screen->resource_from_handle = llvmpipe_resource_from_handle;
+   screen->resource_from_user_memory = llvmpipe_resource_from_user_memory;
    screen->resource_get_handle = llvmpipe_resource_get_handle;
    screen->can_create_resource = llvmpipe_can_create_resource;
 }
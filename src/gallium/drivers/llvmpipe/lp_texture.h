@@ -102,6 +102,9 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the box of a tiled texture, NULL otherwise */
+   void *linear;
 };
 
 
@@ -946,6 +946,19 @@ void SetupPipeline(DRAW_CONTEXT *pDC)
         }
     }
 
+    // Select hot tile formats. Render targets that aren't written keep the default
+    // format so the output merger never touches them through a compact layout.
+    for (uint32_t rt = 0; rt < SWR_NUM_RENDERTARGETS; ++rt)
+    {
+        SWR_FORMAT hotTileFormat = KNOB_COLOR_HOT_TILE_FORMAT;
+        if (pState->state.colorHottileEnable & (1 << rt))
+        {
+            hotTileFormat = GetColorHotTileFormat(pState->state.blendState.renderTargetFormat[rt]);
+        }
+        pState->state.colorHottileFormat[rt] = hotTileFormat;
+        pState->state.colorHottileShift[rt] = (uint8_t)GetColorHotTileShift(hotTileFormat);
+    }
+
     // Setup depth quantization function
     if (pState->state.depthHottileEnable)
     {
@@ -291,15 +291,15 @@ void ProcessClearBE(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t macroTile, vo
             clearData[2] = *(DWORD*)&(pClear->clearRTColor[2]);
             clearData[3] = *(DWORD*)&(pClear->clearRTColor[3]);
 
-            PFN_CLEAR_TILES pfnClearTiles = sClearTilesTable[KNOB_COLOR_HOT_TILE_FORMAT];
-            SWR_ASSERT(pfnClearTiles != nullptr);
-
             unsigned long rt = 0;
             uint32_t mask = pClear->attachmentMask & SWR_ATTACHMENT_MASK_COLOR;
             while (_BitScanForward(&rt, mask))
             {
                 mask &= ~(1 << rt);
 
+                PFN_CLEAR_TILES pfnClearTiles = sClearTilesTable[GetApiState(pDC).colorHottileFormat[rt]];
+                SWR_ASSERT(pfnClearTiles != nullptr);
+
                 pfnClearTiles(pDC, (SWR_RENDERTARGET_ATTACHMENT)rt, macroTile, pClear->renderTargetArrayIndex, clearData, pClear->rect);
             }
         }
@@ -334,22 +334,6 @@ void ProcessStoreTileBE(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t macroTile
 
     AR_BEGIN(BEStoreTiles, pDC->drawId);
 
-    SWR_FORMAT srcFormat;
-    switch (attachment)
-    {
-    case SWR_ATTACHMENT_COLOR0:
-    case SWR_ATTACHMENT_COLOR1:
-    case SWR_ATTACHMENT_COLOR2:
-    case SWR_ATTACHMENT_COLOR3:
-    case SWR_ATTACHMENT_COLOR4:
-    case SWR_ATTACHMENT_COLOR5:
-    case SWR_ATTACHMENT_COLOR6:
-    case SWR_ATTACHMENT_COLOR7: srcFormat = KNOB_COLOR_HOT_TILE_FORMAT; break;
-    case SWR_ATTACHMENT_DEPTH: srcFormat = KNOB_DEPTH_HOT_TILE_FORMAT; break;
-    case SWR_ATTACHMENT_STENCIL: srcFormat = KNOB_STENCIL_HOT_TILE_FORMAT; break;
-    default: SWR_ASSERT(false, "Unknown attachment: %d", attachment); srcFormat = KNOB_COLOR_HOT_TILE_FORMAT; break;
-    }
-
     uint32_t x, y;
     MacroTileMgr::getTileIndices(macroTile, x, y);
 
@@ -357,6 +341,8 @@ void ProcessStoreTileBE(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t macroTile
     HOTTILE *pHotTile = pContext->pHotTileMgr->GetHotTileNoLoad(pContext, pDC, macroTile, attachment, false);
     if (pHotTile)
     {
+        SWR_FORMAT srcFormat = pHotTile->format;
+
         // clear if clear is pending (i.e., not rendered to), then mark as dirty for store.
         if (pHotTile->state == HOTTILE_CLEAR)
         {
@@ -593,9 +579,9 @@ void BackendSingleSample(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t x, uint3
                 // output merger
                 AR_BEGIN(BEOutputMerger, pDC->drawId);
 #if USE_8x2_TILE_BACKEND
-                OutputMerger(psContext, pColorBuffer, 0, &state.blendState, state.pfnBlendFunc, vCoverageMask, depthPassMask, state.psState.numRenderTargets, useAlternateOffset);
+                OutputMerger(psContext, pColorBuffer, 0, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, vCoverageMask, depthPassMask, state.psState.numRenderTargets, useAlternateOffset);
 #else
-                OutputMerger(psContext, pColorBuffer, 0, &state.blendState, state.pfnBlendFunc, vCoverageMask, depthPassMask, state.psState.numRenderTargets);
+                OutputMerger(psContext, pColorBuffer, 0, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, vCoverageMask, depthPassMask, state.psState.numRenderTargets);
 #endif
 
                 // do final depth write after all pixel kills
@@ -627,7 +613,7 @@ Endtile:
 #else
             for (uint32_t rt = 0; rt < state.psState.numRenderTargets; ++rt)
             {
-                pColorBuffer[rt] += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8;
+                pColorBuffer[rt] += ((KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8) >> state.colorHottileShift[rt];
             }
 #endif
             pDepthBuffer += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_DEPTH_HOT_TILE_FORMAT>::bpp) / 8;
@@ -807,9 +793,9 @@ void BackendSampleRate(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t x, uint32_
                     // output merger
                     AR_BEGIN(BEOutputMerger, pDC->drawId);
 #if USE_8x2_TILE_BACKEND
-                    OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, vCoverageMask, depthPassMask, state.psState.numRenderTargets, useAlternateOffset);
+                    OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, vCoverageMask, depthPassMask, state.psState.numRenderTargets, useAlternateOffset);
 #else
-                    OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, vCoverageMask, depthPassMask, state.psState.numRenderTargets);
+                    OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, vCoverageMask, depthPassMask, state.psState.numRenderTargets);
 #endif
 
                     // do final depth write after all pixel kills
@@ -844,7 +830,7 @@ Endtile:
 #else
             for (uint32_t rt = 0; rt < state.psState.numRenderTargets; ++rt)
             {
-                pColorBuffer[rt] += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8;
+                pColorBuffer[rt] += ((KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8) >> state.colorHottileShift[rt];
             }
 #endif
             pDepthBuffer += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_DEPTH_HOT_TILE_FORMAT>::bpp) / 8;
@@ -1001,9 +987,9 @@ void BackendPixelRate(DRAW_CONTEXT *pDC, uint32_t workerId, uint32_t x, uint32_t
                 
                 // broadcast the results of the PS to all passing pixels
 #if USE_8x2_TILE_BACKEND
-                OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, coverageMask, depthMask, state.psState.numRenderTargets, useAlternateOffset);
+                OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, coverageMask, depthMask, state.psState.numRenderTargets, useAlternateOffset);
 #else
-                OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, coverageMask, depthMask, state.psState.numRenderTargets);
+                OutputMerger(psContext, pColorBuffer, sample, &state.blendState, state.pfnBlendFunc, state.colorHottileFormat, coverageMask, depthMask, state.psState.numRenderTargets);
 #endif
 
                 if(!state.psState.forceEarlyZ && !T::bForcedSampleCount)
@@ -1041,7 +1027,7 @@ Endtile:
 #else
             for(uint32_t rt = 0; rt < state.psState.numRenderTargets; ++rt)
             {
-                pColorBuffer[rt] += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8;
+                pColorBuffer[rt] += ((KNOB_SIMD_WIDTH * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp) / 8) >> state.colorHottileShift[rt];
             }
             pDepthBuffer += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_DEPTH_HOT_TILE_FORMAT>::bpp) / 8;
             pStencilBuffer += (KNOB_SIMD_WIDTH * FormatTraits<KNOB_STENCIL_HOT_TILE_FORMAT>::bpp) / 8;
@@ -1183,6 +1169,7 @@ void InitClearTilesTable()
     sClearTilesTable[B8G8R8A8_UNORM] = ClearMacroTile<B8G8R8A8_UNORM>;
     sClearTilesTable[R32_FLOAT] = ClearMacroTile<R32_FLOAT>;
     sClearTilesTable[R32G32B32A32_FLOAT] = ClearMacroTile<R32G32B32A32_FLOAT>;
+    sClearTilesTable[R16G16B16A16_FLOAT] = ClearMacroTile<R16G16B16A16_FLOAT>;
     sClearTilesTable[R8_UINT] = ClearMacroTile<R8_UINT>;
 }
 
@@ -31,6 +31,7 @@
 #include "common/os.h"
 #include "core/context.h"
 #include "core/multisample.h"
+#include "core/format_conversion.h"
 #include "rdtsc_core.h"
 
 void ProcessComputeBE(DRAW_CONTEXT* pDC, uint32_t workerId, uint32_t threadGroupId, void*& pSpillFillBuffer);
@@ -691,8 +692,35 @@ INLINE void CalcSampleBarycentrics(const BarycentricCoeffs& coeffs, SWR_PS_CONTE
     psContext.vOneOverW.sample = vplaneps(coeffs.vAOneOverW, coeffs.vBOneOverW, coeffs.vCOneOverW, psContext.vI.sample, psContext.vJ.sample);
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Loads a SIMD tile from a color hot tile and converts it to
+///        SOA RGBA32_FLOAT.
+INLINE void LoadColorHotTile(SWR_FORMAT hotTileFormat, const uint8_t *pSrc, simdvector &dst)
+{
+    switch (hotTileFormat)
+    {
+    case R8G8B8A8_UNORM: LoadSOA<R8G8B8A8_UNORM>(pSrc, dst); break;
+    case R16G16B16A16_FLOAT: LoadSOA<R16G16B16A16_FLOAT>(pSrc, dst); break;
+    default: LoadSOA<KNOB_COLOR_HOT_TILE_FORMAT>(pSrc, dst); break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Converts a SOA RGBA32_FLOAT SIMD tile to the color hot tile
+///        format and stores it.
+INLINE void StoreColorHotTile(SWR_FORMAT hotTileFormat, const simdvector &src, uint8_t *pDst)
+{
+    switch (hotTileFormat)
+    {
+    case R8G8B8A8_UNORM: StoreSOA<R8G8B8A8_UNORM>(src, pDst); break;
+    case R16G16B16A16_FLOAT: StoreSOA<R16G16B16A16_FLOAT>(src, pDst); break;
+    default: StoreSOA<KNOB_COLOR_HOT_TILE_FORMAT>(src, pDst); break;
+    }
+}
+
 INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_NUM_RENDERTARGETS], uint32_t sample, const SWR_BLEND_STATE *pBlendState,
-                         const PFN_BLEND_JIT_FUNC (&pfnBlendFunc)[SWR_NUM_RENDERTARGETS], simdscalar &coverageMask, simdscalar depthPassMask, const uint32_t NumRT)
+                         const PFN_BLEND_JIT_FUNC (&pfnBlendFunc)[SWR_NUM_RENDERTARGETS], const SWR_FORMAT (&hotTileFormat)[SWR_NUM_RENDERTARGETS],
+                         simdscalar &coverageMask, simdscalar depthPassMask, const uint32_t NumRT)
 {
     // type safety guaranteed from template instantiation in BEChooser<>::GetFunc
     const uint32_t rasterTileColorOffset = RasterTileColorOffset(sample);
@@ -700,23 +728,37 @@ INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_N
 
     for(uint32_t rt = 0; rt < NumRT; ++rt)
     {
-        uint8_t *pColorSample = pColorBase[rt] + rasterTileColorOffset;
+        const SWR_FORMAT format = hotTileFormat[rt];
+        const bool bCompact = (format != KNOB_COLOR_HOT_TILE_FORMAT);
+        uint8_t *pColorSample = pColorBase[rt] + (rasterTileColorOffset >> GetColorHotTileShift(format));
 
         const SWR_RENDER_TARGET_BLEND_STATE *pRTBlend = &pBlendState->renderTarget[rt];
         // pfnBlendFunc may not update all channels.  Initialize with PS output.
         /// TODO: move this into the blend JIT.
         blendOut = psContext.shaded[rt];
 
+        // The blend JIT always consumes a RGBA32_FLOAT destination, so unpack compact hot tiles first.
+        simdvector dst;
+        bool bDstLoaded = false;
+
         // Blend outputs and update coverage mask for alpha test
         if(pfnBlendFunc[rt] != nullptr)
         {
+            uint8_t *pBlendDst = pColorSample;
+            if (bCompact)
+            {
+                LoadColorHotTile(format, pColorSample, dst);
+                bDstLoaded = true;
+                pBlendDst = (uint8_t*)&dst;
+            }
+
             pfnBlendFunc[rt](
                 pBlendState,
                 psContext.shaded[rt],
                 psContext.shaded[1],
                 psContext.shaded[0].w,
                 sample,
-                pColorSample,
+                pBlendDst,
                 blendOut,
                 &psContext.oMask,
                 (simdscalari*)&coverageMask);
@@ -725,8 +767,51 @@ INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_N
         // final write mask 
         simdscalari outputMask = _simd_castps_si(_simd_and_ps(coverageMask, depthPassMask));
 
-        ///@todo can only use maskstore fast path if bpc is 32. Assuming hot tile is RGBA32_FLOAT.
-        static_assert(KNOB_COLOR_HOT_TILE_FORMAT == R32G32B32A32_FLOAT, "Unsupported hot tile format");
+        if (bCompact)
+        {
+            // Compact hot tiles can't use masked stores, merge the written channels and lanes
+            // into the current contents instead. Skip the load when every lane and channel is written.
+            const bool bAllChannels = !pRTBlend->writeDisableRed && !pRTBlend->writeDisableGreen &&
+                                      !pRTBlend->writeDisableBlue && !pRTBlend->writeDisableAlpha;
+            const simdscalar vMask = _simd_castsi_ps(outputMask);
+            const uint32_t laneMask = _simd_movemask_ps(vMask);
+
+            if (laneMask == 0)
+            {
+                continue;
+            }
+
+            if (bAllChannels && laneMask == ((1 << KNOB_SIMD_WIDTH) - 1))
+            {
+                StoreColorHotTile(format, blendOut, pColorSample);
+                continue;
+            }
+
+            if (!bDstLoaded)
+            {
+                LoadColorHotTile(format, pColorSample, dst);
+            }
+
+            if(!pRTBlend->writeDisableRed)
+            {
+                dst.x = _simd_blendv_ps(dst.x, blendOut.x, vMask);
+            }
+            if(!pRTBlend->writeDisableGreen)
+            {
+                dst.y = _simd_blendv_ps(dst.y, blendOut.y, vMask);
+            }
+            if(!pRTBlend->writeDisableBlue)
+            {
+                dst.z = _simd_blendv_ps(dst.z, blendOut.z, vMask);
+            }
+            if(!pRTBlend->writeDisableAlpha)
+            {
+                dst.w = _simd_blendv_ps(dst.w, blendOut.w, vMask);
+            }
+
+            StoreColorHotTile(format, dst, pColorSample);
+            continue;
+        }
 
         const uint32_t simd = KNOB_SIMD_WIDTH * sizeof(float);
 
@@ -752,7 +837,8 @@ INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_N
 
 #if USE_8x2_TILE_BACKEND
 INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_NUM_RENDERTARGETS], uint32_t sample, const SWR_BLEND_STATE *pBlendState,
-    const PFN_BLEND_JIT_FUNC(&pfnBlendFunc)[SWR_NUM_RENDERTARGETS], simdscalar &coverageMask, simdscalar depthPassMask, const uint32_t NumRT, bool useAlternateOffset)
+    const PFN_BLEND_JIT_FUNC(&pfnBlendFunc)[SWR_NUM_RENDERTARGETS], const SWR_FORMAT(&hotTileFormat)[SWR_NUM_RENDERTARGETS],
+    simdscalar &coverageMask, simdscalar depthPassMask, const uint32_t NumRT, bool useAlternateOffset)
 {
     // type safety guaranteed from template instantiation in BEChooser<>::GetFunc
     uint32_t rasterTileColorOffset = RasterTileColorOffset(sample);
@@ -799,6 +885,7 @@ INLINE void OutputMerger(SWR_PS_CONTEXT &psContext, uint8_t* (&pColorBase)[SWR_N
 
         ///@todo can only use maskstore fast path if bpc is 32. Assuming hot tile is RGBA32_FLOAT.
         static_assert(KNOB_COLOR_HOT_TILE_FORMAT == R32G32B32A32_FLOAT, "Unsupported hot tile format");
+        SWR_ASSERT(hotTileFormat[rt] == KNOB_COLOR_HOT_TILE_FORMAT);
 
         // store with color mask
         if (!pRTBlend->writeDisableRed)
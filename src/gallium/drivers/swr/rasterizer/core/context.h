@@ -211,6 +211,49 @@ struct GUARDBANDS
     float bottom[KNOB_NUM_VIEWPORTS_SCISSORS];
 };
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Returns the hot tile format used to render to a color surface.
+///        8-bit unorm RGBA and 16-bit float RGBA surfaces are rendered to
+///        compact hot tiles, everything else uses KNOB_COLOR_HOT_TILE_FORMAT.
+/// @param surfaceFormat - format of the render target surface
+INLINE SWR_FORMAT GetColorHotTileFormat(SWR_FORMAT surfaceFormat)
+{
+#if !USE_8x2_TILE_BACKEND
+    if (KNOB_COMPACT_COLOR_HOT_TILES)
+    {
+        switch (surfaceFormat)
+        {
+        case R8G8B8A8_UNORM:
+        case R8G8B8X8_UNORM:
+        case B8G8R8A8_UNORM:
+        case B8G8R8X8_UNORM:
+            return R8G8B8A8_UNORM;
+        case R16G16B16A16_FLOAT:
+        case R16G16B16X16_FLOAT:
+            return R16G16B16A16_FLOAT;
+        default:
+            break;
+        }
+    }
+#endif
+    return KNOB_COLOR_HOT_TILE_FORMAT;
+}
+
+//////////////////////////////////////////////////////////////////////////
+/// @brief Returns log2 of the size ratio between KNOB_COLOR_HOT_TILE_FORMAT
+///        and the given color hot tile format.
+INLINE uint32_t GetColorHotTileShift(SWR_FORMAT hotTileFormat)
+{
+    switch (hotTileFormat)
+    {
+    case R8G8B8A8_UNORM:        return 2;
+    case R16G16B16A16_FLOAT:    return 1;
+    default:
+        SWR_ASSERT(hotTileFormat == KNOB_COLOR_HOT_TILE_FORMAT, "Unsupported color hot tile format");
+        return 0;
+    }
+}
+
 struct PA_STATE;
 
 // function signature for pipeline stages that execute after primitive assembly
@@ -289,6 +332,11 @@ OSALIGNLINE(struct) API_STATE
     SWR_BLEND_STATE         blendState;
     PFN_BLEND_JIT_FUNC      pfnBlendFunc[SWR_NUM_RENDERTARGETS];
 
+    // Color hot tile format per render target, and its size relative to
+    // KNOB_COLOR_HOT_TILE_FORMAT as a right shift of the bytes per pixel
+    SWR_FORMAT              colorHottileFormat[SWR_NUM_RENDERTARGETS];
+    uint8_t                 colorHottileShift[SWR_NUM_RENDERTARGETS];
+
     struct
     {
         uint32_t enableStatsFE : 1;             // Enable frontend pipeline stats
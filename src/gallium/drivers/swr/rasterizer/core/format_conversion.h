@@ -25,6 +25,8 @@
 * @brief API implementation
 *
 ******************************************************************************/
+#pragma once
+
 #include "format_types.h"
 #include "format_traits.h"
 
@@ -40,9 +40,9 @@
 template <uint32_t numSamples = 1>
 void GetRenderHotTiles(DRAW_CONTEXT *pDC, uint32_t macroID, uint32_t x, uint32_t y, RenderOutputBuffers &renderBuffers, uint32_t renderTargetArrayIndex);
 template <typename RT>
-void StepRasterTileX(uint32_t MaxRT, RenderOutputBuffers &buffers);
+void StepRasterTileX(uint32_t MaxRT, const uint8_t (&colorShift)[SWR_NUM_RENDERTARGETS], RenderOutputBuffers &buffers);
 template <typename RT>
-void StepRasterTileY(uint32_t MaxRT, RenderOutputBuffers &buffers, RenderOutputBuffers &startBufferRow);
+void StepRasterTileY(uint32_t MaxRT, const uint8_t (&colorShift)[SWR_NUM_RENDERTARGETS], RenderOutputBuffers &buffers, RenderOutputBuffers &startBufferRow);
 
 #define MASKTOVEC(i3,i2,i1,i0) {-i0,-i1,-i2,-i3}
 const __m256d gMaskToVecpd[] =
@@ -1277,7 +1277,7 @@ void RasterizeTriangle(DRAW_CONTEXT* pDC, uint32_t workerId, uint32_t macroTile,
             {
                 vEdgeFix16[e] = _mm256_add_pd(vEdgeFix16[e], _mm256_set1_pd(rastEdges[e].stepRasterTileX));
             }
-            StepRasterTileX<RT>(state.psState.numRenderTargets, renderBuffers);
+            StepRasterTileX<RT>(state.psState.numRenderTargets, state.colorHottileShift, renderBuffers);
         }
 
         // step to the next tile in Y
@@ -1285,7 +1285,7 @@ void RasterizeTriangle(DRAW_CONTEXT* pDC, uint32_t workerId, uint32_t macroTile,
         {
             vEdgeFix16[e] = _mm256_add_pd(vStartOfRowEdge[e], _mm256_set1_pd(rastEdges[e].stepRasterTileY));
         }
-        StepRasterTileY<RT>(state.psState.numRenderTargets, renderBuffers, currentRenderBufferRow);
+        StepRasterTileY<RT>(state.psState.numRenderTargets, state.colorHottileShift, renderBuffers, currentRenderBufferRow);
     }
 
     AR_END(BERasterizeTriangle, 1);
@@ -1497,7 +1497,7 @@ void GetRenderHotTiles(DRAW_CONTEXT *pDC, uint32_t macroID, uint32_t tileX, uint
     tileX -= KNOB_MACROTILE_X_DIM_IN_TILES * mx;
     tileY -= KNOB_MACROTILE_Y_DIM_IN_TILES * my;
 
-    // compute tile offset for active hottile buffers
+    // compute tile offset for active hottile buffers, compact color hot tiles scale it down by their shift
     const uint32_t pitch = KNOB_MACROTILE_X_DIM * FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp / 8;
     uint32_t offset = ComputeTileOffset2D<TilingTraits<SWR_TILE_SWRZ, FormatTraits<KNOB_COLOR_HOT_TILE_FORMAT>::bpp> >(pitch, tileX, tileY);
     offset*=numSamples;
@@ -1509,7 +1509,8 @@ void GetRenderHotTiles(DRAW_CONTEXT *pDC, uint32_t macroID, uint32_t tileX, uint
         HOTTILE *pColor = pContext->pHotTileMgr->GetHotTile(pContext, pDC, macroID, (SWR_RENDERTARGET_ATTACHMENT)(SWR_ATTACHMENT_COLOR0 + rtSlot), true, 
             numSamples, renderTargetArrayIndex);
         pColor->state = HOTTILE_DIRTY;
-        renderBuffers.pColor[rtSlot] = pColor->pBuffer + offset;
+        SWR_ASSERT(pColor->format == state.colorHottileFormat[rtSlot]);
+        renderBuffers.pColor[rtSlot] = pColor->pBuffer + (offset >> state.colorHottileShift[rtSlot]);
         
         colorHottileEnableMask &= ~(1 << rtSlot);
     }
@@ -1538,11 +1539,11 @@ void GetRenderHotTiles(DRAW_CONTEXT *pDC, uint32_t macroID, uint32_t tileX, uint
 }
 
 template <typename RT>
-INLINE void StepRasterTileX(uint32_t NumRT, RenderOutputBuffers &buffers)
+INLINE void StepRasterTileX(uint32_t NumRT, const uint8_t (&colorShift)[SWR_NUM_RENDERTARGETS], RenderOutputBuffers &buffers)
 {
     for(uint32_t rt = 0; rt < NumRT; ++rt)
     {
-        buffers.pColor[rt] += RT::colorRasterTileStep;
+        buffers.pColor[rt] += RT::colorRasterTileStep >> colorShift[rt];
     }
     
     buffers.pDepth += RT::depthRasterTileStep;
@@ -1550,11 +1551,11 @@ INLINE void StepRasterTileX(uint32_t NumRT, RenderOutputBuffers &buffers)
 }
 
 template <typename RT>
-INLINE void StepRasterTileY(uint32_t NumRT, RenderOutputBuffers &buffers, RenderOutputBuffers &startBufferRow)
+INLINE void StepRasterTileY(uint32_t NumRT, const uint8_t (&colorShift)[SWR_NUM_RENDERTARGETS], RenderOutputBuffers &buffers, RenderOutputBuffers &startBufferRow)
 {
     for(uint32_t rt = 0; rt < NumRT; ++rt)
     {
-        startBufferRow.pColor[rt] += RT::colorRasterTileRowStep;
+        startBufferRow.pColor[rt] += RT::colorRasterTileRowStep >> colorShift[rt];
         buffers.pColor[rt] = startBufferRow.pColor[rt];
     }
     startBufferRow.pDepth += RT::depthRasterTileRowStep;
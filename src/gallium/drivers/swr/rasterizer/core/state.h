@@ -794,8 +794,11 @@ struct SWR_BLEND_STATE
     SWR_MULTISAMPLE_COUNT sampleCount;  // @llvm_enum 
 
     SWR_RENDER_TARGET_BLEND_STATE renderTarget[SWR_NUM_RENDERTARGETS];
+
+    // surface format of each bound render target, used to pick the color hot tile format
+    SWR_FORMAT renderTargetFormat[SWR_NUM_RENDERTARGETS];   // @llvm_enum
 };
-static_assert(sizeof(SWR_BLEND_STATE) == 36, "Invalid SWR_BLEND_STATE size");
+static_assert(sizeof(SWR_BLEND_STATE) == 68, "Invalid SWR_BLEND_STATE size");
 
 //////////////////////////////////////////////////////////////////////////
 /// FUNCTION POINTERS FOR SHADERS
@@ -31,6 +31,7 @@
 #include "fifo.hpp"
 #include "core/tilemgr.h"
 #include "core/multisample.h"
+#include "core/format_conversion.h"
 #include "rdtsc_core.h"
 
 #define TILE_ID(x,y) ((x << 16 | y))
@@ -83,6 +84,27 @@ void MacroTileMgr::markTileComplete(uint32_t id)
     tile.mWorkItemsBE = 0;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Returns the format a hot tile for the given attachment should be
+///        in for the current draw.
+SWR_FORMAT HotTileMgr::GetHotTileFormat(const API_STATE& state, SWR_RENDERTARGET_ATTACHMENT attachment)
+{
+    switch (attachment)
+    {
+    case SWR_ATTACHMENT_COLOR0:
+    case SWR_ATTACHMENT_COLOR1:
+    case SWR_ATTACHMENT_COLOR2:
+    case SWR_ATTACHMENT_COLOR3:
+    case SWR_ATTACHMENT_COLOR4:
+    case SWR_ATTACHMENT_COLOR5:
+    case SWR_ATTACHMENT_COLOR6:
+    case SWR_ATTACHMENT_COLOR7: return state.colorHottileFormat[attachment - SWR_ATTACHMENT_COLOR0];
+    case SWR_ATTACHMENT_DEPTH: return KNOB_DEPTH_HOT_TILE_FORMAT;
+    case SWR_ATTACHMENT_STENCIL: return KNOB_STENCIL_HOT_TILE_FORMAT;
+    default: SWR_ASSERT(false, "Unknown attachment: %d", attachment); return KNOB_COLOR_HOT_TILE_FORMAT;
+    }
+}
+
 HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32_t macroID, SWR_RENDERTARGET_ATTACHMENT attachment, bool create, uint32_t numSamples,
     uint32_t renderTargetArrayIndex)
 {
@@ -98,12 +120,14 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32
     {
         if (create)
         {
-            uint32_t size = numSamples * mHotTileSize[attachment];
+            SWR_FORMAT format = GetHotTileFormat(GetApiState(pDC), attachment);
+            uint32_t size = numSamples * GetHotTileSize(attachment, format);
             uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
             hotTile.pBuffer = (uint8_t*)AllocHotTileMem(size, KNOB_SIMD_WIDTH * 4, numaNode);
             hotTile.state = HOTTILE_INVALID;
             hotTile.numSamples = numSamples;
             hotTile.renderTargetArrayIndex = renderTargetArrayIndex;
+            hotTile.format = format;
         }
         else
         {
@@ -112,6 +136,34 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32
     }
     else
     {
+        // if the render target now wants a different hot tile format, write back the tile in
+        // its current format and reload it in the new one before rendering to it
+        SWR_FORMAT format = create ? GetHotTileFormat(GetApiState(pDC), attachment) : hotTile.format;
+        if (format != hotTile.format)
+        {
+            if (hotTile.state == HOTTILE_DIRTY)
+            {
+                pContext->pfnStoreTile(GetPrivateState(pDC), hotTile.format, attachment,
+                    x * KNOB_MACROTILE_X_DIM, y * KNOB_MACROTILE_Y_DIM, hotTile.renderTargetArrayIndex, hotTile.pBuffer);
+            }
+
+            if (GetHotTileSize(attachment, format) != GetHotTileSize(attachment, hotTile.format))
+            {
+                FreeHotTileMem(hotTile.pBuffer);
+
+                uint32_t size = hotTile.numSamples * GetHotTileSize(attachment, format);
+                uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
+                hotTile.pBuffer = (uint8_t*)AllocHotTileMem(size, KNOB_SIMD_WIDTH * 4, numaNode);
+            }
+
+            // a pending clear is format independent, anything else needs a reload
+            if (hotTile.state != HOTTILE_CLEAR)
+            {
+                hotTile.state = HOTTILE_INVALID;
+            }
+            hotTile.format = format;
+        }
+
         // free the old tile and create a new one with enough space to hold all samples
         if (numSamples > hotTile.numSamples)
         {
@@ -122,7 +174,7 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32
                 (hotTile.state == HOTTILE_CLEAR));
             FreeHotTileMem(hotTile.pBuffer);
 
-            uint32_t size = numSamples * mHotTileSize[attachment];
+            uint32_t size = numSamples * GetHotTileSize(attachment, hotTile.format);
             uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
             hotTile.pBuffer = (uint8_t*)AllocHotTileMem(size, KNOB_SIMD_WIDTH * 4, numaNode);
             hotTile.state = HOTTILE_INVALID;
@@ -133,22 +185,6 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32
         // and load the requested array slice
         if (renderTargetArrayIndex != hotTile.renderTargetArrayIndex)
         {
-            SWR_FORMAT format;
-            switch (attachment)
-            {
-            case SWR_ATTACHMENT_COLOR0:
-            case SWR_ATTACHMENT_COLOR1:
-            case SWR_ATTACHMENT_COLOR2:
-            case SWR_ATTACHMENT_COLOR3:
-            case SWR_ATTACHMENT_COLOR4:
-            case SWR_ATTACHMENT_COLOR5:
-            case SWR_ATTACHMENT_COLOR6:
-            case SWR_ATTACHMENT_COLOR7: format = KNOB_COLOR_HOT_TILE_FORMAT; break;
-            case SWR_ATTACHMENT_DEPTH: format = KNOB_DEPTH_HOT_TILE_FORMAT; break;
-            case SWR_ATTACHMENT_STENCIL: format = KNOB_STENCIL_HOT_TILE_FORMAT; break;
-            default: SWR_ASSERT(false, "Unknown attachment: %d", attachment); format = KNOB_COLOR_HOT_TILE_FORMAT; break;
-            }
-
             if (hotTile.state == HOTTILE_CLEAR)
             {
                 if (attachment == SWR_ATTACHMENT_STENCIL)
@@ -163,11 +199,11 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, uint32
 
             if (hotTile.state == HOTTILE_DIRTY)
             {
-                pContext->pfnStoreTile(GetPrivateState(pDC), format, attachment,
+                pContext->pfnStoreTile(GetPrivateState(pDC), hotTile.format, attachment,
                     x * KNOB_MACROTILE_X_DIM, y * KNOB_MACROTILE_Y_DIM, hotTile.renderTargetArrayIndex, hotTile.pBuffer);
             }
 
-            pContext->pfnLoadTile(GetPrivateState(pDC), format, attachment,
+            pContext->pfnLoadTile(GetPrivateState(pDC), hotTile.format, attachment,
                 x * KNOB_MACROTILE_X_DIM, y * KNOB_MACROTILE_Y_DIM, renderTargetArrayIndex, hotTile.pBuffer);
 
             hotTile.renderTargetArrayIndex = renderTargetArrayIndex;
@@ -193,11 +229,13 @@ HOTTILE* HotTileMgr::GetHotTileNoLoad(
     {
         if (create)
         {
-            uint32_t size = numSamples * mHotTileSize[attachment];
+            SWR_FORMAT format = GetHotTileFormat(GetApiState(pDC), attachment);
+            uint32_t size = numSamples * GetHotTileSize(attachment, format);
             hotTile.pBuffer = (uint8_t*)AlignedMalloc(size, KNOB_SIMD_WIDTH * 4);
             hotTile.state = HOTTILE_INVALID;
             hotTile.numSamples = numSamples;
             hotTile.renderTargetArrayIndex = 0;
+            hotTile.format = format;
         }
         else
         {
@@ -290,8 +328,46 @@ void HotTileMgr::ClearStencilHotTile(const HOTTILE* pHotTile)
 }
 
 #else
+//////////////////////////////////////////////////////////////////////////
+/// @brief Clears a compact color hot tile. The float4 clear color is
+///        converted to the hot tile format once and then replicated.
+template<SWR_FORMAT HotTileFormat>
+static void ClearCompactColorHotTile(const HOTTILE* pHotTile)
+{
+    // number of SIMD registers per SIMD tile
+    static const uint32_t numVectors = (KNOB_SIMD_WIDTH * FormatTraits<HotTileFormat>::bpp / 8) / sizeof(simdscalari);
+
+    float *pClearData = (float*)(pHotTile->clearData);
+    simdvector vClear;
+    vClear.x = _simd_broadcast_ss(&pClearData[0]);
+    vClear.y = _simd_broadcast_ss(&pClearData[1]);
+    vClear.z = _simd_broadcast_ss(&pClearData[2]);
+    vClear.w = _simd_broadcast_ss(&pClearData[3]);
+
+    OSALIGNSIMD(simdscalari) vClearTile[numVectors];
+    StoreSOA<HotTileFormat>(vClear, (uint8_t*)vClearTile);
+
+    simdscalari* pBuf = (simdscalari*)pHotTile->pBuffer;
+    uint32_t numSimdTiles = (KNOB_MACROTILE_X_DIM * KNOB_MACROTILE_Y_DIM * pHotTile->numSamples) / (SIMD_TILE_X_DIM * SIMD_TILE_Y_DIM);
+
+    for (uint32_t si = 0; si < numSimdTiles; ++si)
+    {
+        for (uint32_t v = 0; v < numVectors; ++v)
+        {
+            _simd_store_si(pBuf++, vClearTile[v]);
+        }
+    }
+}
+
 void HotTileMgr::ClearColorHotTile(const HOTTILE* pHotTile)  // clear a macro tile from float4 clear data.
 {
+    switch (pHotTile->format)
+    {
+    case R8G8B8A8_UNORM: ClearCompactColorHotTile<R8G8B8A8_UNORM>(pHotTile); return;
+    case R16G16B16A16_FLOAT: ClearCompactColorHotTile<R16G16B16A16_FLOAT>(pHotTile); return;
+    default: SWR_ASSERT(pHotTile->format == KNOB_COLOR_HOT_TILE_FORMAT); break;
+    }
+
     // Load clear color into SIMD register...
     float *pClearData = (float*)(pHotTile->clearData);
     simdscalar valR = _simd_broadcast_ss(&pClearData[0]);
@@ -398,7 +474,7 @@ void HotTileMgr::InitializeHotTiles(SWR_CONTEXT* pContext, DRAW_CONTEXT* pDC, ui
         {
             AR_BEGIN(BELoadTiles, pDC->drawId);
             // invalid hottile before draw requires a load from surface before we can draw to it
-            pContext->pfnLoadTile(GetPrivateState(pDC), KNOB_COLOR_HOT_TILE_FORMAT, (SWR_RENDERTARGET_ATTACHMENT)(SWR_ATTACHMENT_COLOR0 + rtSlot), x, y, pHotTile->renderTargetArrayIndex, pHotTile->pBuffer);
+            pContext->pfnLoadTile(GetPrivateState(pDC), pHotTile->format, (SWR_RENDERTARGET_ATTACHMENT)(SWR_ATTACHMENT_COLOR0 + rtSlot), x, y, pHotTile->renderTargetArrayIndex, pHotTile->pBuffer);
             pHotTile->state = HOTTILE_DIRTY;
             AR_END(BELoadTiles, 0);
         }
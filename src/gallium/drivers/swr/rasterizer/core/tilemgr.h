@@ -260,6 +260,7 @@ struct HOTTILE
     DWORD clearData[4];                 // May need to change based on pfnClearTile implementation.  Reorder for alignment?
     uint32_t numSamples;
     uint32_t renderTargetArrayIndex;    // current render target array index loaded
+    SWR_FORMAT format;                  // format of the hot tile contents
 };
 
 union HotTileSet
@@ -318,6 +319,17 @@ private:
     HotTileSet mHotTiles[KNOB_NUM_HOT_TILES_X][KNOB_NUM_HOT_TILES_Y];
     uint32_t mHotTileSize[SWR_NUM_ATTACHMENTS];
 
+    static SWR_FORMAT GetHotTileFormat(const API_STATE& state, SWR_RENDERTARGET_ATTACHMENT attachment);
+
+    uint32_t GetHotTileSize(SWR_RENDERTARGET_ATTACHMENT attachment, SWR_FORMAT format) const
+    {
+        if (attachment <= SWR_ATTACHMENT_COLOR7)
+        {
+            return mHotTileSize[attachment] >> GetColorHotTileShift(format);
+        }
+        return mHotTileSize[attachment];
+    }
+
     void* AllocHotTileMem(size_t size, uint32_t align, uint32_t numaNode)
     {
         void* p = nullptr;
@@ -74,7 +74,27 @@ void LoadHotTile(
         renderTargetArrayIndex = 0;
     }
 
-    if (renderTargetIndex < SWR_ATTACHMENT_DEPTH)
+    if (renderTargetIndex < SWR_ATTACHMENT_DEPTH && dstFormat != KNOB_COLOR_HOT_TILE_FORMAT)
+    {
+        SWR_ASSERT(dstFormat == GetColorHotTileFormat(pSrcSurface->format), "Mismatched compact hot tile format");
+
+        switch (pSrcSurface->tileMode)
+        {
+        case SWR_TILE_NONE:
+            pfnLoadTiles = sLoadTilesCompactColorTable_SWR_TILE_NONE[pSrcSurface->format];
+            break;
+        case SWR_TILE_MODE_YMAJOR:
+            pfnLoadTiles = sLoadTilesCompactColorTable_SWR_TILE_MODE_YMAJOR[pSrcSurface->format];
+            break;
+        case SWR_TILE_MODE_XMAJOR:
+            pfnLoadTiles = sLoadTilesCompactColorTable_SWR_TILE_MODE_XMAJOR[pSrcSurface->format];
+            break;
+        default:
+            SWR_ASSERT(0, "Unsupported tiling mode");
+            break;
+        }
+    }
+    else if (renderTargetIndex < SWR_ATTACHMENT_DEPTH)
     {
         switch (pSrcSurface->tileMode)
         {
@@ -29,6 +29,7 @@
 #include "common/formats.h"
 #include "core/context.h"
 #include "core/rdtsc_core.h"
+#include "core/format_conversion.h"
 #include "memory/TilingFunctions.h"
 #include "memory/tilingtraits.h"
 #include "memory/Convert.h"
@@ -47,6 +48,10 @@ extern PFN_LOAD_TILES sLoadTilesColorTable_SWR_TILE_MODE_XMAJOR[NUM_SWR_FORMATS]
 
 extern PFN_LOAD_TILES sLoadTilesDepthTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
 
+extern PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_NONE[NUM_SWR_FORMATS];
+extern PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
+extern PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_MODE_XMAJOR[NUM_SWR_FORMATS];
+
 void InitLoadTilesTable_Linear();
 void InitLoadTilesTable_XMajor();
 void InitLoadTilesTable_YMajor();
@@ -134,6 +139,51 @@ struct LoadRasterTile
     }
 };
 
+#if !USE_8x2_TILE_BACKEND
+//////////////////////////////////////////////////////////////////////////
+/// LoadCompactRasterTile - Loads a raster tile into a compact color hot
+/// tile. The per-pixel path produces float colors, so the raster tile is
+/// loaded as RGBA32_FLOAT and then packed to the hot tile format.
+//////////////////////////////////////////////////////////////////////////
+template<typename TTraits, SWR_FORMAT SrcFormat, SWR_FORMAT DstFormat>
+struct LoadCompactRasterTile
+{
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Loads an 8x8 raster tile from the src surface.
+    /// @param pSrcSurface - Src surface state
+    /// @param pDst - Destination hot tile pointer
+    /// @param x, y - Coordinates to raster tile.
+    INLINE static void Load(
+        const SWR_SURFACE_STATE* pSrcSurface,
+        uint8_t* pDst,
+        uint32_t x, uint32_t y, uint32_t sampleNum, uint32_t renderTargetArrayIndex)
+    {
+        OSALIGNSIMD(uint8_t) floatTile[KNOB_TILE_X_DIM * KNOB_TILE_Y_DIM * FormatTraits<R32G32B32A32_FLOAT>::bpp / 8] = {};
+
+        LoadRasterTile<TTraits, SrcFormat, R32G32B32A32_FLOAT>::Load(pSrcSurface, floatTile, x, y, sampleNum, renderTargetArrayIndex);
+
+        const uint8_t *pFloat = floatTile;
+        for (uint32_t i = 0; i < (KNOB_TILE_X_DIM * KNOB_TILE_Y_DIM) / KNOB_SIMD_WIDTH; ++i)
+        {
+            simdvector color;
+            LoadSOA<R32G32B32A32_FLOAT>(pFloat, color);
+            StoreSOA<DstFormat>(color, pDst);
+
+            pFloat += (KNOB_SIMD_WIDTH * FormatTraits<R32G32B32A32_FLOAT>::bpp) / 8;
+            pDst += (KNOB_SIMD_WIDTH * FormatTraits<DstFormat>::bpp) / 8;
+        }
+    }
+};
+
+template<typename TTraits, SWR_FORMAT SrcFormat>
+struct LoadRasterTile<TTraits, SrcFormat, R8G8B8A8_UNORM> : LoadCompactRasterTile<TTraits, SrcFormat, R8G8B8A8_UNORM>
+{};
+
+template<typename TTraits, SWR_FORMAT SrcFormat>
+struct LoadRasterTile<TTraits, SrcFormat, R16G16B16A16_FLOAT> : LoadCompactRasterTile<TTraits, SrcFormat, R16G16B16A16_FLOAT>
+{};
+
+#endif
 //////////////////////////////////////////////////////////////////////////
 /// LoadMacroTile - Loads a macro tile which consists of raster tiles.
 //////////////////////////////////////////////////////////////////////////
@@ -352,3 +402,21 @@ static INLINE void InitLoadTileDepthTable(PFN_LOAD_TILES(&table)[NUM_SWR_FORMATS
    table[R16_UNORM]                       = LoadMacroTile<TilingTraits<TTileMode, 16>, R16_UNORM, R32_FLOAT>::Load;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// InitLoadTileCompactColorTable - Helper function for setting up the
+/// tables used for compact color hot tiles, indexed by source format.
+template<SWR_TILE_MODE TTileMode>
+static INLINE void InitLoadTileCompactColorTable(PFN_LOAD_TILES(&table)[NUM_SWR_FORMATS])
+{
+    memset(table, 0, sizeof(table));
+
+#if !USE_8x2_TILE_BACKEND
+    table[R8G8B8A8_UNORM]                  = LoadMacroTile<TilingTraits<TTileMode, 32>, R8G8B8A8_UNORM, R8G8B8A8_UNORM>::Load;
+    table[R8G8B8X8_UNORM]                  = LoadMacroTile<TilingTraits<TTileMode, 32>, R8G8B8X8_UNORM, R8G8B8A8_UNORM>::Load;
+    table[B8G8R8A8_UNORM]                  = LoadMacroTile<TilingTraits<TTileMode, 32>, B8G8R8A8_UNORM, R8G8B8A8_UNORM>::Load;
+    table[B8G8R8X8_UNORM]                  = LoadMacroTile<TilingTraits<TTileMode, 32>, B8G8R8X8_UNORM, R8G8B8A8_UNORM>::Load;
+    table[R16G16B16A16_FLOAT]              = LoadMacroTile<TilingTraits<TTileMode, 64>, R16G16B16A16_FLOAT, R16G16B16A16_FLOAT>::Load;
+    table[R16G16B16X16_FLOAT]              = LoadMacroTile<TilingTraits<TTileMode, 64>, R16G16B16X16_FLOAT, R16G16B16A16_FLOAT>::Load;
+#endif
+}
+
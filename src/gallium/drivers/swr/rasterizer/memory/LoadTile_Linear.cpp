@@ -28,6 +28,7 @@
 #include "LoadTile.h"
 
 PFN_LOAD_TILES sLoadTilesColorTable_SWR_TILE_NONE[NUM_SWR_FORMATS];
+PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_NONE[NUM_SWR_FORMATS];
 PFN_LOAD_TILES sLoadTilesDepthTable_SWR_TILE_NONE[NUM_SWR_FORMATS];
 
 //////////////////////////////////////////////////////////////////////////
@@ -35,5 +36,6 @@ PFN_LOAD_TILES sLoadTilesDepthTable_SWR_TILE_NONE[NUM_SWR_FORMATS];
 void InitLoadTilesTable_Linear()
 {
     InitLoadTileColorTable<SWR_TILE_NONE>(sLoadTilesColorTable_SWR_TILE_NONE);
+    InitLoadTileCompactColorTable<SWR_TILE_NONE>(sLoadTilesCompactColorTable_SWR_TILE_NONE);
     InitLoadTileDepthTable<SWR_TILE_NONE>(sLoadTilesDepthTable_SWR_TILE_NONE);
 }
@@ -28,10 +28,12 @@
 #include "LoadTile.h"
 
 PFN_LOAD_TILES sLoadTilesColorTable_SWR_TILE_MODE_XMAJOR[NUM_SWR_FORMATS];
+PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_MODE_XMAJOR[NUM_SWR_FORMATS];
 
 //////////////////////////////////////////////////////////////////////////
 /// @brief Sets up tables for LoadTile
 void InitLoadTilesTable_XMajor()
 {
     InitLoadTileColorTable<SWR_TILE_MODE_XMAJOR>(sLoadTilesColorTable_SWR_TILE_MODE_XMAJOR);
+    InitLoadTileCompactColorTable<SWR_TILE_MODE_XMAJOR>(sLoadTilesCompactColorTable_SWR_TILE_MODE_XMAJOR);
 }
@@ -28,6 +28,7 @@
 #include "LoadTile.h"
 
 PFN_LOAD_TILES sLoadTilesColorTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
+PFN_LOAD_TILES sLoadTilesCompactColorTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
 PFN_LOAD_TILES sLoadTilesDepthTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
 
 //////////////////////////////////////////////////////////////////////////
@@ -35,5 +36,6 @@ PFN_LOAD_TILES sLoadTilesDepthTable_SWR_TILE_MODE_YMAJOR[NUM_SWR_FORMATS];
 void InitLoadTilesTable_YMajor()
 {
     InitLoadTileColorTable<SWR_TILE_MODE_YMAJOR>(sLoadTilesColorTable_SWR_TILE_MODE_YMAJOR);
+    InitLoadTileCompactColorTable<SWR_TILE_MODE_YMAJOR>(sLoadTilesCompactColorTable_SWR_TILE_MODE_YMAJOR);
     InitLoadTileDepthTable<SWR_TILE_MODE_YMAJOR>(sLoadTilesDepthTable_SWR_TILE_MODE_YMAJOR);
 }
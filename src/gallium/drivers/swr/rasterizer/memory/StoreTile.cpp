@@ -32,6 +32,7 @@
 PFN_STORE_TILES sStoreTilesTableColor[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS] = {};
 PFN_STORE_TILES sStoreTilesTableDepth[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS] = {};
 PFN_STORE_TILES sStoreTilesTableStencil[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS] = {};
+PFN_STORE_TILES sStoreTilesTableCompactColor[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS] = {};
 
 static void BUCKETS_START(UINT id)
 {
@@ -80,7 +81,15 @@ void StoreHotTileToSurface(
 
     if (renderTargetIndex <= SWR_ATTACHMENT_COLOR7)
     {
-        pfnStoreTiles = sStoreTilesTableColor[pDstSurface->tileMode][pDstSurface->format];
+        if (srcFormat != KNOB_COLOR_HOT_TILE_FORMAT)
+        {
+            SWR_ASSERT(srcFormat == GetColorHotTileFormat(pDstSurface->format), "Mismatched compact hot tile format");
+            pfnStoreTiles = sStoreTilesTableCompactColor[pDstSurface->tileMode][pDstSurface->format];
+        }
+        else
+        {
+            pfnStoreTiles = sStoreTilesTableColor[pDstSurface->tileMode][pDstSurface->format];
+        }
     }
     else if (renderTargetIndex == SWR_ATTACHMENT_DEPTH)
     {
@@ -125,6 +134,7 @@ void InitSimStoreTilesTable()
 {
     memset(sStoreTilesTableColor, 0, sizeof(sStoreTilesTableColor));
     memset(sStoreTilesTableDepth, 0, sizeof(sStoreTilesTableDepth));
+    memset(sStoreTilesTableCompactColor, 0, sizeof(sStoreTilesTableCompactColor));
 
     InitStoreTilesTable_Linear_1();
     InitStoreTilesTable_Linear_2();
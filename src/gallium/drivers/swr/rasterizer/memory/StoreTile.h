@@ -49,6 +49,7 @@ typedef void(*PFN_STORE_TILES)(uint8_t*, SWR_SURFACE_STATE*, uint32_t, uint32_t,
 extern PFN_STORE_TILES sStoreTilesTableColor[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS];
 extern PFN_STORE_TILES sStoreTilesTableDepth[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS];
 extern PFN_STORE_TILES sStoreTilesTableStencil[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS];
+extern PFN_STORE_TILES sStoreTilesTableCompactColor[SWR_TILE_MODE_COUNT][NUM_SWR_FORMATS];
 
 void InitStoreTilesTable_Linear_1();
 void InitStoreTilesTable_Linear_2();
@@ -423,6 +424,48 @@ struct ConvertPixelsSOAtoAOS<Format, Format>
     }
 };
 
+#if !USE_8x2_TILE_BACKEND
+//////////////////////////////////////////////////////////////////////////
+/// ConvertPixelsSOAtoAOS - Specialization for RGBA8 hot tile to BGRA8.
+/// Swizzles and transposes with byte unpacks, without converting to float.
+//////////////////////////////////////////////////////////////////////////
+template<>
+struct ConvertPixelsSOAtoAOS<R8G8B8A8_UNORM, B8G8R8A8_UNORM>
+{
+    template <size_t NumDests>
+    INLINE static void Convert(const uint8_t* pSrc, uint8_t* (&ppDsts)[NumDests])
+    {
+        OSALIGNSIMD(uint8_t) aosTile[KNOB_SIMD_WIDTH * 4];
+
+        __m128i vRG = _mm_load_si128((const __m128i*)pSrc);                 // rrrrrrrrgggggggg
+        __m128i vBA = _mm_load_si128((const __m128i*)(pSrc + 16));          // bbbbbbbbaaaaaaaa
+        __m128i vBG = _mm_unpacklo_epi8(vBA, _mm_srli_si128(vRG, 8));       // bgbgbgbgbgbgbgbg
+        __m128i vRA = _mm_unpacklo_epi8(vRG, _mm_srli_si128(vBA, 8));       // rararararararara
+
+        _mm_store_si128((__m128i*)aosTile, _mm_unpacklo_epi16(vBG, vRA));           // bgrabgrabgrabgra
+        _mm_store_si128((__m128i*)(aosTile + 16), _mm_unpackhi_epi16(vBG, vRA));    // bgrabgrabgrabgra
+
+        StorePixels<32, NumDests>::Store(aosTile, ppDsts);
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////
+/// ConvertPixelsSOAtoAOS - Compact hot tiles to surfaces without alpha.
+/// The layout matches the alpha variant, the X channel is don't care.
+//////////////////////////////////////////////////////////////////////////
+template<>
+struct ConvertPixelsSOAtoAOS<R8G8B8A8_UNORM, R8G8B8X8_UNORM> : ConvertPixelsSOAtoAOS<R8G8B8A8_UNORM, R8G8B8A8_UNORM>
+{};
+
+template<>
+struct ConvertPixelsSOAtoAOS<R8G8B8A8_UNORM, B8G8R8X8_UNORM> : ConvertPixelsSOAtoAOS<R8G8B8A8_UNORM, B8G8R8A8_UNORM>
+{};
+
+template<>
+struct ConvertPixelsSOAtoAOS<R16G16B16A16_FLOAT, R16G16B16X16_FLOAT> : ConvertPixelsSOAtoAOS<R16G16B16A16_FLOAT, R16G16B16A16_FLOAT>
+{};
+
+#endif
 //////////////////////////////////////////////////////////////////////////
 /// ConvertPixelsSOAtoAOS - Specialization conversion for B5G6R6_UNORM
 //////////////////////////////////////////////////////////////////////////
@@ -1142,6 +1185,51 @@ struct StoreRasterTile
     }
 };
 
+#if !USE_8x2_TILE_BACKEND
+//////////////////////////////////////////////////////////////////////////
+/// StoreCompactRasterTile - Generic store from a compact color hot tile.
+/// The per-pixel path works on float colors, so the raster tile is
+/// expanded to RGBA32_FLOAT first.
+//////////////////////////////////////////////////////////////////////////
+template<typename TTraits, SWR_FORMAT SrcFormat, SWR_FORMAT DstFormat>
+struct StoreCompactRasterTile
+{
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief Stores an 8x8 raster tile to the destination surface.
+    /// @param pSrc - Pointer to raster tile.
+    /// @param pDstSurface - Destination surface state
+    /// @param x, y - Coordinates to raster tile.
+    INLINE static void Store(
+        uint8_t *pSrc,
+        SWR_SURFACE_STATE* pDstSurface,
+        uint32_t x, uint32_t y, uint32_t sampleNum, uint32_t renderTargetArrayIndex)
+    {
+        OSALIGNSIMD(uint8_t) floatTile[KNOB_TILE_X_DIM * KNOB_TILE_Y_DIM * FormatTraits<R32G32B32A32_FLOAT>::bpp / 8];
+
+        uint8_t *pFloat = floatTile;
+        for (uint32_t i = 0; i < (KNOB_TILE_X_DIM * KNOB_TILE_Y_DIM) / KNOB_SIMD_WIDTH; ++i)
+        {
+            simdvector color;
+            LoadSOA<SrcFormat>(pSrc, color);
+            StoreSOA<R32G32B32A32_FLOAT>(color, pFloat);
+
+            pSrc += (KNOB_SIMD_WIDTH * FormatTraits<SrcFormat>::bpp) / 8;
+            pFloat += (KNOB_SIMD_WIDTH * FormatTraits<R32G32B32A32_FLOAT>::bpp) / 8;
+        }
+
+        StoreRasterTile<TTraits, R32G32B32A32_FLOAT, DstFormat>::Store(floatTile, pDstSurface, x, y, sampleNum, renderTargetArrayIndex);
+    }
+};
+
+template<typename TTraits, SWR_FORMAT DstFormat>
+struct StoreRasterTile<TTraits, R8G8B8A8_UNORM, DstFormat> : StoreCompactRasterTile<TTraits, R8G8B8A8_UNORM, DstFormat>
+{};
+
+template<typename TTraits, SWR_FORMAT DstFormat>
+struct StoreRasterTile<TTraits, R16G16B16A16_FLOAT, DstFormat> : StoreCompactRasterTile<TTraits, R16G16B16A16_FLOAT, DstFormat>
+{};
+
+#endif
 template<typename TTraits, SWR_FORMAT SrcFormat, SWR_FORMAT DstFormat>
 struct OptStoreRasterTile : StoreRasterTile<TTraits, SrcFormat, DstFormat>
 {};
@@ -2472,6 +2560,24 @@ void InitStoreTilesTableColor_Half2(
     table[TTileMode][R8G8B8_SINT]                   = StoreMacroTile<TilingTraits<TTileMode, 24>, R32G32B32A32_FLOAT, R8G8B8_SINT>::Store;
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// InitStoreTilesTableCompactColor - Helper for setting up the tables used
+/// for compact color hot tiles, indexed by destination format. The source
+/// format is the one GetColorHotTileFormat picks for the destination.
+template <SWR_TILE_MODE TTileMode, size_t NumTileModesT, size_t ArraySizeT>
+void InitStoreTilesTableCompactColor(
+    PFN_STORE_TILES(&table)[NumTileModesT][ArraySizeT])
+{
+#if !USE_8x2_TILE_BACKEND
+    table[TTileMode][R8G8B8A8_UNORM]                = StoreMacroTile<TilingTraits<TTileMode, 32>, R8G8B8A8_UNORM, R8G8B8A8_UNORM>::Store;
+    table[TTileMode][R8G8B8X8_UNORM]                = StoreMacroTile<TilingTraits<TTileMode, 32>, R8G8B8A8_UNORM, R8G8B8X8_UNORM>::Store;
+    table[TTileMode][B8G8R8A8_UNORM]                = StoreMacroTile<TilingTraits<TTileMode, 32>, R8G8B8A8_UNORM, B8G8R8A8_UNORM>::Store;
+    table[TTileMode][B8G8R8X8_UNORM]                = StoreMacroTile<TilingTraits<TTileMode, 32>, R8G8B8A8_UNORM, B8G8R8X8_UNORM>::Store;
+    table[TTileMode][R16G16B16A16_FLOAT]            = StoreMacroTile<TilingTraits<TTileMode, 64>, R16G16B16A16_FLOAT, R16G16B16A16_FLOAT>::Store;
+    table[TTileMode][R16G16B16X16_FLOAT]            = StoreMacroTile<TilingTraits<TTileMode, 64>, R16G16B16A16_FLOAT, R16G16B16X16_FLOAT>::Store;
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////
 /// INIT_STORE_TILES_TABLE - Helper macro for setting up the tables.
 template <SWR_TILE_MODE TTileMode, size_t NumTileModes, size_t ArraySizeT>
@@ -30,4 +30,5 @@
 void InitStoreTilesTable_Linear_2()
 {
     InitStoreTilesTableColor_Half2<SWR_TILE_NONE>(sStoreTilesTableColor);
+    InitStoreTilesTableCompactColor<SWR_TILE_NONE>(sStoreTilesTableCompactColor);
 }
@@ -30,4 +30,5 @@
 void InitStoreTilesTable_TileX_2()
 {
     InitStoreTilesTableColor_Half2<SWR_TILE_MODE_XMAJOR>(sStoreTilesTableColor);
+    InitStoreTilesTableCompactColor<SWR_TILE_MODE_XMAJOR>(sStoreTilesTableCompactColor);
 }
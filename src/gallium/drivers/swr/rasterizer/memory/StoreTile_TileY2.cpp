@@ -30,4 +30,5 @@
 void InitStoreTilesTable_TileY_2()
 {
     InitStoreTilesTableColor_Half2<SWR_TILE_MODE_YMAJOR>(sStoreTilesTableColor);
+    InitStoreTilesTableCompactColor<SWR_TILE_MODE_YMAJOR>(sStoreTilesTableCompactColor);
 }
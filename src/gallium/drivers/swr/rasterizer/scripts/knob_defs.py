@@ -61,6 +61,14 @@ KNOBS = [
         'category'  : 'perf',
     }],
 
+    ['COMPACT_COLOR_HOT_TILES', {
+        'type'      : 'bool',
+        'default'   : 'true',
+        'desc'      : ['Use RGBA8 / RGBA16F color hot tiles for 8-bit unorm and 16-bit float',
+                       'render targets instead of RGBA32F hot tiles'],
+        'category'  : 'perf',
+    }],
+
     ['MAX_NUMA_NODES', {
         'type'      : 'uint32_t',
         'default'   : '0',
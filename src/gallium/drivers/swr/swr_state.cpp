@@ -1408,6 +1408,8 @@ swr_update_derived(struct pipe_context *pipe,
             struct swr_resource *colorBuffer =
                swr_resource(fb->cbufs[target]->texture);
 
+            blendState.renderTargetFormat[target] = colorBuffer->swr.format;
+
             BLEND_COMPILE_STATE compileState;
             memset(&compileState, 0, sizeof(compileState));
             compileState.format = colorBuffer->swr.format;
@@ -93,6 +93,22 @@ struct sw_winsys
                             const void *front_private,
                             unsigned *stride );
 
+   /**
+    * Wrap caller-owned memory as a render target, with the given stride.
+    *
+    * The memory is neither allocated nor freed by the winsys, and must stay
+    * valid until the display target is destroyed.  Optional, may be NULL.
+    *
+    * Used to implement resource_from_user_memory.
+    */
+   struct sw_displaytarget *
+   (*displaytarget_create_mapped)( struct sw_winsys *ws,
+                                   unsigned tex_usage,
+                                   enum pipe_format format,
+                                   unsigned width, unsigned height,
+                                   unsigned stride,
+                                   void *data );
+
    /**
     * Used to implement texture_from_handle.
     */
@@ -454,10 +454,7 @@ dri_init_screen_helper(struct dri_screen *screen,
 
    /* Handle force_s3tc_enable. */
    if (!util_format_s3tc_enabled && screen->options.force_s3tc_enable) {
-      /* Ensure libtxc_dxtn has been loaded if available.
-       * Forcing S3TC on before calling this would prevent loading
-       * the library.
-       * This is just a precaution, the driver should have called it
+      /* This is just a precaution, the driver should have called it
        * already.
        */
       util_format_s3tc_init();
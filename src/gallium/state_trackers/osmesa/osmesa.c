@@ -38,9 +38,16 @@
  * With llvmpipe we could only render directly into the user's buffer when its
  * width and height is a multiple of the tile size (64 pixels).
  *
- * Because of these constraints we always render into ordinary resources then
- * copy the results to the user's buffer in the flush_front() function which
- * is called when the app calls glFlush/Finish.
+ * Because of these constraints we normally render into ordinary resources
+ * then copy the results to the user's buffer in the flush_front() function
+ * which is called when the app calls glFlush/Finish.
+ *
+ * When the driver can wrap user memory (llvmpipe, through the null sw
+ * winsys), OSMESA_Y_UP is FALSE, the row length matches the width, the
+ * size is a multiple of the 4x4 pixel block llvmpipe shades and the
+ * gallium format matches the user's format/type exactly, the color buffer
+ * is rendered directly into the user's buffer and flush_front() only waits
+ * for rendering to finish.  Set OSMESA_DIRECT_RENDERING=0 to always copy.
  *
  * In general, the OSMesa interface is pretty ugly and not a good match
  * for Gallium.  But we're interested in doing the best we can to preserve
@@ -61,6 +68,7 @@
 #include "util/u_atomic.h"
 #include "util/u_box.h"
 #include "util/u_debug.h"
+#include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_memory.h"
 
@@ -87,6 +95,9 @@ struct osmesa_buffer
 
    void *map;
 
+   /** Is the front color resource wrapping the user's buffer ('map')? */
+   boolean direct;
+
    struct osmesa_buffer *next;  /**< next in linked list */
 };
 
@@ -124,6 +135,9 @@ struct osmesa_context
 static struct osmesa_buffer *BufferList = NULL;
 
 
+DEBUG_GET_ONCE_BOOL_OPTION(osmesa_direct_rendering, "OSMESA_DIRECT_RENDERING", TRUE)
+
+
 /**
  * Called from the ST manager.
  */
@@ -265,6 +279,30 @@ osmesa_choose_format(GLenum format, GLenum type)
 }
 
 
+/**
+ * Does the gallium format returned by osmesa_choose_format() have exactly
+ * the memory layout of the user's format/type?  Only then can we render
+ * straight into the user's buffer.
+ */
+static boolean
+osmesa_format_is_exact(GLenum format, GLenum type)
+{
+   switch (format) {
+   case OSMESA_RGBA:
+   case OSMESA_RGB:
+      return TRUE;
+   case OSMESA_BGRA:
+   case OSMESA_ARGB:
+      /* short/float variants are stored as RGBA */
+      return type == GL_UNSIGNED_BYTE;
+   case OSMESA_RGB_565:
+      return type == GL_UNSIGNED_SHORT_5_6_5;
+   default:
+      return FALSE;
+   }
+}
+
+
 /**
  * Initialize an st_visual object.
  */
@@ -299,6 +337,54 @@ stfbi_to_osbuffer(struct st_framebuffer_iface *stfbi)
 }
 
 
+/**
+ * Can the front color buffer of osbuffer be a resource wrapping the
+ * user's buffer, given the current pixel store state of the context?
+ */
+static boolean
+osmesa_can_render_direct(const struct osmesa_context *osmesa,
+                         const struct osmesa_buffer *osbuffer)
+{
+   struct pipe_screen *screen = get_st_manager()->screen;
+   enum pipe_format format = osbuffer->visual.color_format;
+
+   if (!debug_get_option_osmesa_direct_rendering() ||
+       !screen->resource_from_user_memory)
+      return FALSE;
+
+   /* Gallium renders with Y down, and the winsys wants packed rows */
+   if (osmesa->y_up ||
+       (osmesa->user_row_length &&
+        osmesa->user_row_length != osbuffer->width))
+      return FALSE;
+
+   /* llvmpipe shades whole 4x4 blocks, which must not fall outside */
+   if (osbuffer->width % 4 || osbuffer->height % 4)
+      return FALSE;
+
+   if (!osmesa_format_is_exact(osmesa->format, osmesa->type))
+      return FALSE;
+
+   return screen->is_format_supported(screen, format, PIPE_TEXTURE_RECT, 0,
+                                      PIPE_BIND_RENDER_TARGET);
+}
+
+
+/**
+ * Called when the pixel store state or the user's buffer changes.  If
+ * whether we can render directly changed, bump the framebuffer stamp so
+ * the state tracker revalidates and we pick the matching color resource.
+ */
+static void
+osmesa_update_direct(OSMesaContext osmesa, struct osmesa_buffer *osbuffer)
+{
+   if (osbuffer &&
+       osbuffer->direct != osmesa_can_render_direct(osmesa, osbuffer)) {
+      p_atomic_inc(&osbuffer->stfb->stamp);
+   }
+}
+
+
 /**
  * Called via glFlush/glFinish.  This is where we copy the contents
  * of the driver's color buffer into the user-specified buffer.
@@ -346,6 +432,14 @@ osmesa_st_framebuffer_flush_front(struct st_context_iface *stctx,
    map = pipe->transfer_map(pipe, res, 0, PIPE_TRANSFER_READ, &box,
                             &transfer);
 
+   if (statt == ST_ATTACHMENT_FRONT_LEFT && osbuffer->direct) {
+      /* Already rendered into the user's buffer, the map above only
+       * waited for rendering to finish.
+       */
+      pipe->transfer_unmap(pipe, transfer);
+      return TRUE;
+   }
+
    /*
     * Copy the color buffer from the resource to the user's buffer.
     */
@@ -388,6 +482,7 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
                                struct pipe_resource **out)
 {
    struct pipe_screen *screen = get_st_manager()->screen;
+   OSMesaContext osmesa = (OSMesaContext) stctx->st_manager_private;
    enum st_attachment_type i;
    struct osmesa_buffer *osbuffer = stfbi_to_osbuffer(stfbi);
    struct pipe_resource templat;
@@ -432,8 +527,22 @@ osmesa_st_framebuffer_validate(struct st_context_iface *stctx,
 
       templat.format = format;
       templat.bind = bind;
-      out[i] = osbuffer->textures[statts[i]] =
-         screen->resource_create(screen, &templat);
+      out[i] = NULL;
+
+      if (statts[i] == ST_ATTACHMENT_FRONT_LEFT) {
+         /* Try to render straight into the user's buffer, fall back to a
+          * private resource that flush_front() copies from.
+          */
+         if (osmesa_can_render_direct(osmesa, osbuffer))
+            out[i] = screen->resource_from_user_memory(screen, &templat,
+                                                       osbuffer->map);
+         osbuffer->direct = out[i] != NULL;
+      }
+
+      if (!out[i])
+         out[i] = screen->resource_create(screen, &templat);
+
+      osbuffer->textures[statts[i]] = out[i];
    }
 
    return TRUE;
@@ -776,6 +885,26 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
 
    osbuffer->width = width;
    osbuffer->height = height;
+
+   if (osbuffer->direct && osbuffer->map != buffer) {
+      /* Rendering into the old user buffer must land before the app
+       * reuses it, and the color resource must wrap the new one.
+       */
+      OSMesaContext current = OSMesaGetCurrentContext();
+      if (current) {
+         struct pipe_screen *screen = get_st_manager()->screen;
+         struct pipe_fence_handle *fence = NULL;
+
+         current->stctx->flush(current->stctx, 0, &fence);
+         if (fence) {
+            screen->fence_finish(screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+            screen->fence_reference(screen, &fence, NULL);
+         }
+      }
+      osbuffer->direct = FALSE;
+      p_atomic_inc(&osbuffer->stfb->stamp);
+   }
+
    osbuffer->map = buffer;
 
    /* XXX unused for now */
@@ -784,6 +913,8 @@ OSMesaMakeCurrent(OSMesaContext osmesa, void *buffer, GLenum type,
    osmesa->current_buffer = osbuffer;
    osmesa->type = type;
 
+   osmesa_update_direct(osmesa, osbuffer);
+
    stapi->make_current(stapi, osmesa->stctx, osbuffer->stfb, osbuffer->stfb);
 
    if (!osmesa->ever_used) {
@@ -840,6 +971,8 @@ OSMesaPixelStore(GLint pname, GLint value)
       fprintf(stderr, "Invalid pname in OSMesaPixelStore()\n");
       return;
    }
+
+   osmesa_update_direct(osmesa, osmesa->current_buffer);
 }
 
 
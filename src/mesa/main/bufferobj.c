@@ -1092,7 +1092,8 @@ _mesa_lookup_bufferobj(struct gl_context *ctx, GLuint buffer)
       return NULL;
    else
       return (struct gl_buffer_object *)
-         _mesa_HashLookup(ctx->Shared->BufferObjects, buffer);
+         _mesa_HashLookupCached(ctx->Shared->BufferObjects, buffer,
+                                &ctx->BufferObjectLookupCache);
 }
 
 
@@ -141,6 +141,7 @@
 
 #include "compiler/glsl_types.h"
 #include "compiler/glsl/glsl_parser_extras.h"
+#include "util/disk_cache.h"
 #include <stdbool.h>
 
 
@@ -1260,6 +1261,11 @@ _mesa_initialize_context(struct gl_context *ctx,
       break;
    }
 
+   /* Linked GLSL programs are kept on disk unless disabled through the
+    * MESA_GLSL_CACHE_* environment variables.
+    */
+   ctx->Cache = disk_cache_create();
+
    ctx->FirstTimeCurrent = GL_TRUE;
 
    return GL_TRUE;
@@ -1348,6 +1354,11 @@ _mesa_free_context_data( struct gl_context *ctx )
 
    free(ctx->VersionString);
 
+   if (ctx->Cache) {
+      disk_cache_destroy(ctx->Cache);
+      ctx->Cache = NULL;
+   }
+
    /* unbind the context if it's currently bound */
    if (ctx == _mesa_get_current_context()) {
       _mesa_make_current(NULL, NULL, NULL);
@@ -1728,6 +1739,11 @@ _mesa_share_state(struct gl_context *ctx, struct gl_context *ctxToShare)
       /* update ctx's Shared pointer */
       _mesa_reference_shared_state(ctx, &ctx->Shared, ctxToShare->Shared);
 
+      /* the cached lookups refer to the old tables */
+      memset(&ctx->TextureLookupCache, 0, sizeof ctx->TextureLookupCache);
+      memset(&ctx->BufferObjectLookupCache, 0,
+             sizeof ctx->BufferObjectLookupCache);
+
       update_default_objects(ctx);
 
       /* release the old shared state */
@@ -515,6 +515,13 @@ struct dd_function_table {
     */
    GLboolean (*LinkShader)(struct gl_context *ctx,
                            struct gl_shader_program *shader);
+
+   /**
+    * Called when the GLSL compiler begins a phase of compiling a shader
+    * ("preprocess", "parse", "ast_to_hir" or "optimize"), and with a NULL
+    * phase once it's done.  Only meant for profiling tools, may be NULL.
+    */
+   void (*GLSLCompilePhase)(struct gl_context *ctx, const char *phase);
    /*@}*/
 
    /**
@@ -37,36 +37,82 @@
 #include "glheader.h"
 #include "imports.h"
 #include "hash.h"
-#include "util/hash_table.h"
+#include "util/u_atomic.h"
 
 /**
- * Magic GLuint object name that gets stored outside of the struct hash_table.
- *
- * The hash table needs a particular pointer to be the marker for a key that
- * was deleted from the table, along with NULL for the "never allocated in the
- * table" marker.  Legacy GL allows any GLuint to be used as a GL object name,
- * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
- * able to track a GLuint that happens to match the deleted key outside of
- * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * Number of reader counters.  Readers are spread over them so that threads
+ * looking up objects in the same table don't all hit the same cache line.
+ */
+#define NUM_READER_SHARDS 8
+
+#define MIN_TABLE_SIZE 16
+
+/**
+ * Lookups can only skip the mutex when p_atomic_read() and p_atomic_set()
+ * are acquire loads and release stores.  The other u_atomic.h
+ * implementations make them plain accesses, which would let a lookup see a
+ * key without its data, or the data pointer before the object it points to.
+ */
+#ifdef USE_GCC_ATOMIC_BUILTINS
+#define HASH_LOCKLESS_LOOKUP 1
+#else
+#define HASH_LOCKLESS_LOOKUP 0
+#endif
+
+/**
+ * A table entry.  key=0 means the slot was never used, data=NULL means the
+ * key was removed and the slot may be reused.
+ */
+struct hash_slot {
+   GLuint key;
+   void *data;
+};
+
+/**
+ * The slot array, replaced as a whole when the table is resized.
  */
-#define DELETED_KEY_VALUE 1
+struct hash_slots {
+   GLuint Mask;                          /**< number of slots - 1 */
+   struct hash_slot *Slot;
+};
 
 /**
- * The hash table data structure.  
+ * Per shard count of the lookups in progress, for each epoch parity.
+ */
+union hash_readers {
+   int Count[2];
+   char Pad[64];
+};
+
+/**
+ * The hash table data structure.
+ *
+ * Lookups don't take the mutex (see HASH_LOCKLESS_LOOKUP).  Inserts and
+ * removes update the slots in place with release stores, writing the key
+ * before the data, so readers only ever see a complete entry or none.  A
+ * lookup that finds the key re-reads it after the data, because the slot of
+ * a removed key can be given to another key.
+ *
+ * When the table is resized, the new slot array is published and the old
+ * one is only freed once all lookups that could still be reading it have
+ * completed.  Lookups register themselves in Readers[shard].Count[epoch],
+ * and the writer flips the epoch twice, waiting for the counters of the
+ * previous parity to drain each time.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct hash_slots *Slots;
+   GLuint NumEntries;                    /**< number of keys with data */
+   GLuint NumUsed;                       /**< number of slots with a key */
    GLuint MaxKey;                        /**< highest key inserted so far */
+   GLuint Generation;                    /**< bumped when data is unmapped */
+   unsigned ReaderEpoch;
+   union hash_readers Readers[NUM_READER_SHARDS];
    mtx_t Mutex;                /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
-/** @{
- * Mapping from our use of GLuint as both the key and the hash value to the
- * hash_table.h API
+/**
+ * The key is also the hash value.
  *
  * There exist many integer hash functions, designed to avoid collisions when
  * the integers are spread across key space with some patterns.  In GL, the
@@ -83,30 +129,111 @@ struct _mesa_HashTable {
  * the end of that sequence, instead of 1-150.  So far it doesn't appear to be
  * a problem.
  */
-static bool
-uint_key_compare(const void *a, const void *b)
+static inline GLuint
+uint_hash(GLuint id)
 {
-   return a == b;
+   return id;
 }
 
-static uint32_t
-uint_hash(GLuint id)
+
+static struct hash_slots *
+alloc_slots(GLuint size)
 {
-   return id;
+   struct hash_slots *slots;
+
+   assert(_mesa_is_pow_two(size));
+
+   slots = malloc(sizeof *slots + size * sizeof(struct hash_slot));
+   if (!slots)
+      return NULL;
+
+   slots->Mask = size - 1;
+   slots->Slot = (struct hash_slot *) (slots + 1);
+   memset(slots->Slot, 0, size * sizeof(struct hash_slot));
+   return slots;
+}
+
+
+/**
+ * Pick the reader counter of the calling thread.  Threads run on different
+ * stacks, so the stack address tells them apart without a thread-local
+ * lookup.  Two threads sharing a shard is harmless, it only costs speed.
+ */
+static inline unsigned
+reader_shard(void)
+{
+   int local;
+
+   return (uint32_t) (((uintptr_t) &local >> 16) * 2654435761u) >> 29;
 }
 
-static uint32_t
-uint_key_hash(const void *key)
+
+/**
+ * Wait until no lookup started before this call is still running.
+ * Called with the mutex held, after publishing new slots.
+ */
+static void
+wait_for_readers(struct _mesa_HashTable *table)
 {
-   return uint_hash((uintptr_t)key);
+   unsigned pass, i;
+
+   for (pass = 0; pass < 2; pass++) {
+      const unsigned old = table->ReaderEpoch & 1;
+
+      p_atomic_inc(&table->ReaderEpoch);
+
+      /* New lookups count themselves in the other parity now, so these
+       * counters drain.  The compare-and-swap, rather than a plain read,
+       * orders the publication of the slots with the lookups' increments.
+       */
+      for (i = 0; i < NUM_READER_SHARDS; i++) {
+         while (p_atomic_cmpxchg(&table->Readers[i].Count[old], 0, 0) != 0)
+            thrd_yield();
+      }
+   }
 }
 
-static void *
-uint_key(GLuint id)
+
+/**
+ * Move the entries to a new slot array with room for at least twice as
+ * many keys, which also drops the slots of removed keys.
+ */
+static bool
+resize_table(struct _mesa_HashTable *table)
 {
-   return (void *)(uintptr_t) id;
+   struct hash_slots *old = table->Slots;
+   struct hash_slots *slots;
+   GLuint size = MIN_TABLE_SIZE;
+   GLuint i;
+
+   while (size < 2 * (table->NumEntries + 1))
+      size *= 2;
+
+   slots = alloc_slots(size);
+   if (!slots)
+      return false;
+
+   for (i = 0; i <= old->Mask; i++) {
+      const struct hash_slot *src = &old->Slot[i];
+
+      if (src->data) {
+         GLuint j = uint_hash(src->key) & slots->Mask;
+
+         while (slots->Slot[j].key)
+            j = (j + 1) & slots->Mask;
+
+         slots->Slot[j] = *src;
+      }
+   }
+
+   p_atomic_set(&table->Slots, slots);
+   table->NumUsed = table->NumEntries;
+
+   wait_for_readers(table);
+   free(old);
+   return true;
 }
-/** @} */
+
 
 /**
  * Create a new hash table.
@@ -119,15 +246,13 @@ _mesa_NewHashTable(void)
    struct _mesa_HashTable *table = CALLOC_STRUCT(_mesa_HashTable);
 
    if (table) {
-      table->ht = _mesa_hash_table_create(NULL, uint_key_hash,
-                                          uint_key_compare);
-      if (table->ht == NULL) {
+      table->Slots = alloc_slots(MIN_TABLE_SIZE);
+      if (table->Slots == NULL) {
          free(table);
          _mesa_error_no_memory(__func__);
          return NULL;
       }
 
-      _mesa_hash_table_set_deleted_key(table->ht, uint_key(DELETED_KEY_VALUE));
       /*
        * Needs to be recursive, since the callback in _mesa_HashWalk()
        * is allowed to call _mesa_HashRemove().
@@ -156,11 +281,11 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (table->NumEntries != 0) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
-   _mesa_hash_table_destroy(table->ht, NULL);
+   free(table->Slots);
 
    mtx_destroy(&table->Mutex);
    free(table);
@@ -170,29 +295,45 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 
 /**
  * Lookup an entry in the hash table, without locking.
- * \sa _mesa_HashLookup
+ *
+ * This is safe against concurrent inserts and removes, but the slots must
+ * not be freed under it, see _mesa_HashLookup.
  */
 static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
-   const struct hash_entry *entry;
+   const struct hash_slots *slots;
+   GLuint i;
 
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   slots = p_atomic_read(&table->Slots);
 
-   entry = _mesa_hash_table_search(table->ht, uint_key(key));
-   if (!entry)
-      return NULL;
+   for (i = uint_hash(key) & slots->Mask; ; i = (i + 1) & slots->Mask) {
+      struct hash_slot *slot = &slots->Slot[i];
+      GLuint k = p_atomic_read(&slot->key);
+
+      if (k == key) {
+         void *data = p_atomic_read(&slot->data);
+
+         /* The slot may have been handed to another key in the meantime,
+          * in which case this key was removed.
+          */
+         return p_atomic_read(&slot->key) == key ? data : NULL;
+      }
 
-   return entry->data;
+      if (k == 0)
+         return NULL;
+   }
 }
 
 
 /**
  * Lookup an entry in the hash table.
+ *
+ * Where the atomics allow it, this doesn't take the mutex, so it can run
+ * concurrently with other lookups and with writers.
  * 
  * \param table the hash table.
  * \param key the key.
@@ -203,10 +344,22 @@ void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
    assert(table);
+#if HASH_LOCKLESS_LOOKUP
+   {
+      const unsigned shard = reader_shard();
+      const unsigned epoch = p_atomic_read(&table->ReaderEpoch) & 1;
+
+      p_atomic_inc(&table->Readers[shard].Count[epoch]);
+      res = _mesa_HashLookup_unlocked(table, key);
+      p_atomic_dec(&table->Readers[shard].Count[epoch]);
+   }
+#else
    mtx_lock(&table->Mutex);
    res = _mesa_HashLookup_unlocked(table, key);
    mtx_unlock(&table->Mutex);
+#endif
    return res;
 }
 
@@ -229,6 +382,66 @@ _mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
 }
 
 
+static inline void *
+lookup_cached(struct _mesa_HashTable *table, GLuint key,
+              struct _mesa_HashLookupCache *cache)
+{
+   /* Read before the lookup, so that a concurrent remove invalidates what
+    * gets cached below.
+    */
+   const GLuint generation = p_atomic_read(&table->Generation);
+   void *res;
+
+   if (cache->Table == table && cache->Key == key &&
+       cache->Generation == generation)
+      return cache->Data;
+
+   res = _mesa_HashLookup(table, key);
+   if (res) {
+      cache->Table = table;
+      cache->Key = key;
+      cache->Generation = generation;
+      cache->Data = res;
+   }
+   return res;
+}
+
+/**
+ * Lookup an entry in the hash table, going through a single entry cache.
+ *
+ * Repeated lookups of the same name, like an application rebinding the same
+ * object, are answered from the cache without touching the table.  The cache
+ * is dropped whenever the table unmaps or remaps any key, so it never
+ * returns data that _mesa_HashLookup() wouldn't.
+ *
+ * The cache isn't thread-safe, it is meant to be owned by a context.
+ *
+ * \param table the hash table.
+ * \param key the key.
+ * \param cache the cache, zero-initialized before first use.
+ *
+ * \return pointer to user's data or NULL if key not in table
+ */
+void *
+_mesa_HashLookupCached(struct _mesa_HashTable *table, GLuint key,
+                       struct _mesa_HashLookupCache *cache)
+{
+#if HASH_LOCKLESS_LOOKUP
+   return lookup_cached(table, key, cache);
+#else
+   /* Without acquire loads, the generation is only ordered with the
+    * lookup under the (recursive) mutex.
+    */
+   void *res;
+
+   mtx_lock(&table->Mutex);
+   res = lookup_cached(table, key, cache);
+   mtx_unlock(&table->Mutex);
+   return res;
+#endif
+}
+
+
 /**
  * Lock the hash table mutex.
  *
@@ -259,11 +472,47 @@ _mesa_HashUnlockMutex(struct _mesa_HashTable *table)
 }
 
 
+/**
+ * Find the slot holding key, or else the slot key should be inserted in.
+ * Returns NULL if the table must grow first.
+ */
+static struct hash_slot *
+find_slot(struct _mesa_HashTable *table, GLuint key)
+{
+   const struct hash_slots *slots = table->Slots;
+   struct hash_slot *free_slot = NULL;
+   GLuint i;
+
+   for (i = uint_hash(key) & slots->Mask; ; i = (i + 1) & slots->Mask) {
+      struct hash_slot *slot = &slots->Slot[i];
+
+      if (slot->key == key)
+         return slot;
+
+      if (slot->key == 0)
+         break;
+
+      if (!free_slot && !slot->data)
+         free_slot = slot;
+   }
+
+   if (free_slot)
+      return free_slot;
+
+   /* Keep a quarter of the slots empty, so that probing stays short and
+    * always ends.
+    */
+   if ((table->NumUsed + 1) * 4 > (slots->Mask + 1) * 3)
+      return NULL;
+
+   return &slots->Slot[i];
+}
+
+
 static inline void
 _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
-   uint32_t hash = uint_hash(key);
-   struct hash_entry *entry;
+   struct hash_slot *slot;
 
    assert(table);
    assert(key);
@@ -271,15 +520,32 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
-   } else {
-      entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
-      if (entry) {
-         entry->data = data;
-      } else {
-         _mesa_hash_table_insert_pre_hashed(table->ht, hash, uint_key(key), data);
+   slot = find_slot(table, key);
+   if (!slot) {
+      if (!resize_table(table)) {
+         _mesa_error_no_memory(__func__);
+         return;
       }
+      slot = find_slot(table, key);
+   }
+
+   if (slot->key == key) {
+      if (slot->data) {
+         p_atomic_set(&slot->data, data);
+         p_atomic_inc(&table->Generation);
+         if (!data)
+            table->NumEntries--;
+         return;
+      }
+   } else {
+      if (slot->key == 0)
+         table->NumUsed++;
+      p_atomic_set(&slot->key, key);
+   }
+
+   if (data) {
+      p_atomic_set(&slot->data, data);
+      table->NumEntries++;
    }
 }
 
@@ -320,6 +586,19 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 }
 
 
+/**
+ * Clear the data of a slot, keeping the key so that probing continues
+ * past it.
+ */
+static inline void
+remove_slot(struct _mesa_HashTable *table, struct hash_slot *slot)
+{
+   p_atomic_set(&slot->data, NULL);
+   p_atomic_inc(&table->Generation);
+   table->NumEntries--;
+}
+
+
 /**
  * Remove an entry from the hash table.
  * 
@@ -332,7 +611,8 @@ _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data)
 static inline void
 _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
-   struct hash_entry *entry;
+   const struct hash_slots *slots;
+   GLuint i;
 
    assert(table);
    assert(key);
@@ -344,11 +624,16 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
       return;
    }
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
-   } else {
-      entry = _mesa_hash_table_search(table->ht, uint_key(key));
-      _mesa_hash_table_remove(table->ht, entry);
+   slots = table->Slots;
+   for (i = uint_hash(key) & slots->Mask; slots->Slot[i].key;
+        i = (i + 1) & slots->Mask) {
+      struct hash_slot *slot = &slots->Slot[i];
+
+      if (slot->key == key) {
+         if (slot->data)
+            remove_slot(table, slot);
+         return;
+      }
    }
 }
 
@@ -381,19 +666,21 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
                     void (*callback)(GLuint key, void *data, void *userData),
                     void *userData)
 {
-   struct hash_entry *entry;
+   const struct hash_slots *slots;
+   GLuint i;
 
    assert(table);
    assert(callback);
    mtx_lock(&table->Mutex);
    table->InDeleteAll = GL_TRUE;
-   hash_table_foreach(table->ht, entry) {
-      callback((uintptr_t)entry->key, entry->data, userData);
-      _mesa_hash_table_remove(table->ht, entry);
-   }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
+   slots = table->Slots;
+   for (i = 0; i <= slots->Mask; i++) {
+      struct hash_slot *slot = &slots->Slot[i];
+
+      if (slot->data) {
+         callback(slot->key, slot->data, userData);
+         remove_slot(table, slot);
+      }
    }
    table->InDeleteAll = GL_FALSE;
    mtx_unlock(&table->Mutex);
@@ -414,16 +701,19 @@ _mesa_HashWalk(const struct _mesa_HashTable *table,
 {
    /* cast-away const */
    struct _mesa_HashTable *table2 = (struct _mesa_HashTable *) table;
-   struct hash_entry *entry;
+   const struct hash_slots *slots;
+   GLuint i;
 
    assert(table);
    assert(callback);
    mtx_lock(&table2->Mutex);
-   hash_table_foreach(table->ht, entry) {
-      callback((uintptr_t)entry->key, entry->data, userData);
+   slots = table->Slots;
+   for (i = 0; i <= slots->Mask; i++) {
+      const struct hash_slot *slot = &slots->Slot[i];
+
+      if (slot->data)
+         callback(slot->key, slot->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
    mtx_unlock(&table2->Mutex);
 }
 
@@ -441,8 +731,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -499,12 +787,5 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
-
-   count += _mesa_hash_table_num_entries(table->ht);
-
-   return count;
+   return table->NumEntries;
 }
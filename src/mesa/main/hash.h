@@ -35,12 +35,27 @@
 #include "glheader.h"
 
 
+/**
+ * Single entry lookup cache, see _mesa_HashLookupCached().
+ */
+struct _mesa_HashLookupCache {
+   const struct _mesa_HashTable *Table;
+   GLuint Key;
+   GLuint Generation;
+   void *Data;
+};
+
+
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
 
 extern void _mesa_DeleteHashTable(struct _mesa_HashTable *table);
 
 extern void *_mesa_HashLookup(struct _mesa_HashTable *table, GLuint key);
 
+extern void *
+_mesa_HashLookupCached(struct _mesa_HashTable *table, GLuint key,
+                       struct _mesa_HashLookupCache *cache);
+
 extern void _mesa_HashInsert(struct _mesa_HashTable *table, GLuint key, void *data);
 
 extern void _mesa_HashRemove(struct _mesa_HashTable *table, GLuint key);
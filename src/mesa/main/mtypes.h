@@ -45,6 +45,7 @@
 #include "compiler/shader_enums.h"
 #include "compiler/shader_info.h"
 #include "main/formats.h"       /* MESA_FORMAT_COUNT */
+#include "main/hash.h"          /* struct _mesa_HashLookupCache */
 #include "compiler/glsl/list.h"
 #include "util/bitscan.h"
 
@@ -88,6 +89,7 @@ struct prog_instruction;
 struct gl_program_parameter_list;
 struct set;
 struct set_entry;
+struct disk_cache;
 struct vbo_context;
 /*@}*/
 
@@ -2425,6 +2427,17 @@ struct gl_shader
 #endif
    const GLchar *Source;  /**< Source code string */
 
+   /**
+    * Source the shader was last compiled from, when that compile was skipped
+    * because a program linked from it is in the shader cache.  The shader
+    * has no IR in that case; it is compiled from this string if the link
+    * misses the cache.
+    */
+   const GLchar *FallbackSource;
+
+   /** Shader cache key of the source the shader was last compiled from */
+   unsigned char sha1[20];
+
    GLchar *InfoLog;
 
    unsigned Version;       /**< GLSL version used for linking */
@@ -2657,6 +2670,10 @@ struct gl_shader_program_data
    unsigned NumHiddenUniforms;
    struct gl_uniform_storage *UniformStorage;
 
+   /** Backing store of gl_uniform_storage::storage for all uniforms */
+   unsigned NumUniformDataSlots;
+   union gl_constant_value *UniformDataSlots;
+
    unsigned NumUniformBlocks;
    struct gl_uniform_block *UniformBlocks;
 
@@ -2861,6 +2878,12 @@ struct gl_shader_program
    struct gl_program_resource *ProgramResourceList;
    unsigned NumProgramResourceList;
 
+   /**
+    * Index of ProgramResourceList by interface and name, see
+    * _mesa_create_program_resource_hash().
+    */
+   struct hash_table *ProgramResourceHash;
+
    /* True if any of the fragment shaders attached to this program use:
     * #extension ARB_fragment_coord_conventions: enable
     */
@@ -4358,6 +4381,10 @@ struct gl_context
    /** State possibly shared with other contexts in the address space */
    struct gl_shared_state *Shared;
 
+   /** Last texture and buffer objects looked up in the shared tables */
+   struct _mesa_HashLookupCache TextureLookupCache;
+   struct _mesa_HashLookupCache BufferObjectLookupCache;
+
    /** \name API function pointer tables */
    /*@{*/
    gl_api API;
@@ -4679,6 +4706,9 @@ struct gl_context
     * Stores the arguments to glPrimitiveBoundingBox
     */
    GLfloat PrimitiveBoundingBox[8];
+
+   /** On-disk cache of linked GLSL programs, or NULL if disabled */
+   struct disk_cache *Cache;
 };
 
 /**
@@ -37,6 +37,7 @@
 #include "compiler/glsl/glsl_symbol_table.h"
 #include "compiler/glsl/ir.h"
 #include "compiler/glsl/program.h"
+#include "util/hash_table.h"
 #include "util/string_to_uint_map.h"
 #include "util/strndup.h"
 
@@ -459,6 +460,144 @@ valid_array_index(const GLchar *name, unsigned *array_index)
    return true;
 }
 
+/**
+ * Key of ProgramResourceHash.  The name is not necessarily nul-terminated.
+ */
+struct resource_name_key {
+   GLenum type;
+   unsigned length;
+   const char *name;
+};
+
+static uint32_t
+resource_name_key_hash(const void *key)
+{
+   const struct resource_name_key *k = (const struct resource_name_key *) key;
+
+   return _mesa_hash_data(k->name, k->length) ^ k->type;
+}
+
+static bool
+resource_name_key_equal(const void *a, const void *b)
+{
+   const struct resource_name_key *ka = (const struct resource_name_key *) a;
+   const struct resource_name_key *kb = (const struct resource_name_key *) b;
+
+   return ka->type == kb->type && ka->length == kb->length &&
+          memcmp(ka->name, kb->name, ka->length) == 0;
+}
+
+static void
+add_resource_name(struct hash_table *ht, struct gl_program_resource *res,
+                  const char *name, unsigned length)
+{
+   struct resource_name_key key = { res->Type, length, name };
+
+   /* Keep the first resource in list order, as the linear search would. */
+   if (_mesa_hash_table_search(ht, &key))
+      return;
+
+   struct resource_name_key *k = ralloc(ht, struct resource_name_key);
+   *k = key;
+   _mesa_hash_table_insert(ht, k, res);
+}
+
+static struct gl_program_resource *
+lookup_resource_name(struct hash_table *ht, GLenum type,
+                     const char *name, unsigned length)
+{
+   struct resource_name_key key = { type, length, name };
+   struct hash_entry *entry = _mesa_hash_table_search(ht, &key);
+
+   return entry ? (struct gl_program_resource *) entry->data : NULL;
+}
+
+/**
+ * Index the program resources by interface and name, so that name lookups
+ * don't have to walk the whole resource list.  Called once the resource list
+ * is complete.  Resources whose name ends in "[0]" are also indexed under
+ * their base name, as the spec has those match the bare array name.
+ */
+void
+_mesa_create_program_resource_hash(struct gl_shader_program *shProg)
+{
+   shProg->ProgramResourceHash = NULL;
+
+   if (!shProg->ProgramResourceList)
+      return;
+
+   struct hash_table *ht =
+      _mesa_hash_table_create(shProg->ProgramResourceList,
+                              resource_name_key_hash,
+                              resource_name_key_equal);
+   if (!ht)
+      return;
+
+   struct gl_program_resource *res = shProg->ProgramResourceList;
+   for (unsigned i = 0; i < shProg->NumProgramResourceList; i++, res++) {
+      /* These have no name. */
+      if (res->Type == GL_ATOMIC_COUNTER_BUFFER ||
+          res->Type == GL_TRANSFORM_FEEDBACK_BUFFER)
+         continue;
+
+      const char *rname = _mesa_program_resource_name(res);
+      unsigned length = strlen(rname);
+
+      add_resource_name(ht, res, rname, length);
+      if (length > 3 && strcmp(rname + length - 3, "[0]") == 0)
+         add_resource_name(ht, res, rname, length - 3);
+   }
+
+   shProg->ProgramResourceHash = ht;
+}
+
+/**
+ * Look a name up in ProgramResourceHash.  Returns false if the linear search
+ * is needed to tell the answer, which is only the case for names of struct
+ * members and for array elements not matched by their base name.
+ */
+static bool
+find_name_hashed(struct gl_shader_program *shProg,
+                 GLenum programInterface, const char *name,
+                 unsigned *array_index, struct gl_program_resource **out)
+{
+   struct hash_table *ht = shProg->ProgramResourceHash;
+   struct gl_program_resource *res;
+
+   res = lookup_resource_name(ht, programInterface, name, strlen(name));
+   if (res) {
+      *out = res;
+      return true;
+   }
+
+   const GLchar *base_name_end;
+   long idx = parse_program_resource_name(name, &base_name_end);
+   if (idx >= 0) {
+      unsigned baselen = base_name_end - name;
+
+      res = lookup_resource_name(ht, programInterface, name, baselen);
+
+      /* Array index on an array resource rather than on its "[0]" alias. */
+      if (res && strlen(_mesa_program_resource_name(res)) == baselen) {
+         if (programInterface != GL_UNIFORM_BLOCK &&
+             programInterface != GL_SHADER_STORAGE_BLOCK && array_index)
+            *array_index = idx;
+         *out = res;
+         return true;
+      }
+   }
+
+   /* Without a subscript or member selection, only an exact match or the
+    * "[0]" alias may match, and both are in the table.
+    */
+   if (!strpbrk(name, "[.")) {
+      *out = NULL;
+      return true;
+   }
+
+   return false;
+}
+
 /* Find a program resource with specific name in given interface.
  */
 struct gl_program_resource *
@@ -466,7 +605,13 @@ _mesa_program_resource_find_name(struct gl_shader_program *shProg,
                                  GLenum programInterface, const char *name,
                                  unsigned *array_index)
 {
-   struct gl_program_resource *res = shProg->ProgramResourceList;
+   struct gl_program_resource *res;
+
+   if (shProg->ProgramResourceHash &&
+       find_name_hashed(shProg, programInterface, name, array_index, &res))
+      return res;
+
+   res = shProg->ProgramResourceList;
    for (unsigned i = 0; i < shProg->NumProgramResourceList; i++, res++) {
       if (res->Type != programInterface)
          continue;
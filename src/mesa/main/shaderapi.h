@@ -241,6 +241,9 @@ extern GLuint
 _mesa_program_resource_index(struct gl_shader_program *shProg,
                              struct gl_program_resource *res);
 
+extern void
+_mesa_create_program_resource_hash(struct gl_shader_program *shProg);
+
 extern struct gl_program_resource *
 _mesa_program_resource_find_name(struct gl_shader_program *shProg,
                                  GLenum programInterface, const char *name,
@@ -141,6 +141,7 @@ void
 _mesa_delete_shader(struct gl_context *ctx, struct gl_shader *sh)
 {
    free((void *)sh->Source);
+   free((void *)sh->FallbackSource);
    free(sh->Label);
    ralloc_free(sh);
 }
@@ -357,6 +358,8 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
       ralloc_free(shProg->data->UniformStorage);
       shProg->data->NumUniformStorage = 0;
       shProg->data->UniformStorage = NULL;
+      shProg->data->NumUniformDataSlots = 0;
+      shProg->data->UniformDataSlots = NULL;
    }
 
    if (shProg->UniformRemapTable) {
@@ -390,6 +393,7 @@ _mesa_clear_shader_program_data(struct gl_context *ctx,
       ralloc_free(shProg->ProgramResourceList);
       shProg->ProgramResourceList = NULL;
       shProg->NumProgramResourceList = 0;
+      shProg->ProgramResourceHash = NULL;
    }
 }
 
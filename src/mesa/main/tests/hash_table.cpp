@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name hash_table.cpp
+ *
+ * Check the hash table used for GL object names, in particular that lookups
+ * running concurrently with inserts, removes and resizes never return data
+ * that belongs to another key or that isn't fully written yet.
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+
+#include "c11/threads.h"
+#include "util/u_atomic.h"
+
+extern "C" {
+#include "main/hash.h"
+}
+
+#define NUM_WRITERS 4
+#define NUM_READERS 4
+#define KEYS_PER_WRITER 512
+#define NUM_ROUNDS 200
+
+namespace {
+
+struct object {
+   GLuint key;
+   unsigned round;
+};
+
+struct stress_state {
+   struct _mesa_HashTable *table;
+   int writers_done;
+   int errors;
+};
+
+struct writer {
+   struct stress_state *state;
+   GLuint first_key;
+   struct object *objects;
+};
+
+struct reader {
+   struct stress_state *state;
+   unsigned seed;
+   unsigned found;
+};
+
+/* Whether the key is in the table after the given round. */
+bool
+is_mapped(GLuint key, unsigned round)
+{
+   return (key + round) % 3 != 0;
+}
+
+int
+writer_func(void *data)
+{
+   struct writer *w = (struct writer *) data;
+   struct object *obj = w->objects;
+
+   for (unsigned round = 0; round < NUM_ROUNDS; round++) {
+      for (GLuint i = 0; i < KEYS_PER_WRITER; i++) {
+         const GLuint key = w->first_key + i;
+
+         if (is_mapped(key, round)) {
+            /* Always a fresh object, so that a lookup racing with the
+             * insert has to see these stores.
+             */
+            obj->key = key;
+            obj->round = round;
+            _mesa_HashInsert(w->state->table, key, obj);
+            obj++;
+         } else {
+            _mesa_HashRemove(w->state->table, key);
+         }
+      }
+   }
+
+   p_atomic_inc(&w->state->writers_done);
+   return 0;
+}
+
+int
+reader_func(void *data)
+{
+   struct reader *r = (struct reader *) data;
+   struct _mesa_HashLookupCache cache = { 0 };
+
+   while (p_atomic_read(&r->state->writers_done) < NUM_WRITERS) {
+      for (unsigned i = 0; i < 1024; i++) {
+         r->seed = r->seed * 1103515245 + 12345;
+
+         const GLuint key =
+            1 + (r->seed >> 8) % (NUM_WRITERS * KEYS_PER_WRITER);
+         const struct object *obj = (const struct object *)
+            ((i & 1) ? _mesa_HashLookupCached(r->state->table, key, &cache)
+                     : _mesa_HashLookup(r->state->table, key));
+
+         if (obj) {
+            if (obj->key != key || obj->round >= NUM_ROUNDS)
+               p_atomic_inc(&r->state->errors);
+            r->found++;
+         }
+      }
+   }
+
+   return 0;
+}
+
+} /* anonymous namespace */
+
+TEST(HashTableTest, InsertRemoveLookup)
+{
+   struct _mesa_HashTable *table = _mesa_NewHashTable();
+   struct _mesa_HashLookupCache cache = { 0 };
+   struct object objects[1000];
+
+   ASSERT_TRUE(table != NULL);
+
+   /* Enough keys to resize the table a few times. */
+   for (GLuint key = 1; key <= 1000; key++) {
+      objects[key - 1].key = key;
+      _mesa_HashInsert(table, key, &objects[key - 1]);
+   }
+   EXPECT_EQ(1000u, _mesa_HashNumEntries(table));
+
+   for (GLuint key = 2; key <= 1000; key += 2)
+      _mesa_HashRemove(table, key);
+   EXPECT_EQ(500u, _mesa_HashNumEntries(table));
+
+   for (GLuint key = 1; key <= 1000; key++) {
+      void *expected = (key & 1) ? &objects[key - 1] : NULL;
+
+      EXPECT_EQ(expected, _mesa_HashLookup(table, key));
+      EXPECT_EQ(expected, _mesa_HashLookupCached(table, key, &cache));
+   }
+
+   /* The cache must not outlive a remove of the cached key. */
+   EXPECT_EQ(&objects[0], _mesa_HashLookupCached(table, 1, &cache));
+   _mesa_HashRemove(table, 1);
+   EXPECT_EQ(NULL, _mesa_HashLookupCached(table, 1, &cache));
+
+   /* Removed keys can be reused. */
+   _mesa_HashInsert(table, 2, &objects[1]);
+   EXPECT_EQ(&objects[1], _mesa_HashLookup(table, 2));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 4));
+
+   for (GLuint key = 1; key <= 1000; key++)
+      _mesa_HashRemove(table, key);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+
+   _mesa_DeleteHashTable(table);
+}
+
+TEST(HashTableTest, ConcurrentLookups)
+{
+   struct stress_state state;
+   struct writer writers[NUM_WRITERS];
+   struct reader readers[NUM_READERS];
+   thrd_t writer_threads[NUM_WRITERS];
+   thrd_t reader_threads[NUM_READERS];
+
+   state.table = _mesa_NewHashTable();
+   state.writers_done = 0;
+   state.errors = 0;
+   ASSERT_TRUE(state.table != NULL);
+
+   for (unsigned i = 0; i < NUM_READERS; i++) {
+      readers[i].state = &state;
+      readers[i].seed = i;
+      readers[i].found = 0;
+      ASSERT_EQ(thrd_success,
+                thrd_create(&reader_threads[i], reader_func, &readers[i]));
+   }
+
+   for (unsigned i = 0; i < NUM_WRITERS; i++) {
+      writers[i].state = &state;
+      writers[i].first_key = 1 + i * KEYS_PER_WRITER;
+      writers[i].objects = (struct object *)
+         calloc(NUM_ROUNDS * KEYS_PER_WRITER, sizeof(struct object));
+      ASSERT_TRUE(writers[i].objects != NULL);
+      ASSERT_EQ(thrd_success,
+                thrd_create(&writer_threads[i], writer_func, &writers[i]));
+   }
+
+   for (unsigned i = 0; i < NUM_WRITERS; i++)
+      thrd_join(writer_threads[i], NULL);
+   for (unsigned i = 0; i < NUM_READERS; i++)
+      thrd_join(reader_threads[i], NULL);
+
+   EXPECT_EQ(0, state.errors);
+
+   /* Every key ends up as the last round left it. */
+   GLuint num_mapped = 0;
+   for (GLuint key = 1; key <= NUM_WRITERS * KEYS_PER_WRITER; key++) {
+      const struct object *obj = (const struct object *)
+         _mesa_HashLookup(state.table, key);
+
+      if (is_mapped(key, NUM_ROUNDS - 1)) {
+         ASSERT_TRUE(obj != NULL);
+         EXPECT_EQ(key, obj->key);
+         EXPECT_EQ(NUM_ROUNDS - 1u, obj->round);
+         num_mapped++;
+      } else {
+         EXPECT_EQ(NULL, obj);
+      }
+      _mesa_HashRemove(state.table, key);
+   }
+   EXPECT_EQ(0u, _mesa_HashNumEntries(state.table));
+   EXPECT_LT(0u, num_mapped);
+
+   _mesa_DeleteHashTable(state.table);
+   for (unsigned i = 0; i < NUM_WRITERS; i++)
+      free(writers[i].objects);
+}
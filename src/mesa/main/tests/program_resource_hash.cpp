@@ -0,0 +1,250 @@
+/*
+ * Copyright © 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name program_resource_hash.cpp
+ *
+ * Check that looking program resources up by name through
+ * gl_shader_program::ProgramResourceHash finds the same resource and array
+ * index as the linear search of the resource list.
+ */
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "main/mtypes.h"
+#include "main/shaderapi.h"
+#include "compiler/glsl/ir_uniform.h"
+#include "util/hash_table.h"
+#include "util/ralloc.h"
+
+namespace {
+
+class program_resource_hash : public ::testing::Test {
+public:
+   virtual void SetUp();
+   virtual void TearDown();
+
+   void add_uniform(GLenum type, const char *name);
+   void add_block(GLenum type, const char *name);
+   void add_variable(GLenum type, const char *name);
+   void add_varying(const char *name);
+   void create_resource_list();
+
+   void check_names(GLenum type, const std::vector<std::string> &names);
+
+   void *mem_ctx;
+   struct gl_shader_program *prog;
+   std::vector<std::string> resource_names;
+   std::vector<struct gl_program_resource> resources;
+};
+
+void
+program_resource_hash::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+   prog = rzalloc(mem_ctx, struct gl_shader_program);
+}
+
+void
+program_resource_hash::TearDown()
+{
+   ralloc_free(mem_ctx);
+}
+
+void
+program_resource_hash::add_uniform(GLenum type, const char *name)
+{
+   struct gl_uniform_storage *uni =
+      rzalloc(mem_ctx, struct gl_uniform_storage);
+   struct gl_program_resource res = { type, uni, 0 };
+
+   uni->name = ralloc_strdup(mem_ctx, name);
+   resources.push_back(res);
+   resource_names.push_back(name);
+}
+
+void
+program_resource_hash::add_block(GLenum type, const char *name)
+{
+   struct gl_uniform_block *block = rzalloc(mem_ctx, struct gl_uniform_block);
+   struct gl_program_resource res = { type, block, 0 };
+
+   block->Name = ralloc_strdup(mem_ctx, name);
+   resources.push_back(res);
+   resource_names.push_back(name);
+}
+
+void
+program_resource_hash::add_variable(GLenum type, const char *name)
+{
+   struct gl_shader_variable *var =
+      rzalloc(mem_ctx, struct gl_shader_variable);
+   struct gl_program_resource res = { type, var, 0 };
+
+   var->name = ralloc_strdup(mem_ctx, name);
+   resources.push_back(res);
+   resource_names.push_back(name);
+}
+
+void
+program_resource_hash::add_varying(const char *name)
+{
+   struct gl_transform_feedback_varying_info *xfv =
+      rzalloc(mem_ctx, struct gl_transform_feedback_varying_info);
+   struct gl_program_resource res = { GL_TRANSFORM_FEEDBACK_VARYING, xfv, 0 };
+
+   xfv->Name = ralloc_strdup(mem_ctx, name);
+   resources.push_back(res);
+   resource_names.push_back(name);
+}
+
+void
+program_resource_hash::create_resource_list()
+{
+   prog->NumProgramResourceList = resources.size();
+   prog->ProgramResourceList =
+      ralloc_array(mem_ctx, struct gl_program_resource, resources.size());
+   for (unsigned i = 0; i < resources.size(); i++)
+      prog->ProgramResourceList[i] = resources[i];
+
+   _mesa_create_program_resource_hash(prog);
+}
+
+/**
+ * Look each name up with the linear search and through the hash table and
+ * compare the results.
+ */
+void
+program_resource_hash::check_names(GLenum type,
+                                   const std::vector<std::string> &names)
+{
+   for (unsigned i = 0; i < names.size(); i++) {
+      const char *name = names[i].c_str();
+      unsigned linear_index = ~0u, hashed_index = ~0u;
+      struct hash_table *ht = prog->ProgramResourceHash;
+
+      prog->ProgramResourceHash = NULL;
+      struct gl_program_resource *linear =
+         _mesa_program_resource_find_name(prog, type, name, &linear_index);
+
+      prog->ProgramResourceHash = ht;
+      struct gl_program_resource *hashed =
+         _mesa_program_resource_find_name(prog, type, name, &hashed_index);
+
+      EXPECT_EQ(linear, hashed) << "interface 0x" << std::hex << type
+                                << ", name \"" << name << "\"";
+      EXPECT_EQ(linear_index, hashed_index) << "interface 0x" << std::hex
+                                            << type << ", name \""
+                                            << name << "\"";
+   }
+}
+
+} /* anonymous namespace */
+
+TEST_F(program_resource_hash, matches_linear_search)
+{
+   static const GLenum interfaces[] = {
+      GL_UNIFORM,
+      GL_UNIFORM_BLOCK,
+      GL_SHADER_STORAGE_BLOCK,
+      GL_BUFFER_VARIABLE,
+      GL_PROGRAM_INPUT,
+      GL_PROGRAM_OUTPUT,
+      GL_TRANSFORM_FEEDBACK_VARYING,
+   };
+
+   /* Plain variables and arrays, whose names have no subscript. */
+   add_uniform(GL_UNIFORM, "scalar");
+   add_uniform(GL_UNIFORM, "array");
+   /* Arrays of structs and arrays of arrays. */
+   add_uniform(GL_UNIFORM, "s[0].f");
+   add_uniform(GL_UNIFORM, "s[0].g");
+   add_uniform(GL_UNIFORM, "s[1].f");
+   add_uniform(GL_UNIFORM, "s[1].g");
+   add_uniform(GL_UNIFORM, "aoa[0]");
+   add_uniform(GL_UNIFORM, "aoa[1]");
+   /* Struct members, and a uniform named like a member of another. */
+   add_uniform(GL_UNIFORM, "t.x");
+   add_uniform(GL_UNIFORM, "t.y.z");
+   add_uniform(GL_UNIFORM, "tt");
+   /* Members of a named uniform block. */
+   add_uniform(GL_UNIFORM, "Blk.member");
+   add_uniform(GL_UNIFORM, "Blk.arr[0]");
+
+   add_block(GL_UNIFORM_BLOCK, "Single");
+   add_block(GL_UNIFORM_BLOCK, "Blk");
+   add_block(GL_UNIFORM_BLOCK, "Arr[0]");
+   add_block(GL_UNIFORM_BLOCK, "Arr[1]");
+   add_block(GL_UNIFORM_BLOCK, "Arr[2]");
+   add_block(GL_SHADER_STORAGE_BLOCK, "Ssbo");
+   add_block(GL_SHADER_STORAGE_BLOCK, "SsboArr[0]");
+   add_block(GL_SHADER_STORAGE_BLOCK, "SsboArr[1]");
+
+   add_uniform(GL_BUFFER_VARIABLE, "Ssbo.v[0]");
+   add_uniform(GL_BUFFER_VARIABLE, "Ssbo.f");
+   add_uniform(GL_BUFFER_VARIABLE, "SsboArr.data[0].a");
+   add_uniform(GL_BUFFER_VARIABLE, "SsboArr.data[0].b[0]");
+
+   add_variable(GL_PROGRAM_INPUT, "position");
+   add_variable(GL_PROGRAM_INPUT, "colors");
+   add_variable(GL_PROGRAM_INPUT, "Vertex.normal");
+   add_variable(GL_PROGRAM_OUTPUT, "frag");
+   add_variable(GL_PROGRAM_OUTPUT, "frag_arr");
+
+   add_varying("out_arr[0]");
+   add_varying("out_arr[1]");
+   add_varying("out_single");
+   add_varying("out_struct.x");
+
+   create_resource_list();
+   ASSERT_TRUE(prog->ProgramResourceHash != NULL);
+
+   /* Query every resource name, every prefix of it, and the name with
+    * subscripts, member selections and junk appended.
+    */
+   static const char *const suffixes[] = {
+      "[0]", "[1]", "[2]", "[7]", "[0][0]", "[1][3]", "[", "[]", "[x]",
+      "[-1]", "[01]", ".x", ".f", ".member", "[0].f", "[1].g", "x", " ",
+   };
+   std::vector<std::string> names;
+
+   names.push_back("");
+   names.push_back("unknown");
+   names.push_back("unknown[0]");
+   for (unsigned i = 0; i < resource_names.size(); i++) {
+      const std::string &rname = resource_names[i];
+
+      for (unsigned len = 1; len <= rname.size(); len++) {
+         const std::string prefix = rname.substr(0, len);
+
+         names.push_back(prefix);
+         for (unsigned j = 0; j < ARRAY_SIZE(suffixes); j++)
+            names.push_back(prefix + suffixes[j]);
+      }
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(interfaces); i++)
+      check_names(interfaces[i], names);
+}
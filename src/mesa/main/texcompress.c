@@ -30,6 +30,12 @@
  */
 
 
+#include <stdlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "c11/threads.h"
 #include "glheader.h"
 #include "imports.h"
 #include "context.h"
@@ -944,3 +950,101 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
       }
    }
 }
+
+
+/** Upper bound on the number of threads compressing one image. */
+#define MAX_COMPRESS_THREADS 16
+
+/** Don't bother spawning a thread for less than this many blocks. */
+#define MIN_BLOCKS_PER_THREAD 1024
+
+struct compress_band
+{
+   thrd_t thread;
+   compress_rows_func func;
+   void *data;
+   int first_row;
+   int last_row;
+};
+
+
+static int
+compress_band_thread(void *arg)
+{
+   struct compress_band *band = arg;
+
+   band->func(band->data, band->first_row, band->last_row);
+   return 0;
+}
+
+
+/**
+ * Number of threads to compress with: MESA_TEXCOMPRESS_THREADS if set,
+ * the number of online CPUs otherwise.
+ */
+static int
+compress_thread_count(void)
+{
+   const char *env = getenv("MESA_TEXCOMPRESS_THREADS");
+   int n = 1;
+
+   if (env) {
+      n = atoi(env);
+   }
+   else {
+#ifdef _SC_NPROCESSORS_ONLN
+      n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   }
+
+   return CLAMP(n, 1, MAX_COMPRESS_THREADS);
+}
+
+
+/**
+ * Run func over the rows of blocks of an image, splitting them in bands
+ * compressed in parallel when the image is large enough.  func is called
+ * with disjoint [first_row, last_row) ranges and must not touch anything
+ * outside of them.  Returns once all the rows are done.
+ */
+void
+_mesa_compress_rows_parallel(int n_block_rows, int n_blocks_per_row,
+                             compress_rows_func func, void *data)
+{
+   struct compress_band bands[MAX_COMPRESS_THREADS];
+   int n_bands, i;
+
+   n_bands = MIN2(compress_thread_count(), n_block_rows);
+   n_bands = MIN2(n_bands,
+                  n_block_rows * n_blocks_per_row / MIN_BLOCKS_PER_THREAD);
+
+   if (n_bands <= 1) {
+      func(data, 0, n_block_rows);
+      return;
+   }
+
+   for (i = 0; i < n_bands; i++) {
+      bands[i].func = func;
+      bands[i].data = data;
+      bands[i].first_row = n_block_rows * i / n_bands;
+      bands[i].last_row = n_block_rows * (i + 1) / n_bands;
+   }
+
+   /* The calling thread takes the first band. */
+   for (i = 1; i < n_bands; i++) {
+      if (thrd_create(&bands[i].thread, compress_band_thread,
+                      &bands[i]) != thrd_success) {
+         /* do it ourselves */
+         bands[i].func = NULL;
+      }
+   }
+
+   func(data, bands[0].first_row, bands[0].last_row);
+
+   for (i = 1; i < n_bands; i++) {
+      if (bands[i].func)
+         thrd_join(bands[i].thread, NULL);
+      else
+         func(data, bands[i].first_row, bands[i].last_row);
+   }
+}
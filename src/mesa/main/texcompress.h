@@ -63,4 +63,12 @@ _mesa_decompress_image(mesa_format format, GLuint width, GLuint height,
                        const GLubyte *src, GLint srcRowStride,
                        GLfloat *dest);
 
+
+/** Compress the rows of blocks [first_row, last_row) of an image */
+typedef void (*compress_rows_func)(void *data, int first_row, int last_row);
+
+extern void
+_mesa_compress_rows_parallel(int n_block_rows, int n_blocks_per_row,
+                             compress_rows_func func, void *data);
+
 #endif /* TEXCOMPRESS_H */
@@ -26,6 +26,8 @@
  * GL_ARB_texture_compression_bptc support.
  */
 
+#include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include "texcompress.h"
 #include "texcompress_bptc.h"
@@ -1246,32 +1248,444 @@ compress_rgba_unorm_block(int src_width, int src_height,
                              endpoints);
 }
 
+/* The GL_NICEST compressor below tries modes 4 (with both index
+ * selections) and 6 for each block.  Endpoints are first fitted along the
+ * principal axis of the texels, then refined by least squares given the
+ * indices, and every texel gets the palette entry nearest to it.
+ */
+
+static int
+quantize_endpoint(float value, int n_bits, int pbit)
+{
+   int max = (1 << n_bits) - 1;
+   int q;
+
+   if (pbit < 0)
+      q = (int) (value * max / 255.0f + 0.5f);
+   else
+      q = (int) ((value - pbit) / 2.0f + 0.5f);
+
+   return CLAMP(q, 0, max);
+}
+
+static int
+unquantize_endpoint(int q, int n_bits, int pbit)
+{
+   if (pbit < 0)
+      return expand_component(q, n_bits);
+   else
+      return expand_component((q << 1) | pbit, n_bits + 1);
+}
+
+/* Quantize the endpoints of the given components.  pbits is NULL if the
+ * mode has none, otherwise the p-bit of each endpoint is chosen to
+ * minimize the quantization error.
+ */
 static void
-compress_rgba_unorm(int width, int height,
-                    const uint8_t *src, int src_rowstride,
-                    uint8_t *dst, int dst_rowstride)
+quantize_endpoints_unorm(float endpoints[2][4],
+                         int first_component, int n_components,
+                         int n_bits, int pbits[2],
+                         int quantized[2][4], int expanded[2][4])
+{
+   int endpoint, component, pbit, best_pbit, q, e;
+   float error, best_error;
+
+   for (endpoint = 0; endpoint < 2; endpoint++) {
+      best_pbit = -1;
+
+      if (pbits) {
+         best_error = 0.0f;
+         for (pbit = 0; pbit < 2; pbit++) {
+            error = 0.0f;
+            for (component = first_component;
+                 component < first_component + n_components;
+                 component++) {
+               q = quantize_endpoint(endpoints[endpoint][component],
+                                     n_bits, pbit);
+               e = unquantize_endpoint(q, n_bits, pbit);
+               error += ((e - endpoints[endpoint][component]) *
+                         (e - endpoints[endpoint][component]));
+            }
+            if (pbit == 0 || error < best_error) {
+               best_error = error;
+               best_pbit = pbit;
+            }
+         }
+         pbits[endpoint] = best_pbit;
+      }
+
+      for (component = first_component;
+           component < first_component + n_components;
+           component++) {
+         q = quantize_endpoint(endpoints[endpoint][component],
+                               n_bits, best_pbit);
+         quantized[endpoint][component] = q;
+         expanded[endpoint][component] =
+            unquantize_endpoint(q, n_bits, best_pbit);
+      }
+   }
+}
+
+/* Pick the nearest palette entry for each texel, returns the total squared
+ * error.
+ */
+static int
+choose_indices_unorm(int n_texels, const uint8_t texels[][4],
+                     int first_component, int n_components,
+                     int expanded[2][4], int n_index_bits,
+                     uint8_t indices[])
+{
+   int palette[16][4];
+   int n_indices = 1 << n_index_bits;
+   int total_error = 0;
+   int texel, index, component, error, best_error, diff;
+
+   for (index = 0; index < n_indices; index++) {
+      for (component = first_component;
+           component < first_component + n_components;
+           component++) {
+         palette[index][component] = interpolate(expanded[0][component],
+                                                 expanded[1][component],
+                                                 index, n_index_bits);
+      }
+   }
+
+   for (texel = 0; texel < n_texels; texel++) {
+      best_error = INT_MAX;
+      for (index = 0; index < n_indices; index++) {
+         error = 0;
+         for (component = first_component;
+              component < first_component + n_components;
+              component++) {
+            diff = palette[index][component] - texels[texel][component];
+            error += diff * diff;
+         }
+         if (error < best_error) {
+            best_error = error;
+            indices[texel] = index;
+         }
+      }
+      total_error += best_error;
+   }
+
+   return total_error;
+}
+
+/* Initial endpoints: the extent of the texels along their principal axis,
+ * which is found with a few steps of power iteration on the covariance
+ * matrix.
+ */
+static void
+principal_axis_endpoints_unorm(int n_texels, const uint8_t texels[][4],
+                               int first_component, int n_components,
+                               float endpoints[2][4])
+{
+   float mean[4] = { 0 }, cov[4][4] = { { 0 } }, axis[4], next[4];
+   float d[4], t, t_min, t_max, len2, scale;
+   int texel, i, j, iteration;
+   const int last = first_component + n_components;
+
+   for (texel = 0; texel < n_texels; texel++)
+      for (i = first_component; i < last; i++)
+         mean[i] += texels[texel][i];
+   for (i = first_component; i < last; i++)
+      mean[i] /= n_texels;
+
+   for (texel = 0; texel < n_texels; texel++) {
+      for (i = first_component; i < last; i++)
+         d[i] = texels[texel][i] - mean[i];
+      for (i = first_component; i < last; i++)
+         for (j = first_component; j < last; j++)
+            cov[i][j] += d[i] * d[j];
+   }
+
+   for (i = first_component; i < last; i++)
+      axis[i] = 1.0f;
+
+   for (iteration = 0; iteration < 8; iteration++) {
+      scale = 0.0f;
+      for (i = first_component; i < last; i++) {
+         next[i] = 0.0f;
+         for (j = first_component; j < last; j++)
+            next[i] += cov[i][j] * axis[j];
+         scale = MAX2(scale, fabsf(next[i]));
+      }
+      if (scale == 0.0f)
+         break;
+      for (i = first_component; i < last; i++)
+         axis[i] = next[i] / scale;
+   }
+
+   len2 = 0.0f;
+   for (i = first_component; i < last; i++)
+      len2 += axis[i] * axis[i];
+
+   t_min = t_max = 0.0f;
+   if (len2 > 0.0f) {
+      for (texel = 0; texel < n_texels; texel++) {
+         t = 0.0f;
+         for (i = first_component; i < last; i++)
+            t += (texels[texel][i] - mean[i]) * axis[i];
+         t /= len2;
+         t_min = MIN2(t_min, t);
+         t_max = MAX2(t_max, t);
+      }
+   }
+
+   for (i = first_component; i < last; i++) {
+      endpoints[0][i] = CLAMP(mean[i] + t_min * axis[i], 0.0f, 255.0f);
+      endpoints[1][i] = CLAMP(mean[i] + t_max * axis[i], 0.0f, 255.0f);
+   }
+}
+
+/* Least squares endpoints for the given indices.  Returns false if the
+ * indices don't constrain them.
+ */
+static bool
+refine_endpoints_unorm(int n_texels, const uint8_t texels[][4],
+                       int first_component, int n_components,
+                       const uint8_t indices[], int n_index_bits,
+                       float endpoints[2][4])
+{
+   float a = 0.0f, b = 0.0f, c = 0.0f, det, w;
+   float x0[4] = { 0 }, x1[4] = { 0 };
+   int texel, i;
+   const int last = first_component + n_components;
+
+   for (texel = 0; texel < n_texels; texel++) {
+      /* the palette weight of the second endpoint, without rounding */
+      w = interpolate(0, 64 * 64, indices[texel], n_index_bits) / 4096.0f;
+      a += (1.0f - w) * (1.0f - w);
+      b += (1.0f - w) * w;
+      c += w * w;
+      for (i = first_component; i < last; i++) {
+         x0[i] += (1.0f - w) * texels[texel][i];
+         x1[i] += w * texels[texel][i];
+      }
+   }
+
+   det = a * c - b * b;
+   if (fabsf(det) < 1e-6f)
+      return false;
+
+   for (i = first_component; i < last; i++) {
+      endpoints[0][i] = CLAMP((c * x0[i] - b * x1[i]) / det, 0.0f, 255.0f);
+      endpoints[1][i] = CLAMP((a * x1[i] - b * x0[i]) / det, 0.0f, 255.0f);
+   }
+
+   return true;
+}
+
+struct unorm_fit {
+   int quantized[2][4];
+   int pbits[2];
+   uint8_t indices[BLOCK_SIZE * BLOCK_SIZE];
+   int error;
+};
+
+static void
+fit_endpoints_unorm(int n_texels, const uint8_t texels[][4],
+                    int first_component, int n_components,
+                    int n_endpoint_bits, bool has_pbits,
+                    int n_index_bits,
+                    struct unorm_fit *fit)
+{
+   struct unorm_fit attempt;
+   float endpoints[2][4];
+   int expanded[2][4];
+   int iteration;
+
+   principal_axis_endpoints_unorm(n_texels, texels,
+                                  first_component, n_components,
+                                  endpoints);
+
+   attempt.pbits[0] = attempt.pbits[1] = 0;
+   fit->error = INT_MAX;
+
+   for (iteration = 0; iteration < 2; iteration++) {
+      quantize_endpoints_unorm(endpoints, first_component, n_components,
+                               n_endpoint_bits,
+                               has_pbits ? attempt.pbits : NULL,
+                               attempt.quantized, expanded);
+      attempt.error = choose_indices_unorm(n_texels, texels,
+                                           first_component, n_components,
+                                           expanded, n_index_bits,
+                                           attempt.indices);
+      if (attempt.error < fit->error)
+         *fit = attempt;
+
+      if (fit->error == 0 ||
+          !refine_endpoints_unorm(n_texels, texels,
+                                  first_component, n_components,
+                                  attempt.indices, n_index_bits,
+                                  endpoints))
+         break;
+   }
+
+   /* The most-significant bit of the first index must be zero */
+   if (fit->indices[0] >> (n_index_bits - 1)) {
+      int i, tmp;
+
+      for (i = first_component; i < first_component + n_components; i++) {
+         tmp = fit->quantized[0][i];
+         fit->quantized[0][i] = fit->quantized[1][i];
+         fit->quantized[1][i] = tmp;
+      }
+      tmp = fit->pbits[0];
+      fit->pbits[0] = fit->pbits[1];
+      fit->pbits[1] = tmp;
+      for (i = 0; i < n_texels; i++)
+         fit->indices[i] = (1 << n_index_bits) - 1 - fit->indices[i];
+   }
+}
+
+static void
+write_indices_unorm(struct bit_writer *writer,
+                    int src_width, int src_height,
+                    const uint8_t *indices, int n_index_bits)
 {
-   int dst_row_diff;
    int y, x;
 
-   if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
-   else
-      dst_row_diff = 0;
-
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
-                                   MIN2(height - y, BLOCK_SIZE),
-                                   src + x * 4 + y * src_rowstride,
-                                   src_rowstride,
-                                   dst);
+   for (y = 0; y < BLOCK_SIZE; y++) {
+      for (x = 0; x < BLOCK_SIZE; x++) {
+         int index = (x < src_width && y < src_height) ?
+            indices[y * src_width + x] : 0;
+         write_bits(writer, n_index_bits - (x == 0 && y == 0), index);
+      }
+   }
+}
+
+static void
+compress_rgba_unorm_block_nicest(int src_width, int src_height,
+                                 const uint8_t *src, int src_rowstride,
+                                 uint8_t *dst)
+{
+   uint8_t texels[BLOCK_SIZE * BLOCK_SIZE][4];
+   struct unorm_fit color[2], alpha[2], rgba;
+   struct bit_writer writer;
+   int n_texels = src_width * src_height;
+   int index_selection, best_selection;
+   int component, endpoint, y;
+
+   for (y = 0; y < src_height; y++)
+      memcpy(texels[y * src_width], src + y * src_rowstride, src_width * 4);
+
+   /* Mode 4, with each index selection */
+   for (index_selection = 0; index_selection < 2; index_selection++) {
+      fit_endpoints_unorm(n_texels, texels, 0, 3, 5, false,
+                          2 + index_selection, &color[index_selection]);
+      fit_endpoints_unorm(n_texels, texels, 3, 1, 6, false,
+                          3 - index_selection, &alpha[index_selection]);
+   }
+
+   best_selection = (color[1].error + alpha[1].error <
+                     color[0].error + alpha[0].error);
+
+   /* Mode 6 */
+   fit_endpoints_unorm(n_texels, texels, 0, 4, 7, true, 4, &rgba);
+
+   writer.dst = dst;
+   writer.pos = 0;
+   writer.buf = 0;
+
+   if (rgba.error < (color[best_selection].error +
+                     alpha[best_selection].error)) {
+      write_bits(&writer, 7, 0x40); /* mode 6 */
+
+      for (component = 0; component < 4; component++)
+         for (endpoint = 0; endpoint < 2; endpoint++)
+            write_bits(&writer, 7, rgba.quantized[endpoint][component]);
+
+      for (endpoint = 0; endpoint < 2; endpoint++)
+         write_bits(&writer, 1, rgba.pbits[endpoint]);
+
+      write_indices_unorm(&writer, src_width, src_height, rgba.indices, 4);
+   } else {
+      const struct unorm_fit *c = &color[best_selection];
+      const struct unorm_fit *a = &alpha[best_selection];
+
+      write_bits(&writer, 5, 0x10); /* mode 4 */
+      write_bits(&writer, 2, 0); /* rotation 0 */
+      write_bits(&writer, 1, best_selection); /* index selection bit */
+
+      for (component = 0; component < 3; component++)
+         for (endpoint = 0; endpoint < 2; endpoint++)
+            write_bits(&writer, 5, c->quantized[endpoint][component]);
+
+      for (endpoint = 0; endpoint < 2; endpoint++)
+         write_bits(&writer, 6, a->quantized[endpoint][3]);
+
+      /* The 2-bit indices come first */
+      if (best_selection) {
+         write_indices_unorm(&writer, src_width, src_height, a->indices, 2);
+         write_indices_unorm(&writer, src_width, src_height, c->indices, 3);
+      } else {
+         write_indices_unorm(&writer, src_width, src_height, c->indices, 2);
+         write_indices_unorm(&writer, src_width, src_height, a->indices, 3);
+      }
+   }
+}
+
+struct compress_rgba_unorm_state {
+   int width, height;
+   const uint8_t *src;
+   int src_rowstride;
+   uint8_t *dst;
+   int dst_rowstride;
+   bool nicest;
+};
+
+static void
+compress_rgba_unorm_rows(void *data, int first_row, int last_row)
+{
+   const struct compress_rgba_unorm_state *state = data;
+   int row, y, x;
+
+   for (row = first_row; row < last_row; row++) {
+      uint8_t *dst = state->dst + row * state->dst_rowstride;
+
+      y = row * BLOCK_SIZE;
+
+      for (x = 0; x < state->width; x += BLOCK_SIZE) {
+         const uint8_t *src = state->src + x * 4 + y * state->src_rowstride;
+         int width = MIN2(state->width - x, BLOCK_SIZE);
+         int height = MIN2(state->height - y, BLOCK_SIZE);
+
+         if (state->nicest)
+            compress_rgba_unorm_block_nicest(width, height,
+                                             src, state->src_rowstride, dst);
+         else
+            compress_rgba_unorm_block(width, height,
+                                      src, state->src_rowstride, dst);
          dst += BLOCK_BYTES;
       }
-      dst += dst_row_diff;
    }
 }
 
+static void
+compress_rgba_unorm(int width, int height,
+                    const uint8_t *src, int src_rowstride,
+                    uint8_t *dst, int dst_rowstride,
+                    bool nicest)
+{
+   struct compress_rgba_unorm_state state;
+
+   state.width = width;
+   state.height = height;
+   state.src = src;
+   state.src_rowstride = src_rowstride;
+   state.dst = dst;
+   if (dst_rowstride >= width * 4)
+      state.dst_rowstride = dst_rowstride;
+   else
+      state.dst_rowstride = ((width + 3) & ~3) * 4;
+   state.nicest = nicest;
+
+   _mesa_compress_rows_parallel((height + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                                (width + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                                compress_rgba_unorm_rows, &state);
+}
+
 GLboolean
 _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
 {
@@ -1310,7 +1724,8 @@ _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
 
    compress_rgba_unorm(srcWidth, srcHeight,
                        pixels, rowstride,
-                       dstSlices[0], dstRowStride);
+                       dstSlices[0], dstRowStride,
+                       ctx->Hint.TextureCompression == GL_NICEST);
 
    free((void *) tempImage);
 
@@ -1554,33 +1969,61 @@ compress_rgb_float_block(int src_width, int src_height,
                            endpoints);
 }
 
+struct compress_rgb_float_state {
+   int width, height;
+   const float *src;
+   int src_rowstride;
+   uint8_t *dst;
+   int dst_rowstride;
+   bool is_signed;
+};
+
+static void
+compress_rgb_float_rows(void *data, int first_row, int last_row)
+{
+   const struct compress_rgb_float_state *state = data;
+   int row, y, x;
+
+   for (row = first_row; row < last_row; row++) {
+      uint8_t *dst = state->dst + row * state->dst_rowstride;
+
+      y = row * BLOCK_SIZE;
+
+      for (x = 0; x < state->width; x += BLOCK_SIZE) {
+         compress_rgb_float_block(MIN2(state->width - x, BLOCK_SIZE),
+                                  MIN2(state->height - y, BLOCK_SIZE),
+                                  state->src + x * 3 +
+                                  y * state->src_rowstride / sizeof (float),
+                                  state->src_rowstride,
+                                  dst,
+                                  state->is_signed);
+         dst += BLOCK_BYTES;
+      }
+   }
+}
+
 static void
 compress_rgb_float(int width, int height,
                    const float *src, int src_rowstride,
                    uint8_t *dst, int dst_rowstride,
                    bool is_signed)
 {
-   int dst_row_diff;
-   int y, x;
+   struct compress_rgb_float_state state;
 
+   state.width = width;
+   state.height = height;
+   state.src = src;
+   state.src_rowstride = src_rowstride;
+   state.dst = dst;
    if (dst_rowstride >= width * 4)
-      dst_row_diff = dst_rowstride - ((width + 3) & ~3) * 4;
+      state.dst_rowstride = dst_rowstride;
    else
-      dst_row_diff = 0;
-
-   for (y = 0; y < height; y += BLOCK_SIZE) {
-      for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgb_float_block(MIN2(width - x, BLOCK_SIZE),
-                                  MIN2(height - y, BLOCK_SIZE),
-                                  src + x * 3 +
-                                  y * src_rowstride / sizeof (float),
-                                  src_rowstride,
-                                  dst,
-                                  is_signed);
-         dst += BLOCK_BYTES;
-      }
-      dst += dst_row_diff;
-   }
+      state.dst_rowstride = ((width + 3) & ~3) * 4;
+   state.is_signed = is_signed;
+
+   _mesa_compress_rows_parallel((height + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                                (width + BLOCK_SIZE - 1) / BLOCK_SIZE,
+                                compress_rgb_float_rows, &state);
 }
 
 static GLboolean
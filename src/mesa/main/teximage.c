@@ -2779,8 +2779,8 @@ _mesa_choose_texture_format(struct gl_context *ctx,
       }
    }
 
-   /* If the application requested compression to an S3TC format but we don't
-    * have the DXTn library, force a generic compressed format instead.
+   /* If the application requested compression to an S3TC format but DXTn
+    * support is disabled, force a generic compressed format instead.
     */
    if (internalFormat != format && format != GL_NONE) {
       const GLenum before = internalFormat;
@@ -2803,7 +2803,7 @@ _mesa_choose_texture_format(struct gl_context *ctx,
       if (before != internalFormat) {
          _mesa_warning(ctx,
                        "DXT compression requested (%s), "
-                       "but libtxc_dxtn library not installed.  Using %s "
+                       "but DXTn support is disabled.  Using %s "
                        "instead.",
                        _mesa_enum_to_string(before),
                        _mesa_enum_to_string(internalFormat));
@@ -106,7 +106,8 @@ struct gl_texture_object *
 _mesa_lookup_texture(struct gl_context *ctx, GLuint id)
 {
    return (struct gl_texture_object *)
-      _mesa_HashLookup(ctx->Shared->TexObjects, id);
+      _mesa_HashLookupCached(ctx->Shared->TexObjects, id,
+                             &ctx->TextureLookupCache);
 }
 
 /**
@@ -589,6 +589,14 @@ _mesa_propagate_uniforms_to_driver_storage(struct gl_uniform_storage *uni,
 
       dst += array_index * store->element_stride;
 
+      if (store->params) {
+         const unsigned start =
+            dst - (uint8_t *) store->params->ParameterValues;
+
+         _mesa_mark_parameter_values_dirty(store->params, start,
+                                           start + count * store->element_stride);
+      }
+
       switch (store->format) {
       case uniform_native: {
 	 unsigned j;
@@ -46,6 +46,7 @@
 #include "compiler/glsl_types.h"
 #include "compiler/glsl/linker.h"
 #include "compiler/glsl/program.h"
+#include "compiler/glsl/shader_cache.h"
 #include "program/prog_instruction.h"
 #include "program/prog_optimize.h"
 #include "program/prog_print.h"
@@ -2566,7 +2567,8 @@ _mesa_associate_uniform_storage(struct gl_context *ctx,
 					     dmul * columns,
 					     dmul,
 					     format,
-					     &params->ParameterValues[i]);
+					     &params->ParameterValues[i],
+					     params);
 
 	 /* After attaching the driver's storage to the uniform, propagate any
 	  * data from the linker's backing store.  This will cause values from
@@ -3058,8 +3060,25 @@ _mesa_glsl_link_shader(struct gl_context *ctx, struct gl_shader_program *prog)
       }
    }
 
-   if (prog->data->LinkStatus) {
-      link_shaders(ctx, prog);
+   if (prog->data->LinkStatus &&
+       !shader_cache_read_program_metadata(ctx, prog)) {
+      /* Compile the shaders whose compile was deferred in the expectation
+       * of a cache hit.
+       */
+      for (i = 0; i < prog->NumShaders; i++) {
+         if (prog->Shaders[i]->FallbackSource) {
+            _mesa_glsl_compile_shader(ctx, prog->Shaders[i], false, false,
+                                      true);
+            if (!prog->Shaders[i]->CompileStatus)
+               linker_error(prog, "linking with uncompiled shader");
+         }
+      }
+
+      if (prog->data->LinkStatus)
+         link_shaders(ctx, prog);
+
+      if (prog->data->LinkStatus)
+         shader_cache_write_program_metadata(ctx, prog);
    }
 
    if (prog->data->LinkStatus) {
@@ -292,6 +292,10 @@ _mesa_add_parameter(struct gl_program_parameter_list *paramList,
          paramList->Parameters[oldNum].StateIndexes[i] = state[i];
    }
 
+   _mesa_mark_parameter_values_dirty(paramList,
+                                     oldNum * sizeof(paramList->ParameterValues[0]),
+                                     (oldNum + sz4) * sizeof(paramList->ParameterValues[0]));
+
    return (GLint) oldNum;
 }
 
@@ -334,6 +338,9 @@ _mesa_add_typed_unnamed_constant(struct gl_program_parameter_list *paramList,
             gl_constant_value *pVal = paramList->ParameterValues[pos];
             GLuint swz = p->Size; /* 1, 2 or 3 for Y, Z, W */
             pVal[p->Size] = values[0];
+            _mesa_mark_parameter_values_dirty(paramList,
+                                              pos * sizeof(paramList->ParameterValues[0]),
+                                              (pos + 1) * sizeof(paramList->ParameterValues[0]));
             p->Size++;
             *swizzleOut = MAKE_SWIZZLE4(swz, swz, swz, swz);
             return pos;
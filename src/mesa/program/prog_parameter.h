@@ -88,9 +88,36 @@ struct gl_program_parameter_list
    gl_constant_value (*ParameterValues)[4]; /**< Array [Size] of constant[4] */
    GLbitfield StateFlags; /**< _NEW_* flags indicating which state changes
                                might invalidate ParameterValues[] */
+
+   /**
+    * Byte range of ParameterValues[] written since DirtyOwner last consumed
+    * the values, empty if DirtyStart >= DirtyEnd.  Lets a driver keeping a
+    * copy of the values only update what changed, as long as it is the last
+    * one to have consumed them.  Writers which don't track what they
+    * change, like _mesa_load_state_parameters(), clear DirtyOwner.
+    */
+   GLuint DirtyStart, DirtyEnd;
+   const void *DirtyOwner;
 };
 
 
+/**
+ * Records that bytes [start, end) of paramList->ParameterValues[] changed.
+ */
+static inline void
+_mesa_mark_parameter_values_dirty(struct gl_program_parameter_list *paramList,
+                                  unsigned start, unsigned end)
+{
+   if (paramList->DirtyStart >= paramList->DirtyEnd) {
+      paramList->DirtyStart = start;
+      paramList->DirtyEnd = end;
+   } else {
+      paramList->DirtyStart = MIN2(paramList->DirtyStart, start);
+      paramList->DirtyEnd = MAX2(paramList->DirtyEnd, end);
+   }
+}
+
+
 extern struct gl_program_parameter_list *
 _mesa_new_parameter_list(void);
 
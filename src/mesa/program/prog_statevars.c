@@ -1096,6 +1096,9 @@ _mesa_load_state_parameters(struct gl_context *ctx,
    if (!paramList)
       return;
 
+   /* The changed values aren't tracked, so nobody's copy is current. */
+   paramList->DirtyOwner = NULL;
+
    for (i = 0; i < paramList->NumParameters; i++) {
       if (paramList->Parameters[i].Type == PROGRAM_STATE_VAR) {
          _mesa_fetch_state(ctx,
@@ -1104,3 +1107,36 @@ _mesa_load_state_parameters(struct gl_context *ctx,
       }
    }
 }
+
+
+/**
+ * Like _mesa_load_state_parameters(), but only adds the values that
+ * actually changed to the list's dirty range, for drivers which upload
+ * just that range.  Most state stays the same from one draw to the next.
+ */
+void
+_mesa_load_state_parameters_tracked(struct gl_context *ctx,
+                                    struct gl_program_parameter_list *paramList)
+{
+   GLuint i;
+
+   if (!paramList)
+      return;
+
+   for (i = 0; i < paramList->NumParameters; i++) {
+      if (paramList->Parameters[i].Type == PROGRAM_STATE_VAR) {
+         gl_constant_value old[4];
+
+         memcpy(old, paramList->ParameterValues[i], sizeof(old));
+         _mesa_fetch_state(ctx,
+			   paramList->Parameters[i].StateIndexes,
+                           &paramList->ParameterValues[i][0]);
+
+         if (memcmp(old, paramList->ParameterValues[i], sizeof(old))) {
+            _mesa_mark_parameter_values_dirty(paramList,
+                                              i * sizeof(old),
+                                              (i + 1) * sizeof(old));
+         }
+      }
+   }
+}
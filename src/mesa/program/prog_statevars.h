@@ -144,6 +144,10 @@ extern void
 _mesa_load_state_parameters(struct gl_context *ctx,
                             struct gl_program_parameter_list *paramList);
 
+extern void
+_mesa_load_state_parameters_tracked(struct gl_context *ctx,
+                                    struct gl_program_parameter_list *paramList);
+
 
 extern GLbitfield
 _mesa_program_state_flags(const gl_state_index state[STATE_LENGTH]);
@@ -38,6 +38,7 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "util/u_inlines.h"
+#include "util/u_math.h"
 #include "util/u_upload_mgr.h"
 #include "cso_cache/cso_context.h"
 
@@ -48,6 +49,73 @@
 #include "st_program.h"
 #include "st_cb_bufferobjects.h"
 
+/**
+ * Whether the stage's constant buffer was last updated with the parameter
+ * list, and nothing else consumed the list's dirty range since, i.e. only
+ * the values in the dirty range need to be written.
+ */
+static bool
+constbuf_is_current(const struct st_context *st,
+                    enum pipe_shader_type shader_type,
+                    const struct gl_program_parameter_list *params)
+{
+   return st->constbuf[shader_type].buffer &&
+          st->constbuf[shader_type].params == params &&
+          params->DirtyOwner == &st->constbuf[shader_type];
+}
+
+
+/**
+ * Update the stage's constant buffer with the parameter values.
+ *
+ * If the buffer is current, only the values that changed are written.
+ * A mostly dirty buffer is replaced as a whole, which doesn't
+ * need to wait for pending draws using the old contents.
+ * Returns false if there's no buffer.
+ */
+static bool
+update_constbuf(struct st_context *st, enum pipe_shader_type shader_type,
+                struct gl_program_parameter_list *params, unsigned paramBytes)
+{
+   struct pipe_context *pipe = st->pipe;
+   struct pipe_resource **buffer = &st->constbuf[shader_type].buffer;
+   const void *owner = &st->constbuf[shader_type];
+   unsigned usage = PIPE_TRANSFER_WRITE;
+   unsigned start = 0, end = paramBytes;
+
+   if (!*buffer || (*buffer)->width0 < paramBytes) {
+      pipe_resource_reference(buffer, NULL);
+      *buffer = pipe_buffer_create(pipe->screen, PIPE_BIND_CONSTANT_BUFFER,
+                                   PIPE_USAGE_DYNAMIC, paramBytes);
+      if (!*buffer)
+         return false;
+   } else if (constbuf_is_current(st, shader_type, params)) {
+      if (params->DirtyStart < params->DirtyEnd) {
+         start = params->DirtyStart & ~15;
+         end = MIN2(align(params->DirtyEnd, 16), paramBytes);
+      } else {
+         start = end = 0;
+      }
+   }
+
+   if (end - start > paramBytes / 2) {
+      start = 0;
+      end = paramBytes;
+      usage |= PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE;
+   }
+
+   if (start < end) {
+      pipe->buffer_subdata(pipe, *buffer, usage, start, end - start,
+                           (uint8_t *) params->ParameterValues + start);
+   }
+
+   st->constbuf[shader_type].params = params;
+   params->DirtyOwner = owner;
+   params->DirtyStart = params->DirtyEnd = 0;
+   return true;
+}
+
+
 /**
  * Pass the given program parameters to the graphics pipe as a
  * constant buffer.
@@ -79,6 +147,9 @@ void st_upload_constants( struct st_context *st,
             memcpy(params->ParameterValues[c],
                    st->ctx->ATIFragmentShader.GlobalConstants[c], sizeof(GLfloat) * 4);
       }
+      _mesa_mark_parameter_values_dirty(params, 0,
+                                        MAX_NUM_FRAGMENT_CONSTANTS_ATI *
+                                        sizeof(params->ParameterValues[0]));
    }
 
    /* update constants */
@@ -91,16 +162,29 @@ void st_upload_constants( struct st_context *st,
        * the parameters list are explicitly set by the user with glUniform,
        * glProgramParameter(), etc.
        */
-      if (params->StateFlags)
-         _mesa_load_state_parameters(st->ctx, params);
+      if (params->StateFlags) {
+         if (st->constbuf_uploader &&
+             constbuf_is_current(st, shader_type, params))
+            _mesa_load_state_parameters_tracked(st->ctx, params);
+         else
+            _mesa_load_state_parameters(st->ctx, params);
+      }
 
       _mesa_shader_write_subroutine_indices(st->ctx, stage);
 
-      /* We always need to get a new buffer, to keep the drivers simple and
-       * avoid gratuitous rendering synchronization.
-       * Let's use a user buffer to avoid an unnecessary copy.
+      /* Let's use a user buffer to avoid an unnecessary copy.  Otherwise only
+       * update the values that changed, if possible.
        */
-      if (st->constbuf_uploader) {
+      if (st->constbuf_uploader &&
+          update_constbuf(st, shader_type, params, paramBytes)) {
+         cb.buffer = NULL;
+         cb.user_buffer = NULL;
+         cb.buffer_offset = 0;
+         pipe_resource_reference(&cb.buffer, st->constbuf[shader_type].buffer);
+      } else if (st->constbuf_uploader) {
+         /* We always need to get a new buffer, to keep the drivers simple
+          * and avoid gratuitous rendering synchronization.
+          */
          cb.buffer = NULL;
          cb.user_buffer = NULL;
          u_upload_data(st->constbuf_uploader, 0, paramBytes,
@@ -305,6 +305,8 @@ st_destroy_context_priv(struct st_context *st)
    if (st->constbuf_uploader) {
       u_upload_destroy(st->constbuf_uploader);
    }
+   for (i = 0; i < ARRAY_SIZE(st->constbuf); i++)
+      pipe_resource_reference(&st->constbuf[i].buffer, NULL);
 
    /* free glDrawPixels cache data */
    free(st->drawpix_cache.image);
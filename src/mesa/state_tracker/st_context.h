@@ -45,6 +45,7 @@ struct dd_function_table;
 struct draw_context;
 struct draw_stage;
 struct gen_mipmap_state;
+struct gl_program_parameter_list;
 struct st_context;
 struct st_fragment_program;
 struct st_perf_monitor_group;
@@ -70,6 +71,16 @@ struct st_context
 
    struct u_upload_mgr *uploader, *indexbuf_uploader, *constbuf_uploader;
 
+   /**
+    * Constant buffers holding the parameters of each stage, used when
+    * constbuf_uploader is, and only updated where the parameters changed.
+    * See st_upload_constants().
+    */
+   struct {
+      struct pipe_resource *buffer;
+      const struct gl_program_parameter_list *params;
+   } constbuf[PIPE_SHADER_TYPES];
+
    struct draw_context *draw;  /**< For selection/feedback/rastpos only */
    struct draw_stage *feedback_stage;  /**< For GL_FEEDBACK rendermode */
    struct draw_stage *selection_stage;  /**< For GL_SELECT rendermode */
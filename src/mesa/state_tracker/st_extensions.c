@@ -404,14 +404,17 @@ void st_init_limits(struct pipe_screen *screen,
    c->GLSLFrontFacingIsSysVal =
       screen->get_param(screen, PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL);
 
+   /* Drivers may only support buffers in compute shaders. */
    c->MaxAtomicBufferBindings =
-         c->Program[MESA_SHADER_FRAGMENT].MaxAtomicBuffers;
+         MAX2(c->Program[MESA_SHADER_FRAGMENT].MaxAtomicBuffers,
+              c->Program[MESA_SHADER_COMPUTE].MaxAtomicBuffers);
    c->MaxCombinedAtomicBuffers =
          c->Program[MESA_SHADER_VERTEX].MaxAtomicBuffers +
          c->Program[MESA_SHADER_TESS_CTRL].MaxAtomicBuffers +
          c->Program[MESA_SHADER_TESS_EVAL].MaxAtomicBuffers +
          c->Program[MESA_SHADER_GEOMETRY].MaxAtomicBuffers +
-         c->Program[MESA_SHADER_FRAGMENT].MaxAtomicBuffers;
+         c->Program[MESA_SHADER_FRAGMENT].MaxAtomicBuffers +
+         c->Program[MESA_SHADER_COMPUTE].MaxAtomicBuffers;
    assert(c->MaxCombinedAtomicBuffers <= MAX_COMBINED_ATOMIC_BUFFERS);
 
    if (c->MaxCombinedAtomicBuffers > 0) {
@@ -0,0 +1,723 @@
+/*
+ * Copyright © 2016 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * DXT1/3/5 (S3TC) block decoding and encoding.
+ *
+ * Decoding follows the same rules as libtxc_dxtn, so results are bit
+ * identical with it.  The encoder is a bounding box fit: the endpoints are
+ * the corners of the (inset) color bounding box along the diagonal that
+ * best matches the covariance of the block, and texels are assigned to the
+ * nearest palette entry by projecting them onto that diagonal.  That is
+ * much cheaper than a least squares fit and good enough for textures
+ * compressed at upload time.
+ *
+ * When SSE2 is available, block decoding and the color index search are
+ * vectorized.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "macros.h"
+#include "s3tc.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+static inline unsigned
+dxtn_block_size(enum util_format_dxtn format)
+{
+   return (format == UTIL_FORMAT_DXT1_RGB ||
+           format == UTIL_FORMAT_DXT1_RGBA) ? 8 : 16;
+}
+
+
+/*
+ * Decoding.
+ */
+
+static inline void
+dxtn_expand_565(unsigned c, uint8_t *rgba)
+{
+   rgba[0] = ((c >> 8) & 0xf8) | ((c >> 13) & 0x7);
+   rgba[1] = ((c >> 3) & 0xfc) | ((c >> 9) & 0x3);
+   rgba[2] = ((c << 3) & 0xf8) | ((c >> 2) & 0x7);
+   rgba[3] = 0xff;
+}
+
+
+/**
+ * Build the four colors of a color block.  DXT1 blocks with color0 <=
+ * color1 only have three colors, the fourth being black, and transparent
+ * for DXT1 RGBA.
+ */
+static void
+dxtn_color_palette(enum util_format_dxtn format, const uint8_t *blk,
+                   uint8_t palette[4][4])
+{
+   const unsigned c0 = blk[0] | (blk[1] << 8);
+   const unsigned c1 = blk[2] | (blk[3] << 8);
+   unsigned k;
+
+   dxtn_expand_565(c0, palette[0]);
+   dxtn_expand_565(c1, palette[1]);
+
+   if (c0 > c1 || dxtn_block_size(format) == 16) {
+      for (k = 0; k < 3; k++) {
+         palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+         palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+      }
+      palette[2][3] = 0xff;
+      palette[3][3] = 0xff;
+   }
+   else {
+      for (k = 0; k < 3; k++) {
+         palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+         palette[3][k] = 0;
+      }
+      palette[2][3] = 0xff;
+      palette[3][3] = format == UTIL_FORMAT_DXT1_RGBA ? 0 : 0xff;
+   }
+}
+
+
+static void
+dxt5_alpha_palette(const uint8_t *blk, uint8_t palette[8])
+{
+   const unsigned a0 = blk[0], a1 = blk[1];
+   unsigned k;
+
+   palette[0] = a0;
+   palette[1] = a1;
+   if (a0 > a1) {
+      for (k = 2; k < 8; k++)
+         palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+   }
+   else {
+      for (k = 2; k < 6; k++)
+         palette[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+      palette[6] = 0;
+      palette[7] = 0xff;
+   }
+}
+
+
+static inline uint32_t
+dxtn_read_32(const uint8_t *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+static inline uint64_t
+dxt5_alpha_bits(const uint8_t *blk)
+{
+   return dxtn_read_32(blk + 2) | ((uint64_t)(blk[6] | (blk[7] << 8)) << 32);
+}
+
+
+static inline void
+dxtn_fetch_texel(enum util_format_dxtn format, int srcRowStride,
+                 const uint8_t *pixdata, int i, int j, uint8_t *value)
+{
+   const unsigned block_size = dxtn_block_size(format);
+   const uint8_t *blk = pixdata +
+      (((srcRowStride + 3) / 4) * (j / 4) + i / 4) * block_size;
+   const uint8_t *color = block_size == 16 ? blk + 8 : blk;
+   const unsigned bit = 4 * (j & 3) + (i & 3);
+   uint8_t palette[4][4];
+
+   dxtn_color_palette(format, color, palette);
+   memcpy(value, palette[(dxtn_read_32(color + 4) >> (2 * bit)) & 3], 4);
+
+   if (format == UTIL_FORMAT_DXT3_RGBA) {
+      const unsigned a = (blk[bit / 2] >> (4 * (bit & 1))) & 0xf;
+      value[3] = a * 0x11;
+   }
+   else if (format == UTIL_FORMAT_DXT5_RGBA) {
+      uint8_t alpha[8];
+      dxt5_alpha_palette(blk, alpha);
+      value[3] = alpha[(dxt5_alpha_bits(blk) >> (3 * bit)) & 7];
+   }
+}
+
+
+void
+util_format_fetch_texel_dxt1_rgb(int srcRowStride, const uint8_t *pixdata,
+                                 int i, int j, uint8_t *value)
+{
+   dxtn_fetch_texel(UTIL_FORMAT_DXT1_RGB, srcRowStride, pixdata, i, j, value);
+}
+
+
+void
+util_format_fetch_texel_dxt1_rgba(int srcRowStride, const uint8_t *pixdata,
+                                  int i, int j, uint8_t *value)
+{
+   dxtn_fetch_texel(UTIL_FORMAT_DXT1_RGBA, srcRowStride, pixdata, i, j, value);
+}
+
+
+void
+util_format_fetch_texel_dxt3_rgba(int srcRowStride, const uint8_t *pixdata,
+                                  int i, int j, uint8_t *value)
+{
+   dxtn_fetch_texel(UTIL_FORMAT_DXT3_RGBA, srcRowStride, pixdata, i, j, value);
+}
+
+
+void
+util_format_fetch_texel_dxt5_rgba(int srcRowStride, const uint8_t *pixdata,
+                                  int i, int j, uint8_t *value)
+{
+   dxtn_fetch_texel(UTIL_FORMAT_DXT5_RGBA, srcRowStride, pixdata, i, j, value);
+}
+
+
+/**
+ * Decode the alpha of a DXT3/5 block, one byte per texel.
+ */
+static void
+dxtn_decode_alpha(enum util_format_dxtn format, const uint8_t *blk,
+                  uint8_t alpha[16])
+{
+   unsigned k;
+
+   if (format == UTIL_FORMAT_DXT3_RGBA) {
+      for (k = 0; k < 16; k++)
+         alpha[k] = ((blk[k / 2] >> (4 * (k & 1))) & 0xf) * 0x11;
+   }
+   else {
+      const uint64_t bits = dxt5_alpha_bits(blk);
+      uint8_t palette[8];
+
+      dxt5_alpha_palette(blk, palette);
+      for (k = 0; k < 16; k++)
+         alpha[k] = palette[(bits >> (3 * k)) & 7];
+   }
+}
+
+
+#if defined(__SSE2__)
+
+static void
+dxtn_decode_block_sse2(enum util_format_dxtn format, const uint8_t *blk,
+                       uint8_t *dst, unsigned dst_stride)
+{
+   const uint8_t *color = dxtn_block_size(format) == 16 ? blk + 8 : blk;
+   const __m128i mask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+   const __m128i zero = _mm_setzero_si128();
+   __m128i bits, pal[4], sel[4], alpha[4];
+   uint8_t palette[4][4];
+   unsigned j, k;
+
+   dxtn_color_palette(format, color, palette);
+   for (k = 0; k < 4; k++) {
+      uint32_t c = dxtn_read_32(palette[k]);
+      if (format == UTIL_FORMAT_DXT3_RGBA || format == UTIL_FORMAT_DXT5_RGBA)
+         c &= 0x00ffffff;
+      pal[k] = _mm_set1_epi32(c);
+      sel[k] = _mm_setr_epi32(k, k << 2, k << 4, k << 6);
+   }
+
+   if (format == UTIL_FORMAT_DXT3_RGBA || format == UTIL_FORMAT_DXT5_RGBA) {
+      const __m128i nibble = _mm_set1_epi8(0xf);
+      __m128i a, lo, hi;
+
+      if (format == UTIL_FORMAT_DXT3_RGBA) {
+         a = _mm_loadl_epi64((const __m128i *)blk);
+         lo = _mm_and_si128(a, nibble);
+         hi = _mm_and_si128(_mm_srli_epi16(a, 4), nibble);
+         a = _mm_unpacklo_epi8(lo, hi);
+         a = _mm_or_si128(a, _mm_slli_epi16(a, 4));
+      }
+      else {
+         uint8_t tmp[16];
+         dxtn_decode_alpha(format, blk, tmp);
+         a = _mm_loadu_si128((const __m128i *)tmp);
+      }
+
+      /* move each alpha to the top byte of its texel */
+      lo = _mm_unpacklo_epi8(zero, a);
+      hi = _mm_unpackhi_epi8(zero, a);
+      alpha[0] = _mm_unpacklo_epi16(zero, lo);
+      alpha[1] = _mm_unpackhi_epi16(zero, lo);
+      alpha[2] = _mm_unpacklo_epi16(zero, hi);
+      alpha[3] = _mm_unpackhi_epi16(zero, hi);
+   }
+   else {
+      alpha[0] = alpha[1] = alpha[2] = alpha[3] = zero;
+   }
+
+   bits = _mm_set1_epi32(dxtn_read_32(color + 4));
+   for (j = 0; j < 4; j++) {
+      const __m128i idx = _mm_and_si128(bits, mask);
+      __m128i texels = alpha[j];
+
+      for (k = 0; k < 4; k++) {
+         const __m128i eq = _mm_cmpeq_epi32(idx, sel[k]);
+         texels = _mm_or_si128(texels, _mm_and_si128(eq, pal[k]));
+      }
+      _mm_storeu_si128((__m128i *)(dst + j * dst_stride), texels);
+
+      bits = _mm_srli_epi32(bits, 8);
+   }
+}
+
+#endif /* __SSE2__ */
+
+
+void
+util_format_decode_block_dxtn(enum util_format_dxtn format,
+                              const uint8_t *src,
+                              uint8_t *dst, unsigned dst_stride)
+{
+#if defined(__SSE2__)
+   dxtn_decode_block_sse2(format, src, dst, dst_stride);
+#else
+   const uint8_t *color = dxtn_block_size(format) == 16 ? src + 8 : src;
+   const uint32_t bits = dxtn_read_32(color + 4);
+   uint8_t palette[4][4];
+   unsigned i, j;
+
+   dxtn_color_palette(format, color, palette);
+   for (j = 0; j < 4; j++) {
+      for (i = 0; i < 4; i++) {
+         memcpy(dst + j * dst_stride + i * 4,
+                palette[(bits >> (2 * (4 * j + i))) & 3], 4);
+      }
+   }
+
+   if (format == UTIL_FORMAT_DXT3_RGBA || format == UTIL_FORMAT_DXT5_RGBA) {
+      uint8_t alpha[16];
+
+      dxtn_decode_alpha(format, src, alpha);
+      for (j = 0; j < 4; j++) {
+         for (i = 0; i < 4; i++)
+            dst[j * dst_stride + i * 4 + 3] = alpha[4 * j + i];
+      }
+   }
+#endif
+}
+
+
+/*
+ * Encoding.
+ */
+
+static inline unsigned
+dxtn_pack_565(const int *rgb)
+{
+   return (((rgb[0] * 31 + 127) / 255) << 11) |
+          (((rgb[1] * 63 + 127) / 255) << 5) |
+          ((rgb[2] * 31 + 127) / 255);
+}
+
+
+static inline void
+dxtn_write_16(uint8_t *p, unsigned v)
+{
+   p[0] = v & 0xff;
+   p[1] = (v >> 8) & 0xff;
+}
+
+
+static inline void
+dxtn_write_32(uint8_t *p, uint32_t v)
+{
+   p[0] = v & 0xff;
+   p[1] = (v >> 8) & 0xff;
+   p[2] = (v >> 16) & 0xff;
+   p[3] = v >> 24;
+}
+
+
+/** Interleave the bits of lo and hi, lo's going to the even positions. */
+static inline uint32_t
+dxtn_interleave_bits(uint32_t lo, uint32_t hi)
+{
+   uint32_t x = lo | (hi << 16);
+
+   x = (x & 0xff0000ff) | ((x & 0x00ff0000) >> 8) | ((x & 0x0000ff00) << 8);
+   x = (x & 0xf00ff00f) | ((x & 0x0f000f00) >> 4) | ((x & 0x00f000f0) << 4);
+   x = (x & 0xc3c3c3c3) | ((x & 0x30303030) >> 2) | ((x & 0x0c0c0c0c) << 2);
+   x = (x & 0x99999999) | ((x & 0x44444444) >> 1) | ((x & 0x22222222) << 1);
+   return x;
+}
+
+
+/**
+ * Color bounding box of the texels.  Transparent texels are skipped if
+ * opaque_only is set.  Returns false if there is no texel left.
+ */
+static bool
+dxtn_bounding_box(const uint8_t texels[16][4], bool opaque_only,
+                  int min[3], int max[3])
+{
+   unsigned k, c;
+
+#if defined(__SSE2__)
+   if (!opaque_only) {
+      const __m128i *rows = (const __m128i *)texels;
+      __m128i lo = _mm_min_epu8(_mm_min_epu8(_mm_loadu_si128(&rows[0]),
+                                             _mm_loadu_si128(&rows[1])),
+                                _mm_min_epu8(_mm_loadu_si128(&rows[2]),
+                                             _mm_loadu_si128(&rows[3])));
+      __m128i hi = _mm_max_epu8(_mm_max_epu8(_mm_loadu_si128(&rows[0]),
+                                             _mm_loadu_si128(&rows[1])),
+                                _mm_max_epu8(_mm_loadu_si128(&rows[2]),
+                                             _mm_loadu_si128(&rows[3])));
+      uint32_t l, h;
+
+      lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+      lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+      hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+      hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+      l = _mm_cvtsi128_si32(lo);
+      h = _mm_cvtsi128_si32(hi);
+      for (c = 0; c < 3; c++) {
+         min[c] = (l >> (8 * c)) & 0xff;
+         max[c] = (h >> (8 * c)) & 0xff;
+      }
+      return true;
+   }
+#endif
+
+   for (c = 0; c < 3; c++) {
+      min[c] = 255;
+      max[c] = 0;
+   }
+
+   for (k = 0; k < 16; k++) {
+      if (opaque_only && texels[k][3] < 128)
+         continue;
+      for (c = 0; c < 3; c++) {
+         min[c] = MIN2(min[c], texels[k][c]);
+         max[c] = MAX2(max[c], texels[k][c]);
+      }
+   }
+
+   return min[0] <= max[0];
+}
+
+
+/**
+ * Pick the endpoints of the block from its bounding box.  The box diagonal
+ * from min to max only follows the colors if they all grow together; flip
+ * the channels which go against the one with the widest range.  The box is
+ * then inset a bit, since the extremes rarely matter as much as the bulk.
+ */
+static void
+dxtn_choose_endpoints(const uint8_t texels[16][4], bool opaque_only,
+                      int min[3], int max[3])
+{
+   unsigned ref = 0, k, c;
+   int cov[3] = { 0, 0, 0 };
+
+   for (c = 1; c < 3; c++) {
+      if (max[c] - min[c] > max[ref] - min[ref])
+         ref = c;
+   }
+
+   for (k = 0; k < 16; k++) {
+      const int r = 2 * texels[k][ref] - (min[ref] + max[ref]);
+
+      if (opaque_only && texels[k][3] < 128)
+         continue;
+      for (c = 0; c < 3; c++)
+         cov[c] += (2 * texels[k][c] - (min[c] + max[c])) * r;
+   }
+
+   for (c = 0; c < 3; c++) {
+      const int inset = (max[c] - min[c]) >> 4;
+
+      min[c] += inset;
+      max[c] -= inset;
+      if (cov[c] < 0) {
+         const int tmp = min[c];
+         min[c] = max[c];
+         max[c] = tmp;
+      }
+   }
+}
+
+
+/**
+ * Index of each texel in a four color palette from e0 to e1.
+ */
+static uint32_t
+dxtn_color_indices(const uint8_t texels[16][4],
+                   const uint8_t *e0, const uint8_t *e1)
+{
+   const int d[3] = { e0[0] - e1[0], e0[1] - e1[1], e0[2] - e1[2] };
+   const int len2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+   const int base = e1[0] * d[0] + e1[1] * d[1] + e1[2] * d[2];
+
+#if defined(__SSE2__)
+   const __m128i *rows = (const __m128i *)texels;
+   const __m128i dir = _mm_setr_epi16(d[0], d[1], d[2], 0,
+                                      d[0], d[1], d[2], 0);
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i ones = _mm_set1_epi32(-1);
+   __m128i lo_bits[4], hi_bits[4];
+   unsigned j;
+
+   for (j = 0; j < 4; j++) {
+      const __m128i row = _mm_loadu_si128(&rows[j]);
+      __m128i a = _mm_madd_epi16(_mm_unpacklo_epi8(row, zero), dir);
+      __m128i b = _mm_madd_epi16(_mm_unpackhi_epi8(row, zero), dir);
+      __m128i t, m1, m2, m3;
+
+      /* sum the two halves of each texel's dot product */
+      a = _mm_add_epi32(a, _mm_srli_epi64(a, 32));
+      b = _mm_add_epi32(b, _mm_srli_epi64(b, 32));
+      a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+      b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+      t = _mm_sub_epi32(_mm_unpacklo_epi64(a, b), _mm_set1_epi32(base));
+
+      /* 6 * dot, compared against the midpoints between palette entries */
+      t = _mm_add_epi32(_mm_slli_epi32(t, 2), _mm_slli_epi32(t, 1));
+      m1 = _mm_cmpgt_epi32(t, _mm_set1_epi32(len2));
+      m2 = _mm_cmpgt_epi32(t, _mm_set1_epi32(3 * len2));
+      m3 = _mm_cmpgt_epi32(t, _mm_set1_epi32(5 * len2));
+
+      lo_bits[j] = _mm_xor_si128(m2, ones);
+      hi_bits[j] = _mm_andnot_si128(m3, m1);
+   }
+
+   return dxtn_interleave_bits(
+      _mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(lo_bits[0], lo_bits[1]),
+                                        _mm_packs_epi32(lo_bits[2], lo_bits[3]))),
+      _mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(hi_bits[0], hi_bits[1]),
+                                        _mm_packs_epi32(hi_bits[2], hi_bits[3]))));
+#else
+   /* position along the axis, from e1 to e0, to index */
+   static const unsigned index[4] = { 1, 3, 2, 0 };
+   uint32_t bits = 0;
+   unsigned k;
+
+   for (k = 0; k < 16; k++) {
+      const int t = 6 * (texels[k][0] * d[0] + texels[k][1] * d[1] +
+                         texels[k][2] * d[2] - base);
+      const unsigned pos = (t > len2) + (t > 3 * len2) + (t > 5 * len2);
+
+      bits |= index[pos] << (2 * k);
+   }
+
+   return bits;
+#endif
+}
+
+
+static void
+dxtn_encode_color(enum util_format_dxtn format, const uint8_t texels[16][4],
+                  uint8_t *dst)
+{
+   bool transparent = false;
+   int min[3], max[3];
+   unsigned c0, c1, k;
+   uint8_t e0[4], e1[4];
+   uint32_t bits;
+
+   if (format == UTIL_FORMAT_DXT1_RGBA) {
+      for (k = 0; k < 16; k++)
+         transparent |= texels[k][3] < 128;
+   }
+
+   if (!dxtn_bounding_box(texels, transparent, min, max)) {
+      /* fully transparent */
+      dxtn_write_16(dst, 0);
+      dxtn_write_16(dst + 2, 0);
+      dxtn_write_32(dst + 4, ~0u);
+      return;
+   }
+
+   dxtn_choose_endpoints(texels, transparent, min, max);
+
+   c0 = dxtn_pack_565(max);
+   c1 = dxtn_pack_565(min);
+
+   /*
+    * Four color blocks need c0 > c1, three color ones (for transparency)
+    * c0 <= c1.
+    */
+   if (transparent ? c0 > c1 : c0 < c1) {
+      const unsigned tmp = c0;
+      c0 = c1;
+      c1 = tmp;
+   }
+
+   dxtn_expand_565(c0, e0);
+   dxtn_expand_565(c1, e1);
+
+   if (c0 == c1 && !transparent) {
+      bits = 0;
+   }
+   else if (!transparent) {
+      bits = dxtn_color_indices(texels, e0, e1);
+   }
+   else {
+      const int d[3] = { e0[0] - e1[0], e0[1] - e1[1], e0[2] - e1[2] };
+      const int len2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+      bits = 0;
+      for (k = 0; k < 16; k++) {
+         unsigned idx;
+
+         if (texels[k][3] < 128) {
+            idx = 3;
+         }
+         else if (len2 == 0) {
+            idx = 0;
+         }
+         else {
+            const int t = 4 * ((texels[k][0] - e1[0]) * d[0] +
+                               (texels[k][1] - e1[1]) * d[1] +
+                               (texels[k][2] - e1[2]) * d[2]);
+            const unsigned pos = (t > len2) + (t > 3 * len2);
+            idx = pos == 2 ? 0 : pos == 1 ? 2 : 1;
+         }
+         bits |= idx << (2 * k);
+      }
+   }
+
+   dxtn_write_16(dst, c0);
+   dxtn_write_16(dst + 2, c1);
+   dxtn_write_32(dst + 4, bits);
+}
+
+
+static void
+dxt3_encode_alpha(const uint8_t texels[16][4], uint8_t *dst)
+{
+   unsigned k;
+
+   for (k = 0; k < 16; k += 2) {
+      dst[k / 2] = ((texels[k][3] + 8) / 17) |
+                   (((texels[k + 1][3] + 8) / 17) << 4);
+   }
+}
+
+
+static void
+dxt5_encode_alpha(const uint8_t texels[16][4], uint8_t *dst)
+{
+   unsigned amin = 255, amax = 0, range, k;
+   uint64_t bits = 0;
+
+   for (k = 0; k < 16; k++) {
+      amin = MIN2(amin, texels[k][3]);
+      amax = MAX2(amax, texels[k][3]);
+   }
+
+   dst[0] = amax;
+   dst[1] = amin;
+
+   /*
+    * Eight alpha mode.  Codes 0 and 1 are the endpoints, 2 to 7 the ramp
+    * from amax down to amin.  A flat block is all code 0.
+    */
+   range = amax - amin;
+   if (range) {
+      for (k = 0; k < 16; k++) {
+         const unsigned pos =
+            (14 * (texels[k][3] - amin) + range) / (2 * range);
+         const unsigned code = pos == 7 ? 0 : pos == 0 ? 1 : 8 - pos;
+
+         bits |= (uint64_t)code << (3 * k);
+      }
+   }
+
+   dxtn_write_16(dst + 2, bits & 0xffff);
+   dxtn_write_32(dst + 4, (uint32_t)(bits >> 16));
+}
+
+
+void
+util_format_encode_block_dxtn(enum util_format_dxtn format,
+                              const uint8_t *src, unsigned src_stride,
+                              uint8_t *dst)
+{
+   uint8_t texels[16][4];
+   unsigned j;
+
+   for (j = 0; j < 4; j++)
+      memcpy(texels[4 * j], src + j * src_stride, 16);
+
+   switch (format) {
+   case UTIL_FORMAT_DXT3_RGBA:
+      dxt3_encode_alpha(texels, dst);
+      dxtn_encode_color(format, texels, dst + 8);
+      break;
+   case UTIL_FORMAT_DXT5_RGBA:
+      dxt5_encode_alpha(texels, dst);
+      dxtn_encode_color(format, texels, dst + 8);
+      break;
+   default:
+      dxtn_encode_color(format, texels, dst);
+      break;
+   }
+}
+
+
+void
+util_format_compress_dxtn(int src_comps, int width, int height,
+                          const uint8_t *src,
+                          enum util_format_dxtn format,
+                          uint8_t *dst, int dst_stride)
+{
+   const unsigned block_size = dxtn_block_size(format);
+   int x, y, i, j;
+
+   if (!dst_stride)
+      dst_stride = ((width + 3) / 4) * block_size;
+
+   for (y = 0; y < height; y += 4) {
+      uint8_t *dst_block = dst + (y / 4) * dst_stride;
+
+      for (x = 0; x < width; x += 4) {
+         uint8_t texels[16][4];
+
+         /* replicate the last row and column into partial blocks */
+         for (j = 0; j < 4; j++) {
+            for (i = 0; i < 4; i++) {
+               const uint8_t *p = src +
+                  (MIN2(y + j, height - 1) * width +
+                   MIN2(x + i, width - 1)) * src_comps;
+
+               texels[4 * j + i][0] = p[0];
+               texels[4 * j + i][1] = p[1];
+               texels[4 * j + i][2] = p[2];
+               texels[4 * j + i][3] = src_comps == 4 ? p[3] : 0xff;
+            }
+         }
+
+         util_format_encode_block_dxtn(format, &texels[0][0], 16, dst_block);
+         dst_block += block_size;
+      }
+   }
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2016 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _S3TC_H
+#define _S3TC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The values match the GL enums, so GL callers can pass those through. */
+enum util_format_dxtn {
+  UTIL_FORMAT_DXT1_RGB = 0x83F0,
+  UTIL_FORMAT_DXT1_RGBA = 0x83F1,
+  UTIL_FORMAT_DXT3_RGBA = 0x83F2,
+  UTIL_FORMAT_DXT5_RGBA = 0x83F3
+};
+
+/*
+ * Single texel fetches, with the same interface as libtxc_dxtn:  the texel
+ * (i, j) of an image whose rows are srcRowStride texels wide is returned as
+ * RGBA8 in value.
+ */
+void util_format_fetch_texel_dxt1_rgb(int srcRowStride, const uint8_t *pixdata,
+                                      int i, int j, uint8_t *value);
+
+void util_format_fetch_texel_dxt1_rgba(int srcRowStride, const uint8_t *pixdata,
+                                       int i, int j, uint8_t *value);
+
+void util_format_fetch_texel_dxt3_rgba(int srcRowStride, const uint8_t *pixdata,
+                                       int i, int j, uint8_t *value);
+
+void util_format_fetch_texel_dxt5_rgba(int srcRowStride, const uint8_t *pixdata,
+                                       int i, int j, uint8_t *value);
+
+/* Decode a whole block to 4x4 RGBA8 texels, dst_stride is in bytes. */
+void util_format_decode_block_dxtn(enum util_format_dxtn format,
+                                   const uint8_t *src,
+                                   uint8_t *dst, unsigned dst_stride);
+
+/* Encode 4x4 RGBA8 texels, src_stride is in bytes. */
+void util_format_encode_block_dxtn(enum util_format_dxtn format,
+                                   const uint8_t *src, unsigned src_stride,
+                                   uint8_t *dst);
+
+/*
+ * Compress a tightly packed RGB8 or RGBA8 image, with the same interface as
+ * libtxc_dxtn's tx_compress_dxtn().  dst_stride is the distance in bytes
+ * between rows of blocks, or zero if they are tightly packed.
+ */
+void util_format_compress_dxtn(int src_comps, int width, int height,
+                               const uint8_t *src,
+                               enum util_format_dxtn format,
+                               uint8_t *dst, int dst_stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _S3TC_H */
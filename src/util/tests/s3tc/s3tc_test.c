@@ -0,0 +1,361 @@
+/*
+ * Copyright © 2016 VMware, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Tests for the S3TC decoder and encoder in s3tc.c:  decoding of known
+ * blocks, agreement of the texel fetches with the block decoder, and the
+ * error of an encode/decode round trip.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+#include "s3tc.h"
+
+static bool pass = true;
+
+static const enum util_format_dxtn formats[] = {
+   UTIL_FORMAT_DXT1_RGB,
+   UTIL_FORMAT_DXT1_RGBA,
+   UTIL_FORMAT_DXT3_RGBA,
+   UTIL_FORMAT_DXT5_RGBA,
+};
+
+static const char *
+format_name(enum util_format_dxtn format)
+{
+   switch (format) {
+   case UTIL_FORMAT_DXT1_RGB:
+      return "DXT1_RGB";
+   case UTIL_FORMAT_DXT1_RGBA:
+      return "DXT1_RGBA";
+   case UTIL_FORMAT_DXT3_RGBA:
+      return "DXT3_RGBA";
+   default:
+      return "DXT5_RGBA";
+   }
+}
+
+static unsigned
+block_size(enum util_format_dxtn format)
+{
+   return (format == UTIL_FORMAT_DXT1_RGB ||
+           format == UTIL_FORMAT_DXT1_RGBA) ? 8 : 16;
+}
+
+static void
+fetch_texel(enum util_format_dxtn format, int row_stride,
+            const uint8_t *data, int i, int j, uint8_t *value)
+{
+   switch (format) {
+   case UTIL_FORMAT_DXT1_RGB:
+      util_format_fetch_texel_dxt1_rgb(row_stride, data, i, j, value);
+      break;
+   case UTIL_FORMAT_DXT1_RGBA:
+      util_format_fetch_texel_dxt1_rgba(row_stride, data, i, j, value);
+      break;
+   case UTIL_FORMAT_DXT3_RGBA:
+      util_format_fetch_texel_dxt3_rgba(row_stride, data, i, j, value);
+      break;
+   default:
+      util_format_fetch_texel_dxt5_rgba(row_stride, data, i, j, value);
+      break;
+   }
+}
+
+static uint32_t seed = 1;
+
+static uint8_t
+random_byte(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 16;
+}
+
+
+/*
+ * Known blocks.
+ */
+
+/* red and blue endpoints, texel k uses index k % 4 */
+static const uint8_t red_blue_4color[8] = {
+   0x00, 0xf8, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4
+};
+
+/* same with the endpoints swapped, making it a three color block */
+static const uint8_t blue_red_3color[8] = {
+   0x1f, 0x00, 0x00, 0xf8, 0xe4, 0xe4, 0xe4, 0xe4
+};
+
+/* texel k has the alpha nibble k */
+static const uint8_t dxt3_alpha[8] = {
+   0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe
+};
+
+/* texel k uses code k % 8 */
+static const uint8_t dxt5_alpha_codes[6] = {
+   0x88, 0xc6, 0xfa, 0x88, 0xc6, 0xfa
+};
+
+static void
+check_block(const char *name, enum util_format_dxtn format,
+            const uint8_t *block, const uint8_t expected[16][4])
+{
+   uint8_t texels[16][4];
+   unsigned k;
+
+   util_format_decode_block_dxtn(format, block, &texels[0][0], 16);
+
+   for (k = 0; k < 16; k++) {
+      if (memcmp(texels[k], expected[k], 4) != 0) {
+         fprintf(stderr, "%s: texel %u is %u %u %u %u, expected %u %u %u %u\n",
+                 name, k, texels[k][0], texels[k][1], texels[k][2],
+                 texels[k][3], expected[k][0], expected[k][1],
+                 expected[k][2], expected[k][3]);
+         pass = false;
+         return;
+      }
+   }
+}
+
+static void
+test_known_blocks(void)
+{
+   static const uint8_t palette_4color[4][4] = {
+      { 255, 0, 0, 255 }, { 0, 0, 255, 255 },
+      { 170, 0, 85, 255 }, { 85, 0, 170, 255 },
+   };
+   static const uint8_t palette_3color[4][4] = {
+      { 0, 0, 255, 255 }, { 255, 0, 0, 255 },
+      { 127, 0, 127, 255 }, { 0, 0, 0, 0 },
+   };
+   static const uint8_t dxt5_ramp_8[8] = {
+      255, 0, 218, 182, 145, 109, 72, 36
+   };
+   static const uint8_t dxt5_ramp_6[8] = {
+      0, 255, 51, 102, 153, 204, 0, 255
+   };
+   uint8_t expected[16][4];
+   uint8_t block[16];
+   unsigned k;
+
+   for (k = 0; k < 16; k++)
+      memcpy(expected[k], palette_4color[k % 4], 4);
+   check_block("DXT1 4 colors", UTIL_FORMAT_DXT1_RGB, red_blue_4color,
+               expected);
+   check_block("DXT1 RGBA 4 colors", UTIL_FORMAT_DXT1_RGBA, red_blue_4color,
+               expected);
+
+   /* The fourth color is black, and transparent for RGBA. */
+   for (k = 0; k < 16; k++)
+      memcpy(expected[k], palette_3color[k % 4], 4);
+   check_block("DXT1 RGBA 3 colors", UTIL_FORMAT_DXT1_RGBA, blue_red_3color,
+               expected);
+   for (k = 0; k < 16; k++)
+      expected[k][3] = 255;
+   check_block("DXT1 RGB 3 colors", UTIL_FORMAT_DXT1_RGB, blue_red_3color,
+               expected);
+
+   /* DXT3/5 color blocks always have four colors. */
+   memcpy(block, dxt3_alpha, 8);
+   memcpy(block + 8, blue_red_3color, 8);
+   for (k = 0; k < 16; k++) {
+      memcpy(expected[k], palette_4color[k % 4], 4);
+      expected[k][0] = palette_4color[k % 4][2];
+      expected[k][2] = palette_4color[k % 4][0];
+      expected[k][3] = k * 0x11;
+   }
+   check_block("DXT3", UTIL_FORMAT_DXT3_RGBA, block, expected);
+
+   block[0] = 255;
+   block[1] = 0;
+   memcpy(block + 2, dxt5_alpha_codes, 6);
+   for (k = 0; k < 16; k++)
+      expected[k][3] = dxt5_ramp_8[k % 8];
+   check_block("DXT5 8 alphas", UTIL_FORMAT_DXT5_RGBA, block, expected);
+
+   block[0] = 0;
+   block[1] = 255;
+   for (k = 0; k < 16; k++)
+      expected[k][3] = dxt5_ramp_6[k % 8];
+   check_block("DXT5 6 alphas", UTIL_FORMAT_DXT5_RGBA, block, expected);
+}
+
+
+/*
+ * Texel fetches against the block decoder, on random data covering both
+ * DXT1 modes and both DXT5 alpha modes.  The image is 12x8 texels, so that
+ * the row stride matters.
+ */
+
+#define WIDTH 12
+#define HEIGHT 8
+
+static void
+test_fetch(enum util_format_dxtn format)
+{
+   const unsigned bs = block_size(format);
+   uint8_t data[(WIDTH / 4) * (HEIGHT / 4) * 16];
+   uint8_t decoded[HEIGHT][WIDTH][4];
+   unsigned n, x, y;
+   int i, j;
+
+   for (n = 0; n < 64; n++) {
+      for (x = 0; x < sizeof(data); x++)
+         data[x] = random_byte();
+
+      for (y = 0; y < HEIGHT / 4; y++) {
+         for (x = 0; x < WIDTH / 4; x++) {
+            util_format_decode_block_dxtn(format,
+                                          data + (y * (WIDTH / 4) + x) * bs,
+                                          decoded[4 * y][4 * x],
+                                          sizeof(decoded[0]));
+         }
+      }
+
+      for (j = 0; j < HEIGHT; j++) {
+         for (i = 0; i < WIDTH; i++) {
+            uint8_t texel[4];
+
+            fetch_texel(format, WIDTH, data, i, j, texel);
+            if (memcmp(texel, decoded[j][i], 4) != 0) {
+               fprintf(stderr, "%s: fetch of texel %d,%d doesn't match "
+                       "the block decode\n", format_name(format), i, j);
+               pass = false;
+               return;
+            }
+         }
+      }
+   }
+}
+
+
+/*
+ * Encode/decode round trips.  Each test block is a gradient between two
+ * random colors, which the endpoints and their interpolations can follow,
+ * so the error is bounded by the 565 quantization plus half a palette step
+ * (and the inset of the endpoints).
+ */
+
+static void
+test_round_trip(enum util_format_dxtn format)
+{
+   unsigned n, k, c;
+
+   for (n = 0; n < 1000; n++) {
+      const bool transparent = format == UTIL_FORMAT_DXT1_RGBA && (n & 2);
+      uint8_t texels[16][4], decoded[16][4], block[16];
+      uint8_t a[4], b[4];
+      int max_err[4] = { 0, 0, 0, 0 };
+      int bound[4];
+
+      for (c = 0; c < 4; c++) {
+         a[c] = random_byte();
+         b[c] = random_byte();
+      }
+
+      /* every other block is flat */
+      if (n & 1)
+         memcpy(b, a, 4);
+
+      for (k = 0; k < 16; k++) {
+         const unsigned t = (k * 7) % 16;
+
+         for (c = 0; c < 4; c++)
+            texels[k][c] = (a[c] * (15 - t) + b[c] * t + 7) / 15;
+      }
+
+      /* DXT1 has no alpha, only opaque or transparent texels. */
+      if (format == UTIL_FORMAT_DXT1_RGB) {
+         for (k = 0; k < 16; k++)
+            texels[k][3] = 255;
+      }
+      else if (format == UTIL_FORMAT_DXT1_RGBA) {
+         for (k = 0; k < 16; k++)
+            texels[k][3] = transparent && k % 5 == 0 ? 0 : 255;
+      }
+
+      util_format_encode_block_dxtn(format, &texels[0][0], 16, block);
+      util_format_decode_block_dxtn(format, block, &decoded[0][0], 16);
+
+      /* Transparent texels leave only three colors, a step of half the
+       * range apart.
+       */
+      for (c = 0; c < 4; c++) {
+         const int range = abs(a[c] - b[c]);
+
+         bound[c] = (c == 1 ? 4 : 8) + range / (transparent ? 4 : 6);
+      }
+
+      /* 16 DXT3 levels, and an 8 step ramp for DXT5 */
+      if (format == UTIL_FORMAT_DXT3_RGBA)
+         bound[3] = 8;
+      else if (format == UTIL_FORMAT_DXT5_RGBA)
+         bound[3] = 1 + abs(a[3] - b[3]) / 14;
+      else
+         bound[3] = 0;
+
+      for (k = 0; k < 16; k++) {
+         for (c = 0; c < 4; c++) {
+            /* transparent DXT1 texels don't keep their color */
+            if (c < 3 && format == UTIL_FORMAT_DXT1_RGBA &&
+                texels[k][3] == 0)
+               continue;
+            max_err[c] = MAX2(max_err[c], abs(texels[k][c] - decoded[k][c]));
+         }
+      }
+
+      for (c = 0; c < 4; c++) {
+         if (max_err[c] > bound[c]) {
+            fprintf(stderr, "%s: round trip %u has an error of %d in "
+                    "channel %u, more than %d\n", format_name(format), n,
+                    max_err[c], c, bound[c]);
+            pass = false;
+            return;
+         }
+      }
+   }
+}
+
+
+int
+main(int argc, char **argv)
+{
+   unsigned i;
+
+   (void) argc;
+   (void) argv;
+
+   test_known_blocks();
+
+   for (i = 0; i < ARRAY_SIZE(formats); i++) {
+      test_fetch(formats[i]);
+      test_round_trip(formats[i]);
+   }
+
+   return pass ? 0 : 1;
+}